@@ -19,183 +19,145 @@
  */
 
 #include "ai.h"
+#include "tablebase.h"
+#include "kpk.h"
+#include "analysis.h"
+#include "speculation.h"
 
-AI::AI()
+AI::AI() : m_search(m_tt)
 {
-	strcpy(m_pos,"position startpos moves ");
+	setPos("position startpos moves ");
+	strcpy(m_bookPath, BOOK_FILE);
 	m_searchDepth = 10;
 	m_customEngine = false;
+	m_bookSource = "Book";
+	m_outOfBook = false;
+	m_kpkReported = false;
+	m_ponder = true;
+	m_randomize = true;
+	m_pondering = m_ponderHit = m_stopPonder = m_discardBestmove = false;
+	m_ponderMove[0] = 0;
+	m_ponderReply = MOVE_NONE;
 }
 
+// the state machine cleans up after itself once it sees m_active go
 AI::~AI()
 {
-	cleanup();
+	stop();
+	m_search.requestStop();
+	m_stateMachine.join();
+	m_bookPlayer.join();
 }
 
-AI& AI::inst(void)
+// the engine names come in 32 and 64 bit builds
+static bool is64Bit(void)
 {
-	static AI ai;
-	return ai;
+#if defined(_WIN32)
+	return isOS64Bit();
+#else
+	return sizeof(void*) == 8;
+#endif
 }
 
-/* test if the AI process is still running for some reason, and terminate */
-static void checkProcess(const char* name)
+AI& AI::inst(void)
 {
-	PROCESSENTRY32 PE32		= {0};
-	HANDLE hProc			= NULL,
-		   hSnap			= NULL;
-
-	hSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-	PE32.dwSize = sizeof(PROCESSENTRY32);
-
-	Process32First(hSnap, &PE32);
-	do{
-		if(strcmp(PE32.szExeFile, name) == 0){
-			hProc = OpenProcess(PROCESS_TERMINATE, 0, PE32.th32ProcessID);
-
-			if(!TerminateProcess(hProc, 0)){
-				char buf[1024];
-
-				sprintf(buf, "Failed to terminate the previous AI engine process \"%s\", please open task manager and end the process to prevent memory errors.", name);
-				MessageBox(g_hWnd, buf, "Error", MB_ICONERROR);
-			}
-		}
-	} while(Process32Next(hSnap, &PE32));
-
-	CloseHandle(hProc);
-	CloseHandle(hSnap);
+	static AI ai;
+	return ai;
 }
 
 bool AI::init(int engine)
 {
-	bool engine_started = false;
-	bool b64bit = isOS64Bit();
-	bool jobSuccess = false;
+	bool b64bit = is64Bit();
+	const char* name;
+	char exe[64];
 
 	m_engine = engine;
 	memset(m_engine_path, 0, sizeof(m_engine_path));
 
-	// set up the security attributes
-	m_sa.bInheritHandle = true;
-	m_sa.lpSecurityDescriptor = NULL;
-	m_sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+	if(!m_book.isOpen() && m_bookPath[0] != 0){
+		if(m_book.open(m_bookPath))
+			printf("Opened book %s (%d entries)\n", m_bookPath, m_book.getNumEntries());
+		else
+			printf("No opening book at %s\n", m_bookPath);
+	}
 
-	// setup job to kill the child process when calling process terminates
-	m_hJob = CreateJobObject(NULL, NULL);
-	if(m_hJob != NULL){
-		m_jeli.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+	if(!Syzygy::inst().isInitialized()){
+		int tables = Syzygy::inst().init();
 
-		jobSuccess = SetInformationJobObject(m_hJob, JobObjectExtendedLimitInformation, &m_jeli, sizeof(m_jeli));
+		if(tables > 0)
+			printf("Found %d Syzygy tables (up to %d pieces) in %s\n", tables, Syzygy::inst().getMaxPieces(), Syzygy::inst().getPath());
 	}
 
-	// open a pipe to the AI engine
-	if(!CreatePipe(&m_child_stdin, &m_hWrite, &m_sa, 0)){
-		throw std::runtime_error("CreatePipe - stdin");
-		return false;
-	}
+	// the built-in engine runs in-process, there is nothing to launch
+	if(m_engine == ENGINE_BUILTIN){
+		strcpy(m_engine_path, "built-in");
+		m_active = true;
 
-	if(!CreatePipe(&m_hRead, &m_child_stdout, &m_sa, 0)){
-		throw std::runtime_error("CreatePipe - stdout");
-		cleanup();
-		return false;
+		// the network is mapped once and shared, without it the classical evaluation is used
+		if(!Network::inst().isLoaded()){
+			if(Network::inst().load(NNUE_FILE))
+				printf("Loaded network %s (%s)\n", NNUE_FILE, Network::inst().getKernelName());
+			else
+				printf("No network at %s, using classical evaluation\n", NNUE_FILE);
+		}
+
+		if(!m_stateMachine.start(&InitThread, this)){
+			m_active = false;
+			printf("Failed to start the built-in engine\n");
+			return false;
+		}
+		return true;
 	}
 
-	// prepare to launch the process
-	GetStartupInfo(&m_si);
-	m_si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-	m_si.wShowWindow = SW_HIDE;
-	m_si.hStdOutput = m_child_stdout;
-	m_si.hStdError = m_child_stdout;
-	m_si.hStdInput = m_child_stdin;
-
-	for(;!engine_started;){
-		switch(m_engine){
-			case ENGINE_HOUDINI:
-				if(b64bit){
-					strcpy(m_engine_path, "Data/Engines/Houdini_x64.exe");
-					checkProcess("Houdini_x64.exe");
-				}
-				else{
-					strcpy(m_engine_path, "Data/Engines/Houdini_x86.exe");
-					checkProcess("Houdini_x86.exe");
-				}
-				break;
+	switch(m_engine){
+		case ENGINE_HOUDINI:
+			name = b64bit ? "Houdini_x64" : "Houdini_x86";
+			break;
 
-			case ENGINE_STOCKFISH:
-				if(b64bit){
-					strcpy(m_engine_path, "Data/Engines/Stockfish_x64.exe");
-					checkProcess("Stockfish_x64.exe");
-				}
-				else{
-					strcpy(m_engine_path, "Data/Engines/Stockfish_x86.exe");
-					checkProcess("Stockfish_x86.exe");
-				}
-				break;
+		case ENGINE_STOCKFISH:
+			name = b64bit ? "Stockfish_x64" : "Stockfish_x86";
+			break;
 
-			case ENGINE_CRITTER:
-				if(b64bit){
-					strcpy(m_engine_path, "Data/Engines/Critter_x64.exe");
-					checkProcess("Critter_x64.exe");
-				}
-				else{
-					strcpy(m_engine_path, "Data/Engines/Critter_x86.exe");
-					checkProcess("Critter_x86.exe");
-				}
-				break;
+		case ENGINE_CRITTER:
+			name = b64bit ? "Critter_x64" : "Critter_x86";
+			break;
 
-			case ENGINE_CUSTOM:
-				strcpy(m_engine_path, "Data/Engines/Custom.exe");
-				break;
+		case ENGINE_CUSTOM:
+			name = "Custom";
+			break;
 
-			default:
-				throw std::runtime_error("No valid engine found");
-				cleanup();
-				return false;
-		}
+		default:
+			throw std::runtime_error("No valid engine found");
+			return false;
+	}
 
-		// attempt to launch the process
-		engine_started =
-			CreateProcess(m_engine_path, 
-						  NULL,
-						  NULL,
-						  NULL,
-						  TRUE,
-						  0,
-						  NULL,
-						  NULL,
-						  &m_si,
-						  &m_pi);
-
-		if(!engine_started){
-			if(engine > 0)
-				engine = 0;
-			else
-				++engine;
+	// a copy left running by an earlier crash would hold on to its memory
+	sprintf(exe, "%s%s", name, ENGINE_EXE_SUFFIX);
+	if(m_engine != ENGINE_CUSTOM)
+		EngineProcess::killStale(exe);
 
-			continue;
-		}
+	sprintf(m_engine_path, "Data/Engines/%s", exe);
 
-		break;
+	// no usable engine binary, play with the built-in engine instead
+	if(!m_process.start(m_engine_path)){
+		printf("Failed to launch \"%s\", using the built-in engine\n", m_engine_path);
+		return init(ENGINE_BUILTIN);
 	}
 
-	// assign the job to the process
-	if(jobSuccess){
-		jobSuccess = AssignProcessToJobObject(m_hJob, m_pi.hProcess);
+	if(!m_reader.start(&ReaderThread, this)){
+		m_process.close();
+		printf("Failed to start reading \"%s\", using the built-in engine\n", m_engine_path);
+		return init(ENGINE_BUILTIN);
 	}
 
-	// change states
-	//m_active = true;
-	//m_thinking = true;
-	
-	// set process priority to below normal to prevent destruction of the CPU
-	SetPriorityClass(m_pi.hProcess, BELOW_NORMAL_PRIORITY_CLASS);
-
-	// set AI to active
-	if(engine_started){
-		m_active = true;
+	m_active = true;
 
-		// start the state machine thread
-		(void)CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)&InitThread, this, 0, 0);
+	// start the state machine thread
+	if(!m_stateMachine.start(&InitThread, this)){
+		m_active = false;
+		cleanup();
+		printf("Failed to start the state machine for \"%s\", using the built-in engine\n", m_engine_path);
+		return init(ENGINE_BUILTIN);
 	}
 
 	return true;
@@ -206,67 +168,172 @@ void AI::reset(void)
 	char buf[1024];
 
 	//sprintf(buf, "stop ");
-	//WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL); // allowing this command on the first run caused a hang-up when trying again or quitting the program (only in release mode, weird)
-	//WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+	//send(buf); // allowing this command on the first run caused a hang-up when trying again or quitting the program (only in release mode, weird)
+
+	m_outOfBook = false;
+	m_kpkReported = false;
+
+	if(m_pondering)
+		stopPondering();
+
+	if(m_engine == ENGINE_BUILTIN){
+		Speculation::inst().setPosition(NULL, SearchLimits());
+		m_tt.clear();
+		m_search.clearHistory();
+		setPos("position startpos moves ");
+		return;
+	}
 
-	Sleep(200);
+	sleepMs(200);
 
 	if(m_engine == ENGINE_HOUDINI){
 		sprintf(buf, "ucinewgame ");
-		WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-		WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+		send(buf);
 	}
 
-	strcpy(m_pos,"position startpos moves ");
+	setPos("position startpos moves ");
 }
 
-unsigned long WINAPI AI::InitThread(void* lpThread)
+// the analysis, hint and mate finder threads follow the game through this copy
+void AI::getPos(char* out, size_t n)
 {
-	if(lpThread){
-		return ((AI*)lpThread)->_AI(NULL);
+	m_posLock.lock();
+	strncpy(out, m_pos, n - 1);
+	out[n - 1] = 0;
+	m_posLock.unlock();
+}
+
+void AI::appendMove(const char* move)
+{
+	m_posLock.lock();
+	strcat(m_pos, move);
+	strcat(m_pos, " ");
+	m_posLock.unlock();
+}
+
+void AI::InitThread(void* arg)
+{
+	AI* ai = (AI*)arg;
+
+	if(ai->m_engine == ENGINE_BUILTIN)
+		ai->_BuiltinAI();
+	else
+		ai->_AI();
+}
+
+// node budget for each difficulty. Unlike a depth limit it costs about the same
+// CPU time in every position, and any UCI engine honours "go nodes".
+static U64 levelNodes(unsigned int level)
+{
+	switch(level){
+	case Game::CHILD:
+		return 1000;
+
+	case Game::WALRUS:
+		return 10000;
+
+	case Game::LION:
+	default:
+		return 60000;
+
+	case Game::RAPTOR:
+		return 400000;
+
+	case Game::GRANDMASTER:
+		return 3000000;
 	}
+}
+
+// with randomization on, the weaker levels play any of their best lines within
+// this many centipawns of the best, rather than repeating the same game
+static int levelMargin(unsigned int level)
+{
+	switch(level){
+	case Game::CHILD:
+		return 150;
+
+	case Game::WALRUS:
+		return 80;
+
+	case Game::LION:
+	default:
+		return 30;
+
+	case Game::RAPTOR:
+		return 10;
+
+	case Game::GRANDMASTER:
+		return 0;
+	}
+}
 
-	return 0;
+// an external engine only reports its best move, so its budget varies instead, by up to a quarter
+static U64 randomizeNodes(U64 nodes)
+{
+	return nodes - nodes / 4 + (U64)rand() * (nodes / 2) / RAND_MAX;
+}
+
+// the weakest levels don't ponder, they'd barely use the time and it keeps the CPU quiet
+static bool levelPonder(unsigned int level)
+{
+	return level != Game::CHILD && level != Game::WALRUS;
 }
 
 // thread for state machine
-DWORD WINAPI AI::_AI(LPVOID lpBuffer)
+void AI::_AI(void)
 {
 	Game& game = Game::inst();
 	char buf[BUFSIZE] = {0};
-	memset(buf, 0, sizeof(buf));
-	int depth = 1;
-	static unsigned int aiLevel = 99;
-
-	Sleep(500);
+	std::string output;
+	U64 nodes;
 
 	for(int i=0;m_active;++i){
-		GetExitCodeProcess(m_pi.hProcess, &m_exit);
-		if(m_exit != STILL_ACTIVE){
+		if(!m_process.isAlive()){
 			m_active = false;
 			printf("NOT ACTIVE...quitting\n");
 			//break;
 		}
 		
-		// check for output, and obtain the bread
-		PeekNamedPipe(m_hRead, buf, BUFSIZE, &m_bread, &m_avail, NULL);
-		if(m_bread > 0){
-			for(;;){
-				memset(buf, 0, sizeof(buf));
-
-				ReadFile(m_hRead, buf, BUFSIZE, &m_bread, NULL);
-				printf("%s", buf);
-				if(!game.getTurn())
-					parseAIMove(buf);
-
-				Sleep(100);
-
-				PeekNamedPipe(m_hRead, buf, BUFSIZE, &m_bread, &m_avail, NULL);
-				if(m_bread > 0)
-					continue;
-				else
-					break;
-			}
+		// whole lines collected by the reader thread, in the order they came
+		while(takeOutput(output)){
+			strcpy(buf, output.c_str());
+			printf("%s", buf);
+
+			// the engine always searches for black, even while pondering
+			Analysis::inst().parseInfo(buf, SIDE_BLACK);
+
+			// the answer to a stopped ponder search is for a position that never happened
+			if(m_discardBestmove && strstr(buf, "bestmove"))
+				m_discardBestmove = false;
+			else if(!game.getTurn())
+				parseAIMove(buf);
+		}
+
+		if(m_stopPonder){
+			m_stopPonder = false;
+
+			sprintf(buf, "stop ");
+			send(buf);
+		}
+
+		// think on the expected reply while the user is choosing a move
+		if(m_ponderMove[0] && !m_pondering && game.getTurn() == WHITE && m_ponder && levelPonder(game.getAILevel())){
+			TimeManager timeMan;
+			char pos[sizeof(m_pos) + 8];
+
+			timeMan.init(game.getTime(BLACK), game.getIncrement(), 0);
+
+			sprintf(pos, "%s%s ", m_pos, m_ponderMove);
+			send(pos);
+
+			nodes = levelNodes(game.getAILevel());
+			if(m_randomize)
+				nodes = randomizeNodes(nodes);
+
+			sprintf(buf, "go ponder nodes %llu movetime %u ", nodes, timeMan.getOptimum());
+			send(buf);
+
+			m_pondering = true;
 		}
 
 		if(m_engine == ENGINE_STOCKFISH){
@@ -274,83 +341,203 @@ DWORD WINAPI AI::_AI(LPVOID lpBuffer)
 			sprintf(buf, (i == 0) ? "uci " : "");
 		}
 		else{
-			sprintf(buf, (i == 0) ? "uci " : (i == 1) ? "isready " : (i == 2) ? "setoption name Hash value 512 " : (i == 3) ? "setoption name UCI_LimitStrength value true " : "");
+			sprintf(buf, (i == 0) ? "uci " : (i == 1) ? "isready " : (i == 2) ? "setoption name Hash value 512 " : "");
 		}
-		if(m_sendMove == true){
-			strcat(m_pos, m_lastUserMove);
-			strcat(m_pos, " ");
-
-			WriteFile(m_hWrite, m_pos, sizeof(m_pos), &m_bread, NULL);
-			WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+		if(m_sendMove == true && m_ponderHit){
+			appendMove(m_lastUserMove);
 
-			//sprintf(buf, "go wtime %ld btime %ld depth %d ", g_whiteTime, g_blackTime, m_searchDepth);
-			while(game.isAnimating())
-				Sleep(50);
-
-			// calculate depth to search
-			if(m_engine != ENGINE_STOCKFISH){
-				if(aiLevel != game.getAILevel()){
-					aiLevel = game.getAILevel();
-					switch(aiLevel){
-					case Game::CHILD:
-						depth = 1;
-						sprintf(buf, "setoption name UCI_Elo value 1000 "); // it's questionable whether or not this works
-						break;
+			// the engine has been searching this position all along
+			sprintf(buf, "ponderhit ");
+			send(buf);
 
-					case Game::WALRUS:
-						depth = 3;
-						sprintf(buf, "setoption name UCI_Elo value 1200 ");
-						break;
+			m_ponderHit = false;
+			m_sendMove = false;
+			game.setTurn(BLACK);
+		}
+		else if(m_sendMove == true){
+			appendMove(m_lastUserMove);
 
-					case Game::LION:
-					default:
-						depth = 5;
-						sprintf(buf, "setoption name UCI_Elo value 1500 ");
-						break;
+			send(m_pos);
 
-					case Game::RAPTOR:
-						depth = 10;
-						sprintf(buf, "setoption name UCI_Elo value 1800 ");
-						break;
+			//sprintf(buf, "go wtime %ld btime %ld depth %d ", g_whiteTime, g_blackTime, m_searchDepth);
+			while(m_active && game.isAnimating())
+				sleepMs(50);
 
-					case Game::GRANDMASTER:
-						depth = 15;
-						sprintf(buf, "setoption name UCI_Elo value 2900 ");
-						break;
-					}
+			// the node budget keeps the difficulty, the clock share caps the reply time
+			nodes = levelNodes(game.getAILevel());
+			if(m_randomize)
+				nodes = randomizeNodes(nodes);
 
-					WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-					WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
-				}
-			}
+			TimeManager timeMan;
+			timeMan.init(game.getTime(BLACK), game.getIncrement(), 0);
 
-			//sprintf(buf, "go wtime %ld btime %ld ", game.getTime(WHITE), game.getTime(BLACK));
-			sprintf(buf, "go wtime %ld btime %ld depth %d ", game.getTime(WHITE), game.getTime(BLACK), depth);
-			WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-			WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+			sprintf(buf, "go nodes %llu movetime %u ", nodes, timeMan.getOptimum());
+			send(buf);
 
 			//printf("NEW POS: [%s]\n", m_pos);
 
 			m_sendMove = false;
 			game.setTurn(BLACK);
 		}
-		else{
-			WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-			WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
-
-			if(i > 100000)
-				i = 6;
+		else if(buf[0]){
+			send(buf);
 		}
 
-		Sleep(500);
+		if(i > 100000)
+			i = 6;
+
+		// engine output, a queued command or the user's move wakes the loop at once
+		flushCommands();
+		m_wake.wait(AI_IDLE_WAIT);
 		
 		//if(game.getTurn() == WHITE)
 			//;///printf("Waiting for user to move...\n");
 	}
 
 	cleanup();
+}
+
+// thread for the built-in engine's state machine
+void AI::_BuiltinAI(void)
+{
+	Game& game = Game::inst();
+	Position pos, ponderPos;
+	SearchLimits limits;
+	SearchLine lines[MAX_MULTIPV];
+	Move best = MOVE_NONE, ponderMove = MOVE_NONE, reply;
+	int numLines;
+	bool hit;
+	char buf[64];
+	char move[8];
+
+	m_search.setOutput(Graphics::inst().getDebugConsole());
+
+	for(;m_active;){
+		if(m_sendMove == true){
+			appendMove(m_lastUserMove);
+
+			while(m_active && game.isAnimating())
+				sleepMs(50);
+
+			m_sendMove = false;
+			game.setTurn(BLACK);
+
+			if(!pos.setPosition(m_pos)){
+				printf("Built-in engine can't follow the game: [%s]\n", m_pos);
+				continue;
+			}
+
+			// the time manager budgets the clock, the node budget keeps the difficulty
+			limits.nodes = levelNodes(game.getAILevel());
+			limits.time = game.getTime(BLACK);
+			limits.inc = game.getIncrement();
+			limits.ponder = false;
+			limits.multipv = (m_randomize && levelMargin(game.getAILevel()) > 0) ? BUILTIN_VARIETY_LINES : 1;
+
+			// a correct prediction was searched while the user thought, and so
+			// may have been the reply they chose, with the same limits. Both are
+			// taken at once so a stale answer can't be played on a later move.
+			hit = m_ponderHit;
+			reply = m_ponderReply;
+			m_ponderHit = false;
+			m_ponderReply = MOVE_NONE;
+
+			if(hit && reply != MOVE_NONE){
+				best = reply;
+				if(!m_search.getLines(lines, numLines))
+					numLines = 0;
+			}
+			else if(Speculation::inst().probe(pos.getKey(), limits, lines, numLines)){
+				best = lines[0].moves[0];
+				printf("Speculative hit\n");
+			}
+			else{
+				best = m_search.think(pos, limits);
+				if(!m_search.getLines(lines, numLines))
+					numLines = 0;
+			}
+
+			if(limits.multipv > 1)
+				best = pickVariedMove(lines, numLines, best, levelMargin(game.getAILevel()));
+
+			if(best == MOVE_NONE)
+				continue;
 
-	ExitThread(0);
+			Position::moveToStr(best, move);
+
+			// hand the move over exactly as an external engine would report it
+			sprintf(buf, "bestmove %s\n", move);
+			printf("%s", buf);
+			parseAIMove(buf);
+
+			// the user's likely replies are searched ahead while they think
+			Speculation::inst().setPosition(m_pos, limits);
+
+			ponderMove = MOVE_NONE;
+			if(m_ponder && levelPonder(game.getAILevel())){
+				for(int i=0; i<numLines; ++i){
+					if(lines[i].length > 1 && lines[i].moves[0] == best){
+						ponderMove = lines[i].moves[1];
+						break;
+					}
+				}
+			}
+
+			// a hit or stop the last ponder search didn't need mustn't end this one early
+			if(ponderMove != MOVE_NONE){
+				Position::moveToStr(ponderMove, m_ponderMove);
+				m_search.clearPonderhit();
+				m_search.clearStop();
+				m_pondering = true;
+			}
+		}
+		else if(ponderMove != MOVE_NONE){
+			// search the position after the expected reply into the shared table,
+			// the clock only starts if the user plays it
+			ponderPos = pos;
+			ponderPos.makeMove(best);
+			ponderPos.makeMove(ponderMove);
+			ponderMove = MOVE_NONE;
+
+			limits.time = game.getTime(BLACK);
+			limits.ponder = true;
+			m_ponderReply = MOVE_NONE;
+			if(m_pondering)
+				m_ponderReply = m_search.think(ponderPos, limits);
+
+			// a finished ponder search waits for the user's move
+			while(m_active && m_pondering && !m_sendMove)
+				sleepMs(50);
+		}
+
+		sleepMs(50);
+	}
+}
+
+// one of the best lines within margin centipawns of the best, the closer the likelier
+Move AI::pickVariedMove(const SearchLine* lines, int num, Move best, int margin)
+{
+	int weights[MAX_MULTIPV];
+	int total = 0;
+
+	if(num < 2 || abs(lines[0].score) >= VALUE_MATE_IN_MAX)
+		return best;
+
+	for(int i=0; i<num; ++i){
+		int loss = lines[0].score - lines[i].score;
+
+		weights[i] = (loss <= margin && lines[i].length > 0) ? margin - loss + 1 : 0;
+		total += weights[i];
+	}
+
+	int r = rand() % total;
+	for(int i=0; i<num; ++i){
+		if(r < weights[i])
+			return lines[i].moves[0];
+		r -= weights[i];
+	}
+
+	return best;
 }
 
 void AI::parseAIMove(const char* str)
@@ -368,10 +555,17 @@ void AI::parseAIMove(const char* str)
 			char* p = token + BESTMOVE_OFFSET;
             printf("FOUND: %s\n", p);
             
+            // the engine's guess at the user's reply, for pondering
+            char* ponder = strstr(p, "ponder ");
+            m_ponderMove[0] = 0;
+            if(ponder){
+                strncpy(m_ponderMove, ponder + 7, 4);
+                m_ponderMove[4] = 0;
+            }
+
             *(p + BESTMOVE_END_OFFSET) = 0;
 
-            strcat(m_pos, p);
-            strcat(m_pos, " ");
+            appendMove(p);
             printf("NEW POS: [%s]\n", m_pos);
 
 			strcpy(m_lastAIMove, p);
@@ -419,8 +613,11 @@ void AI::moveAIPiece(void)
 	// get new i component
 	game.setNewSelectionX(m_lastAIMove[3] - '0');
 
-	while(game.isAnimating())
-		Sleep(100);
+	while(m_active && game.isAnimating())
+		sleepMs(100);
+
+	if(!m_active)
+		return;
 
 	game.movePiece();
 
@@ -460,29 +657,248 @@ void AI::moveAgainst(void)
 		case 6: m_lastUserMove[2] = 'g'; break;
 		case 7: m_lastUserMove[2] = 'h'; break;
 	}
+
+	// the player has moved, the speculative workers give the cores back
+	if(m_engine == ENGINE_BUILTIN)
+		Speculation::inst().setPosition(NULL, SearchLimits());
+
+	// a correct prediction lets the pondering search carry on as the real one
+	if(m_pondering){
+		if(strncmp(m_lastUserMove, m_ponderMove, 4) == 0){
+			m_pondering = false;
+			m_ponderHit = true;
+			m_ponderMove[0] = 0;
+
+			if(m_engine == ENGINE_BUILTIN)
+				m_search.ponderhit();
+
+			m_sendMove = true;
+			m_wake.set();
+			return;
+		}
+
+		stopPondering();
+	}
+
+	// the engine never hears about moves answered from the book until the next position command
+	if(playBookMove() || playTablebaseMove())
+		return;
 	
 	m_sendMove = true;
+	m_wake.set();
+}
+
+// the user played something else, the engine's search is for a position that won't happen
+void AI::stopPondering(void)
+{
+	m_pondering = false;
+	m_ponderMove[0] = 0;
+
+	// latched, the state machine may be just about to start the ponder search
+	if(m_engine == ENGINE_BUILTIN){
+		m_search.requestStop();
+	}
+	else{
+		m_discardBestmove = true;
+		m_stopPonder = true;
+		m_wake.set();
+	}
+}
+
+bool AI::playBookMove(void)
+{
+	char buf[sizeof(m_pos) + 8];
+	Move m;
+
+	if(m_outOfBook || !m_book.isOpen())
+		return false;
+
+	sprintf(buf, "%s%s", m_pos, m_lastUserMove);
+	if(!m_bookPos.setPosition(buf) || (m = m_book.probe(m_bookPos)) == MOVE_NONE){
+		m_outOfBook = true;
+		return false;
+	}
+
+	appendMove(m_lastUserMove);
+
+	// the board only knows four character moves, promotions are always to a queen
+	Position::moveToStr(m, m_bookMove);
+	m_bookMove[4] = 0;
+
+	m_bookSource = "Book";
+	m_bookPlayer.join();
+	m_bookPlayer.start(&BookThread, this);
+	return true;
+}
+
+// once the position is in the endgame tables the result is known, so the
+// reply comes from them without waiting for the engine
+bool AI::playTablebaseMove(void)
+{
+	char buf[sizeof(m_pos) + 8];
+	const char* result;
+	int value;
+	bool win;
+	Move m;
+
+	sprintf(buf, "%s%s", m_pos, m_lastUserMove);
+	if(!m_bookPos.setPosition(buf))
+		return false;
+
+	if((m = Tablebases::inst().probeRoot(m_bookPos, value)) != MOVE_NONE){
+		result = tbIsWin(value) ? "black wins" : tbIsLoss(value) ? "white wins" : "draw";
+	}
+	else if((m = Syzygy::inst().probeRoot(m_bookPos, value)) != MOVE_NONE){
+		result = (value == WDL_WIN) ? "black wins" : (value == WDL_LOSS) ? "white wins"
+			: (value == WDL_DRAW) ? "draw" : "draw by the fifty move rule";
+	}
+	else{
+		// the bitbase knows the result but not the move, so the engine still plays
+		if(!m_kpkReported && kpkProbe(m_bookPos, win)){
+			int strong = m_bookPos.getPieces(SIDE_WHITE, P_PAWN) ? SIDE_WHITE : SIDE_BLACK;
+
+			printf("KPK bitbase result: %s\n", !win ? "draw" : (strong == SIDE_WHITE) ? "white wins" : "black wins");
+			m_kpkReported = true;
+		}
+
+		return false;
+	}
+
+	printf("Tablebase result: %s\n", result);
+
+	appendMove(m_lastUserMove);
+
+	Position::moveToStr(m, m_bookMove);
+	m_bookMove[4] = 0;
+
+	m_bookSource = "Tablebase";
+	m_bookPlayer.join();
+	m_bookPlayer.start(&BookThread, this);
+	return true;
+}
+
+// plays the book reply once the user's move has finished on the board. The
+// previous one has always finished by then, so joining it doesn't wait.
+void AI::BookThread(void* arg)
+{
+	AI* ai = (AI*)arg;
+	Game& game = Game::inst();
+	char buf[32];
+
+	while(ai->m_active && (game.getTurn() != BLACK || game.isAnimating()))
+		sleepMs(50);
+
+	if(!ai->m_active)
+		return;
+
+	sprintf(buf, "bestmove %s\n", ai->m_bookMove);
+	printf("%s: %s", ai->m_bookSource, buf);
+	ai->parseAIMove(buf);
 }
 
 void AI::cleanup(void)
 {
 	char buf[1024];
 
+	if(m_engine == ENGINE_BUILTIN){
+		m_search.requestStop();
+		return;
+	}
+
 	// tell the AI engine to terminate
 	if(m_engine != ENGINE_STOCKFISH){ // stockfish is a real piece of work
 		sprintf(buf, "stop ");
-		WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-		WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+		send(buf);
 
 		sprintf(buf, "quit ");
-		WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-		WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+		send(buf);
+	}
+
+	flushCommands();
+
+	// whatever didn't quit is terminated, which ends the reader with the output
+	m_process.kill();
+	m_reader.join();
+	m_process.close();
+
+	m_ioLock.lock();
+	m_commands.clear();
+	m_engineOutput.clear();
+	m_ioLock.unlock();
+}
+
+// commands from any thread are written by the state machine, in order, as
+// exactly the command and its newline
+void AI::send(const char* command)
+{
+	m_ioLock.lock();
+	m_commands += command;
+	m_commands += '\n';
+	m_ioLock.unlock();
+
+	m_wake.set();
+}
+
+// everything queued since the last flush goes out in one write
+void AI::flushCommands(void)
+{
+	std::string commands;
+
+	m_ioLock.lock();
+	commands.swap(m_commands);
+	m_ioLock.unlock();
+
+	if(!commands.empty() && !m_process.write(commands.data(), commands.size()))
+		printf("Failed to write to \"%s\"\n", m_engine_path);
+}
+
+bool AI::takeOutput(std::string& output)
+{
+	bool taken = false;
+
+	m_ioLock.lock();
+	if(!m_engineOutput.empty()){
+		output.swap(m_engineOutput.front());
+		m_engineOutput.pop_front();
+		taken = true;
 	}
+	m_ioLock.unlock();
+
+	return taken;
+}
+
+void AI::ReaderThread(void* arg)
+{
+	((AI*)arg)->readOutput();
+}
+
+// blocks on the engine's output and hands it over a whole number of lines at a
+// time, no longer than the state machine's buffer. Ends with the output itself.
+void AI::readOutput(void)
+{
+	char buf[BUFSIZE];
+	int len = 0, n;
 
-	if(m_pi.hThread) CloseHandle(m_pi.hThread);
-	if(m_pi.hProcess) CloseHandle(m_pi.hProcess);
-	if(m_child_stdin)	CloseHandle(m_child_stdin);
-	if(m_child_stdout)	CloseHandle(m_child_stdout);
-	if(m_hRead)		CloseHandle(m_hRead);
-	if(m_hWrite)	CloseHandle(m_hWrite);
+	while((n = m_process.read(buf + len, BUFSIZE - 1 - len)) > 0){
+		int end;
+
+		len += n;
+
+		// a line that fills the whole buffer goes as it is
+		for(end=len; end>0 && buf[end - 1] != '\n'; --end)
+			;
+		if(end == 0 && len == BUFSIZE - 1)
+			end = len;
+
+		if(end > 0){
+			m_ioLock.lock();
+			m_engineOutput.push_back(std::string(buf, end));
+			m_ioLock.unlock();
+
+			memmove(buf, buf + end, len - end);
+			len -= end;
+
+			m_wake.set();
+		}
+	}
 }
\ No newline at end of file
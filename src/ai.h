@@ -20,15 +20,25 @@
 
 #pragma once
 
-#include <Windows.h>
-#include <TlHelp32.h>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
+#include <string>
+#include <deque>
 
 #include "game.h"
 #include "graphics.h"
+#include "search.h"
+#include "book.h"
+#include "syzygy.h"
+#include "engineprocess.h"
+#include "thread.h"
 
 #define BUFSIZE 65535
+#define AI_MAX_PATH		260
+#define AI_POS_SIZE		4096			// the position command with every move of the game
+#define AI_IDLE_WAIT	500				// milliseconds the external engine's state machine sleeps with nothing to do
+#define BUILTIN_VARIETY_LINES	4		// candidate lines for the randomized levels
 
 // a state machine for the AI
 
@@ -39,10 +49,11 @@ public:
 		ENGINE_HOUDINI = 0,
 		ENGINE_CRITTER,
 		ENGINE_CUSTOM,
-		ENGINE_STOCKFISH
+		ENGINE_STOCKFISH,
+		ENGINE_BUILTIN
 	};
 
-	char customEngine[MAX_PATH];
+	char customEngine[AI_MAX_PATH];
 
 	AI();
 	~AI();
@@ -58,10 +69,14 @@ public:
 	// getter functions
 	bool isActive(void);
 	bool isThinking(void);
-	char* getPos(void);
+	void getPos(char* out, size_t n);					// a copy taken under the lock, for other threads
 	int getEngine(void);
 	char* getEnginePath(void);
 	bool getCustomEngine(void);
+	bool getPonder(void);
+	bool getRandomize(void);
+	const char* getStatsFile(void);
+	const char* getBookPath(void);
 	
 	// setter functions
 	void stop(void);
@@ -70,20 +85,37 @@ public:
 	void setPos(const char* pos);
 	void setCustomEngine(bool custom);
 	void setEngine(int engine);
+	void setPonder(bool ponder);							// think during the user's turn, where the level allows
+	void setRandomize(bool randomize);					// vary the weaker levels' moves
+	void setStatsFile(const char* file);				// built-in engine's per-iteration statistics CSV
+	void setBookPath(const char* path);					// empty to play without a book
 
 private:
 	void cleanup(void);
-	static unsigned long WINAPI InitThread(void* lpThread);
-	DWORD WINAPI _AI(LPVOID lpBuffer);
+	static void InitThread(void* arg);
+	void _AI(void);
+	void _BuiltinAI(void);
+	static void BookThread(void* arg);
+	bool playBookMove(void);
+	bool playTablebaseMove(void);
+	void stopPondering(void);
+	Move pickVariedMove(const SearchLine* lines, int num, Move best, int margin);
 	void parseAIMove(const char* str);
+	void send(const char* command);
+	void flushCommands(void);
+	bool takeOutput(std::string& output);
+	static void ReaderThread(void* arg);
+	void readOutput(void);
 	void moveAIPiece(void);
+	void appendMove(const char* move);
 
-	char m_pos[4096];			// holds all the moves for engine to interpret
+	char m_pos[AI_POS_SIZE];	// holds all the moves for engine to interpret
+	Mutex m_posLock;			// held for every change, the renderer copies it every frame
 	char m_lastAIMove[32];
 	char m_lastUserMove[32];
 
 	int m_engine;
-	char m_engine_path[MAX_PATH];
+	char m_engine_path[AI_MAX_PATH];
 	bool m_customEngine;
 
 	// AI difficulty options
@@ -91,22 +123,45 @@ private:
 	unsigned int m_elo;
 
 	// states
+	Thread m_stateMachine;
 	bool m_thinking;
-	bool m_active;
+	volatile bool m_active;
 	bool m_init;
 	bool m_sendMove;
 	
-	unsigned long m_exit;
-	unsigned long m_bread;
-	unsigned long m_avail;
-
-	// engine process variables
-	STARTUPINFO m_si;
-	PROCESS_INFORMATION m_pi;
-	SECURITY_ATTRIBUTES m_sa;
-	HANDLE m_child_stdin, m_child_stdout, m_hRead, m_hWrite;
-	HANDLE m_hJob;
-	JOBOBJECT_EXTENDED_LIMIT_INFORMATION m_jeli;
+	// external engine. A reader thread queues its output in whole lines, commands
+	// are queued from any thread, and the state machine wakes on either.
+	EngineProcess m_process;
+	Thread m_reader;
+	Event m_wake;
+	Mutex m_ioLock;
+	std::deque<std::string> m_engineOutput;
+	std::string m_commands;				// queued lines, written together
+
+	// built-in engine
+	TransTable m_tt;
+	Search m_search;
+
+	// opening book, answered without the engine
+	Book m_book;
+	Position m_bookPos;
+	Thread m_bookPlayer;			// plays the answer once the user's move is on the board
+	char m_bookPath[AI_MAX_PATH];
+	char m_bookMove[8];
+	const char* m_bookSource;		// "Book" or "Tablebase", for the console
+	bool m_outOfBook;
+	bool m_kpkReported;				// the bitbase result is printed once per game
+
+	// pondering on the expected reply during the user's turn
+	bool m_ponder;
+	volatile bool m_pondering;
+	volatile bool m_ponderHit;		// the user played the expected move
+	volatile bool m_stopPonder;		// external engine: send stop
+	volatile bool m_discardBestmove;	// external engine: ignore the stopped search's answer
+	char m_ponderMove[8];
+	Move m_ponderReply;				// built-in engine: answer to the expected move
+
+	bool m_randomize;
 };
 
 inline bool AI::isActive(void)
@@ -114,11 +169,6 @@ inline bool AI::isActive(void)
 	return m_active;
 }
 
-inline char* AI::getPos(void)
-{
-	return m_pos;
-}
-
 inline int AI::getEngine(void)
 {
 	return m_engine;
@@ -134,12 +184,31 @@ inline bool AI::getCustomEngine(void)
 	return m_customEngine;
 }
 
+inline const char* AI::getBookPath(void)
+{
+	return m_bookPath;
+}
+
+inline bool AI::getPonder(void)
+{
+	return m_ponder;
+}
+
+inline bool AI::getRandomize(void)
+{
+	return m_randomize;
+}
+
+inline const char* AI::getStatsFile(void)
+{
+	return m_search.getStatsFile();
+}
+
 inline void AI::setELO(unsigned int elo){
 	char buf[256] = {0};
 
 	sprintf(buf, "setoption name UCI_Elo value %d ", elo);
-	WriteFile(m_hWrite, buf, sizeof(buf), &m_bread, NULL);
-	WriteFile(m_hWrite, "\n", 1, &m_bread, NULL);
+	send(buf);
 
 	m_elo = elo;
 }
@@ -147,11 +216,14 @@ inline void AI::setELO(unsigned int elo){
 inline void AI::stop(void)
 {
 	m_active = false;
+	m_wake.set();
 }
 
 inline void AI::setPos(const char* pos)
 {
+	m_posLock.lock();
 	strcpy(m_pos, pos);
+	m_posLock.unlock();
 }
 
 inline void AI::setCustomEngine(bool custom)
@@ -162,4 +234,26 @@ inline void AI::setCustomEngine(bool custom)
 inline void AI::setEngine(int engine)
 {
 	m_engine = engine;
-}
\ No newline at end of file
+}
+
+inline void AI::setBookPath(const char* path)
+{
+	strncpy(m_bookPath, path, sizeof(m_bookPath) - 1);
+	m_bookPath[sizeof(m_bookPath) - 1] = 0;
+	m_book.close();
+}
+
+inline void AI::setPonder(bool ponder)
+{
+	m_ponder = ponder;
+}
+
+inline void AI::setRandomize(bool randomize)
+{
+	m_randomize = randomize;
+}
+
+inline void AI::setStatsFile(const char* file)
+{
+	m_search.setStatsFile(file);
+}
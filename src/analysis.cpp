@@ -0,0 +1,286 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include "analysis.h"
+
+Analysis::Analysis()
+{
+	m_tt = NULL;
+	m_search = NULL;
+	m_pos[0] = 0;
+	m_generation = 0;
+	m_searchGeneration = 0;
+	m_side = SIDE_WHITE;
+	m_numLines = ANALYSIS_DEFAULT_LINES;
+	m_hasEngineLine = false;
+	m_running = false;
+	m_finished = true;
+}
+
+Analysis::~Analysis()
+{
+	stop();
+}
+
+Analysis& Analysis::inst(void)
+{
+	static Analysis analysis;
+	return analysis;
+}
+
+bool Analysis::start(void)
+{
+	if(m_running)
+		return true;
+
+	m_tt = new TransTable();
+	m_search = new Search(*m_tt);
+
+	m_lock.lock();
+	m_pos[0] = 0;
+	++m_generation;
+	m_lock.unlock();
+
+	m_running = true;
+	m_finished = false;
+
+	if(!m_thread.start(&worker, this)){
+		printf("Failed to start the analysis thread\n");
+		m_running = false;
+		m_finished = true;
+		delete m_search;
+		delete m_tt;
+		m_search = NULL;
+		m_tt = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void Analysis::stop(void)
+{
+	if(!m_search)
+		return;
+
+	// a stop can land just before the worker starts the next search, so repeat it
+	m_running = false;
+	while(!m_finished){
+		m_search->stop();
+		sleepMs(10);
+	}
+
+	m_thread.join();
+
+	delete m_search;
+	delete m_tt;
+	m_search = NULL;
+	m_tt = NULL;
+}
+
+// called every frame: a changed position is picked up by the worker, and the
+// stale search is stopped until the worker has moved on to it
+void Analysis::setPosition(const char* pos)
+{
+	if(!m_running)
+		return;
+
+	m_lock.lock();
+
+	if(strcmp(pos, m_pos) != 0){
+		strncpy(m_pos, pos, sizeof(m_pos) - 1);
+		m_pos[sizeof(m_pos) - 1] = 0;
+		++m_generation;
+	}
+
+	if(m_searchGeneration != m_generation)
+		m_search->stop();
+
+	m_lock.unlock();
+}
+
+void Analysis::setNumLines(int num)
+{
+	if(num < 1)
+		num = 1;
+	if(num > MAX_MULTIPV)
+		num = MAX_MULTIPV;
+
+	m_lock.lock();
+	if(num != m_numLines){
+		m_numLines = num;
+		++m_generation;
+	}
+	m_lock.unlock();
+}
+
+void Analysis::worker(void* arg)
+{
+	((Analysis*)arg)->run();
+}
+
+void Analysis::run(void)
+{
+	char pos[sizeof(m_pos)];
+	unsigned int generation = m_generation - 1;
+	Position board;
+	SearchLimits limits;
+	U64 signature = 0;
+
+	while(m_running){
+		m_lock.lock();
+		bool changed = (generation != m_generation);
+		if(changed){
+			generation = m_generation;
+			strcpy(pos, m_pos);
+			limits.multipv = m_numLines;
+		}
+		m_searchGeneration = generation;
+		m_lock.unlock();
+
+		if(!changed || !board.setPosition(pos)){
+			sleepMs(20);
+			continue;
+		}
+
+		// the file is versioned by the evaluation that fills it, and the built-in
+		// engine may load the network after start(). Deleting the table at stop()
+		// saves it, so the next session starts warm.
+		if(m_search->getSignature() != signature){
+			signature = m_search->getSignature();
+			m_tt->mapFile(ANALYSIS_TT_FILE, ANALYSIS_TT_MB, signature);
+		}
+
+		// no limits, runs until the position changes or the search reaches its maximum depth
+		m_search->clearLines();
+		m_side = board.getSide();
+		m_search->think(board, limits);
+	}
+
+	m_finished = true;
+}
+
+bool Analysis::getLines(AnalysisLine* lines, int& num)
+{
+	SearchLine found[MAX_MULTIPV];
+	char buf[8];
+
+	if(!m_running || !m_search->getLines(found, num))
+		return false;
+
+	for(int i=0; i<num; ++i){
+		int length = (found[i].length < ANALYSIS_PV_MOVES) ? found[i].length : ANALYSIS_PV_MOVES;
+
+		lines[i].depth = found[i].depth;
+		lines[i].score = (m_side == SIDE_WHITE) ? found[i].score : -found[i].score;
+		lines[i].pv[0] = 0;
+
+		for(int j=0; j<length; ++j){
+			Position::moveToStr(found[i].moves[j], buf);
+			if(j > 0)
+				strcat(lines[i].pv, " ");
+			strcat(lines[i].pv, buf);
+		}
+	}
+
+	return true;
+}
+
+bool Analysis::getEngineLine(AnalysisLine& line)
+{
+	bool found;
+
+	if(!m_lock.tryLock())
+		return false;
+
+	found = m_hasEngineLine;
+	if(found)
+		line = m_engineLine;
+
+	m_lock.unlock();
+	return found;
+}
+
+// keeps the first line of "info depth d [multipv 1] score cp|mate x ... pv m1 m2 ..."
+void Analysis::parseInfo(const char* str, int side)
+{
+	AnalysisLine line;
+
+	for(const char* p = str; p && *p;){
+		const char* start = p;
+		const char* end = strchr(p, '\n');
+		const char* token;
+		int len = end ? (int)(end - p) : (int)strlen(p);
+		char buf[1024];
+
+		p = end ? end + 1 : NULL;
+
+		if(strncmp(start, "info ", 5) != 0 || strncmp(start, "info string", 11) == 0 || len >= (int)sizeof(buf))
+			continue;
+
+		memcpy(buf, start, len);
+		buf[len] = 0;
+
+		if(len > 0 && buf[len - 1] == '\r')
+			buf[len - 1] = 0;
+
+		if((token = strstr(buf, " multipv ")) != NULL && atoi(token + 9) != 1)
+			continue;
+
+		if((token = strstr(buf, " depth ")) == NULL)
+			continue;
+		line.depth = atoi(token + 7);
+
+		if((token = strstr(buf, " score cp ")) != NULL){
+			line.score = atoi(token + 10);
+		}
+		else if((token = strstr(buf, " score mate ")) != NULL){
+			int mate = atoi(token + 12);
+
+			line.score = (mate > 0) ? VALUE_MATE - (2 * mate - 1) : -VALUE_MATE - 2 * mate;
+		}
+		else{
+			continue;
+		}
+
+		if((token = strstr(buf, " pv ")) == NULL)
+			continue;
+
+		// the first moves of the line, cut at a move boundary
+		strncpy(line.pv, token + 4, sizeof(line.pv) - 1);
+		line.pv[sizeof(line.pv) - 1] = 0;
+		if(strlen(token + 4) >= sizeof(line.pv) - 1){
+			char* cut = strrchr(line.pv, ' ');
+			if(cut)
+				*cut = 0;
+		}
+
+		if(side != SIDE_WHITE)
+			line.score = -line.score;
+
+		m_lock.lock();
+		m_engineLine = line;
+		m_hasEngineLine = true;
+		m_lock.unlock();
+	}
+}
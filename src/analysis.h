@@ -0,0 +1,95 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+#pragma once
+
+#include "search.h"
+
+#define ANALYSIS_DEFAULT_LINES	3
+#define ANALYSIS_PV_MOVES		8		// moves of each line kept for the panel
+#define ANALYSIS_TEXT			(ANALYSIS_PV_MOVES * 6 + 1)
+#define ANALYSIS_TT_FILE		"Data/analysis.tt"	// kept between sessions
+#define ANALYSIS_TT_MB			128
+
+// one line for the analysis panel, scored from white's point of view
+struct AnalysisLine{
+	int depth;
+	int score;
+	char pv[ANALYSIS_TEXT];
+};
+
+// continuous multi-PV analysis of the game position on a background thread,
+// plus the last line reported by an external engine. The getters never block,
+// so the render thread can poll them every frame.
+class Analysis{
+public:
+	static Analysis& inst(void);
+
+	bool start(void);
+	void stop(void);
+
+	void setPosition(const char* pos);					// UCI position command, restarts the search when it changed
+	void parseInfo(const char* str, int side);			// UCI info lines of an engine searching for side
+
+	// getter functions
+	bool getLines(AnalysisLine* lines, int& num);		// false when busy, keep the previous lines
+	bool getEngineLine(AnalysisLine& line);				// false when busy or nothing was reported
+	bool isRunning(void) const;
+	int getNumLines(void) const;
+
+	// setter functions
+	void setNumLines(int num);
+
+private:
+	Analysis();
+	~Analysis();
+	Analysis(const Analysis&);
+	Analysis& operator=(const Analysis&);
+
+	static void worker(void* arg);
+	void run(void);
+
+	// allocated while running, so the table costs nothing when the panel is off
+	TransTable* m_tt;
+	Search* m_search;
+	Thread m_thread;
+
+	Mutex m_lock;										// guards the position and the engine line
+	char m_pos[4096];
+	unsigned int m_generation;							// bumped for every new position
+	volatile unsigned int m_searchGeneration;			// position the worker is searching
+	volatile int m_side;
+	int m_numLines;
+
+	AnalysisLine m_engineLine;
+	bool m_hasEngineLine;
+
+	volatile bool m_running;
+	volatile bool m_finished;
+};
+
+inline bool Analysis::isRunning(void) const
+{
+	return m_running;
+}
+
+inline int Analysis::getNumLines(void) const
+{
+	return m_numLines;
+}
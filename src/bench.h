@@ -0,0 +1,42 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "search.h"
+
+#define BENCH_DEPTH		7
+#define BENCH_HASH_MB	16
+
+extern const char* BENCH_POSITIONS[];
+extern const int NUM_BENCH_POSITIONS;
+extern const U64 BENCH_SIGNATURE;
+
+// totals of one pass over the bench suite
+struct BenchResult{
+	U64 nodes;
+	U64 signature;		// hash of every position's node count and best move
+	unsigned int ms;
+};
+
+// searches every bench position to a fixed depth with a fixed size table. The
+// result only depends on the search and evaluation, so the signature changes
+// with any functional change while the time tracks the speed of the build.
+BenchResult runBench(Search& search, TransTable& tt, int depth, bool verbose);
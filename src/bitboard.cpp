@@ -0,0 +1,119 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include "bitboard.h"
+
+U64 g_pawnAttacks[2][SQUARE_NB];
+U64 g_knightAttacks[SQUARE_NB];
+U64 g_kingAttacks[SQUARE_NB];
+
+// ray directions, the first four increase the square index
+enum{
+	DIR_NORTH = 0,
+	DIR_EAST,
+	DIR_NORTH_EAST,
+	DIR_NORTH_WEST,
+	DIR_SOUTH,
+	DIR_WEST,
+	DIR_SOUTH_WEST,
+	DIR_SOUTH_EAST,
+	DIR_NB
+};
+
+static U64 s_rays[DIR_NB][SQUARE_NB];
+
+// sets the bit at (file, rank) if it's on the board
+static U64 safeSquare(int file, int rank)
+{
+	if(file < 0 || file > 7 || rank < 0 || rank > 7)
+		return 0;
+
+	return squareBB(makeSquare(file, rank));
+}
+
+void initBitboards(void)
+{
+	static bool initialized = false;
+	const int rayStep[DIR_NB][2] = { {0, 1}, {1, 0}, {1, 1}, {-1, 1}, {0, -1}, {-1, 0}, {-1, -1}, {1, -1} };
+	const int knightStep[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+
+	if(initialized)
+		return;
+
+	for(int sq=0; sq<SQUARE_NB; ++sq){
+		int f = fileOf(sq), r = rankOf(sq);
+
+		g_pawnAttacks[SIDE_WHITE][sq] = safeSquare(f - 1, r + 1) | safeSquare(f + 1, r + 1);
+		g_pawnAttacks[SIDE_BLACK][sq] = safeSquare(f - 1, r - 1) | safeSquare(f + 1, r - 1);
+
+		g_knightAttacks[sq] = 0;
+		for(int i=0; i<8; ++i)
+			g_knightAttacks[sq] |= safeSquare(f + knightStep[i][0], r + knightStep[i][1]);
+
+		g_kingAttacks[sq] = 0;
+		for(int i=0; i<DIR_NB; ++i)
+			g_kingAttacks[sq] |= safeSquare(f + rayStep[i][0], r + rayStep[i][1]);
+
+		for(int i=0; i<DIR_NB; ++i){
+			s_rays[i][sq] = 0;
+			for(int d=1; d<8; ++d){
+				U64 b = safeSquare(f + rayStep[i][0] * d, r + rayStep[i][1] * d);
+				if(!b)
+					break;
+				s_rays[i][sq] |= b;
+			}
+		}
+	}
+
+	initialized = true;
+}
+
+// filled while the program loads, before main or any thread can run. The tools
+// start search threads without building a Position first, and the lazy call
+// above isn't safe for several threads at once.
+static struct BitboardInit{
+	BitboardInit() { initBitboards(); }
+} s_bitboardInit;
+
+// attacks along a ray stopping at (and including) the first blocker
+static inline U64 rayAttacks(int dir, int sq, U64 occupied)
+{
+	U64 attacks = s_rays[dir][sq];
+	U64 blockers = attacks & occupied;
+
+	if(blockers){
+		int blocker = (dir < DIR_SOUTH) ? lsb(blockers) : msb(blockers);
+		attacks ^= s_rays[dir][blocker];
+	}
+
+	return attacks;
+}
+
+U64 bishopAttacks(int sq, U64 occupied)
+{
+	return rayAttacks(DIR_NORTH_EAST, sq, occupied) | rayAttacks(DIR_NORTH_WEST, sq, occupied) |
+		   rayAttacks(DIR_SOUTH_WEST, sq, occupied) | rayAttacks(DIR_SOUTH_EAST, sq, occupied);
+}
+
+U64 rookAttacks(int sq, U64 occupied)
+{
+	return rayAttacks(DIR_NORTH, sq, occupied) | rayAttacks(DIR_EAST, sq, occupied) |
+		   rayAttacks(DIR_SOUTH, sq, occupied) | rayAttacks(DIR_WEST, sq, occupied);
+}
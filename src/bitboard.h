@@ -0,0 +1,143 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+// bitboard primitives for the built-in engine (no Windows or OpenGL
+// dependencies so the engine can also be built headless)
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+typedef unsigned long long U64;
+
+#define SQUARE_NB	64
+#define FILE_A_BB	0x0101010101010101ULL
+#define FILE_H_BB	0x8080808080808080ULL
+#define RANK_1_BB	0x00000000000000FFULL
+#define RANK_8_BB	0xFF00000000000000ULL
+
+// a1 = 0, b1 = 1 ... h8 = 63
+enum squares{
+	SQ_A1 = 0, SQ_B1, SQ_C1, SQ_D1, SQ_E1, SQ_F1, SQ_G1, SQ_H1,
+	SQ_A8 = 56, SQ_B8, SQ_C8, SQ_D8, SQ_E8, SQ_F8, SQ_G8, SQ_H8,
+	SQ_NONE = 64
+};
+
+// the GUI defines WHITE/BLACK as bools, so the engine uses its own names
+enum sides{
+	SIDE_WHITE = 0,
+	SIDE_BLACK = 1
+};
+
+enum pieceTypes{
+	P_PAWN = 0,
+	P_KNIGHT,
+	P_BISHOP,
+	P_ROOK,
+	P_QUEEN,
+	P_KING,
+	P_NONE
+};
+
+// colored pieces are (type * 2 + side), NO_PIECE marks an empty square
+#define NO_PIECE	12
+
+inline int makePiece(int side, int type)	{ return (type << 1) | side; }
+inline int pieceType(int piece)				{ return piece >> 1; }
+inline int pieceSide(int piece)				{ return piece & 1; }
+inline int fileOf(int sq)					{ return sq & 7; }
+inline int rankOf(int sq)					{ return sq >> 3; }
+inline int makeSquare(int file, int rank)	{ return (rank << 3) | file; }
+inline int relativeRank(int side, int sq)	{ return (side == SIDE_WHITE) ? rankOf(sq) : 7 - rankOf(sq); }
+inline U64 squareBB(int sq)					{ return 1ULL << sq; }
+
+inline int popCount(U64 b)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	return (int)__popcnt64(b);
+#elif defined(_MSC_VER)
+	return (int)(__popcnt((unsigned int)b) + __popcnt((unsigned int)(b >> 32)));
+#else
+	return __builtin_popcountll(b);
+#endif
+}
+
+// index of the least significant set bit, b must be non-zero
+inline int lsb(U64 b)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long idx;
+	_BitScanForward64(&idx, b);
+	return (int)idx;
+#elif defined(_MSC_VER)
+	unsigned long idx;
+	if((unsigned int)b){
+		_BitScanForward(&idx, (unsigned int)b);
+		return (int)idx;
+	}
+	_BitScanForward(&idx, (unsigned int)(b >> 32));
+	return (int)idx + 32;
+#else
+	return __builtin_ctzll(b);
+#endif
+}
+
+// index of the most significant set bit, b must be non-zero
+inline int msb(U64 b)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long idx;
+	_BitScanReverse64(&idx, b);
+	return (int)idx;
+#elif defined(_MSC_VER)
+	unsigned long idx;
+	if(b >> 32){
+		_BitScanReverse(&idx, (unsigned int)(b >> 32));
+		return (int)idx + 32;
+	}
+	_BitScanReverse(&idx, (unsigned int)b);
+	return (int)idx;
+#else
+	return 63 - __builtin_clzll(b);
+#endif
+}
+
+inline int popLsb(U64& b)
+{
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+
+// attack tables, filled by initBitboards()
+extern U64 g_pawnAttacks[2][SQUARE_NB];
+extern U64 g_knightAttacks[SQUARE_NB];
+extern U64 g_kingAttacks[SQUARE_NB];
+
+void initBitboards(void);
+U64 bishopAttacks(int sq, U64 occupied);
+U64 rookAttacks(int sq, U64 occupied);
+
+inline U64 queenAttacks(int sq, U64 occupied)
+{
+	return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+}
@@ -0,0 +1,75 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+#include "mappedfile.h"
+
+#define BOOK_FILE			"Data/Books/book.bin"
+#define BOOK_NUM_KEYS		781
+#define BOOK_ENTRY_SIZE		16
+#define BOOK_STARTPOS_KEY	0x463B96181691FC9CULL		// published key of the initial position
+
+// one book entry as stored on disk (big endian, sorted by key)
+struct BookEntry{
+	U64 key;
+	unsigned short move;
+	unsigned short weight;
+	unsigned int learn;
+};
+
+// Polyglot opening book, memory-mapped and searched in place
+class Book{
+public:
+	Book();
+
+	bool open(const char* file);
+	void close(void);
+
+	Move probe(Position& pos);					// weighted random book move, MOVE_NONE when out of book
+
+	static bool checkKeys(void);
+	static U64 polyglotKey(const Position& pos);
+	static unsigned short polyglotMove(Move m);
+
+	// getter functions
+	bool isOpen(void) const;
+	int getNumEntries(void) const;
+
+private:
+	BookEntry readEntry(int idx) const;
+	int findFirst(U64 key) const;
+	unsigned int random(void);
+
+	MappedFile m_file;
+	int m_numEntries;
+	unsigned int m_seed;
+};
+
+inline bool Book::isOpen(void) const
+{
+	return m_file.isOpen();
+}
+
+inline int Book::getNumEntries(void) const
+{
+	return m_numEntries;
+}
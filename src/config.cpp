@@ -19,6 +19,10 @@
  */
 
 #include "config.h"
+#include "analysis.h"
+#include "mate.h"
+#include "hint.h"
+#include "speculation.h"
 
 extern Music g_music;
 
@@ -73,9 +77,21 @@ int ConfigParser::parseValue(const char* valueName)
 	return 0;
 }
 
+// options added after a file was written fall back to their shipped value
+int ConfigParser::parseValue(const char* valueName, int def)
+{
+	char* p = parseStrValue(valueName);
+	int n = def;
+
+	if(p != NULL)
+		sscanf(p, "%d", &n);
+
+	return n;
+}
+
 char* ConfigParser::parseStrValue(const char* valueName)
 {
-	char buf[1024] = {0};
+	static char buf[1024];				// the result points into this, so it must outlive the call
 	char* p = 0;
 	int len = strlen(valueName);
 	int n = 0;
@@ -117,10 +133,21 @@ bool ConfigParser::saveAll(void)
 			"planet=%d\n"
 			"texture=%d\n"
 			"time=%d\n"
+			"increment=%d\n"
 			"music=%d\n"
 			"ai_engine=%d\n"
 			"ai_custom_engine=%d\n"
 			"ai=%d\n"
+			"ponder=%d\n"
+			"randomize=%d\n"
+			"analysis=%d\n"
+			"multipv=%d\n"
+			"mate_search=%d\n"
+			"hints=%d\n"
+			"speculate=%d\n"
+			"book=%s\n"
+			"tb_path=%s\n"
+			"stats_csv=%s\n"
 			"\n[Graphics]\n"
 			"AA=%d\n"
 			"reflections=%d\n"
@@ -134,11 +161,22 @@ bool ConfigParser::saveAll(void)
 			game.getPlanet(),
 			game.getTextureMode(),
 			game.getTime(),
+			game.getIncrement(),
 			g_music.isPlaying(),
 			
 			AI::inst().getEngine(),
 			AI::inst().getCustomEngine(),
 			game.getAILevel(),
+			AI::inst().getPonder(),
+			AI::inst().getRandomize(),
+			Analysis::inst().isRunning(),
+			Analysis::inst().getNumLines(),
+			MateFinder::inst().isRunning() ? MateFinder::inst().getMateBound() : 0,
+			Hint::inst().isRunning(),
+			Speculation::inst().isRunning() ? Speculation::inst().getCpuPercent() : 0,
+			AI::inst().getBookPath(),
+			Syzygy::inst().getPath(),
+			AI::inst().getStatsFile(),
 
 			graphics.getAntialiasing(),
 			graphics.useReflection(),
@@ -38,6 +38,7 @@ public:
 	~ConfigParser(void);
 
 	int parseValue(const char* valueName);
+	int parseValue(const char* valueName, int def);		// def when the file has no such key
 	char* parseStrValue(const char* valueName);
 	bool isLoaded(void) const;
 	bool saveAll(void);
@@ -67,7 +67,8 @@ BOOL CALLBACK OptionsProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 			SendMessage(hBox, CB_ADDSTRING, 0, (LPARAM)"Houdini");
 			SendMessage(hBox, CB_ADDSTRING, 0, (LPARAM)"Critter");
 			SendMessage(hBox, CB_ADDSTRING, 0, (LPARAM)"Custom");
-			SendMessage(hBox, CB_SETCURSEL, (WPARAM)AI::inst().getEngine(), 0);
+			SendMessage(hBox, CB_ADDSTRING, 0, (LPARAM)"Built-in");
+			SendMessage(hBox, CB_SETCURSEL, (WPARAM)((AI::inst().getEngine() == AI::ENGINE_BUILTIN) ? AI::ENGINE_CUSTOM + 1 : AI::inst().getEngine()), 0);
 
 			hBox = GetDlgItem(hwnd, IDC_COMBO_AI_LEVEL);
 			SendMessage(hBox, CB_ADDSTRING, 0, (LPARAM)"Child");
@@ -180,7 +181,7 @@ BOOL CALLBACK OptionsProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
 				x = SendDlgItemMessage(hwnd, IDC_COMBO_AI_ENGINE, CB_GETCURSEL, 0, 0);
 				if(x == (AI::ENGINE_CUSTOM + 1)){
-					x -= 1;
+					x = AI::ENGINE_BUILTIN;
 				}
 				AI::inst().setEngine(x);
 
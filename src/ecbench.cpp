@@ -0,0 +1,220 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// headless benchmark for the built-in engine
+//
+// usage: ecbench [-compare | -eval] [depth]
+//
+// searches the bench suite to a fixed depth on one thread and prints the node
+// count, a signature and the speed. The signature only changes when the search
+// or evaluation does, so two builds can be compared by it and by their nps.
+// At the default depth with the classical evaluation it is also checked
+// against the reference recorded in bench.cpp.
+//
+//   -compare       search the suite twice, as plain alpha-beta and with the
+//                  selective search enabled, and print both node counts
+//   -eval          score the suite's positions and those two plies on, one at a
+//                  time and with evaluateBatch, and print both speeds
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "bench.h"
+
+#define EVAL_POOL		256				// positions set up at a time, each one is large
+#define EVAL_ROUNDS		5
+
+static void printCacheStats(const EvalStats& stats)
+{
+	U64 pawnProbes = stats.pawnHits + stats.pawnMisses;
+	U64 cacheProbes = stats.cacheHits + stats.cacheMisses;
+
+	printf("eval cache: %llu hits, %llu misses (%.1f%%)\n", stats.cacheHits, stats.cacheMisses,
+		   cacheProbes ? 100.0 * stats.cacheHits / cacheProbes : 0.0);
+	printf("pawn hash:  %llu hits, %llu misses (%.1f%%)\n\n", stats.pawnHits, stats.pawnMisses,
+		   pawnProbes ? 100.0 * stats.pawnHits / pawnProbes : 0.0);
+}
+
+// the bench positions and every position two plies on, without repeats
+static void collectPositions(std::vector<std::string>& fens)
+{
+	std::set<U64> seen;
+	Position pos;
+	Move moves[MAX_MOVES], replies[MAX_MOVES];
+	char fen[128];
+
+	for(int i=0; i<NUM_BENCH_POSITIONS; ++i){
+		pos.setFEN(BENCH_POSITIONS[i]);
+
+		int n = pos.genLegalMoves(moves);
+		for(int j=0; j<n; ++j){
+			pos.makeMove(moves[j]);
+
+			int m = pos.genLegalMoves(replies);
+			for(int k=0; k<m; ++k){
+				pos.makeMove(replies[k]);
+				if(seen.insert(pos.getKey()).second){
+					pos.getFEN(fen);
+					fens.push_back(fen);
+				}
+				pos.unmakeMove(replies[k]);
+			}
+
+			pos.unmakeMove(moves[j]);
+		}
+	}
+}
+
+// only the evaluation is timed, setting the positions up is not
+static void runEvalBench(Evaluator& evaluator, const std::vector<std::string>& fens, Position* pool)
+{
+	static const Position* ptrs[EVAL_POOL];
+	static int scalar[EVAL_POOL], batch[EVAL_POOL];
+	U64 scalarTicks = 0, batchTicks = 0, count = 0;
+	int mismatches = 0;
+
+	for(int i=0; i<EVAL_POOL; ++i)
+		ptrs[i] = &pool[i];
+
+	for(int round=0; round<EVAL_ROUNDS; ++round){
+		for(size_t base=0; base<fens.size(); base+=EVAL_POOL){
+			int n = (fens.size() - base < EVAL_POOL) ? (int)(fens.size() - base) : EVAL_POOL;
+			unsigned int start;
+
+			for(int i=0; i<n; ++i)
+				pool[i].setFEN(fens[base + i].c_str());
+
+			// the cache would answer repeats, so every pass starts without it
+			evaluator.clear();
+			start = getTimeMs();
+			for(int i=0; i<n; ++i)
+				scalar[i] = evaluator.evaluate(pool[i]);
+			scalarTicks += getTimeMs() - start;
+
+			evaluator.clear();
+			start = getTimeMs();
+			evaluator.evaluateBatch(ptrs, n, batch);
+			batchTicks += getTimeMs() - start;
+
+			for(int i=0; i<n; ++i)
+				mismatches += (scalar[i] != batch[i]);
+			count += n;
+		}
+	}
+
+	printf("scalar: %llu positions, %llu ms, %.0f positions/s\n", count, scalarTicks,
+		   scalarTicks ? count * 1000.0 / scalarTicks : 0.0);
+	printf("batch:  %llu positions, %llu ms, %.0f positions/s (%.2fx)\n", count, batchTicks,
+		   batchTicks ? count * 1000.0 / batchTicks : 0.0, batchTicks ? (double)scalarTicks / batchTicks : 0.0);
+
+	if(mismatches)
+		printf("%d scores differ between the two\n", mismatches);
+	printf("\n");
+}
+
+static void printResult(const BenchResult& result)
+{
+	printf("total %llu nodes, %u ms\n", result.nodes, result.ms);
+	printf("signature %016llx\n", result.signature);
+	printf("nps %llu\n", result.ms ? result.nodes * 1000 / result.ms : result.nodes * 1000);
+}
+
+int main(int argc, char* argv[])
+{
+	TransTable tt;
+	Search search(tt);
+	int depth = BENCH_DEPTH;
+	bool compare = false, eval = false;
+	BenchResult full, selective;
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-compare") == 0)
+			compare = true;
+		else if(strcmp(argv[i], "-eval") == 0)
+			eval = true;
+		else if(argv[i][0] == '-' || atoi(argv[i]) < 1){
+			printf("usage: ecbench [-compare | -eval] [depth]\n");
+			return 1;
+		}
+		else
+			depth = atoi(argv[i]);
+	}
+
+	if(Network::inst().load(NNUE_FILE))
+		printf("network: %s (%s)\n", NNUE_FILE, Network::inst().getKernelName());
+	else
+		printf("network: none, classical evaluation\n");
+
+	if(eval){
+		std::vector<std::string> fens;
+		Position* pool = new Position[EVAL_POOL];
+
+		collectPositions(fens);
+		printf("eval: %u positions, %d rounds\n\n", (unsigned int)fens.size(), EVAL_ROUNDS);
+
+		if(Network::inst().isLoaded()){
+			printf("network\n");
+			runEvalBench(search.getEvaluator(), fens, pool);
+			Network::inst().unload();
+		}
+
+		printf("classical\n");
+		runEvalBench(search.getEvaluator(), fens, pool);
+
+		delete[] pool;
+		return 0;
+	}
+
+	printf("bench: %d positions, depth %d, %d MB hash, 1 thread\n\n", NUM_BENCH_POSITIONS, depth, BENCH_HASH_MB);
+
+	if(!compare){
+		search.getEvaluator().clearStats();
+		selective = runBench(search, tt, depth, true);
+		printf("\n");
+		printResult(selective);
+
+		if(depth == BENCH_DEPTH && !Network::inst().isLoaded())
+			printf("reference %016llx, %s\n", BENCH_SIGNATURE, (selective.signature == BENCH_SIGNATURE) ? "matches" : "DIFFERS");
+		return 0;
+	}
+
+	printf("full width (selectivity off)\n");
+	search.setSelectivity(false);
+	search.getEvaluator().clearStats();
+	full = runBench(search, tt, depth, true);
+	printResult(full);
+	printCacheStats(search.getEvaluator().getStats());
+
+	printf("selective (null move, LMR, futility, LMP)\n");
+	search.setSelectivity(true);
+	search.getEvaluator().clearStats();
+	selective = runBench(search, tt, depth, true);
+	printResult(selective);
+	printCacheStats(search.getEvaluator().getStats());
+
+	if(selective.nodes > 0)
+		printf("node reduction: %.1fx\n", (double)full.nodes / (double)selective.nodes);
+
+	return 0;
+}
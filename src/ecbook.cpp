@@ -0,0 +1,533 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// headless Polyglot book builder
+//
+// usage: ecbook [options] file.pgn ...
+//
+//   -o file        output book (default book.bin)
+//   -threads n     worker threads (default: one per core)
+//   -plies n       only record the first n plies of each game (default 30)
+//   -min n         drop moves played in fewer than n games (default 3)
+//   -score n       drop moves scoring under n percent for the side that played them (default 0)
+//
+// the main thread splits the PGN files into batches of games, the workers
+// replay them through the rules core and merge (position, move) counts into
+// sharded tables, and the result is written sorted by key
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+
+#include "book.h"
+#include "search.h"
+#include "thread.h"
+
+#define NUM_SHARDS		64
+#define BATCH_GAMES		256
+#define MAX_QUEUED		64				// batches waiting for a worker
+#define MAX_WORKERS		64
+#define LINE_SIZE		65536
+
+struct BookKey{
+	U64 key;
+	unsigned short move;
+};
+
+struct BookKeyHash{
+	size_t operator()(const BookKey& k) const
+	{
+		return (size_t)(k.key ^ (k.move * 0x9E3779B97F4A7C15ULL));
+	}
+};
+
+inline bool operator==(const BookKey& a, const BookKey& b)
+{
+	return a.key == b.key && a.move == b.move;
+}
+
+struct MoveStats{
+	unsigned int games;
+	unsigned int wins;
+	unsigned int draws;
+};
+
+typedef std::unordered_map<BookKey, MoveStats, BookKeyHash> StatsMap;
+
+struct Shard{
+	Mutex lock;
+	StatsMap stats;
+};
+
+// one move seen in a game, result is 2/1/0 for a win/draw/loss of the side that played it
+struct Record{
+	BookKey bk;
+	int result;
+};
+
+struct OutEntry{
+	U64 key;
+	unsigned short move;
+	unsigned int weight;
+};
+
+struct Worker{
+	Thread thread;
+	U64 games;
+	U64 skipped;
+	U64 moves;
+};
+
+typedef std::vector<std::string> Batch;
+
+static Shard s_shards[NUM_SHARDS];
+static Mutex s_queueLock;
+static std::deque<Batch*> s_queue;
+static bool s_readDone = false;
+static int s_maxPlies = 30;
+
+// the result tag decides whether a game is usable at all
+static int parseResult(const char* str)
+{
+	if(strncmp(str, "1-0", 3) == 0)
+		return 2;
+	if(strncmp(str, "0-1", 3) == 0)
+		return 0;
+	if(strncmp(str, "1/2-1/2", 7) == 0)
+		return 1;
+
+	return -1;
+}
+
+// [Tag "value"], copies the value
+static bool parseTag(const char* line, const char* tag, char* value, int size)
+{
+	int len = (int)strlen(tag);
+	const char* p;
+	int n = 0;
+
+	if(line[0] != '[' || strncmp(line + 1, tag, len) != 0 || !isspace((unsigned char)line[len + 1]))
+		return false;
+
+	if((p = strchr(line, '"')) == NULL)
+		return false;
+
+	for(++p; *p && *p != '"' && n < size - 1; ++p)
+		value[n++] = *p;
+	value[n] = 0;
+
+	return true;
+}
+
+static bool replayGame(Position& pos, const std::string& game, std::vector<Record>* records, U64& moves)
+{
+	const char* text = game.c_str();
+	const char* p = text;
+	char value[256], token[64];
+	int whiteResult = -1, ply = 0;
+	bool fen = false;
+
+	// tag section
+	while(*p == '['){
+		if(parseTag(p, "Result", value, sizeof(value)))
+			whiteResult = parseResult(value);
+		else if(parseTag(p, "FEN", value, sizeof(value)))
+			fen = pos.setFEN(value);
+
+		while(*p && *p != '\n')
+			++p;
+		while(*p && isspace((unsigned char)*p))
+			++p;
+	}
+
+	if(whiteResult < 0)
+		return false;
+	if(!fen)
+		pos.setFEN(START_FEN);
+
+	// movetext, skipping comments, variations and annotation glyphs
+	while(*p && ply < s_maxPlies){
+		int depth = 0, len = 0;
+
+		if(isspace((unsigned char)*p)){
+			++p;
+			continue;
+		}
+
+		if(*p == '{'){
+			while(*p && *p != '}')
+				++p;
+			if(*p)
+				++p;
+			continue;
+		}
+
+		if(*p == ';'){
+			while(*p && *p != '\n')
+				++p;
+			continue;
+		}
+
+		if(*p == '('){
+			do{
+				if(*p == '(') ++depth;
+				else if(*p == ')') --depth;
+				++p;
+			} while(*p && depth > 0);
+			continue;
+		}
+
+		while(*p && !isspace((unsigned char)*p) && *p != '{' && *p != '(' && *p != ';' && len < (int)sizeof(token) - 1)
+			token[len++] = *p++;
+		token[len] = 0;
+
+		if(token[0] == '$' || parseResult(token) >= 0 || token[0] == '*')
+			continue;
+
+		// move numbers, possibly glued to the move ("12.e4", "12...Nf6")
+		char* san = token;
+		while(isdigit((unsigned char)*san))
+			++san;
+		while(*san == '.')
+			++san;
+		if(*san == 0)
+			continue;
+
+		Move m = pos.parseSAN(san);
+		if(m == MOVE_NONE)
+			break;
+
+		Record r;
+		r.bk.key = Book::polyglotKey(pos);
+		r.bk.move = Book::polyglotMove(m);
+		r.result = (pos.getSide() == SIDE_WHITE) ? whiteResult : 2 - whiteResult;
+		records[r.bk.key >> 58].push_back(r);
+
+		pos.makeMove(m);
+		++ply;
+		++moves;
+	}
+
+	return true;
+}
+
+static void mergeRecords(std::vector<Record>* records)
+{
+	for(int i=0; i<NUM_SHARDS; ++i){
+		if(records[i].empty())
+			continue;
+
+		Shard& shard = s_shards[i];
+		shard.lock.lock();
+
+		for(size_t j=0; j<records[i].size(); ++j){
+			const Record& r = records[i][j];
+			StatsMap::iterator it = shard.stats.find(r.bk);
+
+			if(it == shard.stats.end()){
+				MoveStats ms = {0, 0, 0};
+				it = shard.stats.insert(std::make_pair(r.bk, ms)).first;
+			}
+
+			++it->second.games;
+			if(r.result == 2)
+				++it->second.wins;
+			else if(r.result == 1)
+				++it->second.draws;
+		}
+
+		shard.lock.unlock();
+		records[i].clear();
+	}
+}
+
+static void workerThread(void* arg)
+{
+	Worker* w = (Worker*)arg;
+	Position* pos = new Position;
+	std::vector<Record>* records = new std::vector<Record>[NUM_SHARDS];
+
+	for(;;){
+		Batch* batch = NULL;
+		bool done;
+
+		s_queueLock.lock();
+		if(!s_queue.empty()){
+			batch = s_queue.front();
+			s_queue.pop_front();
+		}
+		done = s_readDone;
+		s_queueLock.unlock();
+
+		if(batch == NULL){
+			if(done)
+				break;
+
+			sleepMs(1);
+			continue;
+		}
+
+		for(size_t i=0; i<batch->size(); ++i){
+			if(replayGame(*pos, (*batch)[i], records, w->moves))
+				++w->games;
+			else
+				++w->skipped;
+		}
+
+		delete batch;
+		mergeRecords(records);
+	}
+
+	delete[] records;
+	delete pos;
+}
+
+static void pushBatch(Batch* batch)
+{
+	for(;;){
+		s_queueLock.lock();
+		if(s_queue.size() < MAX_QUEUED){
+			s_queue.push_back(batch);
+			s_queueLock.unlock();
+			return;
+		}
+		s_queueLock.unlock();
+
+		sleepMs(1);
+	}
+}
+
+// a new game starts at the first tag line after some movetext
+static bool readPGN(const char* file)
+{
+	FILE* fp = fopen(file, "r");
+	char* line;
+	std::string game;
+	Batch* batch = new Batch;
+	bool movetext = false, lineStart = true;
+
+	if(fp == NULL){
+		printf("can't open %s\n", file);
+		delete batch;
+		return false;
+	}
+
+	line = new char[LINE_SIZE];
+
+	while(fgets(line, LINE_SIZE, fp)){
+		bool tag = lineStart && line[0] == '[';
+
+		if(tag && movetext){
+			batch->push_back(game);
+			game.clear();
+			movetext = false;
+
+			if(batch->size() >= BATCH_GAMES){
+				pushBatch(batch);
+				batch = new Batch;
+			}
+		}
+
+		if(lineStart && !tag){
+			for(const char* p = line; *p; ++p){
+				if(!isspace((unsigned char)*p)){
+					movetext = true;
+					break;
+				}
+			}
+		}
+
+		game += line;
+		lineStart = (strchr(line, '\n') != NULL);
+	}
+
+	if(movetext)
+		batch->push_back(game);
+
+	if(batch->empty())
+		delete batch;
+	else
+		pushBatch(batch);
+
+	delete[] line;
+	fclose(fp);
+	return true;
+}
+
+static bool compareEntries(const OutEntry& a, const OutEntry& b)
+{
+	if(a.key != b.key)
+		return a.key < b.key;
+
+	return a.weight > b.weight;
+}
+
+static void writeBig(FILE* fp, U64 v, int bytes)
+{
+	unsigned char buf[8];
+
+	for(int i=0; i<bytes; ++i)
+		buf[i] = (unsigned char)(v >> (8 * (bytes - 1 - i)));
+
+	fwrite(buf, 1, bytes, fp);
+}
+
+// Polyglot weights are 2 per win and 1 per draw, scaled per position to fit 16 bits
+static size_t writeBook(const char* file, unsigned int minGames, unsigned int minScore)
+{
+	std::vector<OutEntry> entries;
+	FILE* fp;
+
+	for(int i=0; i<NUM_SHARDS; ++i){
+		for(StatsMap::const_iterator it = s_shards[i].stats.begin(); it != s_shards[i].stats.end(); ++it){
+			const MoveStats& ms = it->second;
+			OutEntry e;
+
+			if(ms.games < minGames)
+				continue;
+			if((2 * ms.wins + ms.draws) * 50 < minScore * ms.games)
+				continue;
+
+			e.key = it->first.key;
+			e.move = it->first.move;
+			e.weight = 2 * ms.wins + ms.draws;
+
+			if(e.weight > 0)
+				entries.push_back(e);
+		}
+
+		s_shards[i].stats.clear();
+	}
+
+	std::sort(entries.begin(), entries.end(), compareEntries);
+
+	if((fp = fopen(file, "wb")) == NULL){
+		printf("can't write %s\n", file);
+		return 0;
+	}
+
+	for(size_t i=0; i<entries.size();){
+		size_t end = i;
+		unsigned int best = entries[i].weight;		// sorted, so the first is the largest
+
+		while(end < entries.size() && entries[end].key == entries[i].key)
+			++end;
+
+		for(; i<end; ++i){
+			U64 weight = entries[i].weight;
+
+			if(best > 0xFFFF)
+				weight = (weight * 0xFFFF / best) ? weight * 0xFFFF / best : 1;
+
+			writeBig(fp, entries[i].key, 8);
+			writeBig(fp, entries[i].move, 2);
+			writeBig(fp, weight, 2);
+			writeBig(fp, 0, 4);
+		}
+	}
+
+	fclose(fp);
+	return entries.size();
+}
+
+int main(int argc, char* argv[])
+{
+	const char* output = "book.bin";
+	int threads = getNumCpus();
+	unsigned int minGames = 3, minScore = 0;
+	std::vector<const char*> files;
+	Worker* workers;
+	U64 games = 0, skipped = 0, moves = 0;
+	unsigned int start;
+	size_t entries;
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-plies") == 0 && i + 1 < argc)
+			s_maxPlies = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-min") == 0 && i + 1 < argc)
+			minGames = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "-score") == 0 && i + 1 < argc)
+			minScore = (unsigned int)atoi(argv[++i]);
+		else if(argv[i][0] == '-'){
+			printf("unknown option %s\n", argv[i]);
+			return 1;
+		}
+		else
+			files.push_back(argv[i]);
+	}
+
+	if(files.empty()){
+		printf("usage: ecbook [-o book.bin] [-threads n] [-plies n] [-min n] [-score n] file.pgn ...\n");
+		return 1;
+	}
+
+	if(threads < 1)
+		threads = 1;
+	if(threads > MAX_WORKERS)
+		threads = MAX_WORKERS;
+
+	initBitboards();
+	if(!Book::checkKeys())
+		return 1;
+
+	start = getTimeMs();
+	workers = new Worker[threads];
+
+	for(int i=0; i<threads; ++i){
+		workers[i].games = workers[i].skipped = workers[i].moves = 0;
+		workers[i].thread.start(workerThread, &workers[i]);
+	}
+
+	for(size_t i=0; i<files.size(); ++i){
+		printf("reading %s\n", files[i]);
+		readPGN(files[i]);
+	}
+
+	s_queueLock.lock();
+	s_readDone = true;
+	s_queueLock.unlock();
+
+	for(int i=0; i<threads; ++i){
+		workers[i].thread.join();
+		games += workers[i].games;
+		skipped += workers[i].skipped;
+		moves += workers[i].moves;
+	}
+
+	delete[] workers;
+
+	printf("%llu games (%llu skipped without a result), %llu moves, %d threads, %u ms\n",
+		   games, skipped, moves, threads, getTimeMs() - start);
+
+	entries = writeBook(output, minGames, minScore);
+	printf("wrote %u entries to %s\n", (unsigned int)entries, output);
+
+	return 0;
+}
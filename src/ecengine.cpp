@@ -0,0 +1,333 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// the built-in engine as a UCI engine, for other GUIs and match managers
+//
+// usage: ecengine
+//
+// speaks UCI on stdin/stdout: uci, debug, isready, setoption, ucinewgame,
+// position, go (searchmoves, wtime, btime, winc, binc, movestogo, depth, nodes,
+// mate, movetime, infinite, ponder), stop, ponderhit and quit. The search runs on
+// its own thread so stop and isready are answered while it thinks. Options
+// are the table size, MultiPV, the network, the book, the Syzygy path and
+// every search parameter.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "book.h"
+#include "search.h"
+#include "syzygy.h"
+#include "thread.h"
+
+#define ENGINE_NAME		"Ethereal Chess"
+#define ENGINE_AUTHOR	"Jordan Sparks"
+#define LINE_SIZE		16384
+#define MAX_HASH_MB		4096
+
+static TransTable s_tt;
+static Search s_search(s_tt);
+static Book s_book;
+static Position s_pos;
+static SearchLimits s_limits;
+static Thread s_thread;
+static volatile bool s_finished = true;
+static volatile bool s_waitForStop;			// infinite and ponder searches hold bestmove until told
+static bool s_ownBook;
+static char s_bookFile[260] = BOOK_FILE;
+static char s_evalFile[260] = NNUE_FILE;
+
+static void think(void* arg)
+{
+	Move best = MOVE_NONE, ponder = MOVE_NONE;
+	char buf[8];
+
+	(void)arg;
+
+	if(s_ownBook && s_book.isOpen())
+		best = s_book.probe(s_pos);
+
+	if(best == MOVE_NONE){
+		best = s_search.think(s_pos, s_limits);
+		ponder = s_search.getPonderMove();
+	}
+
+	while(s_waitForStop)
+		sleepMs(1);
+
+	Position::moveToStr(best, buf);
+	printf("bestmove %s", (best == MOVE_NONE) ? "0000" : buf);
+
+	if(ponder != MOVE_NONE){
+		Position::moveToStr(ponder, buf);
+		printf(" ponder %s", buf);
+	}
+
+	printf("\n");
+	fflush(stdout);
+	s_finished = true;
+}
+
+// a stop can land just before the search starts, so repeat it until the thread is done
+static void stopSearch(void)
+{
+	if(!s_thread.isRunning())
+		return;
+
+	s_waitForStop = false;
+	while(!s_finished){
+		s_search.stop();
+		sleepMs(1);
+	}
+
+	s_thread.join();
+}
+
+static void printOptions(void)
+{
+	const SearchParam* params = s_search.getParams();
+
+	printf("id name %s\n", ENGINE_NAME);
+	printf("id author %s\n", ENGINE_AUTHOR);
+	printf("option name Hash type spin default %d min 1 max %d\n", TT_DEFAULT_MB, MAX_HASH_MB);
+	printf("option name Clear Hash type button\n");
+	printf("option name Ponder type check default false\n");
+	printf("option name MultiPV type spin default 1 min 1 max %d\n", MAX_MULTIPV);
+	printf("option name EvalFile type string default %s\n", NNUE_FILE);
+	printf("option name OwnBook type check default false\n");
+	printf("option name BookFile type string default %s\n", BOOK_FILE);
+	printf("option name SyzygyPath type string default %s\n", Syzygy::inst().getPath()[0] ? Syzygy::inst().getPath() : "<empty>");
+
+	for(int i=0; i<NUM_SEARCH_PARAMS; ++i){
+		if(params[i].min == 0 && params[i].max == 1)
+			printf("option name %s type check default %s\n", params[i].name, params[i].value ? "true" : "false");
+		else
+			printf("option name %s type spin default %d min %d max %d\n", params[i].name, params[i].value, params[i].min, params[i].max);
+	}
+
+	printf("uciok\n");
+}
+
+static void loadNetwork(void)
+{
+	if(s_evalFile[0] == 0 || strcmp(s_evalFile, "<empty>") == 0){
+		Network::inst().unload();
+		printf("info string classical evaluation\n");
+	}
+	else if(Network::inst().load(s_evalFile))
+		printf("info string network %s (%s)\n", s_evalFile, Network::inst().getKernelName());
+	else
+		printf("info string no network at %s, classical evaluation\n", s_evalFile);
+}
+
+// "setoption name <name> [value <value>]", names may have spaces
+static void setOption(char* line)
+{
+	char* name = strstr(line, "name ");
+	char* value = strstr(line, " value ");
+	int v;
+
+	if(name == NULL)
+		return;
+
+	name += 5;
+	if(value){
+		*value = 0;
+		value += 7;
+	}
+	else{
+		value = name + strlen(name);
+	}
+
+	v = (strcmp(value, "true") == 0) ? 1 : (strcmp(value, "false") == 0) ? 0 : atoi(value);
+
+	if(strcmp(name, "Hash") == 0){
+		if(!s_tt.resize(v < 1 ? 1 : v > MAX_HASH_MB ? MAX_HASH_MB : v))
+			printf("info string not enough memory for %d MB\n", v);
+	}
+	else if(strcmp(name, "Clear Hash") == 0){
+		s_tt.clear();
+	}
+	else if(strcmp(name, "Ponder") == 0){
+		// pondering is driven by the GUI, nothing to set
+	}
+	else if(strcmp(name, "MultiPV") == 0){
+		s_limits.multipv = v < 1 ? 1 : v > MAX_MULTIPV ? MAX_MULTIPV : v;
+	}
+	else if(strcmp(name, "EvalFile") == 0){
+		strncpy(s_evalFile, value, sizeof(s_evalFile) - 1);
+		loadNetwork();
+	}
+	else if(strcmp(name, "OwnBook") == 0){
+		s_ownBook = (v != 0);
+		if(s_ownBook && !s_book.isOpen() && !s_book.open(s_bookFile))
+			printf("info string no book at %s\n", s_bookFile);
+	}
+	else if(strcmp(name, "BookFile") == 0){
+		strncpy(s_bookFile, value, sizeof(s_bookFile) - 1);
+		s_book.close();
+		if(s_ownBook && !s_book.open(s_bookFile))
+			printf("info string no book at %s\n", s_bookFile);
+	}
+	else if(strcmp(name, "SyzygyPath") == 0){
+		Syzygy::inst().setPath(strcmp(value, "<empty>") == 0 ? "" : value);
+		printf("info string %d Syzygy tables\n", Syzygy::inst().init());
+	}
+	else if(!s_search.setParam(name, v)){
+		printf("info string unknown option %s\n", name);
+	}
+
+	fflush(stdout);
+}
+
+static const char* token(const char* line, const char* name)
+{
+	size_t len = strlen(name);
+
+	for(const char* p = strstr(line, name); p; p = strstr(p + 1, name)){
+		if((p == line || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0))
+			return p + len;
+	}
+
+	return NULL;
+}
+
+static void go(const char* line)
+{
+	SearchLimits limits;
+	const char* p;
+	int side = s_pos.getSide();
+
+	limits.multipv = s_limits.multipv;
+
+	if((p = token(line, (side == SIDE_WHITE) ? "wtime" : "btime")) != NULL)
+		limits.time = (unsigned int)(atoi(p) > 1 ? atoi(p) : 1);
+	if((p = token(line, (side == SIDE_WHITE) ? "winc" : "binc")) != NULL)
+		limits.inc = (unsigned int)atoi(p);
+	if((p = token(line, "movestogo")) != NULL)
+		limits.movestogo = atoi(p);
+	if((p = token(line, "depth")) != NULL)
+		limits.depth = atoi(p);
+	if((p = token(line, "mate")) != NULL)
+		limits.depth = 2 * atoi(p) - 1;
+	if((p = token(line, "nodes")) != NULL)
+		limits.nodes = strtoull(p, NULL, 10);
+	if((p = token(line, "movetime")) != NULL)
+		limits.movetime = (unsigned int)atoi(p);
+
+	// the list runs to the first word that isn't a legal move
+	if((p = token(line, "searchmoves")) != NULL){
+		char word[8];
+		int len;
+
+		while(limits.numSearchMoves < MAX_MOVES && sscanf(p, " %7s%n", word, &len) == 1){
+			Move m = s_pos.parseMove(word);
+
+			if(m == MOVE_NONE)
+				break;
+
+			limits.searchMoves[limits.numSearchMoves++] = m;
+			p += len;
+		}
+	}
+
+	if(limits.depth < 1 || limits.depth >= MAX_PLY)
+		limits.depth = MAX_PLY - 1;
+
+	limits.ponder = (token(line, "ponder") != NULL);
+	s_waitForStop = limits.ponder || token(line, "infinite") != NULL;
+	s_limits = limits;
+
+	// a ponderhit can come before the thread reaches think(), the search latches
+	// it. One for the previous search, which had already finished, mustn't count.
+	s_search.clearPonderhit();
+
+	s_finished = false;
+	if(!s_thread.start(&think, NULL)){
+		printf("info string can't start the search thread\n");
+		s_finished = true;
+	}
+}
+
+int main(void)
+{
+	static char line[LINE_SIZE];
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	initBitboards();
+	s_pos.setFEN(START_FEN);
+	Syzygy::inst().init();
+
+	if(Network::inst().load(s_evalFile))
+		printf("info string network %s (%s)\n", s_evalFile, Network::inst().getKernelName());
+
+	s_search.setOutput(true);
+
+	while(fgets(line, sizeof(line), stdin)){
+		line[strcspn(line, "\r\n")] = 0;
+
+		if(strcmp(line, "uci") == 0){
+			printOptions();
+		}
+		else if(strcmp(line, "isready") == 0){
+			printf("readyok\n");
+		}
+		else if(strncmp(line, "debug", 5) == 0){
+			// the info lines are always on
+		}
+		else if(strncmp(line, "setoption", 9) == 0){
+			stopSearch();
+			setOption(line);
+		}
+		else if(strcmp(line, "ucinewgame") == 0){
+			stopSearch();
+			s_tt.clear();
+			s_search.clearHistory();
+		}
+		else if(strncmp(line, "position", 8) == 0){
+			stopSearch();
+			if(!s_pos.setPosition(line)){
+				printf("info string bad position: %s\n", line);
+				s_pos.setFEN(START_FEN);
+			}
+		}
+		else if(strncmp(line, "go", 2) == 0){
+			stopSearch();
+			go(line);
+		}
+		else if(strcmp(line, "stop") == 0){
+			stopSearch();
+		}
+		else if(strcmp(line, "ponderhit") == 0){
+			s_search.ponderhit();
+			s_waitForStop = false;
+		}
+		else if(strcmp(line, "quit") == 0){
+			break;
+		}
+
+		fflush(stdout);
+	}
+
+	stopSearch();
+	return 0;
+}
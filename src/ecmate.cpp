@@ -0,0 +1,131 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+// headless mate checker for puzzle validation
+//
+// usage: ecmate [options] [file.epd]
+//
+//   -m n           prove mate within n moves (default 5), unless the line has a "dm n" operation
+//   -nodes n       give up on a position after n nodes (default: no limit)
+//   -hash n        proof table size in megabytes (default 16)
+//
+// reads one FEN or EPD position per line, from stdin without a file, and prints
+// whether the side to move mates within the bound, with the proof line
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mate.h"
+#include "search.h"
+
+#define LINE_SIZE		1024
+
+int main(int argc, char* argv[])
+{
+	MateSolver solver;
+	const char* file = NULL;
+	int mateIn = 5;
+	U64 maxNodes = 0;
+	unsigned int hash = MATE_TT_DEFAULT_MB;
+	int positions = 0, proven = 0, disproven = 0;
+	U64 totalNodes = 0;
+	unsigned int start = getTimeMs();
+	char line[LINE_SIZE];
+	FILE* fp = stdin;
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			mateIn = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-nodes") == 0 && i + 1 < argc)
+			maxNodes = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			hash = (unsigned int)atoi(argv[++i]);
+		else if(argv[i][0] == '-'){
+			printf("usage: ecmate [-m n] [-nodes n] [-hash mb] [file.epd]\n");
+			return 1;
+		}
+		else
+			file = argv[i];
+	}
+
+	if(file != NULL && (fp = fopen(file, "r")) == NULL){
+		printf("Can't open %s\n", file);
+		return 1;
+	}
+
+	if(hash != MATE_TT_DEFAULT_MB && !solver.resize(hash))
+		printf("Not enough memory for a %u MB table, using less\n", hash);
+
+	while(fgets(line, sizeof(line), fp)){
+		Position pos;
+		Move pv[2 * MATE_MAX_MOVES];
+		char buf[8];
+		const char* dm = strstr(line, " dm ");
+		int bound = dm ? atoi(dm + 4) : mateIn;
+		unsigned int t;
+		int result, n;
+
+		line[strcspn(line, "\r\n")] = 0;
+		if(line[0] == 0 || line[0] == '#')
+			continue;
+
+		if(!pos.setFEN(line)){
+			printf("bad position: %s\n", line);
+			continue;
+		}
+
+		// every puzzle is proven from scratch, so the node counts are comparable
+		solver.clear();
+		t = getTimeMs();
+		result = solver.solve(pos, bound, maxNodes);
+		t = getTimeMs() - t;
+
+		++positions;
+		totalNodes += solver.getNodes();
+
+		if(result == MATE_PROVEN){
+			++proven;
+			printf("%3d: mate in %d", positions, solver.getMateIn() ? solver.getMateIn() : bound);
+
+			n = solver.getPV(pv);
+			for(int i=0; i<n; ++i){
+				Position::moveToStr(pv[i], buf);
+				printf(" %s", buf);
+			}
+		}
+		else if(result == MATE_DISPROVEN){
+			++disproven;
+			printf("%3d: no mate in %d", positions, bound);
+		}
+		else{
+			printf("%3d: unknown after %llu nodes", positions, solver.getNodes());
+		}
+
+		printf(" (%llu nodes, %u ms)\n", solver.getNodes(), t);
+	}
+
+	if(fp != stdin)
+		fclose(fp);
+
+	printf("\n%d positions: %d mates, %d without, %d unknown, %llu nodes, %u ms\n",
+		positions, proven, disproven, positions - proven - disproven, totalNodes, getTimeMs() - start);
+
+	return 0;
+}
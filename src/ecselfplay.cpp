@@ -0,0 +1,320 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// headless self-play for training data
+//
+// usage: ecselfplay [options]
+//        ecselfplay -dump file.bin
+//
+//   -o file        output, appended to (default selfplay.bin)
+//   -games n       games to play (default 1000)
+//   -threads n     worker threads (default: one per core)
+//   -nodes n       search nodes per move (default 5000)
+//   -random n      random plies opening each game (default 8)
+//   -hash n        table size per thread in megabytes (default 16)
+//   -seed n        random seed, for repeatable openings with one thread
+//   -dump file     print every sample of a file as EPD with "c9" and "ce"
+//
+// every worker plays whole games with its own search and appends each finished
+// game to the file under a lock. Games start from the initial position, so a
+// game is stored as its moves: each one is the index of the move in the order
+// Position::genLegalMoves gives, followed by the search score once the random
+// opening is over. A sample is three bytes.
+//
+// file layout: "ECSP", version byte, three zero bytes, then per game (little endian)
+//   unsigned short plies, byte result (0 white lost, 1 draw, 2 white won),
+//   byte random plies, then per ply a move index byte and, after the random
+//   plies, a short score in centipawns for the side to move
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "search.h"
+#include "thread.h"
+
+#define SELFPLAY_MAGIC		"ECSP"
+#define SELFPLAY_VERSION	1
+#define MAX_WORKERS			64
+#define MAX_GAME_PLIES		400				// then the game is called a draw
+#define REPORT_GAMES		100
+
+enum results{
+	RESULT_LOSS = 0,
+	RESULT_DRAW,
+	RESULT_WIN
+};
+
+struct Worker{
+	Thread thread;
+	unsigned int seed;
+};
+
+static FILE* s_file;
+static Mutex s_fileLock;
+static long s_games = 1000;
+static volatile long s_nextGame;
+static long s_gamesDone;
+static U64 s_samples, s_bytes;
+static U64 s_nodes = 5000;
+static int s_randomPlies = 8;
+static unsigned int s_hash = 16;
+static unsigned int s_start;
+
+static unsigned int random(unsigned int& seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static int moveIndex(Position& pos, Move m)
+{
+	Move list[MAX_MOVES];
+	int n = pos.genLegalMoves(list);
+
+	for(int i=0; i<n; ++i)
+		if(list[i] == m)
+			return i;
+
+	return -1;
+}
+
+// plays one game into buf, false when the random opening ran into the end of the game
+static bool playGame(Search& search, TransTable& tt, unsigned int& seed, std::vector<unsigned char>& buf)
+{
+	Position pos;
+	SearchLimits limits;
+	Move list[MAX_MOVES];
+	int plies = 0, result = RESULT_DRAW;
+
+	pos.setFEN(START_FEN);
+	tt.clear();
+	search.clearHistory();
+	limits.nodes = s_nodes;
+
+	buf.assign(4, 0);
+
+	for(; plies<s_randomPlies; ++plies){
+		int n = pos.genLegalMoves(list);
+
+		if(n == 0 || pos.isDraw())
+			return false;
+
+		int idx = random(seed) % n;
+		buf.push_back((unsigned char)idx);
+		pos.makeMove(list[idx]);
+	}
+
+	for(; plies<MAX_GAME_PLIES; ++plies){
+		Move best;
+		int idx, score;
+
+		if(pos.genLegalMoves(list) == 0){
+			if(pos.inCheck())
+				result = (pos.getSide() == SIDE_WHITE) ? RESULT_LOSS : RESULT_WIN;
+			break;
+		}
+
+		if(pos.isDraw())
+			break;
+
+		best = search.think(pos, limits);
+		idx = moveIndex(pos, best);
+		if(idx < 0)
+			break;
+
+		score = search.getScore();
+		buf.push_back((unsigned char)idx);
+		buf.push_back((unsigned char)(score & 0xFF));
+		buf.push_back((unsigned char)((score >> 8) & 0xFF));
+		pos.makeMove(best);
+	}
+
+	buf[0] = (unsigned char)(plies & 0xFF);
+	buf[1] = (unsigned char)(plies >> 8);
+	buf[2] = (unsigned char)result;
+	buf[3] = (unsigned char)s_randomPlies;
+	return true;
+}
+
+static void play(void* arg)
+{
+	Worker* w = (Worker*)arg;
+	TransTable tt;
+	Search search(tt);
+	std::vector<unsigned char> buf;
+
+	tt.resize(s_hash);
+
+	while(atomicAdd(&s_nextGame, 1) < s_games){
+		while(!playGame(search, tt, w->seed, buf))
+			;
+
+		s_fileLock.lock();
+		fwrite(&buf[0], 1, buf.size(), s_file);
+		s_samples += (buf.size() - 4 - s_randomPlies) / 3;
+		s_bytes += buf.size();
+
+		if(++s_gamesDone % REPORT_GAMES == 0){
+			unsigned int ms = getTimeMs() - s_start;
+
+			printf("%ld games, %llu samples, %.2f bytes per sample, %.1f games/s\n", s_gamesDone, s_samples,
+				(double)s_bytes / (double)(s_samples ? s_samples : 1), ms ? s_gamesDone * 1000.0 / ms : 0.0);
+			fflush(stdout);
+		}
+		s_fileLock.unlock();
+	}
+}
+
+static const char* resultName(int result)
+{
+	static const char* names[3] = { "0-1", "1/2-1/2", "1-0" };
+
+	return (result >= RESULT_LOSS && result <= RESULT_WIN) ? names[result] : "*";
+}
+
+// replays every game and prints each scored position
+static int dump(const char* file)
+{
+	FILE* fp = fopen(file, "rb");
+	unsigned char header[8], head[4];
+	long games = 0;
+
+	if(fp == NULL){
+		printf("Can't open %s\n", file);
+		return 1;
+	}
+
+	if(fread(header, 1, 8, fp) != 8 || memcmp(header, SELFPLAY_MAGIC, 4) != 0 || header[4] != SELFPLAY_VERSION){
+		printf("%s is not a version %d self-play file\n", file, SELFPLAY_VERSION);
+		fclose(fp);
+		return 1;
+	}
+
+	while(fread(head, 1, 4, fp) == 4){
+		Position pos;
+		Move list[MAX_MOVES];
+		int plies = head[0] | (head[1] << 8);
+		char fen[128];
+
+		pos.setFEN(START_FEN);
+		++games;
+
+		for(int i=0; i<plies; ++i){
+			unsigned char ply[3];
+			int size = (i < head[3]) ? 1 : 3;
+			int n = pos.genLegalMoves(list);
+
+			if(fread(ply, 1, size, fp) != (size_t)size || ply[0] >= n){
+				printf("%s: game %ld is damaged\n", file, games);
+				fclose(fp);
+				return 1;
+			}
+
+			if(size == 3){
+				pos.getFEN(fen);
+				printf("%s c9 \"%s\"; ce %d;\n", fen, resultName(head[2]), (short)(ply[1] | (ply[2] << 8)));
+			}
+
+			pos.makeMove(list[ply[0]]);
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	static Worker workers[MAX_WORKERS];
+	const char* output = "selfplay.bin";
+	int threads = getNumCpus();
+	unsigned int seed = (unsigned int)time(NULL);
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if(strcmp(argv[i], "-games") == 0 && i + 1 < argc)
+			s_games = atol(argv[++i]);
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-nodes") == 0 && i + 1 < argc)
+			s_nodes = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-random") == 0 && i + 1 < argc)
+			s_randomPlies = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-hash") == 0 && i + 1 < argc)
+			s_hash = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-dump") == 0 && i + 1 < argc)
+			return dump(argv[++i]);
+		else{
+			printf("usage: ecselfplay [-o file] [-games n] [-threads n] [-nodes n] [-random n] [-hash mb] [-seed n]\n");
+			printf("       ecselfplay -dump file\n");
+			return 1;
+		}
+	}
+
+	if(threads < 1)
+		threads = 1;
+	if(threads > MAX_WORKERS)
+		threads = MAX_WORKERS;
+	if(s_randomPlies < 0 || s_randomPlies > 255)
+		s_randomPlies = 8;
+
+	if((s_file = fopen(output, "ab")) == NULL){
+		printf("Can't open %s\n", output);
+		return 1;
+	}
+
+	// a new file gets the header, an existing one is added to
+	if(ftell(s_file) == 0){
+		unsigned char header[8] = { 'E', 'C', 'S', 'P', SELFPLAY_VERSION, 0, 0, 0 };
+		fwrite(header, 1, 8, s_file);
+	}
+
+	initBitboards();
+
+	if(Network::inst().load(NNUE_FILE))
+		printf("network: %s (%s)\n", NNUE_FILE, Network::inst().getKernelName());
+	else
+		printf("network: none, classical evaluation\n");
+
+	printf("%ld games, %d threads, %llu nodes per move, %d random plies\n", s_games, threads, s_nodes, s_randomPlies);
+
+	s_start = getTimeMs();
+
+	for(int i=0; i<threads; ++i){
+		workers[i].seed = (seed + 0x9E3779B9u * (i + 1)) | 1;
+		workers[i].thread.start(&play, &workers[i]);
+	}
+
+	for(int i=0; i<threads; ++i)
+		workers[i].thread.join();
+
+	fclose(s_file);
+
+	printf("%ld games, %llu samples, %llu bytes to %s, %u ms\n", s_gamesDone, s_samples, s_bytes, output, getTimeMs() - s_start);
+	return 0;
+}
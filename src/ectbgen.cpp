@@ -0,0 +1,860 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// headless endgame tablebase generator
+//
+// usage: ectbgen [options] [material ...]
+//
+//   -o dir         output directory, created when missing (default Data/Tablebases)
+//   -threads n     worker threads (default: one per core)
+//   -pieces n      without a material list, every combination up to n pieces (default 5)
+//   -verify dir    afterwards, compare every table with the Syzygy files in dir
+//
+// materials are named like KRPvKR. Tables reached by captures and promotions are
+// built first, or read back when their file already exists. Each table is solved by
+// retrograde analysis: checkmates are found first, then each pass retracts moves from
+// the positions decided in the previous one. Workers split the index range and mark
+// newly decided positions in shared bit arrays with atomic writes.
+//
+// values are mate distances in moves with best play and no fifty move rule; en passant
+// and castling rights are not part of the index (the prober steps around en passant).
+// Five piece tables need a few hundred megabytes per table being solved.
+//
+// -verify probes Syzygy for every legal position of each table and reports where the
+// win/draw/loss disagrees. Syzygy's cursed wins and blessed losses count as wins and
+// losses, since ectbgen ignores the fifty move rule. The sign of the DTZ is checked too
+// when the .rtbz file is there.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#if defined(_WIN32)
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+#include <errno.h>
+
+#include "tablebase.h"
+#include "syzygy.h"
+#include "search.h"
+#include "thread.h"
+
+#define MAX_WORKERS		64
+#define CHUNK_SIZE		65536			// indices handed to a worker at a time, a multiple of 64
+#define MAX_RETRACTIONS	256
+#define MAX_DISTANCE	126				// longest mate TB_LOSS + n can store
+
+#define CONV_NONE		0				// no captures or promotions
+#define CONV_DRAW		255				// a capture or promotion holds the draw
+
+enum phases{
+	PHASE_INIT = 0,
+	PHASE_WIN,
+	PHASE_LOSS,
+	PHASE_VERIFY
+};
+
+// bit per position, set concurrently by every worker
+class BitArray{
+public:
+	BitArray() : m_words(NULL), m_numWords(0) {}
+	~BitArray() { delete[] m_words; }
+
+	void init(U64 size)
+	{
+		delete[] m_words;
+		m_numWords = (size + 63) / 64;
+		m_words = new unsigned long long[(size_t)m_numWords];
+		clear();
+	}
+
+	void clear(void)
+	{
+		memset((void*)m_words, 0, (size_t)m_numWords * sizeof(unsigned long long));
+	}
+
+	void set(U64 idx)
+	{
+		atomicOr(&m_words[idx >> 6], 1ULL << (idx & 63));
+	}
+
+	bool test(U64 idx) const
+	{
+		return ((m_words[idx >> 6] >> (idx & 63)) & 1) != 0;
+	}
+
+private:
+	BitArray(const BitArray&);
+	BitArray& operator=(const BitArray&);
+
+	volatile unsigned long long* m_words;
+	U64 m_numWords;
+};
+
+struct TableData{
+	unsigned char* values[2];
+	U64 entries;
+};
+
+struct Worker{
+	Thread thread;
+	long changed;
+	int maxConv;
+	U64 checked;										// PHASE_VERIFY only
+	U64 mismatched;
+	U64 missing;
+};
+
+static std::string s_dir = TB_DIR;
+static int s_threads = 1;
+static std::map<std::string, TableData> s_deps;			// tables a capture or promotion leads to
+static std::set<std::string> s_done;
+
+// table being solved
+static TBPosition s_material;
+static U64 s_entries;
+static unsigned char* s_values[2];
+static unsigned char* s_conv[2];						// best result of a capture or promotion
+static BitArray s_lost[2];								// lost in exactly s_depth moves
+static BitArray s_won[2];								// won in exactly s_depth + 1 moves
+static int s_depth;
+static int s_phase;
+
+// -verify
+static std::string s_verifyDir;
+static U64 s_checked, s_mismatched, s_missing;
+static volatile long s_nextChunk;
+
+static bool attacked(const TBPosition& tp, int sq, int bySide)
+{
+	U64 occupied = 0, target = squareBB(sq);
+
+	for(int i=0; i<tp.count; ++i)
+		occupied |= squareBB(tp.square[i]);
+
+	for(int i=0; i<tp.count; ++i){
+		int from = tp.square[i];
+		U64 attacks;
+
+		if(pieceSide(tp.piece[i]) != bySide)
+			continue;
+
+		switch(pieceType(tp.piece[i])){
+			case P_PAWN:	attacks = g_pawnAttacks[bySide][from]; break;
+			case P_KNIGHT:	attacks = g_knightAttacks[from]; break;
+			case P_BISHOP:	attacks = bishopAttacks(from, occupied); break;
+			case P_ROOK:	attacks = rookAttacks(from, occupied); break;
+			case P_QUEEN:	attacks = queenAttacks(from, occupied); break;
+			default:		attacks = g_kingAttacks[from]; break;
+		}
+
+		if(attacks & target)
+			return true;
+	}
+
+	return false;
+}
+
+// positions one move earlier, with the side that just moved to move
+static int retract(const TBPosition& tp, U64* list)
+{
+	int mover = tp.side ^ 1, n = 0;
+	U64 occupied = 0;
+
+	for(int i=0; i<tp.count; ++i)
+		occupied |= squareBB(tp.square[i]);
+
+	for(int i=0; i<tp.count; ++i){
+		int from = tp.square[i];
+		U64 targets = 0;
+
+		if(pieceSide(tp.piece[i]) != mover)
+			continue;
+
+		switch(pieceType(tp.piece[i])){
+			case P_PAWN:
+				// a pawn steps back, and from its fourth rank it may have made a double push
+				if(relativeRank(mover, from) >= 2){
+					int back = (mover == SIDE_WHITE) ? from - 8 : from + 8;
+
+					if(!(occupied & squareBB(back))){
+						targets = squareBB(back);
+
+						if(relativeRank(mover, from) == 3){
+							int back2 = (mover == SIDE_WHITE) ? back - 8 : back + 8;
+							targets |= squareBB(back2);
+						}
+					}
+				}
+				break;
+			case P_KNIGHT:	targets = g_knightAttacks[from]; break;
+			case P_BISHOP:	targets = bishopAttacks(from, occupied); break;
+			case P_ROOK:	targets = rookAttacks(from, occupied); break;
+			case P_QUEEN:	targets = queenAttacks(from, occupied); break;
+			default:		targets = g_kingAttacks[from]; break;
+		}
+
+		for(targets &= ~occupied; targets;){
+			TBPosition prev = tp;
+
+			prev.square[i] = popLsb(targets);
+			prev.side = mover;
+
+			// the side that didn't move can't have been left in check
+			if(!attacked(prev, prev.square[tp.side], mover))
+				list[n++] = tbIndex(prev);
+		}
+	}
+
+	return n;
+}
+
+// value of a position after a capture or promotion, from the side to move's point of view
+static int probeDependency(const Position& pos)
+{
+	char name[TB_NAME_SIZE];
+	TBPosition tp;
+
+	tbFromPosition(pos, tp, name);
+	if(tp.count == 2)
+		return TB_DRAW;
+
+	return s_deps.find(name)->second.values[tp.side][tbIndex(tp)];
+}
+
+static void initPosition(Position& pos, U64 idx, Worker& worker)
+{
+	TBPosition tp = s_material;
+	Move moves[MAX_MOVES];
+
+	if(!tbDecode(idx, tp)){
+		s_values[SIDE_WHITE][idx] = s_values[SIDE_BLACK][idx] = TB_ILLEGAL;
+		return;
+	}
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		int win = 0, loss = 0, n;
+		bool draw = false;
+
+		if(attacked(tp, tp.square[side ^ 1], side)){
+			s_values[side][idx] = TB_ILLEGAL;
+			continue;
+		}
+
+		pos.setPieces(tp.piece, tp.square, tp.count, side);
+		n = pos.genLegalMoves(moves);
+
+		if(n == 0){
+			if(pos.inCheck()){
+				s_values[side][idx] = TB_LOSS;
+				s_lost[side].set(idx);
+				++worker.changed;
+			}
+			continue;
+		}
+
+		for(int i=0; i<n; ++i){
+			int v;
+
+			if(!pos.isCapture(moves[i]) && moveFlags(moves[i]) != MF_PROMOTION)
+				continue;
+
+			pos.makeMove(moves[i]);
+			v = probeDependency(pos);
+			pos.unmakeMove(moves[i]);
+
+			if(tbIsLoss(v)){
+				int d = v - TB_LOSS + 1;
+				win = (win == 0 || d < win) ? d : win;
+			}
+			else if(tbIsWin(v)){
+				loss = (v > loss) ? v : loss;
+			}
+			else{
+				draw = true;
+			}
+		}
+
+		if(win)
+			s_conv[side][idx] = (unsigned char)win;
+		else if(draw)
+			s_conv[side][idx] = CONV_DRAW;
+		else if(loss)
+			s_conv[side][idx] = (unsigned char)(TB_LOSS + loss);
+
+		if(win > worker.maxConv || loss > worker.maxConv)
+			worker.maxConv = (win > loss) ? win : loss;
+	}
+}
+
+static void markWin(int side, U64 idx, Worker& worker)
+{
+	if(s_values[side][idx] == 0){
+		s_values[side][idx] = (unsigned char)(s_depth + 1);
+		s_won[side].set(idx);
+		++worker.changed;
+	}
+}
+
+// lost when every move inside the table reaches a won position and no capture or promotion escapes
+static void checkLoss(Position& pos, const TBPosition& tp, U64 idx, Worker& worker)
+{
+	int conv = s_conv[tp.side][idx], n;
+	Move moves[MAX_MOVES];
+
+	if(s_values[tp.side][idx] != 0 || tbIsWin(conv) || conv == CONV_DRAW)
+		return;
+
+	// a slower forced loss through a capture is picked up when the passes reach it
+	if(tbIsLoss(conv) && conv - TB_LOSS > s_depth + 1)
+		return;
+
+	pos.setPieces(tp.piece, tp.square, tp.count, tp.side);
+	n = pos.genLegalMoves(moves);
+	if(n == 0)
+		return;
+
+	for(int i=0; i<n; ++i){
+		char name[TB_NAME_SIZE];
+		TBPosition next;
+		bool won;
+
+		if(pos.isCapture(moves[i]) || moveFlags(moves[i]) == MF_PROMOTION)
+			continue;
+
+		pos.makeMove(moves[i]);
+		tbFromPosition(pos, next, name);
+		won = tbIsWin(s_values[next.side][tbIndex(next)]);
+		pos.unmakeMove(moves[i]);
+
+		if(!won)
+			return;
+	}
+
+	s_values[tp.side][idx] = (unsigned char)(TB_LOSS + s_depth + 1);
+	s_lost[tp.side].set(idx);
+	++worker.changed;
+}
+
+static void passPosition(Position& pos, U64 idx, Worker& worker)
+{
+	U64 list[MAX_RETRACTIONS];
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		TBPosition tp = s_material;
+		int n;
+
+		if(s_phase == PHASE_WIN){
+			// the side that moved into a lost position wins
+			if(s_lost[side].test(idx)){
+				tbDecode(idx, tp);
+				tp.side = side;
+
+				n = retract(tp, list);
+				for(int i=0; i<n; ++i)
+					markWin(side ^ 1, list[i], worker);
+			}
+
+			if(s_conv[side][idx] == s_depth + 1)
+				markWin(side, idx, worker);
+		}
+		else{
+			// every position leading into a won one may now be lost
+			if(s_won[side].test(idx)){
+				tbDecode(idx, tp);
+				tp.side = side;
+
+				n = retract(tp, list);
+				for(int i=0; i<n; ++i){
+					TBPosition prev = s_material;
+
+					if(s_values[side ^ 1][list[i]] != 0)
+						continue;
+
+					tbDecode(list[i], prev);
+					prev.side = side ^ 1;
+					checkLoss(pos, prev, list[i], worker);
+				}
+			}
+
+			if(s_conv[side][idx] == TB_LOSS + s_depth + 1 && s_values[side][idx] == 0){
+				tbDecode(idx, tp);
+				tp.side = side;
+				checkLoss(pos, tp, idx, worker);
+			}
+		}
+	}
+}
+
+// -1, 0 or 1 for the side to move
+static int resultOf(int v)
+{
+	return tbIsWin(v) ? 1 : (tbIsLoss(v) ? -1 : 0);
+}
+
+static void verifyPosition(Position& pos, U64 idx, Worker& worker)
+{
+	TBPosition tp = s_material;
+
+	if(!tbDecode(idx, tp))
+		return;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		int v = s_values[side][idx], wdl, dtz, expected, found;
+
+		if(v == TB_ILLEGAL)
+			continue;
+
+		pos.setPieces(tp.piece, tp.square, tp.count, side);
+		if(!Syzygy::inst().probeWDL(pos, wdl)){
+			++worker.missing;
+			continue;
+		}
+
+		expected = resultOf(v);
+		found = (wdl > 0) - (wdl < 0);
+
+		// a DTZ of the wrong sign is as wrong as a bad WDL
+		if(found == expected && Syzygy::inst().probeDTZ(pos, dtz))
+			found = (dtz > 0) - (dtz < 0);
+
+		++worker.checked;
+		if(found != expected && ++worker.mismatched <= 5){
+			char fen[128];
+
+			pos.getFEN(fen);
+			printf("  %s: ectbgen %d, Syzygy wdl %d\n", fen, expected, wdl);
+		}
+	}
+}
+
+static void workerThread(void* arg)
+{
+	Worker* worker = (Worker*)arg;
+	Position* pos = new Position;
+
+	for(;;){
+		U64 begin = (U64)atomicAdd(&s_nextChunk, 1) * CHUNK_SIZE;
+		U64 end = begin + CHUNK_SIZE;
+
+		if(begin >= s_entries)
+			break;
+		if(end > s_entries)
+			end = s_entries;
+
+		for(U64 idx=begin; idx<end; ++idx){
+			if(s_phase == PHASE_INIT)
+				initPosition(*pos, idx, *worker);
+			else if(s_phase == PHASE_VERIFY)
+				verifyPosition(*pos, idx, *worker);
+			else
+				passPosition(*pos, idx, *worker);
+		}
+	}
+
+	delete pos;
+}
+
+// runs one pass over every index, returns the number of positions it decided
+static long runPhase(int phase, int& maxConv)
+{
+	Worker* workers = new Worker[s_threads];
+	long changed = 0;
+
+	s_phase = phase;
+	s_nextChunk = 0;
+
+	for(int i=0; i<s_threads; ++i){
+		workers[i].changed = 0;
+		workers[i].maxConv = 0;
+		workers[i].checked = workers[i].mismatched = workers[i].missing = 0;
+		workers[i].thread.start(workerThread, &workers[i]);
+	}
+
+	for(int i=0; i<s_threads; ++i){
+		workers[i].thread.join();
+		changed += workers[i].changed;
+		s_checked += workers[i].checked;
+		s_mismatched += workers[i].mismatched;
+		s_missing += workers[i].missing;
+		maxConv = (workers[i].maxConv > maxConv) ? workers[i].maxConv : maxConv;
+	}
+
+	delete[] workers;
+	return changed;
+}
+
+static std::string tableFile(const std::string& name)
+{
+	return s_dir + "/" + name + TB_EXT;
+}
+
+// creates the output directory and any missing parents
+static bool makeDir(const std::string& dir)
+{
+	for(size_t i=1; i<=dir.size(); ++i){
+		if(i < dir.size() && dir[i] != '/' && dir[i] != '\\')
+			continue;
+		if(dir[i - 1] == ':')
+			continue;					// drive letter
+
+		std::string part = dir.substr(0, i);
+#if defined(_WIN32)
+		int err = _mkdir(part.c_str());
+#else
+		int err = mkdir(part.c_str(), 0755);
+#endif
+		if(err != 0 && errno != EEXIST){
+			printf("Can't create %s: %s\n", part.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void countMaterial(const TBPosition& tp, int counts[2][6])
+{
+	memset(counts, 0, sizeof(int) * 2 * 6);
+
+	for(int i=0; i<tp.count; ++i)
+		++counts[pieceSide(tp.piece[i])][pieceType(tp.piece[i])];
+}
+
+// tables reached by one capture or promotion
+static std::vector<std::string> dependencies(const std::string& name)
+{
+	std::vector<std::string> deps;
+	char dep[TB_NAME_SIZE];
+	int counts[2][6];
+	TBPosition tp;
+
+	tbSetMaterial(name.c_str(), tp);
+	countMaterial(tp, counts);
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		for(int type=P_PAWN; type<P_KING; ++type){
+			if(counts[side][type] == 0)
+				continue;
+
+			--counts[side][type];
+			if(tp.count > 3){
+				tbMaterialName(counts, dep);
+				deps.push_back(dep);
+			}
+
+			if(type == P_PAWN){
+				for(int promo=P_KNIGHT; promo<=P_QUEEN; ++promo){
+					++counts[side][promo];
+					tbMaterialName(counts, dep);
+					deps.push_back(dep);
+					--counts[side][promo];
+				}
+			}
+			++counts[side][type];
+		}
+	}
+
+	std::sort(deps.begin(), deps.end());
+	deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+	return deps;
+}
+
+static void freeDependencies(void)
+{
+	for(std::map<std::string, TableData>::iterator it = s_deps.begin(); it != s_deps.end(); ++it){
+		delete[] it->second.values[SIDE_WHITE];
+		delete[] it->second.values[SIDE_BLACK];
+	}
+
+	s_deps.clear();
+}
+
+static bool solve(const std::string& name)
+{
+	unsigned int start = getTimeMs();
+	U64 wins = 0, losses = 0, draws = 0;
+	int maxConv = 0, longest = 0;
+
+	tbSetMaterial(name.c_str(), s_material);
+	s_entries = tbSize(s_material);
+
+	printf("%s: %llu positions\n", name.c_str(), s_entries * 2);
+	fflush(stdout);
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		s_values[side] = new unsigned char[(size_t)s_entries];
+		s_conv[side] = new unsigned char[(size_t)s_entries];
+		memset(s_values[side], 0, (size_t)s_entries);
+		memset(s_conv[side], CONV_NONE, (size_t)s_entries);
+		s_lost[side].init(s_entries);
+		s_won[side].init(s_entries);
+	}
+
+	s_depth = 0;
+	runPhase(PHASE_INIT, maxConv);
+
+	for(;;){
+		long changed;
+
+		if(s_depth >= MAX_DISTANCE){
+			printf("%s: mate distance above %d, giving up\n", name.c_str(), MAX_DISTANCE);
+			break;
+		}
+
+		s_won[SIDE_WHITE].clear();
+		s_won[SIDE_BLACK].clear();
+		changed = runPhase(PHASE_WIN, maxConv);
+
+		s_lost[SIDE_WHITE].clear();
+		s_lost[SIDE_BLACK].clear();
+		changed += runPhase(PHASE_LOSS, maxConv);
+
+		if(changed == 0 && s_depth + 1 >= maxConv)
+			break;
+
+		++s_depth;
+	}
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		for(U64 idx=0; idx<s_entries; ++idx){
+			int v = s_values[side][idx];
+
+			if(tbIsWin(v)){
+				++wins;
+				longest = (v > longest) ? v : longest;
+			}
+			else if(tbIsLoss(v)){
+				++losses;
+			}
+			else if(v == TB_DRAW){
+				++draws;
+			}
+		}
+
+		delete[] s_conv[side];
+	}
+
+	bool saved = s_depth < MAX_DISTANCE && tbSave(tableFile(name).c_str(), name.c_str(), s_values, s_entries);
+
+	printf("%s: %llu wins, %llu losses, %llu draws, longest mate %d, %u ms\n",
+		   name.c_str(), wins, losses, draws, longest, getTimeMs() - start);
+	fflush(stdout);
+
+	delete[] s_values[SIDE_WHITE];
+	delete[] s_values[SIDE_BLACK];
+	return saved;
+}
+
+// builds a table after the ones it depends on, reusing files already on disk
+static bool build(const std::string& name)
+{
+	std::vector<std::string> deps;
+	FILE* fp;
+	bool ok = true;
+
+	if(s_done.count(name))
+		return true;
+
+	fp = fopen(tableFile(name).c_str(), "rb");
+	if(fp){
+		fclose(fp);
+		s_done.insert(name);
+		return true;
+	}
+
+	deps = dependencies(name);
+	for(size_t i=0; i<deps.size(); ++i)
+		if(!build(deps[i]))
+			return false;
+
+	for(size_t i=0; i<deps.size() && ok; ++i){
+		TBPosition tp;
+		TableData& data = s_deps[deps[i]];
+
+		tbSetMaterial(deps[i].c_str(), tp);
+		data.entries = tbSize(tp);
+		data.values[SIDE_WHITE] = new unsigned char[(size_t)data.entries];
+		data.values[SIDE_BLACK] = new unsigned char[(size_t)data.entries];
+		ok = tbLoad(tableFile(deps[i]).c_str(), deps[i].c_str(), data.values, data.entries);
+	}
+
+	if(ok)
+		ok = solve(name);
+
+	freeDependencies();
+
+	if(ok)
+		s_done.insert(name);
+	return ok;
+}
+
+// every legal position of a finished table against Syzygy, false when any differ
+static bool verify(const std::string& name)
+{
+	int maxConv = 0;
+	bool ok;
+
+	tbSetMaterial(name.c_str(), s_material);
+	s_entries = tbSize(s_material);
+	s_values[SIDE_WHITE] = new unsigned char[(size_t)s_entries];
+	s_values[SIDE_BLACK] = new unsigned char[(size_t)s_entries];
+
+	ok = tbLoad(tableFile(name).c_str(), name.c_str(), s_values, s_entries);
+	if(ok){
+		s_checked = s_mismatched = s_missing = 0;
+		runPhase(PHASE_VERIFY, maxConv);
+
+		if(s_checked == 0){
+			printf("%s: no Syzygy table in %s, skipped\n", name.c_str(), s_verifyDir.c_str());
+		}
+		else{
+			printf("%s: %llu positions checked, %llu differ, %llu not probed\n",
+				   name.c_str(), s_checked, s_mismatched, s_missing);
+			ok = (s_mismatched == 0);
+		}
+		fflush(stdout);
+	}
+
+	delete[] s_values[SIDE_WHITE];
+	delete[] s_values[SIDE_BLACK];
+	return ok;
+}
+
+static bool byPieces(const std::string& a, const std::string& b)
+{
+	return (a.size() != b.size()) ? a.size() < b.size() : a < b;
+}
+
+// every combination of up to maxPieces pieces, named with the stronger side first
+static void addMaterials(int counts[2][6], int type, int side, int pieces, int maxPieces, std::set<std::string>& names)
+{
+	char name[TB_NAME_SIZE];
+
+	if(type < P_PAWN){
+		if(side == SIDE_WHITE){
+			addMaterials(counts, P_QUEEN, SIDE_BLACK, pieces, maxPieces, names);
+		}
+		else if(pieces > 2){
+			tbMaterialName(counts, name);
+			names.insert(name);
+		}
+		return;
+	}
+
+	for(int n=0; pieces+n<=maxPieces; ++n){
+		counts[side][type] = n;
+		addMaterials(counts, type - 1, side, pieces + n, maxPieces, names);
+	}
+	counts[side][type] = 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> materials;
+	int maxPieces = TB_MAX_PIECES;
+	unsigned int start;
+	int failed = 0;
+
+	s_threads = getNumCpus();
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			s_dir = argv[++i];
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			s_threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-pieces") == 0 && i + 1 < argc)
+			maxPieces = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-verify") == 0 && i + 1 < argc)
+			s_verifyDir = argv[++i];
+		else if(argv[i][0] == '-'){
+			printf("usage: ectbgen [-o dir] [-threads n] [-pieces n] [-verify dir] [material ...]\n");
+			return 1;
+		}
+		else{
+			char name[TB_NAME_SIZE];
+			int counts[2][6];
+			TBPosition tp;
+
+			if(strlen(argv[i]) >= TB_NAME_SIZE || !tbSetMaterial(argv[i], tp) || tp.count < 3){
+				printf("bad material %s, expected something like KRPvKR with up to %d pieces\n", argv[i], TB_MAX_PIECES);
+				return 1;
+			}
+
+			countMaterial(tp, counts);
+			tbMaterialName(counts, name);
+			materials.push_back(name);
+		}
+	}
+
+	if(s_threads < 1)
+		s_threads = 1;
+	if(s_threads > MAX_WORKERS)
+		s_threads = MAX_WORKERS;
+	if(maxPieces > TB_MAX_PIECES)
+		maxPieces = TB_MAX_PIECES;
+
+	if(materials.empty()){
+		std::set<std::string> names;
+		int counts[2][6] = {{0}};
+
+		counts[SIDE_WHITE][P_KING] = counts[SIDE_BLACK][P_KING] = 1;
+		addMaterials(counts, P_QUEEN, SIDE_WHITE, 2, maxPieces, names);
+		materials.assign(names.begin(), names.end());
+	}
+
+	std::sort(materials.begin(), materials.end(), byPieces);
+
+	if(!makeDir(s_dir))
+		return 1;
+
+	initBitboards();
+	start = getTimeMs();
+
+	for(size_t i=0; i<materials.size(); ++i)
+		if(!build(materials[i]))
+			++failed;
+
+	printf("%u tables in %s, %d failed, %d threads, %u ms\n",
+		   (unsigned int)s_done.size(), s_dir.c_str(), failed, s_threads, getTimeMs() - start);
+
+	if(!s_verifyDir.empty()){
+		int differ = 0;
+
+		Syzygy::inst().setPath(s_verifyDir.c_str());
+		printf("%d Syzygy tables in %s\n", Syzygy::inst().init(), s_verifyDir.c_str());
+
+		for(std::set<std::string>::iterator it = s_done.begin(); it != s_done.end(); ++it)
+			if(!verify(*it))
+				++differ;
+
+		printf("%d of %u tables differ from Syzygy\n", differ, (unsigned int)s_done.size());
+		failed += differ;
+	}
+
+	return failed ? 1 : 0;
+}
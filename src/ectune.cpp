@@ -0,0 +1,483 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// headless Texel tuner for the classical evaluation
+//
+// usage: ectune [options] file.epd
+//
+//   -o file        parameter header to write (default evalparams.h)
+//   -threads n     worker threads (default: one per core)
+//   -iterations n  gradient descent steps (default 1000), 0 just writes the current values
+//   -rate r        step size in centipawns (default 1)
+//   -k k           sigmoid scale, fitted to the data when not given
+//
+// every line holds a position and the game's result, either as "1-0", "0-1" and
+// "1/2-1/2" (with or without quotes) or as [1.0], [0.5] and [0.0] from white's side.
+// Quiet positions work best; positions in check are skipped.
+//
+// only material and the piece-square tables are tuned. They enter the evaluation
+// linearly, so each position is kept as a short list of table indices with its
+// phase, and the other terms are folded into a constant. The error is the mean
+// squared difference between the result and the evaluation mapped through a
+// sigmoid; workers each take a slice of the positions and sum their gradients.
+// The header written is the one eval.cpp includes, rebuild to use the new values.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "eval.h"
+#include "evalparams.h"
+#include "kpk.h"
+#include "search.h"
+#include "thread.h"
+
+#define MAX_WORKERS		64
+#define MAX_FEATURES	32					// one per piece
+#define LINE_SIZE		1024
+
+// per game phase: a table entry per piece type and square, then material
+#define NUM_SQUARE_TERMS	(6 * SQUARE_NB)
+#define NUM_TERMS			(NUM_SQUARE_TERMS + 6)
+#define NUM_PARAMS			(2 * NUM_TERMS)		// middlegame then endgame
+
+// a labelled position, reduced to what the tuned terms need
+struct TunePosition{
+	short feature[MAX_FEATURES];			// +-(type * 64 + table square + 1), positive for white
+	unsigned char count;
+	unsigned char phase;
+	float result;							// 1 when white won
+	float base;								// the untuned terms, from white's side
+};
+
+struct Worker{
+	Thread thread;
+	size_t begin;
+	size_t end;
+	bool gradient;
+	double error;
+	double grad[NUM_PARAMS];
+};
+
+static std::vector<TunePosition> s_positions;
+static double s_params[NUM_PARAMS];
+static double s_k = 1.0;
+
+static const char* LICENSE =
+	"/*\n"
+	" *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>\n"
+	" *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com\n"
+	" *\n"
+	" *  This program is free software: you can redistribute it and/or modify\n"
+	" *  it under the terms of the GNU General Public License as published by\n"
+	" *  the Free Software Foundation, either version 3 of the License, or\n"
+	" *  (at your option) any later version.\n"
+	" *\n"
+	" *  This program is distributed in the hope that it will be useful,\n"
+	" *  but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
+	" *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n"
+	" *  GNU General Public License for more details.\n"
+	" *\n"
+	" *  You should have received a copy of the GNU General Public License\n"
+	" *  along with this program.  If not, see <http://www.gnu.org/licenses/>.\n"
+	" *\n"
+	" *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.\n"
+	" */\n";
+
+static const char* PIECE_NAMES[6] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+static void loadParams(void)
+{
+	for(int type=P_PAWN; type<=P_KING; ++type){
+		s_params[NUM_SQUARE_TERMS + type] = MATERIAL_MG[type];
+		s_params[NUM_TERMS + NUM_SQUARE_TERMS + type] = MATERIAL_EG[type];
+
+		for(int sq=0; sq<SQUARE_NB; ++sq){
+			s_params[type * SQUARE_NB + sq] = PST_MG[type][sq];
+			s_params[NUM_TERMS + type * SQUARE_NB + sq] = PST_EG[type][sq];
+		}
+	}
+}
+
+static int param(int idx)
+{
+	return (int)floor(s_params[idx] + 0.5);
+}
+
+// FNV-1a over the rounded values
+static U64 paramsId(void)
+{
+	U64 hash = 0xCBF29CE484222325ULL;
+
+	for(int i=0; i<NUM_PARAMS; ++i)
+		hash = (hash ^ (unsigned int)param(i)) * 0x100000001B3ULL;
+
+	return hash;
+}
+
+// evaluation from white's side with the current values
+static double evaluate(const TunePosition& tp)
+{
+	double mg = 0.0, eg = 0.0;
+
+	for(int i=0; i<tp.count; ++i){
+		int f = tp.feature[i];
+		int sign = (f > 0) ? 1 : -1;
+		int idx = f * sign - 1;
+		int material = NUM_SQUARE_TERMS + idx / SQUARE_NB;
+
+		mg += sign * (s_params[idx] + s_params[material]);
+		eg += sign * (s_params[NUM_TERMS + idx] + s_params[NUM_TERMS + material]);
+	}
+
+	return (mg * tp.phase + eg * (PHASE_MAX - tp.phase)) / PHASE_MAX + tp.base;
+}
+
+static double sigmoid(double score)
+{
+	return 1.0 / (1.0 + pow(10.0, -s_k * score / 400.0));
+}
+
+static void work(void* arg)
+{
+	Worker* w = (Worker*)arg;
+
+	w->error = 0.0;
+	if(w->gradient)
+		memset(w->grad, 0, sizeof(w->grad));
+
+	for(size_t n=w->begin; n<w->end; ++n){
+		const TunePosition& tp = s_positions[n];
+		double s = sigmoid(evaluate(tp));
+		double diff = tp.result - s;
+
+		w->error += diff * diff;
+
+		if(!w->gradient)
+			continue;
+
+		// d(error)/d(score), the constant factors are applied once at the end
+		double d = diff * s * (1.0 - s);
+		double dmg = d * tp.phase, deg = d * (PHASE_MAX - tp.phase);
+
+		for(int i=0; i<tp.count; ++i){
+			int f = tp.feature[i];
+			int sign = (f > 0) ? 1 : -1;
+			int idx = f * sign - 1;
+			int material = NUM_SQUARE_TERMS + idx / SQUARE_NB;
+
+			w->grad[idx] += sign * dmg;
+			w->grad[material] += sign * dmg;
+			w->grad[NUM_TERMS + idx] += sign * deg;
+			w->grad[NUM_TERMS + material] += sign * deg;
+		}
+	}
+}
+
+// mean squared error over every position, and its gradient when asked for
+static double computeError(Worker* workers, int threads, double* grad)
+{
+	size_t chunk = (s_positions.size() + threads - 1) / threads;
+	double error = 0.0;
+
+	for(int i=0; i<threads; ++i){
+		workers[i].begin = i * chunk < s_positions.size() ? i * chunk : s_positions.size();
+		workers[i].end = workers[i].begin + chunk < s_positions.size() ? workers[i].begin + chunk : s_positions.size();
+		workers[i].gradient = (grad != NULL);
+		workers[i].thread.start(&work, &workers[i]);
+	}
+
+	for(int i=0; i<threads; ++i)
+		workers[i].thread.join();
+
+	if(grad){
+		double scale = -2.0 * s_k * log(10.0) / 400.0 / PHASE_MAX / s_positions.size();
+
+		memset(grad, 0, NUM_PARAMS * sizeof(double));
+		for(int i=0; i<threads; ++i)
+			for(int j=0; j<NUM_PARAMS; ++j)
+				grad[j] += workers[i].grad[j] * scale;
+	}
+
+	for(int i=0; i<threads; ++i)
+		error += workers[i].error;
+
+	return error / s_positions.size();
+}
+
+// the scale that best maps the starting evaluation to the results
+static void fitK(Worker* workers, int threads)
+{
+	double lo = 0.1, hi = 5.0;
+
+	for(int i=0; i<40; ++i){
+		double a = lo + (hi - lo) / 3.0, b = hi - (hi - lo) / 3.0;
+		double ea, eb;
+
+		s_k = a;
+		ea = computeError(workers, threads, NULL);
+		s_k = b;
+		eb = computeError(workers, threads, NULL);
+
+		if(ea < eb)
+			hi = b;
+		else
+			lo = a;
+	}
+
+	s_k = (lo + hi) / 2.0;
+}
+
+static bool parseResult(const char* line, float& result)
+{
+	const char* p;
+
+	if(strstr(line, "1/2-1/2"))
+		result = 0.5f;
+	else if(strstr(line, "1-0"))
+		result = 1.0f;
+	else if(strstr(line, "0-1"))
+		result = 0.0f;
+	else if((p = strchr(line, '[')) != NULL)
+		result = (float)atof(p + 1);
+	else
+		return false;
+
+	return true;
+}
+
+static bool loadPositions(const char* file)
+{
+	Evaluator evaluator;
+	char line[LINE_SIZE];
+	int skipped = 0;
+	FILE* fp = fopen(file, "r");
+
+	if(fp == NULL){
+		printf("Can't open %s\n", file);
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), fp)){
+		Position pos;
+		TunePosition tp;
+		bool win;
+		int score;
+
+		line[strcspn(line, "\r\n")] = 0;
+		if(line[0] == 0 || line[0] == '#')
+			continue;
+
+		// known endgames are scored by the bitbase, not the tables
+		if(!parseResult(line, tp.result) || !pos.setFEN(line) || pos.inCheck() || kpkProbe(pos, win)){
+			++skipped;
+			continue;
+		}
+
+		tp.count = 0;
+		for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+			int flip = (side == SIDE_WHITE) ? 56 : 0;
+
+			for(int type=P_PAWN; type<=P_KING; ++type){
+				for(U64 b = pos.getPieces(side, type); b && tp.count < MAX_FEATURES;){
+					int f = type * SQUARE_NB + (popLsb(b) ^ flip) + 1;
+
+					tp.feature[tp.count++] = (short)((side == SIDE_WHITE) ? f : -f);
+				}
+			}
+		}
+
+		tp.phase = (unsigned char)Evaluator::gamePhase(pos);
+
+		// whatever the tables don't explain is a constant for this position
+		score = evaluator.evaluate(pos);
+		if(pos.getSide() == SIDE_BLACK)
+			score = -score;
+
+		tp.base = 0.0f;
+		tp.base = (float)(score - evaluate(tp));
+
+		s_positions.push_back(tp);
+	}
+
+	fclose(fp);
+	printf("%u positions from %s, %d skipped\n", (unsigned int)s_positions.size(), file, skipped);
+	return !s_positions.empty();
+}
+
+// the sources use CRLF line endings, a tuning run should only change the values
+static void writeText(FILE* fp, const char* format, ...)
+{
+	char buf[4096];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+
+	for(const char* p = buf; *p; ++p){
+		if(*p == '\n')
+			fputc('\r', fp);
+		fputc(*p, fp);
+	}
+}
+
+static void writeTable(FILE* fp, const char* name, int offset)
+{
+	writeText(fp, "static const int %s[6][SQUARE_NB] = {\n", name);
+
+	for(int type=P_PAWN; type<=P_KING; ++type){
+		writeText(fp, "\t{ // %s\n", PIECE_NAMES[type]);
+
+		for(int sq=0; sq<SQUARE_NB; ++sq){
+			if(sq % 8 == 0)
+				writeText(fp, "\t");
+			writeText(fp, "%3d", param(offset + type * SQUARE_NB + sq));
+
+			if(sq == SQUARE_NB - 1)
+				writeText(fp, (type == P_KING) ? " }\n" : " },\n");
+			else
+				writeText(fp, (sq % 8 == 7) ? ",\n" : ", ");
+		}
+	}
+
+	writeText(fp, "};\n");
+}
+
+static bool writeParams(const char* file, const char* source, double error)
+{
+	FILE* fp = fopen(file, "wb");
+
+	if(fp == NULL){
+		printf("Can't write %s\n", file);
+		return false;
+	}
+
+	writeText(fp, "%s\n#pragma once\n\n", LICENSE);
+	writeText(fp, "// material and piece-square tables of the classical evaluation, written by\n");
+	writeText(fp, "// ectune from %s (%u positions, error %.6f)\n\n", source, (unsigned int)s_positions.size(), error);
+	writeText(fp, "#define EVAL_PARAMS_ID\t0x%016llXULL\t\t// changes with the values, saved tables depend on it\n\n", paramsId());
+
+	writeText(fp, "// material values (middlegame, endgame)\n");
+	writeText(fp, "static const int MATERIAL_MG[6] = { %d, %d, %d, %d, %d, 0 };\n",
+		param(NUM_SQUARE_TERMS), param(NUM_SQUARE_TERMS + 1), param(NUM_SQUARE_TERMS + 2),
+		param(NUM_SQUARE_TERMS + 3), param(NUM_SQUARE_TERMS + 4));
+	writeText(fp, "static const int MATERIAL_EG[6] = { %d, %d, %d, %d, %d, 0 };\n\n",
+		param(NUM_TERMS + NUM_SQUARE_TERMS), param(NUM_TERMS + NUM_SQUARE_TERMS + 1), param(NUM_TERMS + NUM_SQUARE_TERMS + 2),
+		param(NUM_TERMS + NUM_SQUARE_TERMS + 3), param(NUM_TERMS + NUM_SQUARE_TERMS + 4));
+
+	writeText(fp, "// piece-square tables from white's point of view, rank 8 first so they read like a board\n");
+	writeTable(fp, "PST_MG", 0);
+	writeText(fp, "\n");
+	writeTable(fp, "PST_EG", NUM_TERMS);
+
+	fclose(fp);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	static Worker workers[MAX_WORKERS];
+	static double grad[NUM_PARAMS], m[NUM_PARAMS], v[NUM_PARAMS];
+	const char* file = NULL;
+	const char* output = "evalparams.h";
+	int threads = getNumCpus();
+	int iterations = 1000;
+	double rate = 1.0, error = 0.0;
+	bool fixedK = false;
+	unsigned int start;
+
+	for(int i=1; i<argc; ++i){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+			rate = atof(argv[++i]);
+		else if(strcmp(argv[i], "-k") == 0 && i + 1 < argc){
+			s_k = atof(argv[++i]);
+			fixedK = true;
+		}
+		else if(argv[i][0] == '-' || file != NULL){
+			printf("usage: ectune [-o file] [-threads n] [-iterations n] [-rate r] [-k k] file.epd\n");
+			return 1;
+		}
+		else
+			file = argv[i];
+	}
+
+	if(file == NULL){
+		printf("usage: ectune [-o file] [-threads n] [-iterations n] [-rate r] [-k k] file.epd\n");
+		return 1;
+	}
+
+	if(threads < 1)
+		threads = 1;
+	if(threads > MAX_WORKERS)
+		threads = MAX_WORKERS;
+
+	initBitboards();
+	loadParams();
+
+	if(!loadPositions(file))
+		return 1;
+
+	start = getTimeMs();
+
+	if(!fixedK)
+		fitK(workers, threads);
+
+	error = computeError(workers, threads, NULL);
+	printf("k %.4f, starting error %.6f, %d threads\n", s_k, error, threads);
+
+	// Adam, so terms seen in few positions still move at a useful pace
+	for(int it=1; it<=iterations; ++it){
+		const double beta1 = 0.9, beta2 = 0.999;
+		double c1 = 1.0 - pow(beta1, it), c2 = 1.0 - pow(beta2, it);
+
+		error = computeError(workers, threads, grad);
+
+		for(int j=0; j<NUM_PARAMS; ++j){
+			m[j] = beta1 * m[j] + (1.0 - beta1) * grad[j];
+			v[j] = beta2 * v[j] + (1.0 - beta2) * grad[j] * grad[j];
+			s_params[j] -= rate * (m[j] / c1) / (sqrt(v[j] / c2) + 1e-12);
+		}
+
+		// the king is always on the board, its material value means nothing
+		s_params[NUM_SQUARE_TERMS + P_KING] = s_params[NUM_TERMS + NUM_SQUARE_TERMS + P_KING] = 0.0;
+
+		if(it % 50 == 0 || it == iterations)
+			printf("iteration %d: error %.6f (%u ms)\n", it, error, getTimeMs() - start);
+	}
+
+	if(iterations > 0)
+		error = computeError(workers, threads, NULL);
+
+	if(!writeParams(output, file, error))
+		return 1;
+
+	printf("wrote %s, error %.6f, %u ms\n", output, error, getTimeMs() - start);
+	return 0;
+}
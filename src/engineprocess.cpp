@@ -0,0 +1,473 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+	#include <TlHelp32.h>
+#else
+	#include <sys/ioctl.h>
+	#include <poll.h>
+	#include <sys/resource.h>
+	#include <sys/wait.h>
+	#include <cerrno>
+	#include <csignal>
+	#include <fcntl.h>
+	#include <unistd.h>
+
+	#if defined(__linux__)
+		#include <sys/prctl.h>
+	#endif
+#endif
+
+#include "engineprocess.h"
+#include "thread.h"
+
+EngineProcess::EngineProcess()
+{
+#if defined(_WIN32)
+	memset(&m_pi, 0, sizeof(m_pi));
+	m_hRead = m_hWrite = NULL;
+	m_hJob = NULL;
+#else
+	m_pid = 0;
+	m_readFd = m_writeFd = -1;
+#endif
+
+	m_running = false;
+	m_exited = false;
+}
+
+EngineProcess::~EngineProcess()
+{
+	close();
+}
+
+#if defined(_WIN32)
+
+bool EngineProcess::start(const char* path)
+{
+	SECURITY_ATTRIBUTES sa;
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION jeli;
+	STARTUPINFO si;
+	HANDLE childStdin = NULL, childStdout = NULL;
+
+	close();
+
+	sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+	sa.bInheritHandle = TRUE;
+	sa.lpSecurityDescriptor = NULL;
+
+	if(!CreatePipe(&childStdin, &m_hWrite, &sa, 0))
+		return false;
+
+	if(!CreatePipe(&m_hRead, &childStdout, &sa, 0)){
+		CloseHandle(childStdin);
+		CloseHandle(m_hWrite);
+		m_hWrite = NULL;
+		return false;
+	}
+
+	// only the child's ends are inherited, or the engine would never see end of file
+	SetHandleInformation(m_hWrite, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(m_hRead, HANDLE_FLAG_INHERIT, 0);
+
+	GetStartupInfo(&si);
+	si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+	si.wShowWindow = SW_HIDE;
+	si.hStdOutput = childStdout;
+	si.hStdError = childStdout;
+	si.hStdInput = childStdin;
+
+	m_running = CreateProcess(path, NULL, NULL, NULL, TRUE, BELOW_NORMAL_PRIORITY_CLASS, NULL, NULL, &si, &m_pi) != 0;
+
+	CloseHandle(childStdin);
+	CloseHandle(childStdout);
+
+	if(!m_running){
+		CloseHandle(m_hRead);
+		CloseHandle(m_hWrite);
+		m_hRead = m_hWrite = NULL;
+		return false;
+	}
+
+	// closing the job, even by crashing, kills the engine with it
+	m_hJob = CreateJobObject(NULL, NULL);
+	if(m_hJob != NULL){
+		memset(&jeli, 0, sizeof(jeli));
+		jeli.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+
+		if(!SetInformationJobObject(m_hJob, JobObjectExtendedLimitInformation, &jeli, sizeof(jeli)) ||
+		   !AssignProcessToJobObject(m_hJob, m_pi.hProcess)){
+			CloseHandle(m_hJob);
+			m_hJob = NULL;
+		}
+	}
+
+	m_exited = false;
+	return true;
+}
+
+void EngineProcess::kill(void)
+{
+	if(!m_running)
+		return;
+
+	if(m_hWrite) CloseHandle(m_hWrite);
+	m_hWrite = NULL;
+
+	if(!waitExit(ENGINE_QUIT_WAIT))
+		TerminateProcess(m_pi.hProcess, 0);
+
+	if(m_hJob) CloseHandle(m_hJob);
+	if(m_pi.hThread) CloseHandle(m_pi.hThread);
+	if(m_pi.hProcess) CloseHandle(m_pi.hProcess);
+
+	memset(&m_pi, 0, sizeof(m_pi));
+	m_hJob = NULL;
+	m_running = false;
+}
+
+void EngineProcess::close(void)
+{
+	kill();
+
+	if(m_hRead)
+		CloseHandle(m_hRead);
+	m_hRead = NULL;
+}
+
+bool EngineProcess::write(const char* buf, size_t len)
+{
+	DWORD written;
+
+	while(len > 0){
+		if(!m_hWrite || !WriteFile(m_hWrite, buf, (DWORD)len, &written, NULL))
+			return false;
+
+		buf += written;
+		len -= written;
+	}
+
+	return true;
+}
+
+int EngineProcess::getAvailable(void)
+{
+	DWORD avail = 0;
+
+	if(!m_hRead || !PeekNamedPipe(m_hRead, NULL, 0, NULL, &avail, NULL))
+		return -1;
+
+	return (int)avail;
+}
+
+int EngineProcess::read(char* buf, size_t size)
+{
+	DWORD bytes = 0;
+
+	if(!m_hRead || !ReadFile(m_hRead, buf, (DWORD)size, &bytes, NULL))
+		return 0;
+
+	return (int)bytes;
+}
+
+bool EngineProcess::isAlive(void)
+{
+	DWORD code;
+
+	if(!m_running || m_exited)
+		return false;
+
+	if(GetExitCodeProcess(m_pi.hProcess, &code) && code != STILL_ACTIVE)
+		m_exited = true;
+
+	return !m_exited;
+}
+
+bool EngineProcess::waitExit(unsigned int ms)
+{
+	m_exited = m_exited || WaitForSingleObject(m_pi.hProcess, ms) == WAIT_OBJECT_0;
+	return m_exited;
+}
+
+void EngineProcess::killStale(const char* name)
+{
+	PROCESSENTRY32 pe = {0};
+	HANDLE hSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+
+	if(hSnap == INVALID_HANDLE_VALUE)
+		return;
+
+	pe.dwSize = sizeof(PROCESSENTRY32);
+
+	if(Process32First(hSnap, &pe)){
+		do{
+			if(strcmp(pe.szExeFile, name) == 0){
+				HANDLE hProc = OpenProcess(PROCESS_TERMINATE, 0, pe.th32ProcessID);
+
+				if(hProc == NULL || !TerminateProcess(hProc, 0))
+					printf("Failed to terminate the previous engine process \"%s\", end it in the task manager\n", name);
+
+				if(hProc)
+					CloseHandle(hProc);
+			}
+		} while(Process32Next(hSnap, &pe));
+	}
+
+	CloseHandle(hSnap);
+}
+
+#else
+
+static bool setCloseOnExec(int fd)
+{
+	int flags = fcntl(fd, F_GETFD);
+	return flags >= 0 && fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == 0;
+}
+
+// fork and exec rather than posix_spawn, the child has to ask for its parent's death
+// signal itself. A close-on-exec pipe tells us whether the exec worked.
+bool EngineProcess::start(const char* path)
+{
+	int in[2], out[2], status[2];
+	pid_t parent = getpid();
+	int err = 0;
+
+	close();
+
+	// a dead engine must fail the write, not kill the game
+	signal(SIGPIPE, SIG_IGN);
+
+	if(pipe(in) != 0)
+		return false;
+
+	if(pipe(out) != 0){
+		::close(in[0]); ::close(in[1]);
+		return false;
+	}
+
+	if(pipe(status) != 0){
+		::close(in[0]); ::close(in[1]);
+		::close(out[0]); ::close(out[1]);
+		return false;
+	}
+
+	setCloseOnExec(in[1]);
+	setCloseOnExec(out[0]);
+	fcntl(in[1], F_SETFL, fcntl(in[1], F_GETFL) | O_NONBLOCK);
+	setCloseOnExec(status[0]);
+	setCloseOnExec(status[1]);
+
+	m_pid = fork();
+	if(m_pid == 0){
+		setpgid(0, 0);
+
+#if defined(__linux__)
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+		// we may have died before the death signal was asked for
+		if(getppid() != parent)
+			_exit(127);
+
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		dup2(out[1], STDERR_FILENO);
+		::close(in[0]);
+		::close(out[1]);
+
+		signal(SIGPIPE, SIG_DFL);
+		setpriority(PRIO_PROCESS, 0, 5);
+
+		execl(path, path, (char*)NULL);
+
+		err = errno;
+		if(::write(status[1], &err, sizeof(err)) < 0)
+			_exit(126);
+		_exit(127);
+	}
+
+	// both sides set the group, whichever runs first
+	if(m_pid > 0)
+		setpgid(m_pid, m_pid);
+
+	::close(in[0]);
+	::close(out[1]);
+	::close(status[1]);
+
+	if(m_pid < 0){
+		::close(in[1]);
+		::close(out[0]);
+		::close(status[0]);
+		m_pid = 0;
+		return false;
+	}
+
+	// the pipe closes with nothing in it once the exec has happened
+	while(::read(status[0], &err, sizeof(err)) < 0 && errno == EINTR)
+		;
+	::close(status[0]);
+
+	if(err != 0){
+		::close(in[1]);
+		::close(out[0]);
+		waitpid(m_pid, NULL, 0);
+		m_pid = 0;
+		return false;
+	}
+
+	m_writeFd = in[1];
+	m_readFd = out[0];
+	m_running = true;
+	m_exited = false;
+	return true;
+}
+
+// the engine sees end of file first and gets a moment to quit by itself, then
+// the whole group is terminated, so anything it started goes too
+void EngineProcess::kill(void)
+{
+	if(!m_running)
+		return;
+
+	if(m_writeFd >= 0)
+		::close(m_writeFd);
+	m_writeFd = -1;
+
+	if(!waitExit(ENGINE_QUIT_WAIT)){
+		killpg(m_pid, SIGTERM);
+
+		if(!waitExit(ENGINE_QUIT_WAIT)){
+			killpg(m_pid, SIGKILL);
+			waitpid(m_pid, NULL, 0);
+		}
+	}
+
+	m_pid = 0;
+	m_running = false;
+	m_exited = true;
+}
+
+void EngineProcess::close(void)
+{
+	kill();
+
+	if(m_readFd >= 0)
+		::close(m_readFd);
+	m_readFd = -1;
+}
+
+// our end doesn't block, so an engine that stops reading can't hang the game.
+// A full pipe gets a while to drain and a partial write carries on from there.
+bool EngineProcess::write(const char* buf, size_t len)
+{
+	while(len > 0){
+		ssize_t n = (m_writeFd >= 0) ? ::write(m_writeFd, buf, len) : -1;
+
+		if(n < 0){
+			if(errno == EINTR)
+				continue;
+
+			if(errno == EAGAIN || errno == EWOULDBLOCK){
+				struct pollfd pfd;
+				int ready;
+
+				pfd.fd = m_writeFd;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+
+				do{
+					ready = poll(&pfd, 1, ENGINE_WRITE_WAIT);
+				} while(ready < 0 && errno == EINTR);
+
+				if(ready > 0 && !(pfd.revents & (POLLERR | POLLHUP)))
+					continue;
+			}
+
+			return false;
+		}
+
+		buf += n;
+		len -= (size_t)n;
+	}
+
+	return true;
+}
+
+int EngineProcess::getAvailable(void)
+{
+	int avail = 0;
+
+	if(m_readFd < 0 || ioctl(m_readFd, FIONREAD, &avail) != 0)
+		return -1;
+
+	return avail;
+}
+
+int EngineProcess::read(char* buf, size_t size)
+{
+	ssize_t n;
+
+	if(m_readFd < 0)
+		return 0;
+
+	do{
+		n = ::read(m_readFd, buf, size);
+	} while(n < 0 && errno == EINTR);
+
+	return (n > 0) ? (int)n : 0;
+}
+
+bool EngineProcess::isAlive(void)
+{
+	if(!m_running || m_exited)
+		return false;
+
+	if(waitpid(m_pid, NULL, WNOHANG) != 0)
+		m_exited = true;
+
+	return !m_exited;
+}
+
+bool EngineProcess::waitExit(unsigned int ms)
+{
+	for(unsigned int waited=0; !m_exited; waited+=10){
+		if(waitpid(m_pid, NULL, WNOHANG) != 0){
+			m_exited = true;
+			break;
+		}
+
+		if(waited >= ms)
+			break;
+
+		sleepMs(10);
+	}
+
+	return m_exited;
+}
+
+// an engine can't outlive the game here, there is nothing left over to find
+void EngineProcess::killStale(const char* name)
+{
+	(void)name;
+}
+
+#endif
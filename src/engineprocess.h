@@ -0,0 +1,86 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#else
+	#include <sys/types.h>
+#endif
+
+#include <cstddef>
+
+#if defined(_WIN32)
+	#define ENGINE_EXE_SUFFIX	".exe"
+#else
+	#define ENGINE_EXE_SUFFIX	""
+#endif
+
+#define ENGINE_QUIT_WAIT	500			// milliseconds an engine gets to quit before it's killed
+#define ENGINE_WRITE_WAIT	5000		// milliseconds a full pipe may take to drain before a write gives up
+
+// a UCI engine running as a child process, stdin and stdout piped to us. It runs
+// below normal priority and can't outlive the game: on Windows a job object kills
+// it, on POSIX it leads its own process group and gets SIGKILL when we die.
+class EngineProcess{
+public:
+	EngineProcess();
+	~EngineProcess();
+
+	// kill() leaves the output open, so a reader thread blocked in read() gets
+	// what the engine wrote and then the end of it. close() shuts it after that.
+	bool start(const char* path);
+	void kill(void);								// closes its input, then ends the process
+	void close(void);
+
+	bool write(const char* buf, size_t len);		// all of it, false if the engine stopped reading
+	int getAvailable(void);							// bytes that can be read without blocking, -1 once the pipe is closed
+	int read(char* buf, size_t size);				// blocks for output, 0 at the end of it
+
+	// getter functions
+	bool isRunning(void) const;						// started and not yet killed
+	bool isAlive(void);								// the process hasn't exited
+
+	static void killStale(const char* name);		// leftovers of an earlier run, by executable name
+
+private:
+	EngineProcess(const EngineProcess&);
+	EngineProcess& operator=(const EngineProcess&);
+
+	bool waitExit(unsigned int ms);
+
+#if defined(_WIN32)
+	PROCESS_INFORMATION m_pi;
+	HANDLE m_hRead, m_hWrite;
+	HANDLE m_hJob;
+#else
+	pid_t m_pid;
+	int m_readFd, m_writeFd;
+#endif
+
+	bool m_running;
+	bool m_exited;
+};
+
+inline bool EngineProcess::isRunning(void) const
+{
+	return m_running;
+}
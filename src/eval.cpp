@@ -0,0 +1,259 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstring>
+
+#include "eval.h"
+#include "evalparams.h"
+#include "kpk.h"
+
+// contribution of each piece type to the game phase
+static const int PHASE_WEIGHT[6] = { 0, 1, 1, 2, 4, 0 };
+
+// pawn structure, passed pawn bonus by relative rank
+static const int PASSED_MG[8] = { 0, 5, 10, 15, 25, 45, 70, 0 };
+static const int PASSED_EG[8] = { 0, 10, 15, 25, 45, 75, 120, 0 };
+static const int ISOLATED_MG = -10, ISOLATED_EG = -15;
+static const int DOUBLED_MG = -10, DOUBLED_EG = -20;
+static const int CHAIN_MG = 8, CHAIN_EG = 5;
+
+Evaluator::Evaluator()
+{
+	m_accumulators = NULL;
+	m_useBitbase = true;
+	m_pawnTable = new PawnEntry[PAWN_TABLE_SIZE];
+	m_evalCache = new EvalEntry[EVAL_CACHE_SIZE];
+
+	clear();
+	clearStats();
+}
+
+Evaluator::~Evaluator()
+{
+	delete[] m_accumulators;
+	delete[] m_pawnTable;
+	delete[] m_evalCache;
+}
+
+void Evaluator::clear(void)
+{
+	memset(m_pawnTable, 0, PAWN_TABLE_SIZE * sizeof(PawnEntry));
+	memset(m_evalCache, 0, EVAL_CACHE_SIZE * sizeof(EvalEntry));
+}
+
+void Evaluator::clearStats(void)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+int Evaluator::pieceValue(int type)
+{
+	return MATERIAL_MG[type];
+}
+
+int Evaluator::gamePhase(const Position& pos)
+{
+	int phase = 0;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side)
+		for(int type=P_KNIGHT; type<=P_QUEEN; ++type)
+			phase += PHASE_WEIGHT[type] * popCount(pos.getPieces(side, type));
+
+	return (phase > PHASE_MAX) ? PHASE_MAX : phase;
+}
+
+U64 Evaluator::getParamsId(void)
+{
+	return EVAL_PARAMS_ID;
+}
+
+// king and pawn against king is decided by the bitbase, the pawn's advance
+// keeps the search pushing it
+bool Evaluator::evaluateKnown(const Position& pos, int& score)
+{
+	bool win;
+
+	if(!kpkProbe(pos, win))
+		return false;
+
+	int strong = pos.getPieces(SIDE_WHITE, P_PAWN) ? SIDE_WHITE : SIDE_BLACK;
+
+	score = win ? VALUE_KNOWN_WIN + 20 * relativeRank(strong, lsb(pos.getPieces(strong, P_PAWN))) : 0;
+	if(pos.getSide() != strong)
+		score = -score;
+
+	return true;
+}
+
+// siblings and transpositions are often evaluated more than once per search
+int Evaluator::evaluate(const Position& pos)
+{
+	Network& network = Network::inst();
+	EvalEntry& entry = m_evalCache[pos.getKey() & (EVAL_CACHE_SIZE - 1)];
+	int known;
+
+	if(m_useBitbase && evaluateKnown(pos, known))
+		return known;
+
+	if(entry.key == pos.getKey()){
+		++m_stats.cacheHits;
+		return entry.score;
+	}
+	++m_stats.cacheMisses;
+
+	if(network.isLoaded()){
+		if(m_accumulators == NULL){
+			m_accumulators = new Accumulator[MAX_HISTORY];
+			memset(m_accumulators, 0, MAX_HISTORY * sizeof(Accumulator));
+		}
+
+		entry.score = network.evaluate(pos, m_accumulators);
+	}
+	else
+		entry.score = evaluateClassical(pos);
+
+	entry.key = pos.getKey();
+	return entry.score;
+}
+
+// the network runs blocks of positions through its output layer together. The
+// classical terms are gathered a block at a time and tapered in one loop the
+// compiler can vectorise.
+void Evaluator::evaluateBatch(const Position* const* pos, int n, int* out)
+{
+	int mg[EVAL_BATCH], eg[EVAL_BATCH], phase[EVAL_BATCH], sign[EVAL_BATCH];
+	int known;
+
+	if(Network::inst().isLoaded()){
+		Network::inst().evaluateBatch(pos, n, out);
+	}
+	else{
+		for(int base=0; base<n; base+=EVAL_BATCH){
+			int count = (n - base < EVAL_BATCH) ? n - base : EVAL_BATCH;
+
+			for(int b=0; b<count; ++b){
+				gatherClassical(*pos[base + b], mg[b], eg[b], phase[b]);
+				sign[b] = (pos[base + b]->getSide() == SIDE_WHITE) ? 1 : -1;
+			}
+
+			for(int b=0; b<count; ++b)
+				out[base + b] = sign[b] * ((mg[b] * phase[b] + eg[b] * (PHASE_MAX - phase[b])) / PHASE_MAX) + TEMPO;
+		}
+	}
+
+	for(int i=0; i<n; ++i)
+		if(m_useBitbase && evaluateKnown(*pos[i], known))
+			out[i] = known;
+}
+
+// passed, isolated, doubled and supported pawns for both sides
+const PawnEntry& Evaluator::probePawns(const Position& pos)
+{
+	PawnEntry& entry = m_pawnTable[pos.getPawnKey() & (PAWN_TABLE_SIZE - 1)];
+
+	if(entry.key == pos.getPawnKey()){
+		++m_stats.pawnHits;
+		return entry;
+	}
+	++m_stats.pawnMisses;
+
+	int mg[2] = {0, 0}, eg[2] = {0, 0};
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		U64 ours = pos.getPieces(side, P_PAWN);
+		U64 theirs = pos.getPieces(side ^ 1, P_PAWN);
+
+		for(U64 b = ours; b;){
+			int sq = popLsb(b);
+			int rank = rankOf(sq);
+			U64 file = FILE_A_BB << fileOf(sq);
+			U64 adjacent = ((file << 1) & ~FILE_A_BB) | ((file >> 1) & ~FILE_H_BB);
+			U64 ahead = (side == SIDE_WHITE) ? (~0ULL << (rank * 8)) << 8 : (1ULL << (rank * 8)) - 1;
+
+			if(!((file | adjacent) & ahead & theirs)){
+				mg[side] += PASSED_MG[relativeRank(side, sq)];
+				eg[side] += PASSED_EG[relativeRank(side, sq)];
+			}
+
+			if(!(adjacent & ours)){
+				mg[side] += ISOLATED_MG;
+				eg[side] += ISOLATED_EG;
+			}
+
+			if(file & ahead & ours){
+				mg[side] += DOUBLED_MG;
+				eg[side] += DOUBLED_EG;
+			}
+
+			if(g_pawnAttacks[side ^ 1][sq] & ours){
+				mg[side] += CHAIN_MG;
+				eg[side] += CHAIN_EG;
+			}
+		}
+	}
+
+	entry.key = pos.getPawnKey();
+	entry.mg = mg[SIDE_WHITE] - mg[SIDE_BLACK];
+	entry.eg = eg[SIDE_WHITE] - eg[SIDE_BLACK];
+	return entry;
+}
+
+int Evaluator::evaluateClassical(const Position& pos)
+{
+	int mg, eg, phase;
+	int score;
+
+	gatherClassical(pos, mg, eg, phase);
+
+	// taper between middlegame and endgame scores
+	score = (mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX;
+
+	return ((pos.getSide() == SIDE_WHITE) ? score : -score) + TEMPO;
+}
+
+// material, piece-square and pawn terms summed for each phase
+void Evaluator::gatherClassical(const Position& pos, int& mgScore, int& egScore, int& phase)
+{
+	const PawnEntry& pawns = probePawns(pos);
+	int mg[2] = {0, 0}, eg[2] = {0, 0};
+
+	phase = 0;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		// the tables are laid out rank 8 first, so white squares are flipped
+		int flip = (side == SIDE_WHITE) ? 56 : 0;
+
+		for(int type=P_PAWN; type<=P_KING; ++type){
+			for(U64 b = pos.getPieces(side, type); b;){
+				int sq = popLsb(b) ^ flip;
+
+				mg[side] += MATERIAL_MG[type] + PST_MG[type][sq];
+				eg[side] += MATERIAL_EG[type] + PST_EG[type][sq];
+				phase += PHASE_WEIGHT[type];
+			}
+		}
+	}
+
+	if(phase > PHASE_MAX)
+		phase = PHASE_MAX;
+
+	mgScore = mg[SIDE_WHITE] - mg[SIDE_BLACK] + pawns.mg;
+	egScore = eg[SIDE_WHITE] - eg[SIDE_BLACK] + pawns.eg;
+}
@@ -0,0 +1,107 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+#include "nnue.h"
+
+#define PHASE_MAX	24			// game phase with all minor and major pieces on the board
+
+#define VALUE_KNOWN_WIN		10000	// a won endgame, well clear of any positional score
+#define EVAL_VERSION		1		// bump with any change to the classical evaluation, saved tables depend on it
+
+#define PAWN_TABLE_SIZE		16384	// entries, power of two
+#define EVAL_CACHE_SIZE		65536	// entries, power of two
+#define EVAL_BATCH			64		// positions evaluateBatch tapers in one pass
+
+// pawn structure score, keyed by the pawn-only hash
+struct PawnEntry{
+	U64 key;
+	int mg;
+	int eg;
+};
+
+// full static evaluation, keyed by the position hash
+struct EvalEntry{
+	U64 key;
+	int score;
+};
+
+struct EvalStats{
+	U64 pawnHits;
+	U64 pawnMisses;
+	U64 cacheHits;
+	U64 cacheMisses;
+};
+
+// static evaluation for the built-in engine
+class Evaluator{
+public:
+	Evaluator();
+	~Evaluator();
+
+	int evaluate(const Position& pos);		// centipawns from the side to move's point of view, uses the network when loaded
+
+	// the same scores for unrelated positions, say a data set or the moves at a
+	// node. Skips the cache, which only pays for positions seen again.
+	void evaluateBatch(const Position* const* pos, int n, int* out);
+
+	static int pieceValue(int type);		// middlegame material, used for move ordering
+	static int gamePhase(const Position& pos);	// 0 (bare kings and pawns) to PHASE_MAX
+	static U64 getParamsId(void);			// EVAL_PARAMS_ID of the tables built in
+
+	void clear(void);						// empties both caches
+	void clearStats(void);
+
+	// getter functions
+	const EvalStats& getStats(void) const;
+
+	// setter functions
+	void setUseBitbase(bool use);			// score KPK from the bitbase, on by default
+
+private:
+	Evaluator(const Evaluator&);
+	Evaluator& operator=(const Evaluator&);
+
+	int evaluateClassical(const Position& pos);
+	void gatherClassical(const Position& pos, int& mgScore, int& egScore, int& phase);	// white's point of view
+	const PawnEntry& probePawns(const Position& pos);
+
+	static bool evaluateKnown(const Position& pos, int& score);
+
+	static const int TEMPO = 10;
+
+	Accumulator* m_accumulators;			// network state per move history entry, allocated on first use
+	PawnEntry* m_pawnTable;
+	EvalEntry* m_evalCache;
+	EvalStats m_stats;
+	bool m_useBitbase;
+};
+
+inline const EvalStats& Evaluator::getStats(void) const
+{
+	return m_stats;
+}
+
+inline void Evaluator::setUseBitbase(bool use)
+{
+	m_useBitbase = use;
+}
@@ -37,6 +37,7 @@ Game::Game()
 	m_planet		= PLANET_SATURN;
 	m_textureMode	= METALLIC;
 	m_time			= m_whiteTime = m_blackTime = DEFAULT_TIME;
+	m_increment		= 0;
 	m_aiLevel		= LION;
 	m_gameState		= STATE_LOADING;
 
@@ -269,7 +270,7 @@ bool Game::writeSave(const char* file)
 	save.m_blackCastle = m_blackCastle;
 	save.m_whiteKingInCheck = m_whiteKingInCheck;
 	save.m_blackKingInCheck = m_blackKingInCheck;
-	strcpy(save.m_pos, AI::inst().getPos());
+	AI::inst().getPos(save.m_pos, sizeof(save.m_pos));
 
 	// create the file
 	fp = fopen(file, "wb");
@@ -976,6 +977,8 @@ bool Game::movePiece(void)
 			m_drawSelection = true;
 		}
 
+		// the player's and the AI's moves both end here, whoever just moved gets the increment
+		(m_turn == WHITE) ? m_whiteTime += m_increment : m_blackTime += m_increment;
 		m_turn = !m_turn;
 	}
 
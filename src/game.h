@@ -256,6 +256,7 @@ public:
 	unsigned int getAILevel(void);
 	unsigned int getTime(bool color);					// retrieve time left for player
 	unsigned int getTime(void);							// get the game setting for time
+	unsigned int getIncrement(void);					// added to a player's clock after each move
 	unsigned int getChessSet(void);
 	unsigned int getSkybox(void);
 	unsigned int getPlanet(void);
@@ -287,6 +288,7 @@ public:
 	void setTurn(bool turn);
 	void setTime(bool color, unsigned int time);
 	void setTime(unsigned int time);
+	void setIncrement(unsigned int increment);
 	void appendStatusStream(const char* str);
 	void setStreamBuffer(const char* str);
 	void setChessSet(unsigned int set);
@@ -371,6 +373,7 @@ protected:
 	unsigned int m_animateToX, m_animateToY;				// where to animate to
 	unsigned int m_animationSpeed;						// how fast the piece will move
 	unsigned int m_time;
+	unsigned int m_increment;
 	unsigned int m_whiteTime;
 	unsigned int m_blackTime;
 
@@ -525,6 +528,11 @@ inline unsigned int Game::getTime(void)
 	return m_time;
 }
 
+inline unsigned int Game::getIncrement(void)
+{
+	return m_increment;
+}
+
 inline bool Game::isAnimating(void)
 {
 	return m_animating;
@@ -694,6 +702,11 @@ inline void Game::setTime(unsigned int time)
 	m_time = time;
 }
 
+inline void Game::setIncrement(unsigned int increment)
+{
+	m_increment = increment;
+}
+
 inline void Game::appendStatusStream(const char* str)
 {
 	m_output << str << std::endl;
@@ -0,0 +1,217 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "hint.h"
+
+Hint::Hint()
+{
+	m_tt = NULL;
+	m_search = NULL;
+	m_pos[0] = 0;
+	m_key = 0;
+	m_searchKey = 0;
+	m_generation = 0;
+	m_searchGeneration = 0;
+	m_running = false;
+	m_finished = true;
+
+	memset(m_cache, 0, sizeof(m_cache));
+}
+
+Hint::~Hint()
+{
+	stop();
+}
+
+Hint& Hint::inst(void)
+{
+	static Hint hint;
+	return hint;
+}
+
+bool Hint::start(void)
+{
+	if(m_running)
+		return true;
+
+	m_tt = new TransTable();
+	m_tt->resize(HINT_TT_MB);
+	m_search = new Search(*m_tt);
+
+	m_lock.lock();
+	m_pos[0] = 0;
+	m_key = 0;
+	++m_generation;
+	m_lock.unlock();
+
+	m_running = true;
+	m_finished = false;
+
+	if(!m_thread.start(&worker, this)){
+		printf("Failed to start the hint thread\n");
+		m_running = false;
+		m_finished = true;
+		delete m_search;
+		delete m_tt;
+		m_search = NULL;
+		m_tt = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void Hint::stop(void)
+{
+	if(!m_search)
+		return;
+
+	// a stop can land just before the worker starts the next search, so repeat it
+	m_running = false;
+	while(!m_finished){
+		m_search->stop();
+		sleepMs(10);
+	}
+
+	m_thread.join();
+
+	delete m_search;
+	delete m_tt;
+	m_search = NULL;
+	m_tt = NULL;
+}
+
+// called every frame, like Analysis::setPosition(). NULL stops the search
+// until the player is on move again, so it doesn't compete with the opponent.
+void Hint::setPosition(const char* pos)
+{
+	if(!m_running)
+		return;
+
+	if(pos == NULL)
+		pos = "";
+
+	m_lock.lock();
+
+	if(strcmp(pos, m_pos) != 0){
+		strncpy(m_pos, pos, sizeof(m_pos) - 1);
+		m_pos[sizeof(m_pos) - 1] = 0;
+		m_key = (m_pos[0] && m_board.setPosition(m_pos)) ? m_board.getKey() : 0;
+		++m_generation;
+	}
+
+	if(m_searchGeneration != m_generation)
+		m_search->stop();
+
+	m_lock.unlock();
+}
+
+// the running search has the freshest move, the cache covers the moment
+// before its first iteration finishes
+bool Hint::getHint(char* move, int& depth)
+{
+	SearchLine lines[MAX_MULTIPV];
+	int num;
+	bool found = false;
+
+	if(!m_running)
+		return false;
+
+	m_lock.lock();
+
+	if(m_key != 0 && m_searchKey == m_key && m_search->getLines(lines, num) && num > 0)
+		remember(m_key, lines[0]);
+
+	HintEntry& entry = m_cache[m_key & (HINT_CACHE_SIZE - 1)];
+	if(m_key != 0 && entry.key == m_key){
+		Position::moveToStr(entry.move, move);
+		depth = entry.depth;
+		found = true;
+	}
+
+	m_lock.unlock();
+	return found;
+}
+
+// keeps the deeper result when the position was searched before
+void Hint::remember(U64 key, const SearchLine& line)
+{
+	HintEntry& entry = m_cache[key & (HINT_CACHE_SIZE - 1)];
+
+	if(line.length == 0 || (entry.key == key && entry.depth > line.depth))
+		return;
+
+	entry.key = key;
+	entry.move = line.moves[0];
+	entry.depth = line.depth;
+}
+
+void Hint::worker(void* arg)
+{
+	((Hint*)arg)->run();
+}
+
+void Hint::run(void)
+{
+	char pos[sizeof(m_pos)];
+	unsigned int generation = m_generation - 1;
+	Position board;
+	SearchLimits limits;
+	SearchLine lines[MAX_MULTIPV];
+	int num;
+
+	lowerThreadPriority();
+
+	while(m_running){
+		m_lock.lock();
+		bool changed = (generation != m_generation);
+		if(changed){
+			generation = m_generation;
+			strcpy(pos, m_pos);
+		}
+		m_searchGeneration = generation;
+		m_lock.unlock();
+
+		if(!changed || pos[0] == 0 || !board.setPosition(pos)){
+			sleepMs(20);
+			continue;
+		}
+
+		m_search->clearLines();
+
+		m_lock.lock();
+		m_searchKey = board.getKey();
+		m_lock.unlock();
+
+		// no limits, like the analysis panel. Whatever it got to is kept for a later visit.
+		m_search->think(board, limits);
+
+		m_lock.lock();
+		if(m_search->getLines(lines, num) && num > 0)
+			remember(board.getKey(), lines[0]);
+		m_searchKey = 0;
+		m_lock.unlock();
+	}
+
+	m_finished = true;
+}
@@ -0,0 +1,82 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "search.h"
+
+#define HINT_TT_MB			16
+#define HINT_CACHE_SIZE		256		// positions remembered, power of two
+
+// best move found for one position
+struct HintEntry{
+	U64 key;
+	Move move;
+	int depth;
+};
+
+// searches the player's position on a low priority thread whenever it's their
+// turn, so a hint is there the moment it's asked for. The best move of each
+// position is cached by key, which also covers going back to an earlier one.
+class Hint{
+public:
+	static Hint& inst(void);
+
+	bool start(void);
+	void stop(void);
+
+	void setPosition(const char* pos);					// UCI position command, NULL while the player waits
+	bool getHint(char* move, int& depth);				// false until an iteration has finished in the current position
+
+	// getter functions
+	bool isRunning(void) const;
+
+private:
+	Hint();
+	~Hint();
+	Hint(const Hint&);
+	Hint& operator=(const Hint&);
+
+	static void worker(void* arg);
+	void run(void);
+	void remember(U64 key, const SearchLine& line);
+
+	// allocated while running, like the analysis search
+	TransTable* m_tt;
+	Search* m_search;
+	Thread m_thread;
+	Position m_board;									// the position set, for its key
+
+	Mutex m_lock;										// guards the position, the keys and the cache
+	char m_pos[4096];
+	U64 m_key;											// of the position set, 0 while waiting
+	U64 m_searchKey;									// of the position the worker is searching
+	unsigned int m_generation;
+	volatile unsigned int m_searchGeneration;
+	HintEntry m_cache[HINT_CACHE_SIZE];
+
+	volatile bool m_running;
+	volatile bool m_finished;
+};
+
+inline bool Hint::isRunning(void) const
+{
+	return m_running;
+}
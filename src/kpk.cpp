@@ -0,0 +1,60 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include "kpk.h"
+#include "kpkdata.h"
+
+bool kpkProbe(int side, int wksq, int wpsq, int bksq)
+{
+	unsigned int idx = kpkIndex(side, bksq, wksq, wpsq);
+
+	return (s_kpkBitbase[idx >> 5] >> (idx & 31)) & 1;
+}
+
+// turns the position around so the pawn is white and on the queen side
+bool kpkProbe(const Position& pos, bool& win)
+{
+	int strong, wksq, wpsq, bksq, side;
+
+	if(popCount(pos.getOccupied()) != 3 || popCount(pos.getPieces(SIDE_WHITE, P_PAWN) | pos.getPieces(SIDE_BLACK, P_PAWN)) != 1)
+		return false;
+
+	strong = pos.getPieces(SIDE_WHITE, P_PAWN) ? SIDE_WHITE : SIDE_BLACK;
+	wksq = lsb(pos.getPieces(strong, P_KING));
+	wpsq = lsb(pos.getPieces(strong, P_PAWN));
+	bksq = lsb(pos.getPieces(strong ^ 1, P_KING));
+	side = pos.getSide();
+
+	if(strong == SIDE_BLACK){
+		wksq ^= 56;
+		wpsq ^= 56;
+		bksq ^= 56;
+		side ^= 1;
+	}
+
+	if(fileOf(wpsq) > 3){
+		wksq ^= 7;
+		wpsq ^= 7;
+		bksq ^= 7;
+	}
+
+	win = kpkProbe(side, wksq, wpsq, bksq);
+	return true;
+}
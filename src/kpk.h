@@ -0,0 +1,36 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+
+// king and pawn against king, one bit per position: set when the pawn's side wins.
+// The white side has the pawn on files a-d, so 24 pawn squares x 2 sides to move
+// x 64 x 64 king squares.
+#define KPK_SIZE		(2 * 24 * SQUARE_NB * SQUARE_NB)
+
+inline unsigned int kpkIndex(int side, int bksq, int wksq, int psq)
+{
+	return wksq | (bksq << 6) | (side << 12) | (fileOf(psq) << 13) | ((6 - rankOf(psq)) << 15);
+}
+
+bool kpkProbe(int side, int wksq, int wpsq, int bksq);		// pawn on files a-d
+bool kpkProbe(const Position& pos, bool& win);				// false unless the material is KPvK
@@ -0,0 +1,772 @@
+// KPK bitbase, generated by kpkgen. Do not edit.
+
+static const unsigned int s_kpkBitbase[KPK_SIZE / 32] = {
+	0xFFFFFCFC, 0xFFFEFFFF, 0xFFFFF8F8, 0xFFFEFFFF, 0xFFFFF1F1, 0xFFFEFFFF, 0xFFFFE3E3, 0xFFFEFFFF,
+	0xFFFFC7C7, 0xFFFEFFFF, 0xFFFF8F8F, 0xFFFEFFFF, 0xFFFF1F1F, 0xFFFEFFFF, 0xFFFF3F3F, 0xFFFEFFFF,
+	0xFFFCFCFC, 0xFFFEFFFF, 0xFFF8F8F8, 0xFFFEFFFF, 0xFFF1F1F1, 0xFFFEFFFF, 0xFFE3E3E3, 0xFFFEFFFF,
+	0xFFC7C7C7, 0xFFFEFFFF, 0xFF8F8F8F, 0xFFFEFFFF, 0xFF1F1F1F, 0xFFFEFFFF, 0xFF3F3F3F, 0xFFFEFFFF,
+	0xFCFCFCFF, 0xFFFEFFFF, 0xF8F8F8FF, 0xFFFEFFFF, 0xF1F1F1FF, 0xFFFEFFFF, 0xE3E3E3FF, 0xFFFEFFFF,
+	0xC7C7C7FF, 0xFFFEFFFF, 0x8F8F8FFF, 0xFFFEFFFF, 0x1F1F1FFF, 0xFFFEFFFF, 0x3F3F3FFF, 0xFFFEFFFF,
+	0xFCFCFFFF, 0xFFFEFFFC, 0xF8F8FFFF, 0xFFFEFFF8, 0xF1F1FFFF, 0xFFFEFFF1, 0xE3E3FFFF, 0xFFFEFFE3,
+	0xC7C7FFFF, 0xFFFEFFC7, 0x8F8FFFFF, 0xFFFEFF8F, 0x1F1FFFFF, 0xFFFEFF1F, 0x3F3FFFFF, 0xFFFEFF3F,
+	0xFCFFFFFF, 0xFFFEFCFC, 0xF8FFFFFF, 0xFFFEF8F8, 0xF1FFFFFF, 0xFFFEF1F1, 0xE3FFFFFF, 0xFFFEE3E3,
+	0xC7FFFFFF, 0xFFFEC7C7, 0x8FFFFFFF, 0xFFFE8F8F, 0x1FFFFFFF, 0xFFFE1F1F, 0x3FFFFFFF, 0xFFFE3F3F,
+	0xFFFFFFFF, 0xFFFCFCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF0F1F1, 0xFFFFFFFF, 0xFFE2E3E3,
+	0xFFFFFFFF, 0xFFC6C7C7, 0xFFFFFFFF, 0xFF8E8F8F, 0xFFFFFFFF, 0xFF1E1F1F, 0xFFFFFFFF, 0xFF3E3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0xFFFFFFFF, 0xF0F0F1FF, 0xFFFFFFFF, 0xE3E2E3FF,
+	0xFFFFFFFF, 0xC7C6C7FF, 0xFFFFFFFF, 0x8F8E8FFF, 0xFFFFFFFF, 0x1F1E1FFF, 0xFFFFFFFF, 0x3F3E3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0xFFFFFFFF, 0xF0F0FFFF, 0xFFFFFFFF, 0xE3E2FFFF,
+	0xFFFFFFFF, 0xC7C6FFFF, 0xFFFFFFFF, 0x8F8EFFFF, 0xFFFFFFFF, 0x1F1EFFFF, 0xFFFFFFFF, 0x3F3EFFFF,
+	0xFFFFFCFC, 0xFFFEFFFF, 0xFFFFF8F8, 0xFFFEFFFF, 0xFFFFF1F1, 0xFFFEFFFF, 0xFFFFE3E3, 0xFFFEFFFF,
+	0xFFFFC7C7, 0xFFFEFFFF, 0xFFFF8F8F, 0xFFFEFFFF, 0xFFFF1F1F, 0xFFFEFFFF, 0xFFFF3F3F, 0xFFFEFFFF,
+	0xFFFCFCFC, 0xFFFEFFFF, 0xFFF8F8F8, 0xFFFEFFFF, 0xFFF1F1F1, 0xFFFEFFFF, 0xFFE3E3E3, 0xFFFEFFFF,
+	0xFFC7C7C7, 0xFFFEFFFF, 0xFF8F8F8F, 0xFFFEFFFF, 0xFF1F1F1F, 0xFFFEFFFF, 0xFF3F3F3F, 0xFFFEFFFF,
+	0xFCFCFCFF, 0xFFFEFFFF, 0xF8F8F8FF, 0xFFFEFFFF, 0xF1F1F1FF, 0xFFFEFFFF, 0xE3E3E3FF, 0xFFFEFFFF,
+	0xC7C7C7FF, 0xFFFEFFFF, 0x8F8F8FFF, 0xFFFEFFFF, 0x1F1F1FFF, 0xFFFEFFFF, 0x3F3F3FFF, 0xFFFEFFFF,
+	0xFCFCFFFF, 0xFFFEFFFC, 0xF8F8FFFF, 0xFFFEFFF8, 0xF1F1FFFF, 0xFFFEFFF1, 0xE3E3FFFF, 0xFFFEFFE3,
+	0xC7C7FFFF, 0xFFFEFFC7, 0x8F8FFFFF, 0xFFFEFF8F, 0x1F1FFFFF, 0xFFFEFF1F, 0x3F3FFFFF, 0xFFFEFF3F,
+	0xFCFFFFFF, 0xFFFEFCFC, 0xF8FFFFFF, 0xFFFEF8F8, 0xF1FFFFFF, 0xFFFEF1F1, 0xE3FFFFFF, 0xFFFEE3E3,
+	0xC7FFFFFF, 0xFFFEC7C7, 0x8FFFFFFF, 0xFFFE8F8F, 0x1FFFFFFF, 0xFFFE1F1F, 0x3FFFFFFF, 0xFFFE3F3F,
+	0x00000000, 0x03000000, 0x00000000, 0x02000000, 0x00000000, 0x06000100, 0xFFFFFFFF, 0xFEE2E3E3,
+	0xFFFFFFFF, 0xFFC6C7C7, 0xFFFFFFFF, 0xFF8E8F8F, 0xFFFFFFFF, 0xFF1E1F1F, 0xFFFFFFFF, 0xFF3E3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000100, 0xFFFFFFFF, 0xE2E2E3FF,
+	0xFFFFFFFF, 0xC7C6C7FF, 0xFFFFFFFF, 0x8F8E8FFF, 0xFFFFFFFF, 0x1F1E1FFF, 0xFFFFFFFF, 0x3F3E3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000700, 0xFFFFFFFF, 0xE2E2FFFF,
+	0xFFFFFFFF, 0xC7C6FFFF, 0xFFFFFFFF, 0x8F8EFFFF, 0xFFFFFFFF, 0x1F1EFFFF, 0xFFFFFFFF, 0x3F3EFFFF,
+	0xFFFFFCFC, 0xFFFDFFFF, 0xFFFFF8F8, 0xFFFDFFFF, 0xFFFFF1F1, 0xFFFDFFFF, 0xFFFFE3E3, 0xFFFDFFFF,
+	0xFFFFC7C7, 0xFFFDFFFF, 0xFFFF8F8F, 0xFFFDFFFF, 0xFFFF1F1F, 0xFFFDFFFF, 0xFFFF3F3F, 0xFFFDFFFF,
+	0xFFFCFCFC, 0xFFFDFFFF, 0xFFF8F8F8, 0xFFFDFFFF, 0xFFF1F1F1, 0xFFFDFFFF, 0xFFE3E3E3, 0xFFFDFFFF,
+	0xFFC7C7C7, 0xFFFDFFFF, 0xFF8F8F8F, 0xFFFDFFFF, 0xFF1F1F1F, 0xFFFDFFFF, 0xFF3F3F3F, 0xFFFDFFFF,
+	0xFCFCFCFF, 0xFFFDFFFF, 0xF8F8F8FF, 0xFFFDFFFF, 0xF1F1F1FF, 0xFFFDFFFF, 0xE3E3E3FF, 0xFFFDFFFF,
+	0xC7C7C7FF, 0xFFFDFFFF, 0x8F8F8FFF, 0xFFFDFFFF, 0x1F1F1FFF, 0xFFFDFFFF, 0x3F3F3FFF, 0xFFFDFFFF,
+	0xFCFCFFFF, 0xFFFDFFFC, 0xF8F8FFFF, 0xFFFDFFF8, 0xF1F1FFFF, 0xFFFDFFF1, 0xE3E3FFFF, 0xFFFDFFE3,
+	0xC7C7FFFF, 0xFFFDFFC7, 0x8F8FFFFF, 0xFFFDFF8F, 0x1F1FFFFF, 0xFFFDFF1F, 0x3F3FFFFF, 0xFFFDFF3F,
+	0xFCFFFFFF, 0xFFFDFCFC, 0xF8FFFFFF, 0xFFFDF8F8, 0xF1FFFFFF, 0xFFFDF1F1, 0xE3FFFFFF, 0xFFFDE3E3,
+	0xC7FFFFFF, 0xFFFDC7C7, 0x8FFFFFFF, 0xFFFD8F8F, 0x1FFFFFFF, 0xFFFD1F1F, 0x3FFFFFFF, 0xFFFD3F3F,
+	0xFFFFFFFF, 0xFFFCFCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE1E3E3,
+	0xFFFFFFFF, 0xFFC5C7C7, 0xFFFFFFFF, 0xFF8D8F8F, 0xFFFFFFFF, 0xFF1D1F1F, 0xFFFFFFFF, 0xFF3D3F3F,
+	0x00000000, 0x0C0C0C00, 0x00000000, 0x00000000, 0x00000000, 0x01010100, 0xFFFFFFFF, 0xE3E1E3FF,
+	0xFFFFFFFF, 0xC7C5C7FF, 0xFFFFFFFF, 0x8F8D8FFF, 0xFFFFFFFF, 0x1F1D1FFF, 0xFFFFFFFF, 0x3F3D3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00080A0F, 0x00000000, 0x00000000, 0xFFFFFFFF, 0xE3E1FFFF,
+	0xFFFFFFFF, 0xC7C5FFFF, 0xFFFFFFFF, 0x8F8DFFFF, 0xFFFFFFFF, 0x1F1DFFFF, 0xFFFFFFFF, 0x3F3DFFFF,
+	0xFFFFFCFC, 0xFFFDFFFF, 0xFFFFF8F8, 0xFFFDFFFF, 0xFFFFF1F1, 0xFFFDFFFF, 0xFFFFE3E3, 0xFFFDFFFF,
+	0xFFFFC7C7, 0xFFFDFFFF, 0xFFFF8F8F, 0xFFFDFFFF, 0xFFFF1F1F, 0xFFFDFFFF, 0xFFFF3F3F, 0xFFFDFFFF,
+	0xFFFCFCFC, 0xFFFDFFFF, 0xFFF8F8F8, 0xFFFDFFFF, 0xFFF1F1F1, 0xFFFDFFFF, 0xFFE3E3E3, 0xFFFDFFFF,
+	0xFFC7C7C7, 0xFFFDFFFF, 0xFF8F8F8F, 0xFFFDFFFF, 0xFF1F1F1F, 0xFFFDFFFF, 0xFF3F3F3F, 0xFFFDFFFF,
+	0xFCFCFCFF, 0xFFFDFFFF, 0xF8F8F8FF, 0xFFFDFFFF, 0xF1F1F1FF, 0xFFFDFFFF, 0xE3E3E3FF, 0xFFFDFFFF,
+	0xC7C7C7FF, 0xFFFDFFFF, 0x8F8F8FFF, 0xFFFDFFFF, 0x1F1F1FFF, 0xFFFDFFFF, 0x3F3F3FFF, 0xFFFDFFFF,
+	0xFCFCFFFF, 0xFFFDFFFC, 0xF8F8FFFF, 0xFFFDFFF8, 0xF1F1FFFF, 0xFFFDFFF1, 0xE3E3FFFF, 0xFFFDFFE3,
+	0xC7C7FFFF, 0xFFFDFFC7, 0x8F8FFFFF, 0xFFFDFF8F, 0x1F1FFFFF, 0xFFFDFF1F, 0x3F3FFFFF, 0xFFFDFF3F,
+	0xFCFFFFFF, 0xFFFDFCFC, 0xF8FFFFFF, 0xFFFDF8F8, 0xF1FFFFFF, 0xFFFDF1F1, 0xE3FFFFFF, 0xFFFDE3E3,
+	0xC7FFFFFF, 0xFFFDC7C7, 0x8FFFFFFF, 0xFFFD8F8F, 0x1FFFFFFF, 0xFFFD1F1F, 0x3FFFFFFF, 0xFFFD3F3F,
+	0x00000000, 0x07040400, 0x00000000, 0x07000000, 0x00000000, 0x07010100, 0x00000000, 0x0F010300,
+	0xFFFFFFFF, 0xFFC5C7C7, 0xFFFFFFFF, 0xFF8D8F8F, 0xFFFFFFFF, 0xFF1D1F1F, 0xFFFFFFFF, 0xFF3D3F3F,
+	0x00000000, 0x04040000, 0x00000000, 0x00000000, 0x00000000, 0x01010000, 0x00000000, 0x03010300,
+	0xFFFFFFFF, 0xC7C5C7FF, 0xFFFFFFFF, 0x8F8D8FFF, 0xFFFFFFFF, 0x1F1D1FFF, 0xFFFFFFFF, 0x3F3D3FFF,
+	0x00000000, 0x04040200, 0x00000000, 0x00000500, 0x00000000, 0x01010200, 0x00000000, 0x03010F00,
+	0xFFFFFFFF, 0xC7C5FFFF, 0xFFFFFFFF, 0x8F8DFFFF, 0xFFFFFFFF, 0x1F1DFFFF, 0xFFFFFFFF, 0x3F3DFFFF,
+	0xFFFFFCFC, 0xFFFBFFFF, 0xFFFFF8F8, 0xFFFBFFFF, 0xFFFFF1F1, 0xFFFBFFFF, 0xFFFFE3E3, 0xFFFBFFFF,
+	0xFFFFC7C7, 0xFFFBFFFF, 0xFFFF8F8F, 0xFFFBFFFF, 0xFFFF1F1F, 0xFFFBFFFF, 0xFFFF3F3F, 0xFFFBFFFF,
+	0xFFFCFCFC, 0xFFFBFFFF, 0xFFF8F8F8, 0xFFFBFFFF, 0xFFF1F1F1, 0xFFFBFFFF, 0xFFE3E3E3, 0xFFFBFFFF,
+	0xFFC7C7C7, 0xFFFBFFFF, 0xFF8F8F8F, 0xFFFBFFFF, 0xFF1F1F1F, 0xFFFBFFFF, 0xFF3F3F3F, 0xFFFBFFFF,
+	0xFCFCFCFF, 0xFFFBFFFF, 0xF8F8F8FF, 0xFFFBFFFF, 0xF1F1F1FF, 0xFFFBFFFF, 0xE3E3E3FF, 0xFFFBFFFF,
+	0xC7C7C7FF, 0xFFFBFFFF, 0x8F8F8FFF, 0xFFFBFFFF, 0x1F1F1FFF, 0xFFFBFFFF, 0x3F3F3FFF, 0xFFFBFFFF,
+	0xFCFCFFFF, 0xFFFBFFFC, 0xF8F8FFFF, 0xFFFBFFF8, 0xF1F1FFFF, 0xFFFBFFF1, 0xE3E3FFFF, 0xFFFBFFE3,
+	0xC7C7FFFF, 0xFFFBFFC7, 0x8F8FFFFF, 0xFFFBFF8F, 0x1F1FFFFF, 0xFFFBFF1F, 0x3F3FFFFF, 0xFFFBFF3F,
+	0xFCFFFFFF, 0xFFFBFCFC, 0xF8FFFFFF, 0xFFFBF8F8, 0xF1FFFFFF, 0xFFFBF1F1, 0xE3FFFFFF, 0xFFFBE3E3,
+	0xC7FFFFFF, 0xFFFBC7C7, 0x8FFFFFFF, 0xFFFB8F8F, 0x1FFFFFFF, 0xFFFB1F1F, 0x3FFFFFFF, 0xFFFB3F3F,
+	0xFFFFFFFF, 0xFFF8FCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE3E3E3,
+	0xFFFFFFFF, 0xFFC3C7C7, 0xFFFFFFFF, 0xFF8B8F8F, 0xFFFFFFFF, 0xFF1B1F1F, 0xFFFFFFFF, 0xFF3B3F3F,
+	0xFFFFFFFF, 0xFCF8FCFF, 0x00000000, 0x18181800, 0x00000000, 0x00000000, 0x00000000, 0x03030300,
+	0xFFFFFFFF, 0xC7C3C7FF, 0xFFFFFFFF, 0x8F8B8FFF, 0xFFFFFFFF, 0x1F1B1FFF, 0xFFFFFFFF, 0x3F3B3FFF,
+	0xFFFFFFFF, 0xFCF8FFFF, 0x00000000, 0x00000000, 0x00000000, 0x0011151F, 0x00000000, 0x00000000,
+	0xFFFFFFFF, 0xC7C3FFFF, 0xFFFFFFFF, 0x8F8BFFFF, 0xFFFFFFFF, 0x1F1BFFFF, 0xFFFFFFFF, 0x3F3BFFFF,
+	0xFFFFFCFC, 0xFFFBFFFF, 0xFFFFF8F8, 0xFFFBFFFF, 0xFFFFF1F1, 0xFFFBFFFF, 0xFFFFE3E3, 0xFFFBFFFF,
+	0xFFFFC7C7, 0xFFFBFFFF, 0xFFFF8F8F, 0xFFFBFFFF, 0xFFFF1F1F, 0xFFFBFFFF, 0xFFFF3F3F, 0xFFFBFFFF,
+	0xFFFCFCFC, 0xFFFBFFFF, 0xFFF8F8F8, 0xFFFBFFFF, 0xFFF1F1F1, 0xFFFBFFFF, 0xFFE3E3E3, 0xFFFBFFFF,
+	0xFFC7C7C7, 0xFFFBFFFF, 0xFF8F8F8F, 0xFFFBFFFF, 0xFF1F1F1F, 0xFFFBFFFF, 0xFF3F3F3F, 0xFFFBFFFF,
+	0xFCFCFCFF, 0xFFFBFFFF, 0xF8F8F8FF, 0xFFFBFFFF, 0xF1F1F1FF, 0xFFFBFFFF, 0xE3E3E3FF, 0xFFFBFFFF,
+	0xC7C7C7FF, 0xFFFBFFFF, 0x8F8F8FFF, 0xFFFBFFFF, 0x1F1F1FFF, 0xFFFBFFFF, 0x3F3F3FFF, 0xFFFBFFFF,
+	0xFCFCFFFF, 0xFFFBFFFC, 0xF8F8FFFF, 0xFFFBFFF8, 0xF1F1FFFF, 0xFFFBFFF1, 0xE3E3FFFF, 0xFFFBFFE3,
+	0xC7C7FFFF, 0xFFFBFFC7, 0x8F8FFFFF, 0xFFFBFF8F, 0x1F1FFFFF, 0xFFFBFF1F, 0x3F3FFFFF, 0xFFFBFF3F,
+	0xFCFFFFFF, 0xFFFBFCFC, 0xF8FFFFFF, 0xFFFBF8F8, 0xF1FFFFFF, 0xFFFBF1F1, 0xE3FFFFFF, 0xFFFBE3E3,
+	0xC7FFFFFF, 0xFFFBC7C7, 0x8FFFFFFF, 0xFFFB8F8F, 0x1FFFFFFF, 0xFFFB1F1F, 0x3FFFFFFF, 0xFFFB3F3F,
+	0x00000000, 0x1F181C00, 0x00000000, 0x0E080800, 0x00000000, 0x0E000000, 0x00000000, 0x0E020200,
+	0x00000000, 0x1F030700, 0xFFFFFFFF, 0xFF8B8F8F, 0xFFFFFFFF, 0xFF1B1F1F, 0xFFFFFFFF, 0xFF3B3F3F,
+	0x00000000, 0x1C181C00, 0x00000000, 0x08080000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07030700, 0xFFFFFFFF, 0x8F8B8FFF, 0xFFFFFFFF, 0x1F1B1FFF, 0xFFFFFFFF, 0x3F3B3FFF,
+	0x00000000, 0x1C181C00, 0x00000000, 0x08080400, 0x00000000, 0x00000A00, 0x00000000, 0x02020400,
+	0x00000000, 0x07031F00, 0xFFFFFFFF, 0x8F8BFFFF, 0xFFFFFFFF, 0x1F1BFFFF, 0xFFFFFFFF, 0x3F3BFFFF,
+	0xFFFFFCFC, 0xFFF7FFFF, 0xFFFFF8F8, 0xFFF7FFFF, 0xFFFFF1F1, 0xFFF7FFFF, 0xFFFFE3E3, 0xFFF7FFFF,
+	0xFFFFC7C7, 0xFFF7FFFF, 0xFFFF8F8F, 0xFFF7FFFF, 0xFFFF1F1F, 0xFFF7FFFF, 0xFFFF3F3F, 0xFFF7FFFF,
+	0xFFFCFCFC, 0xFFF7FFFF, 0xFFF8F8F8, 0xFFF7FFFF, 0xFFF1F1F1, 0xFFF7FFFF, 0xFFE3E3E3, 0xFFF7FFFF,
+	0xFFC7C7C7, 0xFFF7FFFF, 0xFF8F8F8F, 0xFFF7FFFF, 0xFF1F1F1F, 0xFFF7FFFF, 0xFF3F3F3F, 0xFFF7FFFF,
+	0xFCFCFCFF, 0xFFF7FFFF, 0xF8F8F8FF, 0xFFF7FFFF, 0xF1F1F1FF, 0xFFF7FFFF, 0xE3E3E3FF, 0xFFF7FFFF,
+	0xC7C7C7FF, 0xFFF7FFFF, 0x8F8F8FFF, 0xFFF7FFFF, 0x1F1F1FFF, 0xFFF7FFFF, 0x3F3F3FFF, 0xFFF7FFFF,
+	0xFCFCFFFF, 0xFFF7FFFC, 0xF8F8FFFF, 0xFFF7FFF8, 0xF1F1FFFF, 0xFFF7FFF1, 0xE3E3FFFF, 0xFFF7FFE3,
+	0xC7C7FFFF, 0xFFF7FFC7, 0x8F8FFFFF, 0xFFF7FF8F, 0x1F1FFFFF, 0xFFF7FF1F, 0x3F3FFFFF, 0xFFF7FF3F,
+	0xFCFFFFFF, 0xFFF7FCFC, 0xF8FFFFFF, 0xFFF7F8F8, 0xF1FFFFFF, 0xFFF7F1F1, 0xE3FFFFFF, 0xFFF7E3E3,
+	0xC7FFFFFF, 0xFFF7C7C7, 0x8FFFFFFF, 0xFFF78F8F, 0x1FFFFFFF, 0xFFF71F1F, 0x3FFFFFFF, 0xFFF73F3F,
+	0xFFFFFFFF, 0xFFF4FCFC, 0xFFFFFFFF, 0xFFF0F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE3E3E3,
+	0xFFFFFFFF, 0xFFC7C7C7, 0xFFFFFFFF, 0xFF878F8F, 0xFFFFFFFF, 0xFF171F1F, 0xFFFFFFFF, 0xFF373F3F,
+	0xFFFFFFFF, 0xFCF4FCFF, 0xFFFFFFFF, 0xF8F0F8FF, 0x00000000, 0x30303000, 0x00000000, 0x00000000,
+	0x00000000, 0x06060600, 0xFFFFFFFF, 0x8F878FFF, 0xFFFFFFFF, 0x1F171FFF, 0xFFFFFFFF, 0x3F373FFF,
+	0xFFFFFFFF, 0xFCF4FFFF, 0xFFFFFFFF, 0xF8F0FFFF, 0x00000000, 0x00000000, 0x00000000, 0x00222A3E,
+	0x00000000, 0x00000000, 0xFFFFFFFF, 0x8F87FFFF, 0xFFFFFFFF, 0x1F17FFFF, 0xFFFFFFFF, 0x3F37FFFF,
+	0xFFFFFCFC, 0xFFF7FFFF, 0xFFFFF8F8, 0xFFF7FFFF, 0xFFFFF1F1, 0xFFF7FFFF, 0xFFFFE3E3, 0xFFF7FFFF,
+	0xFFFFC7C7, 0xFFF7FFFF, 0xFFFF8F8F, 0xFFF7FFFF, 0xFFFF1F1F, 0xFFF7FFFF, 0xFFFF3F3F, 0xFFF7FFFF,
+	0xFFFCFCFC, 0xFFF7FFFF, 0xFFF8F8F8, 0xFFF7FFFF, 0xFFF1F1F1, 0xFFF7FFFF, 0xFFE3E3E3, 0xFFF7FFFF,
+	0xFFC7C7C7, 0xFFF7FFFF, 0xFF8F8F8F, 0xFFF7FFFF, 0xFF1F1F1F, 0xFFF7FFFF, 0xFF3F3F3F, 0xFFF7FFFF,
+	0xFCFCFCFF, 0xFFF7FFFF, 0xF8F8F8FF, 0xFFF7FFFF, 0xF1F1F1FF, 0xFFF7FFFF, 0xE3E3E3FF, 0xFFF7FFFF,
+	0xC7C7C7FF, 0xFFF7FFFF, 0x8F8F8FFF, 0xFFF7FFFF, 0x1F1F1FFF, 0xFFF7FFFF, 0x3F3F3FFF, 0xFFF7FFFF,
+	0xFCFCFFFF, 0xFFF7FFFC, 0xF8F8FFFF, 0xFFF7FFF8, 0xF1F1FFFF, 0xFFF7FFF1, 0xE3E3FFFF, 0xFFF7FFE3,
+	0xC7C7FFFF, 0xFFF7FFC7, 0x8F8FFFFF, 0xFFF7FF8F, 0x1F1FFFFF, 0xFFF7FF1F, 0x3F3FFFFF, 0xFFF7FF3F,
+	0xFCFFFFFF, 0xFFF7FCFC, 0xF8FFFFFF, 0xFFF7F8F8, 0xF1FFFFFF, 0xFFF7F1F1, 0xE3FFFFFF, 0xFFF7E3E3,
+	0xC7FFFFFF, 0xFFF7C7C7, 0x8FFFFFFF, 0xFFF78F8F, 0x1FFFFFFF, 0xFFF71F1F, 0x3FFFFFFF, 0xFFF73F3F,
+	0xFFFFFFFF, 0xFFF4FCFC, 0x00000000, 0x3E303800, 0x00000000, 0x1C101000, 0x00000000, 0x1C000000,
+	0x00000000, 0x1C040400, 0x00000000, 0x3E060E00, 0xFFFFFFFF, 0xFF171F1F, 0xFFFFFFFF, 0xFF373F3F,
+	0xFFFFFFFF, 0xFCF4FCFF, 0x00000000, 0x38303800, 0x00000000, 0x10100000, 0x00000000, 0x00000000,
+	0x00000000, 0x04040000, 0x00000000, 0x0E060E00, 0xFFFFFFFF, 0x1F171FFF, 0xFFFFFFFF, 0x3F373FFF,
+	0xFFFFFFFF, 0xFCF4FFFF, 0x00000000, 0x38303E00, 0x00000000, 0x10100800, 0x00000000, 0x00001400,
+	0x00000000, 0x04040800, 0x00000000, 0x0E063E00, 0xFFFFFFFF, 0x1F17FFFF, 0xFFFFFFFF, 0x3F37FFFF,
+	0xFFFFFCFC, 0xFFFFFEFF, 0xFFFFF8F8, 0xFFFFFEFF, 0xFFFFF1F1, 0xFFFFFEFF, 0xFFFFE3E3, 0xFFFFFEFF,
+	0xFFFFC7C7, 0xFFFFFEFF, 0xFFFF8F8F, 0xFFFFFEFF, 0xFFFF1F1F, 0xFFFFFEFF, 0xFFFF3F3F, 0xFFFFFEFF,
+	0xFFFCFCFC, 0xFFFFFEFF, 0xFFF8F8F8, 0xFFFFFEFF, 0xFFF1F1F1, 0xFFFFFEFF, 0xFFE3E3E3, 0xFFFFFEFF,
+	0xFFC7C7C7, 0xFFFFFEFF, 0xFF8F8F8F, 0xFFFFFEFF, 0xFF1F1F1F, 0xFFFFFEFF, 0xFF3F3F3F, 0xFFFFFEFF,
+	0xFCFCFCFF, 0xFFFFFEFF, 0xF8F8F8FF, 0xFFFFFEFF, 0xF1F1F1FF, 0xFFFFFEFF, 0xE3E3E3FF, 0xFFFFFEFF,
+	0xC7C7C7FF, 0xFFFFFEFF, 0x8F8F8FFF, 0xFFFFFEFF, 0x1F1F1FFF, 0xFFFFFEFF, 0x3F3F3FFF, 0xFFFFFEFF,
+	0xFCFCFFFF, 0xFFFFFEFC, 0xF8F8FFFF, 0xFFFFFEF8, 0xF1F1FFFF, 0xFFFFFEF1, 0xE3E3FFFF, 0xFFFFFEE3,
+	0xC7C7FFFF, 0xFFFFFEC7, 0x8F8FFFFF, 0xFFFFFE8F, 0x1F1FFFFF, 0xFFFFFE1F, 0x3F3FFFFF, 0xFFFFFE3F,
+	0xFCFFFFFF, 0xFFFFFCFC, 0xF8FFFFFF, 0xFFFFF8F8, 0xF1FFFFFF, 0xFFFFF0F1, 0xE3FFFFFF, 0xFFFFE2E3,
+	0xC7FFFFFF, 0xFFFFC6C7, 0x8FFFFFFF, 0xFFFF8E8F, 0x1FFFFFFF, 0xFFFF1E1F, 0x3FFFFFFF, 0xFFFF3E3F,
+	0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000000, 0x07010000, 0xFFFFFFFF, 0xFFE3E2E3,
+	0xFFFFFFFF, 0xFFC7C6C7, 0xFFFFFFFF, 0xFF8F8E8F, 0xFFFFFFFF, 0xFF1F1E1F, 0xFFFFFFFF, 0xFF3F3E3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0xFFFFFFFF, 0xE3E3E2FF,
+	0xFFFFFFFF, 0xC7C7C6FF, 0xFFFFFFFF, 0x8F8F8EFF, 0xFFFFFFFF, 0x1F1F1EFF, 0xFFFFFFFF, 0x3F3F3EFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000600, 0xFFFFFFFF, 0xE3E3FEFF,
+	0xFFFFFFFF, 0xC7C7FEFF, 0xFFFFFFFF, 0x8F8FFEFF, 0xFFFFFFFF, 0x1F1FFEFF, 0xFFFFFFFF, 0x3F3FFEFF,
+	0xFFFFFCFC, 0xFFFFFEFF, 0xFFFFF8F8, 0xFFFFFEFF, 0xFFFFF1F1, 0xFFFFFEFF, 0xFFFFE3E3, 0xFFFFFEFF,
+	0xFFFFC7C7, 0xFFFFFEFF, 0xFFFF8F8F, 0xFFFFFEFF, 0xFFFF1F1F, 0xFFFFFEFF, 0xFFFF3F3F, 0xFFFFFEFF,
+	0xFFFCFCFC, 0xFFFFFEFF, 0xFFF8F8F8, 0xFFFFFEFF, 0xFFF1F1F1, 0xFFFFFEFF, 0xFFE3E3E3, 0xFFFFFEFF,
+	0xFFC7C7C7, 0xFFFFFEFF, 0xFF8F8F8F, 0xFFFFFEFF, 0xFF1F1F1F, 0xFFFFFEFF, 0xFF3F3F3F, 0xFFFFFEFF,
+	0xFCFCFCFF, 0xFFFFFEFF, 0xF8F8F8FF, 0xFFFFFEFF, 0xF1F1F1FF, 0xFFFFFEFF, 0xE3E3E3FF, 0xFFFFFEFF,
+	0xC7C7C7FF, 0xFFFFFEFF, 0x8F8F8FFF, 0xFFFFFEFF, 0x1F1F1FFF, 0xFFFFFEFF, 0x3F3F3FFF, 0xFFFFFEFF,
+	0xFCFCFFFF, 0xFFFFFEFC, 0xF8F8FFFF, 0xFFFFFEF8, 0xF1F1FFFF, 0xFFFFFEF1, 0xE3E3FFFF, 0xFFFFFEE3,
+	0xC7C7FFFF, 0xFFFFFEC7, 0x8F8FFFFF, 0xFFFFFE8F, 0x1F1FFFFF, 0xFFFFFE1F, 0x3F3FFFFF, 0xFFFFFE3F,
+	0x00000000, 0x00030000, 0x00000000, 0x00030000, 0x00000000, 0x02070000, 0x00000000, 0x070F0202,
+	0xC7FFFFFF, 0xFFFFC6C7, 0x8FFFFFFF, 0xFFFF8E8F, 0x1FFFFFFF, 0xFFFF1E1F, 0x3FFFFFFF, 0xFFFF3E3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000000, 0x06020200,
+	0xFFFFFFFF, 0xFFC7C6C7, 0xFFFFFFFF, 0xFF8F8E8F, 0xFFFFFFFF, 0xFF1F1E1F, 0xFFFFFFFF, 0xFF3F3E3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020200,
+	0xFFFFFFFF, 0xC7C7C6FF, 0xFFFFFFFF, 0x8F8F8EFF, 0xFFFFFFFF, 0x1F1F1EFF, 0xFFFFFFFF, 0x3F3F3EFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020600,
+	0xFFFFFFFF, 0xC7C7FEFF, 0xFFFFFFFF, 0x8F8FFEFF, 0xFFFFFFFF, 0x1F1FFEFF, 0xFFFFFFFF, 0x3F3FFEFF,
+	0xFFFFFCFC, 0xFFFFFDFF, 0xFFFFF8F8, 0xFFFFFDFF, 0xFFFFF1F1, 0xFFFFFDFF, 0xFFFFE3E3, 0xFFFFFDFF,
+	0xFFFFC7C7, 0xFFFFFDFF, 0xFFFF8F8F, 0xFFFFFDFF, 0xFFFF1F1F, 0xFFFFFDFF, 0xFFFF3F3F, 0xFFFFFDFF,
+	0xFFFCFCFC, 0xFFFFFDFF, 0xFFF8F8F8, 0xFFFFFDFF, 0xFFF1F1F1, 0xFFFFFDFF, 0xFFE3E3E3, 0xFFFFFDFF,
+	0xFFC7C7C7, 0xFFFFFDFF, 0xFF8F8F8F, 0xFFFFFDFF, 0xFF1F1F1F, 0xFFFFFDFF, 0xFF3F3F3F, 0xFFFFFDFF,
+	0xFCFCFCFF, 0xFFFFFDFF, 0xF8F8F8FF, 0xFFFFFDFF, 0xF1F1F1FF, 0xFFFFFDFF, 0xE3E3E3FF, 0xFFFFFDFF,
+	0xC7C7C7FF, 0xFFFFFDFF, 0x8F8F8FFF, 0xFFFFFDFF, 0x1F1F1FFF, 0xFFFFFDFF, 0x3F3F3FFF, 0xFFFFFDFF,
+	0xFCFCFFFF, 0xFFFFFDFC, 0xF8F8FFFF, 0xFFFFFDF8, 0xF1F1FFFF, 0xFFFFFDF1, 0xE3E3FFFF, 0xFFFFFDE3,
+	0xC7C7FFFF, 0xFFFFFDC7, 0x8F8FFFFF, 0xFFFFFD8F, 0x1F1FFFFF, 0xFFFFFD1F, 0x3F3FFFFF, 0xFFFFFD3F,
+	0xFCFFFFFF, 0xFFFFFCFC, 0xF8FFFFFF, 0xFFFFF8F8, 0xF1FFFFFF, 0xFFFFF1F1, 0xE3FFFFFF, 0xFFFFE1E3,
+	0xC7FFFFFF, 0xFFFFC5C7, 0x8FFFFFFF, 0xFFFF8D8F, 0x1FFFFFFF, 0xFFFF1D1F, 0x3FFFFFFF, 0xFFFF3D3F,
+	0x00000000, 0x0F0C0C0C, 0x00000000, 0x00000000, 0x00000000, 0x07010101, 0x07000000, 0x0F030103,
+	0xFFFFFFFF, 0xFFC7C5C7, 0xFFFFFFFF, 0xFF8F8D8F, 0xFFFFFFFF, 0xFF1F1D1F, 0xFFFFFFFF, 0xFF3F3D3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x1F000000, 0x0303011F,
+	0xFFFFFFFF, 0xC7C7C5FF, 0xFFFFFFFF, 0x8F8F8DFF, 0xFFFFFFFF, 0x1F1F1DFF, 0xFFFFFFFF, 0x3F3F3DFF,
+	0x00000000, 0x040C080F, 0x00000000, 0x00000500, 0x00000000, 0x0101090F, 0x1F000000, 0x03031D1F,
+	0xFFFFFFFF, 0xC7C7FDFF, 0xFFFFFFFF, 0x8F8FFDFF, 0xFFFFFFFF, 0x1F1FFDFF, 0xFFFFFFFF, 0x3F3FFDFF,
+	0xFFFFFCFC, 0xFFFFFDFF, 0xFFFFF8F8, 0xFFFFFDFF, 0xFFFFF1F1, 0xFFFFFDFF, 0xFFFFE3E3, 0xFFFFFDFF,
+	0xFFFFC7C7, 0xFFFFFDFF, 0xFFFF8F8F, 0xFFFFFDFF, 0xFFFF1F1F, 0xFFFFFDFF, 0xFFFF3F3F, 0xFFFFFDFF,
+	0xFFFCFCFC, 0xFFFFFDFF, 0xFFF8F8F8, 0xFFFFFDFF, 0xFFF1F1F1, 0xFFFFFDFF, 0xFFE3E3E3, 0xFFFFFDFF,
+	0xFFC7C7C7, 0xFFFFFDFF, 0xFF8F8F8F, 0xFFFFFDFF, 0xFF1F1F1F, 0xFFFFFDFF, 0xFF3F3F3F, 0xFFFFFDFF,
+	0xFCFCFCFF, 0xFFFFFDFF, 0xF8F8F8FF, 0xFFFFFDFF, 0xF1F1F1FF, 0xFFFFFDFF, 0xE3E3E3FF, 0xFFFFFDFF,
+	0xC7C7C7FF, 0xFFFFFDFF, 0x8F8F8FFF, 0xFFFFFDFF, 0x1F1F1FFF, 0xFFFFFDFF, 0x3F3F3FFF, 0xFFFFFDFF,
+	0xFCFCFFFF, 0xFFFFFDFC, 0xF8F8FFFF, 0xFFFFFDF8, 0xF1F1FFFF, 0xFFFFFDF1, 0xE3E3FFFF, 0xFFFFFDE3,
+	0xC7C7FFFF, 0xFFFFFDC7, 0x8F8FFFFF, 0xFFFFFD8F, 0x1F1FFFFF, 0xFFFFFD1F, 0x3F3FFFFF, 0xFFFFFD3F,
+	0x00000000, 0x00070404, 0x00000000, 0x00070000, 0x00000000, 0x00070101, 0x00000000, 0x070F0103,
+	0x07000000, 0x0F1F0507, 0x8FFFFFFF, 0xFFFF8D8F, 0x1FFFFFFF, 0xFFFF1D1F, 0x3FFFFFFF, 0xFFFF3D3F,
+	0x00000000, 0x00040400, 0x00000000, 0x00000000, 0x00000000, 0x00010100, 0x00000000, 0x07030103,
+	0x07000000, 0x0F070507, 0xFFFFFFFF, 0xFF8F8D8F, 0xFFFFFFFF, 0xFF1F1D1F, 0xFFFFFFFF, 0xFF3F3D3F,
+	0x00000000, 0x00040000, 0x00000000, 0x00000000, 0x00000000, 0x00010100, 0x00000000, 0x0303010F,
+	0x07000000, 0x0707051F, 0xFFFFFFFF, 0x8F8F8DFF, 0xFFFFFFFF, 0x1F1F1DFF, 0xFFFFFFFF, 0x3F3F3DFF,
+	0x00000000, 0x00000500, 0x00000000, 0x00000000, 0x00000000, 0x01010500, 0x00000000, 0x0303090F,
+	0x1F000000, 0x07071D1F, 0xFFFFFFFF, 0x8F8FFDFF, 0xFFFFFFFF, 0x1F1FFDFF, 0xFFFFFFFF, 0x3F3FFDFF,
+	0xFFFFFCFC, 0xFFFFFBFF, 0xFFFFF8F8, 0xFFFFFBFF, 0xFFFFF1F1, 0xFFFFFBFF, 0xFFFFE3E3, 0xFFFFFBFF,
+	0xFFFFC7C7, 0xFFFFFBFF, 0xFFFF8F8F, 0xFFFFFBFF, 0xFFFF1F1F, 0xFFFFFBFF, 0xFFFF3F3F, 0xFFFFFBFF,
+	0xFFFCFCFC, 0xFFFFFBFF, 0xFFF8F8F8, 0xFFFFFBFF, 0xFFF1F1F1, 0xFFFFFBFF, 0xFFE3E3E3, 0xFFFFFBFF,
+	0xFFC7C7C7, 0xFFFFFBFF, 0xFF8F8F8F, 0xFFFFFBFF, 0xFF1F1F1F, 0xFFFFFBFF, 0xFF3F3F3F, 0xFFFFFBFF,
+	0xFCFCFCFF, 0xFFFFFBFF, 0xF8F8F8FF, 0xFFFFFBFF, 0xF1F1F1FF, 0xFFFFFBFF, 0xE3E3E3FF, 0xFFFFFBFF,
+	0xC7C7C7FF, 0xFFFFFBFF, 0x8F8F8FFF, 0xFFFFFBFF, 0x1F1F1FFF, 0xFFFFFBFF, 0x3F3F3FFF, 0xFFFFFBFF,
+	0xFCFCFFFF, 0xFFFFFBFC, 0xF8F8FFFF, 0xFFFFFBF8, 0xF1F1FFFF, 0xFFFFFBF1, 0xE3E3FFFF, 0xFFFFFBE3,
+	0xC7C7FFFF, 0xFFFFFBC7, 0x8F8FFFFF, 0xFFFFFB8F, 0x1F1FFFFF, 0xFFFFFB1F, 0x3F3FFFFF, 0xFFFFFB3F,
+	0xFCFFFFFF, 0xFFFFF8FC, 0xF8FFFFFF, 0xFFFFF8F8, 0xF1FFFFFF, 0xFFFFF1F1, 0xE3FFFFFF, 0xFFFFE3E3,
+	0xC7FFFFFF, 0xFFFFC3C7, 0x8FFFFFFF, 0xFFFF8B8F, 0x1FFFFFFF, 0xFFFF1B1F, 0x3FFFFFFF, 0xFFFF3B3F,
+	0x3E000000, 0x3F3C383C, 0x00000000, 0x1E181818, 0x00000000, 0x00000000, 0x00000000, 0x0F030303,
+	0x0F000000, 0x1F070307, 0xFFFFFFFF, 0xFF8F8B8F, 0xFFFFFFFF, 0xFF1F1B1F, 0xFFFFFFFF, 0xFF3F3B3F,
+	0x3F000000, 0x3C3C383F, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x3F000000, 0x0707033F, 0xFFFFFFFF, 0x8F8F8BFF, 0xFFFFFFFF, 0x1F1F1BFF, 0xFFFFFFFF, 0x3F3F3BFF,
+	0x3F000000, 0x3C3C3B3F, 0x00000000, 0x1818191F, 0x00000000, 0x00000A00, 0x00000000, 0x0303131F,
+	0x3F000000, 0x07073B3F, 0xFFFFFFFF, 0x8F8FFBFF, 0xFFFFFFFF, 0x1F1FFBFF, 0xFFFFFFFF, 0x3F3FFBFF,
+	0xFFFFFCFC, 0xFFFFFBFF, 0xFFFFF8F8, 0xFFFFFBFF, 0xFFFFF1F1, 0xFFFFFBFF, 0xFFFFE3E3, 0xFFFFFBFF,
+	0xFFFFC7C7, 0xFFFFFBFF, 0xFFFF8F8F, 0xFFFFFBFF, 0xFFFF1F1F, 0xFFFFFBFF, 0xFFFF3F3F, 0xFFFFFBFF,
+	0xFFFCFCFC, 0xFFFFFBFF, 0xFFF8F8F8, 0xFFFFFBFF, 0xFFF1F1F1, 0xFFFFFBFF, 0xFFE3E3E3, 0xFFFFFBFF,
+	0xFFC7C7C7, 0xFFFFFBFF, 0xFF8F8F8F, 0xFFFFFBFF, 0xFF1F1F1F, 0xFFFFFBFF, 0xFF3F3F3F, 0xFFFFFBFF,
+	0xFCFCFCFF, 0xFFFFFBFF, 0xF8F8F8FF, 0xFFFFFBFF, 0xF1F1F1FF, 0xFFFFFBFF, 0xE3E3E3FF, 0xFFFFFBFF,
+	0xC7C7C7FF, 0xFFFFFBFF, 0x8F8F8FFF, 0xFFFFFBFF, 0x1F1F1FFF, 0xFFFFFBFF, 0x3F3F3FFF, 0xFFFFFBFF,
+	0xFCFCFFFF, 0xFFFFFBFC, 0xF8F8FFFF, 0xFFFFFBF8, 0xF1F1FFFF, 0xFFFFFBF1, 0xE3E3FFFF, 0xFFFFFBE3,
+	0xC7C7FFFF, 0xFFFFFBC7, 0x8F8FFFFF, 0xFFFFFB8F, 0x1F1FFFFF, 0xFFFFFB1F, 0x3F3FFFFF, 0xFFFFFB3F,
+	0x00000000, 0x1E1F181C, 0x00000000, 0x000E0808, 0x00000000, 0x000E0000, 0x00000000, 0x000E0202,
+	0x00000000, 0x0F1F0307, 0x0F000000, 0x1F3F0B0F, 0x1FFFFFFF, 0xFFFF1B1F, 0x3FFFFFFF, 0xFFFF3B3F,
+	0x00000000, 0x1E1C181C, 0x00000000, 0x00080800, 0x00000000, 0x00000000, 0x00000000, 0x00020200,
+	0x00000000, 0x0F070307, 0x0F000000, 0x1F0F0B0F, 0xFFFFFFFF, 0xFF1F1B1F, 0xFFFFFFFF, 0xFF3F3B3F,
+	0x00000000, 0x1C1C181F, 0x00000000, 0x00080800, 0x00000000, 0x00000000, 0x00000000, 0x00020200,
+	0x00000000, 0x0707031F, 0x0F000000, 0x0F0F0B3F, 0xFFFFFFFF, 0x1F1F1BFF, 0xFFFFFFFF, 0x3F3F3BFF,
+	0x00000000, 0x1C1C191F, 0x00000000, 0x08080A00, 0x00000000, 0x00000000, 0x00000000, 0x02020A00,
+	0x00000000, 0x0707131F, 0x3F000000, 0x0F0F3B3F, 0xFFFFFFFF, 0x1F1FFBFF, 0xFFFFFFFF, 0x3F3FFBFF,
+	0xFFFFFCFC, 0xFFFFF7FF, 0xFFFFF8F8, 0xFFFFF7FF, 0xFFFFF1F1, 0xFFFFF7FF, 0xFFFFE3E3, 0xFFFFF7FF,
+	0xFFFFC7C7, 0xFFFFF7FF, 0xFFFF8F8F, 0xFFFFF7FF, 0xFFFF1F1F, 0xFFFFF7FF, 0xFFFF3F3F, 0xFFFFF7FF,
+	0xFFFCFCFC, 0xFFFFF7FF, 0xFFF8F8F8, 0xFFFFF7FF, 0xFFF1F1F1, 0xFFFFF7FF, 0xFFE3E3E3, 0xFFFFF7FF,
+	0xFFC7C7C7, 0xFFFFF7FF, 0xFF8F8F8F, 0xFFFFF7FF, 0xFF1F1F1F, 0xFFFFF7FF, 0xFF3F3F3F, 0xFFFFF7FF,
+	0xFCFCFCFF, 0xFFFFF7FF, 0xF8F8F8FF, 0xFFFFF7FF, 0xF1F1F1FF, 0xFFFFF7FF, 0xE3E3E3FF, 0xFFFFF7FF,
+	0xC7C7C7FF, 0xFFFFF7FF, 0x8F8F8FFF, 0xFFFFF7FF, 0x1F1F1FFF, 0xFFFFF7FF, 0x3F3F3FFF, 0xFFFFF7FF,
+	0xFCFCFFFF, 0xFFFFF7FC, 0xF8F8FFFF, 0xFFFFF7F8, 0xF1F1FFFF, 0xFFFFF7F1, 0xE3E3FFFF, 0xFFFFF7E3,
+	0xC7C7FFFF, 0xFFFFF7C7, 0x8F8FFFFF, 0xFFFFF78F, 0x1F1FFFFF, 0xFFFFF71F, 0x3F3FFFFF, 0xFFFFF73F,
+	0xFCFFFFFF, 0xFFFFF4FC, 0xF8FFFFFF, 0xFFFFF0F8, 0xF1FFFFFF, 0xFFFFF1F1, 0xE3FFFFFF, 0xFFFFE3E3,
+	0xC7FFFFFF, 0xFFFFC7C7, 0x8FFFFFFF, 0xFFFF878F, 0x1FFFFFFF, 0xFFFF171F, 0x3FFFFFFF, 0xFFFF373F,
+	0xFFFFFFFF, 0xFFFCF4FC, 0x7C000000, 0x7E787078, 0x00000000, 0x3C303030, 0x00000000, 0x00000000,
+	0x00000000, 0x1E060606, 0x1F000000, 0x3F0F070F, 0xFFFFFFFF, 0xFF1F171F, 0xFFFFFFFF, 0xFF3F373F,
+	0xFFFFFFFF, 0xFCFCF4FF, 0x7F000000, 0x7878707F, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x7F000000, 0x0F0F077F, 0xFFFFFFFF, 0x1F1F17FF, 0xFFFFFFFF, 0x3F3F37FF,
+	0xFFFFFFFF, 0xFCFCF7FF, 0x7F000000, 0x7878777F, 0x00000000, 0x3030323E, 0x00000000, 0x00001400,
+	0x00000000, 0x0606263E, 0x7F000000, 0x0F0F777F, 0xFFFFFFFF, 0x1F1FF7FF, 0xFFFFFFFF, 0x3F3FF7FF,
+	0xFFFFFCFC, 0xFFFFF7FF, 0xFFFFF8F8, 0xFFFFF7FF, 0xFFFFF1F1, 0xFFFFF7FF, 0xFFFFE3E3, 0xFFFFF7FF,
+	0xFFFFC7C7, 0xFFFFF7FF, 0xFFFF8F8F, 0xFFFFF7FF, 0xFFFF1F1F, 0xFFFFF7FF, 0xFFFF3F3F, 0xFFFFF7FF,
+	0xFFFCFCFC, 0xFFFFF7FF, 0xFFF8F8F8, 0xFFFFF7FF, 0xFFF1F1F1, 0xFFFFF7FF, 0xFFE3E3E3, 0xFFFFF7FF,
+	0xFFC7C7C7, 0xFFFFF7FF, 0xFF8F8F8F, 0xFFFFF7FF, 0xFF1F1F1F, 0xFFFFF7FF, 0xFF3F3F3F, 0xFFFFF7FF,
+	0xFCFCFCFF, 0xFFFFF7FF, 0xF8F8F8FF, 0xFFFFF7FF, 0xF1F1F1FF, 0xFFFFF7FF, 0xE3E3E3FF, 0xFFFFF7FF,
+	0xC7C7C7FF, 0xFFFFF7FF, 0x8F8F8FFF, 0xFFFFF7FF, 0x1F1F1FFF, 0xFFFFF7FF, 0x3F3F3FFF, 0xFFFFF7FF,
+	0xFCFCFFFF, 0xFFFFF7FC, 0xF8F8FFFF, 0xFFFFF7F8, 0xF1F1FFFF, 0xFFFFF7F1, 0xE3E3FFFF, 0xFFFFF7E3,
+	0xC7C7FFFF, 0xFFFFF7C7, 0x8F8FFFFF, 0xFFFFF78F, 0x1F1FFFFF, 0xFFFFF71F, 0x3F3FFFFF, 0xFFFFF73F,
+	0x7C000000, 0x7E7F747C, 0x00000000, 0x3C3E3038, 0x00000000, 0x001C1010, 0x00000000, 0x001C0000,
+	0x00000000, 0x001C0404, 0x00000000, 0x1E3E060E, 0x1F000000, 0x3F7F171F, 0x3FFFFFFF, 0xFFFF373F,
+	0x7C000000, 0x7E7C747C, 0x00000000, 0x3C383038, 0x00000000, 0x00101000, 0x00000000, 0x00000000,
+	0x00000000, 0x00040400, 0x00000000, 0x1E0E060E, 0x1F000000, 0x3F1F171F, 0xFFFFFFFF, 0xFF3F373F,
+	0x7C000000, 0x7C7C747F, 0x00000000, 0x3838303E, 0x00000000, 0x00101000, 0x00000000, 0x00000000,
+	0x00000000, 0x00040400, 0x00000000, 0x0E0E063E, 0x1F000000, 0x1F1F177F, 0xFFFFFFFF, 0x3F3F37FF,
+	0x7F000000, 0x7C7C777F, 0x00000000, 0x3838323E, 0x00000000, 0x10101400, 0x00000000, 0x00000000,
+	0x00000000, 0x04041400, 0x00000000, 0x0E0E263E, 0x7F000000, 0x1F1F777F, 0xFFFFFFFF, 0x3F3FF7FF,
+	0xFFFFFCFC, 0xFFFFFFFE, 0xFFFFF8F8, 0xFFFFFFFE, 0xFFFFF1F1, 0xFFFFFFFE, 0xFFFFE3E3, 0xFFFFFFFE,
+	0xFFFFC7C7, 0xFFFFFFFE, 0xFFFF8F8F, 0xFFFFFFFE, 0xFFFF1F1F, 0xFFFFFFFE, 0xFFFF3F3F, 0xFFFFFFFE,
+	0xFFFCFCFC, 0xFFFFFFFE, 0xFFF8F8F8, 0xFFFFFFFE, 0xFFF1F1F1, 0xFFFFFFFE, 0xFFE3E3E3, 0xFFFFFFFE,
+	0xFFC7C7C7, 0xFFFFFFFE, 0xFF8F8F8F, 0xFFFFFFFE, 0xFF1F1F1F, 0xFFFFFFFE, 0xFF3F3F3F, 0xFFFFFFFE,
+	0xFCFCFCFF, 0xFFFFFFFE, 0xF8F8F8FF, 0xFFFFFFFE, 0xF1F1F1FF, 0xFFFFFFFE, 0xE3E3E3FF, 0xFFFFFFFE,
+	0xC7C7C7FF, 0xFFFFFFFE, 0x8F8F8FFF, 0xFFFFFFFE, 0x1F1F1FFF, 0xFFFFFFFE, 0x3F3F3FFF, 0xFFFFFFFE,
+	0xFCFCFFFF, 0xFFFFFFFC, 0xF8F8FFFF, 0xFFFFFFF8, 0xF1F1FFFF, 0xFFFFFFF0, 0xE3E3FFFF, 0xFFFFFFE2,
+	0xC7C7FFFF, 0xFFFFFFC6, 0x8F8FFFFF, 0xFFFFFF8E, 0x1F1FFFFF, 0xFFFFFF1E, 0x3F3FFFFF, 0xFFFFFF3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00030000, 0x00000000, 0x07070100, 0x03000000, 0x0F0F0302,
+	0xC7FFFFFF, 0xFFFFC7C6, 0x8FFFFFFF, 0xFFFF8F8E, 0x1FFFFFFF, 0xFFFF1F1E, 0x3FFFFFFF, 0xFFFF3F3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000000, 0x07030302,
+	0xFFFFFFFF, 0xFFC7C7C6, 0xFFFFFFFF, 0xFF8F8F8E, 0xFFFFFFFF, 0xFF1F1F1E, 0xFFFFFFFF, 0xFF3F3F3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030300,
+	0xFFFFFFFF, 0xC7C7C7FE, 0xFFFFFFFF, 0x8F8F8FFE, 0xFFFFFFFF, 0x1F1F1FFE, 0xFFFFFFFF, 0x3F3F3FFE,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030700,
+	0xFFFFFFFF, 0xC7C7FFFE, 0xFFFFFFFF, 0x8F8FFFFE, 0xFFFFFFFF, 0x1F1FFFFE, 0xFFFFFFFF, 0x3F3FFFFE,
+	0xFFFFFCFC, 0xFFFFFFFE, 0xFFFFF8F8, 0xFFFFFFFE, 0xFFFFF1F1, 0xFFFFFFFE, 0xFFFFE3E3, 0xFFFFFFFE,
+	0xFFFFC7C7, 0xFFFFFFFE, 0xFFFF8F8F, 0xFFFFFFFE, 0xFFFF1F1F, 0xFFFFFFFE, 0xFFFF3F3F, 0xFFFFFFFE,
+	0xFFFCFCFC, 0xFFFFFFFE, 0xFFF8F8F8, 0xFFFFFFFE, 0xFFF1F1F1, 0xFFFFFFFE, 0xFFE3E3E3, 0xFFFFFFFE,
+	0xFFC7C7C7, 0xFFFFFFFE, 0xFF8F8F8F, 0xFFFFFFFE, 0xFF1F1F1F, 0xFFFFFFFE, 0xFF3F3F3F, 0xFFFFFFFE,
+	0xFCFCFCFF, 0xFFFFFFFE, 0xF8F8F8FF, 0xFFFFFFFE, 0xF1F1F1FF, 0xFFFFFFFE, 0xE3E3E3FF, 0xFFFFFFFE,
+	0xC7C7C7FF, 0xFFFFFFFE, 0x8F8F8FFF, 0xFFFFFFFE, 0x1F1F1FFF, 0xFFFFFFFE, 0x3F3F3FFF, 0xFFFFFFFE,
+	0x00000000, 0x00000300, 0x00000000, 0x00000300, 0x00000000, 0x00030700, 0x02000000, 0x07070F02,
+	0x07000000, 0x0F0F1F06, 0x8F8FFFFF, 0xFFFFFF8E, 0x1F1FFFFF, 0xFFFFFF1E, 0x3F3FFFFF, 0xFFFFFF3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020000, 0x00000000, 0x02060202,
+	0x00000000, 0x070F0706, 0x8FFFFFFF, 0xFFFF8F8E, 0x1FFFFFFF, 0xFFFF1F1E, 0x3FFFFFFF, 0xFFFF3F3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020200,
+	0x00000000, 0x07070700, 0xFFFFFFFF, 0xFF8F8F8E, 0xFFFFFFFF, 0xFF1F1F1E, 0xFFFFFFFF, 0xFF3F3F3E,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07070700, 0xFFFFFFFF, 0x8F8F8FFE, 0xFFFFFFFF, 0x1F1F1FFE, 0xFFFFFFFF, 0x3F3F3FFE,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07070700, 0xFFFFFFFF, 0x8F8FFFFE, 0xFFFFFFFF, 0x1F1FFFFE, 0xFFFFFFFF, 0x3F3FFFFE,
+	0xFFFFFCFC, 0xFFFFFFFD, 0xFFFFF8F8, 0xFFFFFFFD, 0xFFFFF1F1, 0xFFFFFFFD, 0xFFFFE3E3, 0xFFFFFFFD,
+	0xFFFFC7C7, 0xFFFFFFFD, 0xFFFF8F8F, 0xFFFFFFFD, 0xFFFF1F1F, 0xFFFFFFFD, 0xFFFF3F3F, 0xFFFFFFFD,
+	0xFFFCFCFC, 0xFFFFFFFD, 0xFFF8F8F8, 0xFFFFFFFD, 0xFFF1F1F1, 0xFFFFFFFD, 0xFFE3E3E3, 0xFFFFFFFD,
+	0xFFC7C7C7, 0xFFFFFFFD, 0xFF8F8F8F, 0xFFFFFFFD, 0xFF1F1F1F, 0xFFFFFFFD, 0xFF3F3F3F, 0xFFFFFFFD,
+	0xFCFCFCFF, 0xFFFFFFFD, 0xF8F8F8FF, 0xFFFFFFFD, 0xF1F1F1FF, 0xFFFFFFFD, 0xE3E3E3FF, 0xFFFFFFFD,
+	0xC7C7C7FF, 0xFFFFFFFD, 0x8F8F8FFF, 0xFFFFFFFD, 0x1F1F1FFF, 0xFFFFFFFD, 0x3F3F3FFF, 0xFFFFFFFD,
+	0xFCFCFFFF, 0xFFFFFFFC, 0xF8F8FFFF, 0xFFFFFFF8, 0xF1F1FFFF, 0xFFFFFFF1, 0xE3E3FFFF, 0xFFFFFFE1,
+	0xC7C7FFFF, 0xFFFFFFC5, 0x8F8FFFFF, 0xFFFFFF8D, 0x1F1FFFFF, 0xFFFFFF1D, 0x3F3FFFFF, 0xFFFFFF3D,
+	0x0C000000, 0x000F0C0C, 0x00000000, 0x00000000, 0x01000000, 0x00070101, 0x03070000, 0x0F0F0301,
+	0x07070000, 0x1F1F0705, 0x8FFFFFFF, 0xFFFF8F8D, 0x1FFFFFFF, 0xFFFF1F1D, 0x3FFFFFFF, 0xFFFF3F3D,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03000000, 0x07030301,
+	0x0F070000, 0x0F070705, 0xFFFFFFFF, 0xFF8F8F8D, 0xFFFFFFFF, 0xFF1F1F1D, 0xFFFFFFFF, 0xFF3F3F3D,
+	0x00000000, 0x0C0C0C0C, 0x00000000, 0x00000000, 0x00000000, 0x01010101, 0x03000000, 0x0303030D,
+	0x1F070000, 0x0707071D, 0xFFFFFFFF, 0x8F8F8FFD, 0xFFFFFFFF, 0x1F1F1FFD, 0xFFFFFFFF, 0x3F3F3FFD,
+	0x00000000, 0x0C0C0F0D, 0x00000000, 0x00080F0D, 0x00000000, 0x01010F0D, 0x03000000, 0x03031F1D,
+	0x1F070000, 0x07073F3D, 0xFFFFFFFF, 0x8F8FFFFD, 0xFFFFFFFF, 0x1F1FFFFD, 0xFFFFFFFF, 0x3F3FFFFD,
+	0xFFFFFCFC, 0xFFFFFFFD, 0xFFFFF8F8, 0xFFFFFFFD, 0xFFFFF1F1, 0xFFFFFFFD, 0xFFFFE3E3, 0xFFFFFFFD,
+	0xFFFFC7C7, 0xFFFFFFFD, 0xFFFF8F8F, 0xFFFFFFFD, 0xFFFF1F1F, 0xFFFFFFFD, 0xFFFF3F3F, 0xFFFFFFFD,
+	0xFFFCFCFC, 0xFFFFFFFD, 0xFFF8F8F8, 0xFFFFFFFD, 0xFFF1F1F1, 0xFFFFFFFD, 0xFFE3E3E3, 0xFFFFFFFD,
+	0xFFC7C7C7, 0xFFFFFFFD, 0xFF8F8F8F, 0xFFFFFFFD, 0xFF1F1F1F, 0xFFFFFFFD, 0xFF3F3F3F, 0xFFFFFFFD,
+	0xFCFCFCFF, 0xFFFFFFFD, 0xF8F8F8FF, 0xFFFFFFFD, 0xF1F1F1FF, 0xFFFFFFFD, 0xE3E3E3FF, 0xFFFFFFFD,
+	0xC7C7C7FF, 0xFFFFFFFD, 0x8F8F8FFF, 0xFFFFFFFD, 0x1F1F1FFF, 0xFFFFFFFD, 0x3F3F3FFF, 0xFFFFFFFD,
+	0x04000000, 0x00000704, 0x00000000, 0x00000700, 0x01000000, 0x00000701, 0x03000000, 0x00070F01,
+	0x07070000, 0x0F0F1F05, 0x0F070000, 0x1F1F3F0D, 0x1F1FFFFF, 0xFFFFFF1D, 0x3F3FFFFF, 0xFFFFFF3D,
+	0x00000000, 0x00000404, 0x00000000, 0x00000000, 0x00000000, 0x00000101, 0x03000000, 0x00070301,
+	0x03000000, 0x070F0705, 0x0F070000, 0x0F1F0F0D, 0x1FFFFFFF, 0xFFFF1F1D, 0x3FFFFFFF, 0xFFFF3F3D,
+	0x00000000, 0x00000400, 0x00000000, 0x00000000, 0x00000000, 0x00000100, 0x00000000, 0x00030301,
+	0x03000000, 0x07070705, 0x0F070000, 0x0F0F0F0D, 0xFFFFFFFF, 0xFF1F1F1D, 0xFFFFFFFF, 0xFF3F3F3D,
+	0x00000000, 0x00040400, 0x00000000, 0x00000000, 0x00000000, 0x00010100, 0x00000000, 0x03030301,
+	0x03000000, 0x0707070D, 0x0F070000, 0x0F0F0F1D, 0xFFFFFFFF, 0x1F1F1FFD, 0xFFFFFFFF, 0x3F3F3FFD,
+	0x00000000, 0x04040700, 0x00000000, 0x00000700, 0x00000000, 0x01010700, 0x00000000, 0x03030F01,
+	0x03000000, 0x07071F0D, 0x1F070000, 0x0F0F3F1D, 0xFFFFFFFF, 0x1F1FFFFD, 0xFFFFFFFF, 0x3F3FFFFD,
+	0xFFFFFCFC, 0xFFFFFFFB, 0xFFFFF8F8, 0xFFFFFFFB, 0xFFFFF1F1, 0xFFFFFFFB, 0xFFFFE3E3, 0xFFFFFFFB,
+	0xFFFFC7C7, 0xFFFFFFFB, 0xFFFF8F8F, 0xFFFFFFFB, 0xFFFF1F1F, 0xFFFFFFFB, 0xFFFF3F3F, 0xFFFFFFFB,
+	0xFFFCFCFC, 0xFFFFFFFB, 0xFFF8F8F8, 0xFFFFFFFB, 0xFFF1F1F1, 0xFFFFFFFB, 0xFFE3E3E3, 0xFFFFFFFB,
+	0xFFC7C7C7, 0xFFFFFFFB, 0xFF8F8F8F, 0xFFFFFFFB, 0xFF1F1F1F, 0xFFFFFFFB, 0xFF3F3F3F, 0xFFFFFFFB,
+	0xFCFCFCFF, 0xFFFFFFFB, 0xF8F8F8FF, 0xFFFFFFFB, 0xF1F1F1FF, 0xFFFFFFFB, 0xE3E3E3FF, 0xFFFFFFFB,
+	0xC7C7C7FF, 0xFFFFFFFB, 0x8F8F8FFF, 0xFFFFFFFB, 0x1F1F1FFF, 0xFFFFFFFB, 0x3F3F3FFF, 0xFFFFFFFB,
+	0xFCFCFFFF, 0xFFFFFFF8, 0xF8F8FFFF, 0xFFFFFFF8, 0xF1F1FFFF, 0xFFFFFFF1, 0xE3E3FFFF, 0xFFFFFFE3,
+	0xC7C7FFFF, 0xFFFFFFC3, 0x8F8FFFFF, 0xFFFFFF8B, 0x1F1FFFFF, 0xFFFFFF1B, 0x3F3FFFFF, 0xFFFFFF3B,
+	0x3C3E0000, 0x3F3F3C38, 0x18000000, 0x001E1818, 0x00000000, 0x00000000, 0x03000000, 0x000F0303,
+	0x070F0000, 0x1F1F0703, 0x0F0F0000, 0x3F3F0F0B, 0x1FFFFFFF, 0xFFFF1F1B, 0x3FFFFFFF, 0xFFFF3F3B,
+	0x3C000000, 0x3E3C3C38, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x07000000, 0x0F070703, 0x1F0F0000, 0x1F0F0F0B, 0xFFFFFFFF, 0xFF1F1F1B, 0xFFFFFFFF, 0xFF3F3F3B,
+	0x3C000000, 0x3C3C3C3B, 0x00000000, 0x18181818, 0x00000000, 0x00000000, 0x00000000, 0x03030303,
+	0x07000000, 0x0707071B, 0x3F0F0000, 0x0F0F0F3B, 0xFFFFFFFF, 0x1F1F1FFB, 0xFFFFFFFF, 0x3F3F3FFB,
+	0x3C000000, 0x3C3C3F3B, 0x00000000, 0x18181F1B, 0x00000000, 0x00111F1B, 0x00000000, 0x03031F1B,
+	0x07000000, 0x07073F3B, 0x3F0F0000, 0x0F0F7F7B, 0xFFFFFFFF, 0x1F1FFFFB, 0xFFFFFFFF, 0x3F3FFFFB,
+	0xFFFFFCFC, 0xFFFFFFFB, 0xFFFFF8F8, 0xFFFFFFFB, 0xFFFFF1F1, 0xFFFFFFFB, 0xFFFFE3E3, 0xFFFFFFFB,
+	0xFFFFC7C7, 0xFFFFFFFB, 0xFFFF8F8F, 0xFFFFFFFB, 0xFFFF1F1F, 0xFFFFFFFB, 0xFFFF3F3F, 0xFFFFFFFB,
+	0xFFFCFCFC, 0xFFFFFFFB, 0xFFF8F8F8, 0xFFFFFFFB, 0xFFF1F1F1, 0xFFFFFFFB, 0xFFE3E3E3, 0xFFFFFFFB,
+	0xFFC7C7C7, 0xFFFFFFFB, 0xFF8F8F8F, 0xFFFFFFFB, 0xFF1F1F1F, 0xFFFFFFFB, 0xFF3F3F3F, 0xFFFFFFFB,
+	0xFCFCFCFF, 0xFFFFFFFB, 0xF8F8F8FF, 0xFFFFFFFB, 0xF1F1F1FF, 0xFFFFFFFB, 0xE3E3E3FF, 0xFFFFFFFB,
+	0xC7C7C7FF, 0xFFFFFFFB, 0x8F8F8FFF, 0xFFFFFFFB, 0x1F1F1FFF, 0xFFFFFFFB, 0x3F3F3FFF, 0xFFFFFFFB,
+	0x1C000000, 0x001E1F18, 0x08000000, 0x00000E08, 0x00000000, 0x00000E00, 0x02000000, 0x00000E02,
+	0x07000000, 0x000F1F03, 0x0F0F0000, 0x1F1F3F0B, 0x1F0F0000, 0x3F3F7F1B, 0x3F3FFFFF, 0xFFFFFF3B,
+	0x1C000000, 0x001E1C18, 0x00000000, 0x00000808, 0x00000000, 0x00000000, 0x00000000, 0x00000202,
+	0x07000000, 0x000F0703, 0x07000000, 0x0F1F0F0B, 0x1F0F0000, 0x1F3F1F1B, 0x3FFFFFFF, 0xFFFF3F3B,
+	0x00000000, 0x001C1C18, 0x00000000, 0x00000800, 0x00000000, 0x00000000, 0x00000000, 0x00000200,
+	0x00000000, 0x00070703, 0x07000000, 0x0F0F0F0B, 0x1F0F0000, 0x1F1F1F1B, 0xFFFFFFFF, 0xFF3F3F3B,
+	0x00000000, 0x1C1C1C18, 0x00000000, 0x00080800, 0x00000000, 0x00000000, 0x00000000, 0x00020200,
+	0x00000000, 0x07070703, 0x07000000, 0x0F0F0F1B, 0x1F0F0000, 0x1F1F1F3B, 0xFFFFFFFF, 0x3F3F3FFB,
+	0x00000000, 0x1C1C1F18, 0x00000000, 0x08080E00, 0x00000000, 0x00000E00, 0x00000000, 0x02020E00,
+	0x00000000, 0x07071F03, 0x07000000, 0x0F0F3F1B, 0x3F0F0000, 0x1F1F7F3B, 0xFFFFFFFF, 0x3F3FFFFB,
+	0xFFFFFCFC, 0xFFFFFFF7, 0xFFFFF8F8, 0xFFFFFFF7, 0xFFFFF1F1, 0xFFFFFFF7, 0xFFFFE3E3, 0xFFFFFFF7,
+	0xFFFFC7C7, 0xFFFFFFF7, 0xFFFF8F8F, 0xFFFFFFF7, 0xFFFF1F1F, 0xFFFFFFF7, 0xFFFF3F3F, 0xFFFFFFF7,
+	0xFFFCFCFC, 0xFFFFFFF7, 0xFFF8F8F8, 0xFFFFFFF7, 0xFFF1F1F1, 0xFFFFFFF7, 0xFFE3E3E3, 0xFFFFFFF7,
+	0xFFC7C7C7, 0xFFFFFFF7, 0xFF8F8F8F, 0xFFFFFFF7, 0xFF1F1F1F, 0xFFFFFFF7, 0xFF3F3F3F, 0xFFFFFFF7,
+	0xFCFCFCFF, 0xFFFFFFF7, 0xF8F8F8FF, 0xFFFFFFF7, 0xF1F1F1FF, 0xFFFFFFF7, 0xE3E3E3FF, 0xFFFFFFF7,
+	0xC7C7C7FF, 0xFFFFFFF7, 0x8F8F8FFF, 0xFFFFFFF7, 0x1F1F1FFF, 0xFFFFFFF7, 0x3F3F3FFF, 0xFFFFFFF7,
+	0xFCFCFFFF, 0xFFFFFFF4, 0xF8F8FFFF, 0xFFFFFFF0, 0xF1F1FFFF, 0xFFFFFFF1, 0xE3E3FFFF, 0xFFFFFFE3,
+	0xC7C7FFFF, 0xFFFFFFC7, 0x8F8FFFFF, 0xFFFFFF87, 0x1F1FFFFF, 0xFFFFFF17, 0x3F3FFFFF, 0xFFFFFF37,
+	0xFCFC0000, 0xFFFFFCF4, 0x787C0000, 0x7E7E7870, 0x30000000, 0x003C3030, 0x00000000, 0x00000000,
+	0x06000000, 0x001E0606, 0x0F1F0000, 0x3F3F0F07, 0x1F1F0000, 0x7F7F1F17, 0x3FFFFFFF, 0xFFFF3F37,
+	0xFEFC0000, 0xFEFCFCF4, 0x78000000, 0x7C787870, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x0F000000, 0x1F0F0F07, 0x3F1F0000, 0x3F1F1F17, 0xFFFFFFFF, 0xFF3F3F37,
+	0xFFFC0000, 0xFCFCFCF7, 0x78000000, 0x78787876, 0x00000000, 0x30303030, 0x00000000, 0x00000000,
+	0x00000000, 0x06060606, 0x0F000000, 0x0F0F0F37, 0x7F1F0000, 0x1F1F1F77, 0xFFFFFFFF, 0x3F3F3FF7,
+	0xFFFC0000, 0xFCFCFFF7, 0x78000000, 0x78787F77, 0x00000000, 0x30303E36, 0x00000000, 0x00223E36,
+	0x00000000, 0x06063E36, 0x0F000000, 0x0F0F7F77, 0x7F1F0000, 0x1F1FFFF7, 0xFFFFFFFF, 0x3F3FFFF7,
+	0xFFFFFCFC, 0xFFFFFFF7, 0xFFFFF8F8, 0xFFFFFFF7, 0xFFFFF1F1, 0xFFFFFFF7, 0xFFFFE3E3, 0xFFFFFFF7,
+	0xFFFFC7C7, 0xFFFFFFF7, 0xFFFF8F8F, 0xFFFFFFF7, 0xFFFF1F1F, 0xFFFFFFF7, 0xFFFF3F3F, 0xFFFFFFF7,
+	0xFFFCFCFC, 0xFFFFFFF7, 0xFFF8F8F8, 0xFFFFFFF7, 0xFFF1F1F1, 0xFFFFFFF7, 0xFFE3E3E3, 0xFFFFFFF7,
+	0xFFC7C7C7, 0xFFFFFFF7, 0xFF8F8F8F, 0xFFFFFFF7, 0xFF1F1F1F, 0xFFFFFFF7, 0xFF3F3F3F, 0xFFFFFFF7,
+	0xFCFCFCFF, 0xFFFFFFF7, 0xF8F8F8FF, 0xFFFFFFF7, 0xF1F1F1FF, 0xFFFFFFF7, 0xE3E3E3FF, 0xFFFFFFF7,
+	0xC7C7C7FF, 0xFFFFFFF7, 0x8F8F8FFF, 0xFFFFFFF7, 0x1F1F1FFF, 0xFFFFFFF7, 0x3F3F3FFF, 0xFFFFFFF7,
+	0x7C7C0000, 0x7E7E7F74, 0x38000000, 0x003C3E30, 0x10000000, 0x00001C10, 0x00000000, 0x00001C00,
+	0x04000000, 0x00001C04, 0x0E000000, 0x001E3E06, 0x1F1F0000, 0x3F3F7F17, 0x3F1F0000, 0x7F7FFF37,
+	0x78000000, 0x7C7E7C74, 0x38000000, 0x003C3830, 0x00000000, 0x00001010, 0x00000000, 0x00000000,
+	0x00000000, 0x00000404, 0x0E000000, 0x001E0E06, 0x0F000000, 0x1F3F1F17, 0x3F1F0000, 0x3F7F3F37,
+	0x78000000, 0x7C7C7C74, 0x00000000, 0x00383830, 0x00000000, 0x00001000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000400, 0x00000000, 0x000E0E06, 0x0F000000, 0x1F1F1F17, 0x3F1F0000, 0x3F3F3F37,
+	0x78000000, 0x7C7C7C76, 0x00000000, 0x38383830, 0x00000000, 0x00101000, 0x00000000, 0x00000000,
+	0x00000000, 0x00040400, 0x00000000, 0x0E0E0E06, 0x0F000000, 0x1F1F1F37, 0x3F1F0000, 0x3F3F3F77,
+	0x78000000, 0x7C7C7F76, 0x00000000, 0x38383E30, 0x00000000, 0x10101C00, 0x00000000, 0x00001C00,
+	0x00000000, 0x04041C00, 0x00000000, 0x0E0E3E06, 0x0F000000, 0x1F1F7F37, 0x7F1F0000, 0x3F3FFF77,
+	0xFEFFFCFC, 0xFFFFFFFF, 0xFEFFF8F8, 0xFFFFFFFF, 0xFEFFF1F1, 0xFFFFFFFF, 0xFEFFE3E3, 0xFFFFFFFF,
+	0xFEFFC7C7, 0xFFFFFFFF, 0xFEFF8F8F, 0xFFFFFFFF, 0xFEFF1F1F, 0xFFFFFFFF, 0xFEFF3F3F, 0xFFFFFFFF,
+	0xFEFCFCFC, 0xFFFFFFFF, 0xFEF8F8F8, 0xFFFFFFFF, 0xFEF1F1F1, 0xFFFFFFFF, 0xFEE3E3E3, 0xFFFFFFFF,
+	0xFEC7C7C7, 0xFFFFFFFF, 0xFE8F8F8F, 0xFFFFFFFF, 0xFE1F1F1F, 0xFFFFFFFF, 0xFE3F3F3F, 0xFFFFFFFF,
+	0xFCFCFCFF, 0xFFFFFFFF, 0xF8F8F8FF, 0xFFFFFFFF, 0xF0F1F1FF, 0xFFFFFFFF, 0xE2E3E3FF, 0xFFFFFFFF,
+	0xC6C7C7FF, 0xFFFFFFFF, 0x8E8F8FFF, 0xFFFFFFFF, 0x1E1F1FFF, 0xFFFFFFFF, 0x3E3F3FFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000300, 0x00000000, 0x00070701, 0x02030000, 0x070F0F03,
+	0x06070000, 0x0F1F1F07, 0x8E8FFFFF, 0xFFFFFF8F, 0x1E1FFFFF, 0xFFFFFF1F, 0x3E3FFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020000, 0x02000000, 0x07070303,
+	0x06000000, 0x0F0F0707, 0x8EFFFFFF, 0xFFFF8F8F, 0x1EFFFFFF, 0xFFFF1F1F, 0x3EFFFFFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x07030303,
+	0x00000000, 0x0F070707, 0xFEFFFFFF, 0xFF8F8F8F, 0xFEFFFFFF, 0xFF1F1F1F, 0xFEFFFFFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030300,
+	0x00000000, 0x0707070F, 0xFEFFFFFF, 0x8F8F8FFF, 0xFEFFFFFF, 0x1F1F1FFF, 0xFEFFFFFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030700,
+	0x00000000, 0x07070F0F, 0xFEFFFFFF, 0x8F8FFFFF, 0xFEFFFFFF, 0x1F1FFFFF, 0xFEFFFFFF, 0x3F3FFFFF,
+	0xFEFFFCFC, 0xFFFFFFFF, 0xFEFFF8F8, 0xFFFFFFFF, 0xFEFFF1F1, 0xFFFFFFFF, 0xFEFFE3E3, 0xFFFFFFFF,
+	0xFEFFC7C7, 0xFFFFFFFF, 0xFEFF8F8F, 0xFFFFFFFF, 0xFEFF1F1F, 0xFFFFFFFF, 0xFEFF3F3F, 0xFFFFFFFF,
+	0xFEFCFCFC, 0xFFFFFFFF, 0xFEF8F8F8, 0xFFFFFFFF, 0xFEF1F1F1, 0xFFFFFFFF, 0xFEE3E3E3, 0xFFFFFFFF,
+	0xFEC7C7C7, 0xFFFFFFFF, 0xFE8F8F8F, 0xFFFFFFFF, 0xFE1F1F1F, 0xFFFFFFFF, 0xFE3F3F3F, 0xFFFFFFFF,
+	0x00000000, 0x00000003, 0x00000000, 0x00000003, 0x00000000, 0x00000307, 0x02020000, 0x0007070F,
+	0x06070000, 0x070F0F1F, 0x0E0F0000, 0x0F1F1F3F, 0x1E1F1FFF, 0xFFFFFFFF, 0x3E3F3FFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000200, 0x02000000, 0x00020602,
+	0x06000000, 0x07070F07, 0x0E000000, 0x0F0F1F0F, 0x1E1FFFFF, 0xFFFFFF1F, 0x3E3FFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020202,
+	0x00000000, 0x07070707, 0x00000000, 0x0F0F0F0F, 0x1EFFFFFF, 0xFFFF1F1F, 0x3EFFFFFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020200,
+	0x00000000, 0x07070700, 0x00000000, 0x0F0F0F0F, 0xFEFFFFFF, 0xFF1F1F1F, 0xFEFFFFFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020000,
+	0x00000000, 0x07070700, 0x00000000, 0x0F0F0F0F, 0xFEFFFFFF, 0x1F1F1FFF, 0xFEFFFFFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07070700, 0x00000000, 0x0F0F0F0F, 0xFEFFFFFF, 0x1F1FFFFF, 0xFEFFFFFF, 0x3F3FFFFF,
+	0xFDFFFCFC, 0xFFFFFFFF, 0xFDFFF8F8, 0xFFFFFFFF, 0xFDFFF1F1, 0xFFFFFFFF, 0xFDFFE3E3, 0xFFFFFFFF,
+	0xFDFFC7C7, 0xFFFFFFFF, 0xFDFF8F8F, 0xFFFFFFFF, 0xFDFF1F1F, 0xFFFFFFFF, 0xFDFF3F3F, 0xFFFFFFFF,
+	0xFDFCFCFC, 0xFFFFFFFF, 0xFDF8F8F8, 0xFFFFFFFF, 0xFDF1F1F1, 0xFFFFFFFF, 0xFDE3E3E3, 0xFFFFFFFF,
+	0xFDC7C7C7, 0xFFFFFFFF, 0xFD8F8F8F, 0xFFFFFFFF, 0xFD1F1F1F, 0xFFFFFFFF, 0xFD3F3F3F, 0xFFFFFFFF,
+	0xFCFCFCFF, 0xFFFFFFFF, 0xF8F8F8FF, 0xFFFFFFFF, 0xF1F1F1FF, 0xFFFFFFFF, 0xE1E3E3FF, 0xFFFFFFFF,
+	0xC5C7C7FF, 0xFFFFFFFF, 0x8D8F8FFF, 0xFFFFFFFF, 0x1D1F1FFF, 0xFFFFFFFF, 0x3D3F3FFF, 0xFFFFFFFF,
+	0x0C0C0000, 0x00000F0C, 0x00000000, 0x00000000, 0x01010000, 0x00000701, 0x01030700, 0x000F0F03,
+	0x05070700, 0x0F1F1F07, 0x0D0F1F0F, 0x1F3F3F0F, 0x1D1FFFFF, 0xFFFFFF1F, 0x3D3FFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x01030000, 0x00070303,
+	0x050F0700, 0x0F0F0707, 0x0D1F1F0F, 0x1F1F0F0F, 0x1DFFFFFF, 0xFFFF1F1F, 0x3DFFFFFF, 0xFFFF3F3F,
+	0x0C000000, 0x000C0C0C, 0x00000000, 0x00000000, 0x01000000, 0x00010101, 0x05030000, 0x07030303,
+	0x0D0F0700, 0x0F070707, 0x1D1F1F0F, 0x1F0F0F0F, 0xFDFFFFFF, 0xFF1F1F1F, 0xFDFFFFFF, 0xFF3F3F3F,
+	0x0D000000, 0x0C0C0C0E, 0x05000000, 0x00000005, 0x0D000000, 0x0101010B, 0x1D030000, 0x03030317,
+	0x3D0F0700, 0x0707072F, 0x7D1F1F0F, 0x0F0F0F5F, 0xFDFFFFFF, 0x1F1F1FFF, 0xFDFFFFFF, 0x3F3F3FFF,
+	0x0C000000, 0x0C0C0F0F, 0x00000000, 0x00080F0F, 0x01000000, 0x01010F0F, 0x05030000, 0x03031F1F,
+	0x0D0F0700, 0x07073F3F, 0x1D1F1F0F, 0x0F0F7F7F, 0xFDFFFFFF, 0x1F1FFFFF, 0xFDFFFFFF, 0x3F3FFFFF,
+	0xFDFFFCFC, 0xFFFFFFFF, 0xFDFFF8F8, 0xFFFFFFFF, 0xFDFFF1F1, 0xFFFFFFFF, 0xFDFFE3E3, 0xFFFFFFFF,
+	0xFDFFC7C7, 0xFFFFFFFF, 0xFDFF8F8F, 0xFFFFFFFF, 0xFDFF1F1F, 0xFFFFFFFF, 0xFDFF3F3F, 0xFFFFFFFF,
+	0xFDFCFCFC, 0xFFFFFFFF, 0xFDF8F8F8, 0xFFFFFFFF, 0xFDF1F1F1, 0xFFFFFFFF, 0xFDE3E3E3, 0xFFFFFFFF,
+	0xFDC7C7C7, 0xFFFFFFFF, 0xFD8F8F8F, 0xFFFFFFFF, 0xFD1F1F1F, 0xFFFFFFFF, 0xFD3F3F3F, 0xFFFFFFFF,
+	0x04040000, 0x00000007, 0x00000000, 0x00000007, 0x01010000, 0x00000007, 0x01030000, 0x0000070F,
+	0x05070700, 0x000F0F1F, 0x0D0F0700, 0x0F1F1F3F, 0x1D1F1F0F, 0x1F3F3F7F, 0x3D3F3FFF, 0xFFFFFFFF,
+	0x04000000, 0x00000004, 0x00000000, 0x00000000, 0x01000000, 0x00000001, 0x01030000, 0x00000703,
+	0x05030000, 0x00070F07, 0x0D0F0700, 0x0F0F1F0F, 0x1D1F1F0F, 0x1F1F3F1F, 0x3D3FFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000004, 0x00000000, 0x00000000, 0x00000000, 0x00000001, 0x01000000, 0x00000303,
+	0x05030000, 0x00070707, 0x0D0F0700, 0x0F0F0F0F, 0x1D1F1F0F, 0x1F1F1F1F, 0x3DFFFFFF, 0xFFFF3F3F,
+	0x00000000, 0x00000404, 0x00000000, 0x00000000, 0x00000000, 0x00000101, 0x01000000, 0x00030303,
+	0x05030000, 0x00070707, 0x0D0F0700, 0x0F0F0F0F, 0x1D1F1F0F, 0x1F1F1F1F, 0xFDFFFFFF, 0xFF3F3F3F,
+	0x00000000, 0x00040405, 0x00000000, 0x00000002, 0x00000000, 0x00010105, 0x01000000, 0x0003030B,
+	0x05030000, 0x07070717, 0x0D0F0700, 0x0F0F0F2F, 0x1D1F1F0F, 0x1F1F1F5F, 0xFDFFFFFF, 0x3F3F3FFF,
+	0x00000000, 0x04040704, 0x00000000, 0x00000700, 0x00000000, 0x01010701, 0x01000000, 0x03030F03,
+	0x05030000, 0x07071F07, 0x0D0F0700, 0x0F0F3F0F, 0x1D1F1F0F, 0x1F1F7F5F, 0xFDFFFFFF, 0x3F3FFFFF,
+	0xFBFFFCFC, 0xFFFFFFFF, 0xFBFFF8F8, 0xFFFFFFFF, 0xFBFFF1F1, 0xFFFFFFFF, 0xFBFFE3E3, 0xFFFFFFFF,
+	0xFBFFC7C7, 0xFFFFFFFF, 0xFBFF8F8F, 0xFFFFFFFF, 0xFBFF1F1F, 0xFFFFFFFF, 0xFBFF3F3F, 0xFFFFFFFF,
+	0xFBFCFCFC, 0xFFFFFFFF, 0xFBF8F8F8, 0xFFFFFFFF, 0xFBF1F1F1, 0xFFFFFFFF, 0xFBE3E3E3, 0xFFFFFFFF,
+	0xFBC7C7C7, 0xFFFFFFFF, 0xFB8F8F8F, 0xFFFFFFFF, 0xFB1F1F1F, 0xFFFFFFFF, 0xFB3F3F3F, 0xFFFFFFFF,
+	0xF8FCFCFF, 0xFFFFFFFF, 0xF8F8F8FF, 0xFFFFFFFF, 0xF1F1F1FF, 0xFFFFFFFF, 0xE3E3E3FF, 0xFFFFFFFF,
+	0xC3C7C7FF, 0xFFFFFFFF, 0x8B8F8FFF, 0xFFFFFFFF, 0x1B1F1FFF, 0xFFFFFFFF, 0x3B3F3FFF, 0xFFFFFFFF,
+	0x383C3E00, 0x003F3F3C, 0x18180000, 0x00001E18, 0x00000000, 0x00000000, 0x03030000, 0x00000F03,
+	0x03070F00, 0x001F1F07, 0x0B0F0F00, 0x1F3F3F0F, 0x1B1F3F1F, 0x3F7F7F1F, 0x3B3FFFFF, 0xFFFFFF3F,
+	0x383C0000, 0x003E3C3C, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x03070000, 0x000F0707, 0x0B1F0F00, 0x1F1F0F0F, 0x1B3F3F1F, 0x3F3F1F1F, 0x3BFFFFFF, 0xFFFF3F3F,
+	0x3A3C0000, 0x3E3C3C3C, 0x18000000, 0x00181818, 0x00000000, 0x00000000, 0x03000000, 0x00030303,
+	0x0B070000, 0x0F070707, 0x1B1F0F00, 0x1F0F0F0F, 0x3B3F3F1F, 0x3F1F1F1F, 0xFBFFFFFF, 0xFF3F3F3F,
+	0x3B3C0000, 0x3C3C3C3E, 0x1B000000, 0x1818181D, 0x0A000000, 0x0000000A, 0x1B000000, 0x03030317,
+	0x3B070000, 0x0707072F, 0x7B1F0F00, 0x0F0F0F5F, 0xFB3F3F1F, 0x1F1F1FBF, 0xFBFFFFFF, 0x3F3F3FFF,
+	0x3A3C0000, 0x3C3C3F3F, 0x18000000, 0x18181F1F, 0x00000000, 0x00111F1F, 0x03000000, 0x03031F1F,
+	0x0B070000, 0x07073F3F, 0x1B1F0F00, 0x0F0F7F7F, 0x3B3F3F1F, 0x1F1FFFFF, 0xFBFFFFFF, 0x3F3FFFFF,
+	0xFBFFFCFC, 0xFFFFFFFF, 0xFBFFF8F8, 0xFFFFFFFF, 0xFBFFF1F1, 0xFFFFFFFF, 0xFBFFE3E3, 0xFFFFFFFF,
+	0xFBFFC7C7, 0xFFFFFFFF, 0xFBFF8F8F, 0xFFFFFFFF, 0xFBFF1F1F, 0xFFFFFFFF, 0xFBFF3F3F, 0xFFFFFFFF,
+	0xFBFCFCFC, 0xFFFFFFFF, 0xFBF8F8F8, 0xFFFFFFFF, 0xFBF1F1F1, 0xFFFFFFFF, 0xFBE3E3E3, 0xFFFFFFFF,
+	0xFBC7C7C7, 0xFFFFFFFF, 0xFB8F8F8F, 0xFFFFFFFF, 0xFB1F1F1F, 0xFFFFFFFF, 0xFB3F3F3F, 0xFFFFFFFF,
+	0x181C0000, 0x00001E1F, 0x08080000, 0x0000000E, 0x00000000, 0x0000000E, 0x02020000, 0x0000000E,
+	0x03070000, 0x00000F1F, 0x0B0F0F00, 0x001F1F3F, 0x1B1F0F00, 0x1F3F3F7F, 0x3B3F3F1F, 0x3F7F7FFF,
+	0x181C0000, 0x00001E1C, 0x08000000, 0x00000008, 0x00000000, 0x00000000, 0x02000000, 0x00000002,
+	0x03070000, 0x00000F07, 0x0B070000, 0x000F1F0F, 0x1B1F0F00, 0x1F1F3F1F, 0x3B3F3F1F, 0x3F3F7F3F,
+	0x18000000, 0x00001C1C, 0x00000000, 0x00000008, 0x00000000, 0x00000000, 0x00000000, 0x00000002,
+	0x03000000, 0x00000707, 0x0B070000, 0x000F0F0F, 0x1B1F0F00, 0x1F1F1F1F, 0x3B3F3F1F, 0x3F3F3F3F,
+	0x18000000, 0x001C1C1C, 0x00000000, 0x00000808, 0x00000000, 0x00000000, 0x00000000, 0x00000202,
+	0x03000000, 0x00070707, 0x0B070000, 0x000F0F0F, 0x1B1F0F00, 0x1F1F1F1F, 0x3B3F3F1F, 0x3F3F3F3F,
+	0x18000000, 0x001C1C1D, 0x00000000, 0x0008080A, 0x00000000, 0x00000004, 0x00000000, 0x0002020A,
+	0x03000000, 0x00070717, 0x0B070000, 0x0F0F0F2F, 0x1B1F0F00, 0x1F1F1F5F, 0x3B3F3F1F, 0x3F3F3FBF,
+	0x18000000, 0x1C1C1F1C, 0x00000000, 0x08080E08, 0x00000000, 0x00000E00, 0x00000000, 0x02020E02,
+	0x03000000, 0x07071F07, 0x0B070000, 0x0F0F3F0F, 0x1B1F0F00, 0x1F1F7F1F, 0x3B3F3F1F, 0x3F3FFFBF,
+	0xF7FFFCFC, 0xFFFFFFFF, 0xF7FFF8F8, 0xFFFFFFFF, 0xF7FFF1F1, 0xFFFFFFFF, 0xF7FFE3E3, 0xFFFFFFFF,
+	0xF7FFC7C7, 0xFFFFFFFF, 0xF7FF8F8F, 0xFFFFFFFF, 0xF7FF1F1F, 0xFFFFFFFF, 0xF7FF3F3F, 0xFFFFFFFF,
+	0xF7FCFCFC, 0xFFFFFFFF, 0xF7F8F8F8, 0xFFFFFFFF, 0xF7F1F1F1, 0xFFFFFFFF, 0xF7E3E3E3, 0xFFFFFFFF,
+	0xF7C7C7C7, 0xFFFFFFFF, 0xF78F8F8F, 0xFFFFFFFF, 0xF71F1F1F, 0xFFFFFFFF, 0xF73F3F3F, 0xFFFFFFFF,
+	0xF4FCFCFF, 0xFFFFFFFF, 0xF0F8F8FF, 0xFFFFFFFF, 0xF1F1F1FF, 0xFFFFFFFF, 0xE3E3E3FF, 0xFFFFFFFF,
+	0xC7C7C7FF, 0xFFFFFFFF, 0x878F8FFF, 0xFFFFFFFF, 0x171F1FFF, 0xFFFFFFFF, 0x373F3FFF, 0xFFFFFFFF,
+	0xF4FCFC00, 0xFEFFFFFC, 0x70787C00, 0x007E7E78, 0x30300000, 0x00003C30, 0x00000000, 0x00000000,
+	0x06060000, 0x00001E06, 0x070F1F00, 0x003F3F0F, 0x171F1F00, 0x3F7F7F1F, 0x373F7F3F, 0x7FFFFF3F,
+	0xF4FEFC00, 0xFEFEFCFC, 0x70780000, 0x007C7878, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x070F0000, 0x001F0F0F, 0x173F1F00, 0x3F3F1F1F, 0x377F7F3F, 0x7F7F3F3F,
+	0xF6FEFC00, 0xFEFCFCFC, 0x74780000, 0x7C787878, 0x30000000, 0x00303030, 0x00000000, 0x00000000,
+	0x06000000, 0x00060606, 0x170F0000, 0x1F0F0F0F, 0x373F1F00, 0x3F1F1F1F, 0x777F7F3F, 0x7F3F3F3F,
+	0xF7FEFC00, 0xFCFCFCFE, 0x77780000, 0x7878787D, 0x36000000, 0x3030303A, 0x14000000, 0x00000014,
+	0x36000000, 0x0606062E, 0x770F0000, 0x0F0F0F5F, 0xF73F1F00, 0x1F1F1FBF, 0xF77F7F3F, 0x3F3F3F7F,
+	0xF6FEFC00, 0xFCFCFFFF, 0x74780000, 0x78787F7F, 0x30000000, 0x30303E3E, 0x00000000, 0x00223E3E,
+	0x06000000, 0x06063E3E, 0x170F0000, 0x0F0F7F7F, 0x373F1F00, 0x1F1FFFFF, 0x777F7F3F, 0x3F3FFFFF,
+	0xF7FFFCFC, 0xFFFFFFFF, 0xF7FFF8F8, 0xFFFFFFFF, 0xF7FFF1F1, 0xFFFFFFFF, 0xF7FFE3E3, 0xFFFFFFFF,
+	0xF7FFC7C7, 0xFFFFFFFF, 0xF7FF8F8F, 0xFFFFFFFF, 0xF7FF1F1F, 0xFFFFFFFF, 0xF7FF3F3F, 0xFFFFFFFF,
+	0xF7FCFCFC, 0xFFFFFFFF, 0xF7F8F8F8, 0xFFFFFFFF, 0xF7F1F1F1, 0xFFFFFFFF, 0xF7E3E3E3, 0xFFFFFFFF,
+	0xF7C7C7C7, 0xFFFFFFFF, 0xF78F8F8F, 0xFFFFFFFF, 0xF71F1F1F, 0xFFFFFFFF, 0xF73F3F3F, 0xFFFFFFFF,
+	0x747C7C00, 0x007E7E7F, 0x30380000, 0x00003C3E, 0x10100000, 0x0000001C, 0x00000000, 0x0000001C,
+	0x04040000, 0x0000001C, 0x060E0000, 0x00001E3E, 0x171F1F00, 0x003F3F7F, 0x373F1F00, 0x3F7F7FFF,
+	0x74780000, 0x007C7E7C, 0x30380000, 0x00003C38, 0x10000000, 0x00000010, 0x00000000, 0x00000000,
+	0x04000000, 0x00000004, 0x060E0000, 0x00001E0E, 0x170F0000, 0x001F3F1F, 0x373F1F00, 0x3F3F7F3F,
+	0x74780000, 0x007C7C7C, 0x30000000, 0x00003838, 0x00000000, 0x00000010, 0x00000000, 0x00000000,
+	0x00000000, 0x00000004, 0x06000000, 0x00000E0E, 0x170F0000, 0x001F1F1F, 0x373F1F00, 0x3F3F3F3F,
+	0x74780000, 0x007C7C7C, 0x30000000, 0x00383838, 0x00000000, 0x00001010, 0x00000000, 0x00000000,
+	0x00000000, 0x00000404, 0x06000000, 0x000E0E0E, 0x170F0000, 0x001F1F1F, 0x373F1F00, 0x3F3F3F3F,
+	0x74780000, 0x7C7C7C7D, 0x30000000, 0x0038383A, 0x00000000, 0x00101014, 0x00000000, 0x00000008,
+	0x00000000, 0x00040414, 0x06000000, 0x000E0E2E, 0x170F0000, 0x1F1F1F5F, 0x373F1F00, 0x3F3F3FBF,
+	0x74780000, 0x7C7C7F7C, 0x30000000, 0x38383E38, 0x00000000, 0x10101C10, 0x00000000, 0x00001C00,
+	0x00000000, 0x04041C04, 0x06000000, 0x0E0E3E0E, 0x170F0000, 0x1F1F7F1F, 0x373F1F00, 0x3F3FFF3F,
+	0xFFFEFCFC, 0xFFFFFFFF, 0xFFFEF8F8, 0xFFFFFFFF, 0xFFFEF1F1, 0xFFFFFFFF, 0xFFFEE3E3, 0xFFFFFFFF,
+	0xFFFEC7C7, 0xFFFFFFFF, 0xFFFE8F8F, 0xFFFFFFFF, 0xFFFE1F1F, 0xFFFFFFFF, 0xFFFE3F3F, 0xFFFFFFFF,
+	0xFFFCFCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF0F1F1, 0xFFFFFFFF, 0xFFE2E3E3, 0xFFFFFFFF,
+	0xFFC6C7C7, 0xFFFFFFFF, 0xFF8E8F8F, 0xFFFFFFFF, 0xFF1E1F1F, 0xFFFFFFFF, 0xFF3E3F3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000003, 0x01000000, 0x00000707, 0x03020300, 0x00070F0F,
+	0x07060700, 0x0F0F1F1F, 0x0F0E0F00, 0x1F1F3F3F, 0x1F1E1FFF, 0xFFFFFFFF, 0x3F3E3FFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000200, 0x03020000, 0x00070703,
+	0x07060000, 0x0F0F0F07, 0x0F0E0000, 0x1F1F1F0F, 0x1F1EFFFF, 0xFFFFFF1F, 0x3F3EFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03000000, 0x00070303,
+	0x07000000, 0x0F0F0707, 0x0F000000, 0x1F1F0F0F, 0x1FFEFFFF, 0xFFFF1F1F, 0x3FFEFFFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00030303,
+	0x00000000, 0x0F070707, 0x1F000000, 0x1F0F0F0F, 0xFFFEFFFF, 0xFF1F1F1F, 0xFFFEFFFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030300,
+	0x00000000, 0x0707070F, 0x1F000000, 0x0F0F0F1F, 0xFFFEFFFF, 0x1F1F1FFF, 0xFFFEFFFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030700,
+	0x00000000, 0x07070F0F, 0x1F000000, 0x0F0F1F1F, 0xFFFEFFFF, 0x1F1FFFFF, 0xFFFEFFFF, 0x3F3FFFFF,
+	0xFFFEFCFC, 0xFFFFFFFF, 0xFFFEF8F8, 0xFFFFFFFF, 0xFFFEF1F1, 0xFFFFFFFF, 0xFFFEE3E3, 0xFFFFFFFF,
+	0xFFFEC7C7, 0xFFFFFFFF, 0xFFFE8F8F, 0xFFFFFFFF, 0xFFFE1F1F, 0xFFFFFFFF, 0xFFFE3F3F, 0xFFFFFFFF,
+	0x03000000, 0x00000000, 0x03000000, 0x00000000, 0x07000000, 0x00000003, 0x0F020200, 0x00000707,
+	0x1F060700, 0x00070F0F, 0x3F0E0F00, 0x0F0F1F1F, 0x7F1E1F00, 0x1F1F3F3F, 0xFF3E3F3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000002, 0x02020000, 0x00000206,
+	0x07060000, 0x0007070F, 0x0F0E0000, 0x0F0F0F1F, 0x1F1E0000, 0x1F1F1F3F, 0x3F3E3FFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000202,
+	0x07000000, 0x00070707, 0x0F000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0x3F3EFFFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000202,
+	0x00000000, 0x00070707, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0x3FFEFFFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000200,
+	0x00000000, 0x00070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFEFFFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020000,
+	0x00000000, 0x00070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFEFFFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFEFFFF, 0x3F3FFFFF,
+	0xFFFDFCFC, 0xFFFFFFFF, 0xFFFDF8F8, 0xFFFFFFFF, 0xFFFDF1F1, 0xFFFFFFFF, 0xFFFDE3E3, 0xFFFFFFFF,
+	0xFFFDC7C7, 0xFFFFFFFF, 0xFFFD8F8F, 0xFFFFFFFF, 0xFFFD1F1F, 0xFFFFFFFF, 0xFFFD3F3F, 0xFFFFFFFF,
+	0xFFFCFCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE1E3E3, 0xFFFFFFFF,
+	0xFFC5C7C7, 0xFFFFFFFF, 0xFF8D8F8F, 0xFFFFFFFF, 0xFF1D1F1F, 0xFFFFFFFF, 0xFF3D3F3F, 0xFFFFFFFF,
+	0x0C0C0C00, 0x0000000F, 0x00000000, 0x00000000, 0x01010100, 0x00000007, 0x03010307, 0x00000F0F,
+	0x07050707, 0x000F1F1F, 0x0F0D0F1F, 0x1F1F3F3F, 0x1F1D1F3F, 0x3F3F7F7F, 0x3F3D3FFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03010300, 0x00000703,
+	0x07050F07, 0x000F0F07, 0x0F0D1F1F, 0x1F1F1F0F, 0x1F1D3F3F, 0x3F3F3F1F, 0x3F3DFFFF, 0xFFFFFF3F,
+	0x0C0C0000, 0x00000C0C, 0x00000000, 0x00000000, 0x01010000, 0x00000101, 0x03050300, 0x00070303,
+	0x070D0F07, 0x000F0707, 0x0F1D1F1F, 0x1F1F0F0F, 0x1F3D3F3F, 0x3F3F1F1F, 0x3FFDFFFF, 0xFFFF3F3F,
+	0x0E0D0000, 0x000C0C0C, 0x05050000, 0x00000000, 0x0B0D0000, 0x00010101, 0x171D0300, 0x00030303,
+	0x2F3D0F07, 0x0F070707, 0x5F7D1F1F, 0x1F0F0F0F, 0xBFFD3F3F, 0x3F1F1F1F, 0xFFFDFFFF, 0xFF3F3F3F,
+	0x0F0C0000, 0x0C0C0C0F, 0x0F000000, 0x0000080F, 0x0F010000, 0x0101010F, 0x1F050300, 0x0303031F,
+	0x3F0D0F07, 0x0707073F, 0x7F1D1F1F, 0x0F0F0F7F, 0xFF3D3F3F, 0x1F1F1FFF, 0xFFFDFFFF, 0x3F3F3FFF,
+	0x1F1D0000, 0x0C1C1F1F, 0x1F1D0000, 0x00181F1F, 0x1F1D0000, 0x01111F1F, 0x1F1D0300, 0x03031F1F,
+	0x3F3D0F07, 0x07073F3F, 0x7F7D1F1F, 0x0F0F7F7F, 0xFFFD3F3F, 0x1F1FFFFF, 0xFFFDFFFF, 0x3F3FFFFF,
+	0xFFFDFCFC, 0xFFFFFFFF, 0xFFFDF8F8, 0xFFFFFFFF, 0xFFFDF1F1, 0xFFFFFFFF, 0xFFFDE3E3, 0xFFFFFFFF,
+	0xFFFDC7C7, 0xFFFFFFFF, 0xFFFD8F8F, 0xFFFFFFFF, 0xFFFD1F1F, 0xFFFFFFFF, 0xFFFD3F3F, 0xFFFFFFFF,
+	0x07040400, 0x00000000, 0x07000000, 0x00000000, 0x07010100, 0x00000000, 0x0F010300, 0x00000007,
+	0x1F050707, 0x00000F0F, 0x3F0D0F07, 0x000F1F1F, 0x7F1D1F1F, 0x1F1F3F3F, 0xFF3D3F3F, 0x3F3F7F7F,
+	0x04040000, 0x00000000, 0x00000000, 0x00000000, 0x01010000, 0x00000000, 0x03010300, 0x00000007,
+	0x07050300, 0x0000070F, 0x0F0D0F07, 0x000F0F1F, 0x1F1D1F1F, 0x1F1F1F3F, 0x3F3D3F3F, 0x3F3F3F7F,
+	0x04000000, 0x00000000, 0x00000000, 0x00000000, 0x01000000, 0x00000000, 0x03010000, 0x00000003,
+	0x07050300, 0x00000707, 0x0F0D0F07, 0x000F0F0F, 0x1F1D1F1F, 0x1F1F1F1F, 0x3F3D3F3F, 0x3F3F3F3F,
+	0x04000000, 0x00000004, 0x00000000, 0x00000000, 0x01000000, 0x00000001, 0x03010000, 0x00000303,
+	0x07050300, 0x00000707, 0x0F0D0F07, 0x000F0F0F, 0x1F1D1F1F, 0x1F1F1F1F, 0x3F3D3F3F, 0x3F3F3F3F,
+	0x05000000, 0x00000404, 0x02000000, 0x00000000, 0x05000000, 0x00000101, 0x0B010000, 0x00000303,
+	0x17050300, 0x00070707, 0x2F0D0F07, 0x000F0F0F, 0x5F1D1F1F, 0x1F1F1F1F, 0xBF3D3F3F, 0x3F3F3F3F,
+	0x04000000, 0x00040407, 0x00000000, 0x00000007, 0x01000000, 0x00010107, 0x03010000, 0x0003030F,
+	0x07050300, 0x0007071F, 0x0F0D0F07, 0x0F0F0F3F, 0x1F1D1F1F, 0x1F1F1F7F, 0xBF3D3F3F, 0x3F3F3FFF,
+	0x0F000000, 0x04040F0F, 0x0F000000, 0x00000F0F, 0x0F000000, 0x01010F0F, 0x0F010000, 0x03030F0F,
+	0x1F050300, 0x07071F1F, 0x3F0D0F07, 0x0F0F3F3F, 0x7F1D1F1F, 0x1F1F7F7F, 0xFF3D3F3F, 0x3F3FFFFF,
+	0xFFFBFCFC, 0xFFFFFFFF, 0xFFFBF8F8, 0xFFFFFFFF, 0xFFFBF1F1, 0xFFFFFFFF, 0xFFFBE3E3, 0xFFFFFFFF,
+	0xFFFBC7C7, 0xFFFFFFFF, 0xFFFB8F8F, 0xFFFFFFFF, 0xFFFB1F1F, 0xFFFFFFFF, 0xFFFB3F3F, 0xFFFFFFFF,
+	0xFFF8FCFC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE3E3E3, 0xFFFFFFFF,
+	0xFFC3C7C7, 0xFFFFFFFF, 0xFF8B8F8F, 0xFFFFFFFF, 0xFF1B1F1F, 0xFFFFFFFF, 0xFF3B3F3F, 0xFFFFFFFF,
+	0x3C383C3E, 0x00003F3F, 0x18181800, 0x0000001E, 0x00000000, 0x00000000, 0x03030300, 0x0000000F,
+	0x0703070F, 0x00001F1F, 0x0F0B0F0F, 0x001F3F3F, 0x1F1B1F3F, 0x3F3F7F7F, 0x3F3B3F7F, 0x7F7FFFFF,
+	0x3C383C00, 0x00003E3C, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x07030700, 0x00000F07, 0x0F0B1F0F, 0x001F1F0F, 0x1F1B3F3F, 0x3F3F3F1F, 0x3F3B7F7F, 0x7F7F7F3F,
+	0x3C3A3C00, 0x003E3C3C, 0x18180000, 0x00001818, 0x00000000, 0x00000000, 0x03030000, 0x00000303,
+	0x070B0700, 0x000F0707, 0x0F1B1F0F, 0x001F0F0F, 0x1F3B3F3F, 0x3F3F1F1F, 0x3F7B7F7F, 0x7F7F3F3F,
+	0x3E3B3C00, 0x003C3C3C, 0x1D1B0000, 0x00181818, 0x0A0A0000, 0x00000000, 0x171B0000, 0x00030303,
+	0x2F3B0700, 0x00070707, 0x5F7B1F0F, 0x1F0F0F0F, 0xBFFB3F3F, 0x3F1F1F1F, 0x7FFB7F7F, 0x7F3F3F3F,
+	0x3F3A3C00, 0x3C3C3C3F, 0x1F180000, 0x1818181F, 0x1F000000, 0x0000111F, 0x1F030000, 0x0303031F,
+	0x3F0B0700, 0x0707073F, 0x7F1B1F0F, 0x0F0F0F7F, 0xFF3B3F3F, 0x1F1F1FFF, 0xFF7B7F7F, 0x3F3F3FFF,
+	0x3F3B3C00, 0x3C3C3F3F, 0x3F3B0000, 0x18383F3F, 0x3F3B0000, 0x00313F3F, 0x3F3B0000, 0x03233F3F,
+	0x3F3B0700, 0x07073F3F, 0x7F7B1F0F, 0x0F0F7F7F, 0xFFFB3F3F, 0x1F1FFFFF, 0xFFFB7F7F, 0x3F3FFFFF,
+	0xFFFBFCFC, 0xFFFFFFFF, 0xFFFBF8F8, 0xFFFFFFFF, 0xFFFBF1F1, 0xFFFFFFFF, 0xFFFBE3E3, 0xFFFFFFFF,
+	0xFFFBC7C7, 0xFFFFFFFF, 0xFFFB8F8F, 0xFFFFFFFF, 0xFFFB1F1F, 0xFFFFFFFF, 0xFFFB3F3F, 0xFFFFFFFF,
+	0x1F181C00, 0x0000001E, 0x0E080800, 0x00000000, 0x0E000000, 0x00000000, 0x0E020200, 0x00000000,
+	0x1F030700, 0x0000000F, 0x3F0B0F0F, 0x00001F1F, 0x7F1B1F0F, 0x001F3F3F, 0xFF3B3F3F, 0x3F3F7F7F,
+	0x1C181C00, 0x0000001E, 0x08080000, 0x00000000, 0x00000000, 0x00000000, 0x02020000, 0x00000000,
+	0x07030700, 0x0000000F, 0x0F0B0700, 0x00000F1F, 0x1F1B1F0F, 0x001F1F3F, 0x3F3B3F3F, 0x3F3F3F7F,
+	0x1C180000, 0x0000001C, 0x08000000, 0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000000,
+	0x07030000, 0x00000007, 0x0F0B0700, 0x00000F0F, 0x1F1B1F0F, 0x001F1F1F, 0x3F3B3F3F, 0x3F3F3F3F,
+	0x1C180000, 0x00001C1C, 0x08000000, 0x00000008, 0x00000000, 0x00000000, 0x02000000, 0x00000002,
+	0x07030000, 0x00000707, 0x0F0B0700, 0x00000F0F, 0x1F1B1F0F, 0x001F1F1F, 0x3F3B3F3F, 0x3F3F3F3F,
+	0x1D180000, 0x00001C1C, 0x0A000000, 0x00000808, 0x04000000, 0x00000000, 0x0A000000, 0x00000202,
+	0x17030000, 0x00000707, 0x2F0B0700, 0x000F0F0F, 0x5F1B1F0F, 0x001F1F1F, 0xBF3B3F3F, 0x3F3F3F3F,
+	0x1C180000, 0x001C1C1F, 0x08000000, 0x0008080E, 0x00000000, 0x0000000E, 0x02000000, 0x0002020E,
+	0x07030000, 0x0007071F, 0x0F0B0700, 0x000F0F3F, 0x1F1B1F0F, 0x1F1F1F7F, 0x3F3B3F3F, 0x3F3F3FFF,
+	0x1F180000, 0x1C1C1F1F, 0x1F000000, 0x08081F1F, 0x1F000000, 0x00001F1F, 0x1F000000, 0x02021F1F,
+	0x1F030000, 0x07071F1F, 0x3F0B0700, 0x0F0F3F3F, 0x7F1B1F0F, 0x1F1F7F7F, 0xFF3B3F3F, 0x3F3FFFFF,
+	0xFFF7FCFC, 0xFFFFFFFF, 0xFFF7F8F8, 0xFFFFFFFF, 0xFFF7F1F1, 0xFFFFFFFF, 0xFFF7E3E3, 0xFFFFFFFF,
+	0xFFF7C7C7, 0xFFFFFFFF, 0xFFF78F8F, 0xFFFFFFFF, 0xFFF71F1F, 0xFFFFFFFF, 0xFFF73F3F, 0xFFFFFFFF,
+	0xFFF4FCFC, 0xFFFFFFFF, 0xFFF0F8F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE3E3E3, 0xFFFFFFFF,
+	0xFFC7C7C7, 0xFFFFFFFF, 0xFF878F8F, 0xFFFFFFFF, 0xFF171F1F, 0xFFFFFFFF, 0xFF373F3F, 0xFFFFFFFF,
+	0xFCF4FCFC, 0x00FEFFFF, 0x7870787C, 0x00007E7E, 0x30303000, 0x0000003C, 0x00000000, 0x00000000,
+	0x06060600, 0x0000001E, 0x0F070F1F, 0x00003F3F, 0x1F171F1F, 0x003F7F7F, 0x3F373F7F, 0x7F7FFFFF,
+	0xFCF4FEFC, 0x00FEFEFC, 0x78707800, 0x00007C78, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x0F070F00, 0x00001F0F, 0x1F173F1F, 0x003F3F1F, 0x3F377F7F, 0x7F7F7F3F,
+	0xFCF6FEFC, 0x00FEFCFC, 0x78747800, 0x007C7878, 0x30300000, 0x00003030, 0x00000000, 0x00000000,
+	0x06060000, 0x00000606, 0x0F170F00, 0x001F0F0F, 0x1F373F1F, 0x003F1F1F, 0x3F777F7F, 0x7F7F3F3F,
+	0xFEF7FEFC, 0xFEFCFCFC, 0x7D777800, 0x00787878, 0x3A360000, 0x00303030, 0x14140000, 0x00000000,
+	0x2E360000, 0x00060606, 0x5F770F00, 0x000F0F0F, 0xBFF73F1F, 0x3F1F1F1F, 0x7FF77F7F, 0x7F3F3F3F,
+	0xFFF6FEFC, 0xFCFCFCFF, 0x7F747800, 0x7878787F, 0x3E300000, 0x3030303E, 0x3E000000, 0x0000223E,
+	0x3E060000, 0x0606063E, 0x7F170F00, 0x0F0F0F7F, 0xFF373F1F, 0x1F1F1FFF, 0xFF777F7F, 0x3F3F3FFF,
+	0xFFF7FEFC, 0xFCFCFFFF, 0x7F777800, 0x78787F7F, 0x7F770000, 0x30717F7F, 0x7F770000, 0x00637F7F,
+	0x7F770000, 0x06477F7F, 0x7F770F00, 0x0F0F7F7F, 0xFFF73F1F, 0x1F1FFFFF, 0xFFF77F7F, 0x3F3FFFFF,
+	0xFFF7FCFC, 0xFFFFFFFF, 0xFFF7F8F8, 0xFFFFFFFF, 0xFFF7F1F1, 0xFFFFFFFF, 0xFFF7E3E3, 0xFFFFFFFF,
+	0xFFF7C7C7, 0xFFFFFFFF, 0xFFF78F8F, 0xFFFFFFFF, 0xFFF71F1F, 0xFFFFFFFF, 0xFFF73F3F, 0xFFFFFFFF,
+	0x7F747C7C, 0x00007E7E, 0x3E303800, 0x0000003C, 0x1C101000, 0x00000000, 0x1C000000, 0x00000000,
+	0x1C040400, 0x00000000, 0x3E060E00, 0x0000001E, 0x7F171F1F, 0x00003F3F, 0xFF373F1F, 0x003F7F7F,
+	0x7C747800, 0x00007C7E, 0x38303800, 0x0000003C, 0x10100000, 0x00000000, 0x00000000, 0x00000000,
+	0x04040000, 0x00000000, 0x0E060E00, 0x0000001E, 0x1F170F00, 0x00001F3F, 0x3F373F1F, 0x003F3F7F,
+	0x7C747800, 0x00007C7C, 0x38300000, 0x00000038, 0x10000000, 0x00000000, 0x00000000, 0x00000000,
+	0x04000000, 0x00000000, 0x0E060000, 0x0000000E, 0x1F170F00, 0x00001F1F, 0x3F373F1F, 0x003F3F3F,
+	0x7C747800, 0x00007C7C, 0x38300000, 0x00003838, 0x10000000, 0x00000010, 0x00000000, 0x00000000,
+	0x04000000, 0x00000004, 0x0E060000, 0x00000E0E, 0x1F170F00, 0x00001F1F, 0x3F373F1F, 0x003F3F3F,
+	0x7D747800, 0x007C7C7C, 0x3A300000, 0x00003838, 0x14000000, 0x00001010, 0x08000000, 0x00000000,
+	0x14000000, 0x00000404, 0x2E060000, 0x00000E0E, 0x5F170F00, 0x001F1F1F, 0xBF373F1F, 0x003F3F3F,
+	0x7C747800, 0x007C7C7F, 0x38300000, 0x0038383E, 0x10000000, 0x0010101C, 0x00000000, 0x0000001C,
+	0x04000000, 0x0004041C, 0x0E060000, 0x000E0E3E, 0x1F170F00, 0x001F1F7F, 0x3F373F1F, 0x3F3F3FFF,
+	0x7F747800, 0x7C7C7F7F, 0x3E300000, 0x38383E3E, 0x3E000000, 0x10103E3E, 0x3E000000, 0x00003E3E,
+	0x3E000000, 0x04043E3E, 0x3E060000, 0x0E0E3E3E, 0x7F170F00, 0x1F1F7F7F, 0xFF373F1F, 0x3F3FFFFF,
+	0xFFFFFCFC, 0xFFFFFFFF, 0xFFFFF8F8, 0xFFFFFFFF, 0xFFFFF0F1, 0xFFFFFFFF, 0xFFFFE2E3, 0xFFFFFFFF,
+	0xFFFFC6C7, 0xFFFFFFFF, 0xFFFF8E8F, 0xFFFFFFFF, 0xFFFF1E1F, 0xFFFFFFFF, 0xFFFF3E3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0xFFF8F8F8, 0xFFFFFFFF, 0xFFF1F0F1, 0xFFFFFFFF, 0xFFE3E2E3, 0xFFFFFFFF,
+	0xFFC7C6C7, 0xFFFFFFFF, 0xFF8F8E8F, 0xFFFFFFFF, 0xFF1F1E1F, 0xFFFFFFFF, 0xFF3F3E3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x01000000, 0x00000F0F, 0x03030200, 0x00071F1F,
+	0x07070600, 0x0F0F3F3F, 0x0F0F0E00, 0x1F1F7F7F, 0x1F1F1EFF, 0xFFFFFFFF, 0x3F3F3EFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000200, 0x03030000, 0x00070703,
+	0x07070000, 0x0F0F0F07, 0x0F0F0000, 0x1F1F1F0F, 0x1F1FFEFF, 0xFFFFFF1F, 0x3F3FFEFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03000000, 0x00070303,
+	0x07000000, 0x0F0F0707, 0x0F000000, 0x1F1F0F0F, 0x1FFFFEFF, 0xFFFF1F1F, 0x3FFFFEFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00030303,
+	0x00000000, 0x0F070707, 0x1F000000, 0x1F0F0F0F, 0xFFFFFEFF, 0xFF1F1F1F, 0xFFFFFEFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030300,
+	0x00000000, 0x0707070F, 0x1F000000, 0x0F0F0F1F, 0xFFFFFEFF, 0x1F1F1FFF, 0xFFFFFEFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030700,
+	0x00000000, 0x07070F0F, 0x1F000000, 0x0F0F1F1F, 0xFFFFFEFF, 0x1F1FFFFF, 0xFFFFFEFF, 0x3F3FFFFF,
+	0x00030000, 0x00000000, 0x00030000, 0x00000000, 0xFFFFF0F1, 0xFFFFFFFF, 0xFFFFE2E3, 0xFFFFFFFF,
+	0xFFFFC6C7, 0xFFFFFFFF, 0xFFFF8E8F, 0xFFFFFFFF, 0xFFFF1E1F, 0xFFFFFFFF, 0xFFFF3E3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0F000000, 0x00000F0F, 0x0F020200, 0x00000F0F,
+	0x1F070600, 0x00071F1F, 0x3F0F0E00, 0x0F0F3F3F, 0x7F1F1E00, 0x1F1F7F7F, 0xFF3F3E3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000006, 0x02020000, 0x0000020E,
+	0x07070000, 0x0007071F, 0x0F0F0000, 0x0F0F0F3F, 0x1F1F0000, 0x1F1F1F7F, 0x3F3F3EFF, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02000000, 0x00000202,
+	0x07000000, 0x00070707, 0x0F000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0x3F3FFEFF, 0xFFFFFF3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000202,
+	0x00000000, 0x00070707, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0x3FFFFEFF, 0xFFFF3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000200,
+	0x00000000, 0x00070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFFFEFF, 0xFF3F3F3F,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00020000,
+	0x00000000, 0x00070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFFFEFF, 0x3F3F3FFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x02020000,
+	0x00000000, 0x07070700, 0x00000000, 0x0F0F0F0F, 0x1F000000, 0x1F1F1F1F, 0xFFFFFEFF, 0x3F3FFFFF,
+	0xFFFFFCFC, 0xFFFFFFFF, 0xFFFFF8F8, 0xFFFFFFFF, 0xFFFFF1F1, 0xFFFFFFFF, 0xFFFFE1E3, 0xFFFFFFFF,
+	0xFFFFC5C7, 0xFFFFFFFF, 0xFFFF8D8F, 0xFFFFFFFF, 0xFFFF1D1F, 0xFFFFFFFF, 0xFFFF3D3F, 0xFFFFFFFF,
+	0xFFFCFCFC, 0xFFFFFFFF, 0x00000000, 0x00000000, 0xFFF1F1F1, 0xFFFFFFFF, 0xFFE3E1E3, 0xFFFFFFFF,
+	0xFFC7C5C7, 0xFFFFFFFF, 0xFF8F8D8F, 0xFFFFFFFF, 0xFF1F1D1F, 0xFFFFFFFF, 0xFF3F3D3F, 0xFFFFFFFF,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x03030103, 0x00001F1F,
+	0x0707050F, 0x000F3F3F, 0x0F0F0D1F, 0x1F1F7F7F, 0x1F1F1D3F, 0x3F3FFFFF, 0x3F3F3DFF, 0xFFFFFFFF,
+	0x0C0C0C00, 0x0000000C, 0x00000000, 0x00000000, 0x01010100, 0x00000001, 0x03030503, 0x00000703,
+	0x07070D0F, 0x000F0F07, 0x0F0F1D1F, 0x1F1F1F0F, 0x1F1F3D3F, 0x3F3F3F1F, 0x3F3FFDFF, 0xFFFFFF3F,
+	0x0C0E0D00, 0x00000C0C, 0x00050500, 0x00000000, 0x010B0D00, 0x00000101, 0x03171D03, 0x00000303,
+	0x072F3D0F, 0x000F0707, 0x0F5F7D1F, 0x1F1F0F0F, 0x1FBFFD3F, 0x3F3F1F1F, 0x3FFFFDFF, 0xFFFF3F3F,
+	0x0F0F0C00, 0x000C0C0C, 0x0F0F0000, 0x00000008, 0x0F0F0100, 0x00010101, 0x1F1F0503, 0x00030303,
+	0x3F3F0D0F, 0x00070707, 0x7F7F1D1F, 0x1F0F0F0F, 0xFFFF3D3F, 0x3F1F1F1F, 0xFFFFFDFF, 0xFF3F3F3F,
+	0x1F1F1D00, 0x0C0C1C1F, 0x1F1F1D00, 0x0000181F, 0x1F1F1D00, 0x0101111F, 0x1F1F1D03, 0x0303031F,
+	0x3F3F3D0F, 0x0707073F, 0x7F7F7D1F, 0x0F0F0F7F, 0xFFFFFD3F, 0x1F1F1FFF, 0xFFFFFDFF, 0x3F3F3FFF,
+	0x3F3F3D3F, 0x0C3C3F3F, 0x3F3F3D3F, 0x00383F3F, 0x3F3F3D3F, 0x01313F3F, 0x3F3F3D3F, 0x03233F3F,
+	0x3F3F3D3F, 0x07073F3F, 0x7F7F7D7F, 0x0F0F7F7F, 0xFFFFFDFF, 0x1F1FFFFF, 0xFFFFFDFF, 0x3F3FFFFF,
+	0x00070404, 0x00000000, 0x00070000, 0x00000000, 0x00070101, 0x00000000, 0xFFFFE1E3, 0xFFFFFFFF,
+	0xFFFFC5C7, 0xFFFFFFFF, 0xFFFF8D8F, 0xFFFFFFFF, 0xFFFF1D1F, 0xFFFFFFFF, 0xFFFF3D3F, 0xFFFFFFFF,
+	0x00040400, 0x00000000, 0x00000000, 0x00000000, 0x00010100, 0x00000000, 0x1F030103, 0x00001F1F,
+	0x1F070503, 0x00001F1F, 0x3F0F0D0F, 0x000F3F3F, 0x7F1F1D1F, 0x1F1F7F7F, 0xFF3F3D3F, 0x3F3FFFFF,
+	0x00040000, 0x00000000, 0x00000000, 0x00000000, 0x00010000, 0x00000000, 0x03030100, 0x0000000F,
+	0x07070503, 0x0000071F, 0x0F0F0D0F, 0x000F0F3F, 0x1F1F1D1F, 0x1F1F1F7F, 0x3F3F3D3F, 0x3F3F3FFF,
+	0x04040000, 0x00000000, 0x00000000, 0x00000000, 0x01010000, 0x00000000, 0x03030100, 0x00000003,
+	0x07070503, 0x00000707, 0x0F0F0D0F, 0x000F0F0F, 0x1F1F1D1F, 0x1F1F1F1F, 0x3F3F3D3F, 0x3F3F3F3F,
+	0x04050000, 0x00000004, 0x00020000, 0x00000000, 0x01050000, 0x00000001, 0x030B0100, 0x00000003,
+	0x07170503, 0x00000707, 0x0F2F0D0F, 0x000F0F0F, 0x1F5F1D1F, 0x1F1F1F1F, 0x3FBF3D3F, 0x3F3F3F3F,
+	0x07040000, 0x00000404, 0x07000000, 0x00000000, 0x07010000, 0x00000101, 0x0F030100, 0x00000303,
+	0x1F070503, 0x00000707, 0x3F0F0D0F, 0x000F0F0F, 0x7F1F1D1F, 0x1F1F1F1F, 0xFFBF3D3F, 0x3F3F3F3F,
+	0x0F0F0000, 0x0004040F, 0x0F0F0000, 0x0000000F, 0x0F0F0000, 0x0001010F, 0x0F0F0100, 0x0003030F,
+	0x1F1F0503, 0x0007071F, 0x3F3F0D0F, 0x000F0F3F, 0x7F7F1D1F, 0x1F1F1F7F, 0xFFFF3D3F, 0x3F3F3FFF,
+	0x1F1F1D00, 0x04041F1F, 0x1F1F1D00, 0x00001F1F, 0x1F1F1D00, 0x01011F1F, 0x1F1F1D00, 0x03031F1F,
+	0x1F1F1D03, 0x07071F1F, 0x3F3F3D0F, 0x0F0F3F3F, 0x7F7F7D1F, 0x1F1F7F7F, 0xFFFFFD3F, 0x3F3FFFFF,
+	0xFFFFF8FC, 0xFFFFFFFF, 0xFFFFF8F8, 0xFFFFFFFF, 0xFFFFF1F1, 0xFFFFFFFF, 0xFFFFE3E3, 0xFFFFFFFF,
+	0xFFFFC3C7, 0xFFFFFFFF, 0xFFFF8B8F, 0xFFFFFFFF, 0xFFFF1B1F, 0xFFFFFFFF, 0xFFFF3B3F, 0xFFFFFFFF,
+	0xFFFCF8FC, 0xFFFFFFFF, 0xFFF8F8F8, 0xFFFFFFFF, 0x00000000, 0x00000000, 0xFFE3E3E3, 0xFFFFFFFF,
+	0xFFC7C3C7, 0xFFFFFFFF, 0xFF8F8B8F, 0xFFFFFFFF, 0xFF1F1B1F, 0xFFFFFFFF, 0xFF3F3B3F, 0xFFFFFFFF,
+	0x3C3C383C, 0x00003F3F, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x07070307, 0x00003F3F, 0x0F0F0B1F, 0x001F7F7F, 0x1F1F1B3F, 0x3F3FFFFF, 0x3F3F3B7F, 0x7F7FFFFF,
+	0x3C3C3A3C, 0x00003E3C, 0x18181800, 0x00000018, 0x00000000, 0x00000000, 0x03030300, 0x00000003,
+	0x07070B07, 0x00000F07, 0x0F0F1B1F, 0x001F1F0F, 0x1F1F3B3F, 0x3F3F3F1F, 0x3F3F7B7F, 0x7F7F7F3F,
+	0x3C3E3B3C, 0x00003C3C, 0x181D1B00, 0x00001818, 0x000A0A00, 0x00000000, 0x03171B00, 0x00000303,
+	0x072F3B07, 0x00000707, 0x0F5F7B1F, 0x001F0F0F, 0x1FBFFB3F, 0x3F3F1F1F, 0x3F7FFB7F, 0x7F7F3F3F,
+	0x3F3F3A3C, 0x003C3C3C, 0x1F1F1800, 0x00181818, 0x1F1F0000, 0x00000011, 0x1F1F0300, 0x00030303,
+	0x3F3F0B07, 0x00070707, 0x7F7F1B1F, 0x000F0F0F, 0xFFFF3B3F, 0x3F1F1F1F, 0xFFFF7B7F, 0x7F3F3F3F,
+	0x3F3F3B3C, 0x3C3C3C3F, 0x3F3F3B00, 0x1818383F, 0x3F3F3B00, 0x0000313F, 0x3F3F3B00, 0x0303233F,
+	0x3F3F3B07, 0x0707073F, 0x7F7F7B1F, 0x0F0F0F7F, 0xFFFFFB3F, 0x1F1F1FFF, 0xFFFFFB7F, 0x3F3F3FFF,
+	0x7F7F7B7F, 0x3C7C7F7F, 0x7F7F7B7F, 0x18787F7F, 0x7F7F7B7F, 0x00717F7F, 0x7F7F7B7F, 0x03637F7F,
+	0x7F7F7B7F, 0x07477F7F, 0x7F7F7B7F, 0x0F0F7F7F, 0xFFFFFBFF, 0x1F1FFFFF, 0xFFFFFBFF, 0x3F3FFFFF,
+	0xFFFFF8FC, 0xFFFFFFFF, 0x000E0808, 0x00000000, 0x000E0000, 0x00000000, 0x000E0202, 0x00000000,
+	0xFFFFC3C7, 0xFFFFFFFF, 0xFFFF8B8F, 0xFFFFFFFF, 0xFFFF1B1F, 0xFFFFFFFF, 0xFFFF3B3F, 0xFFFFFFFF,
+	0x3F3C383C, 0x00003F3F, 0x00080800, 0x00000000, 0x00000000, 0x00000000, 0x00020200, 0x00000000,
+	0x3F070307, 0x00003F3F, 0x3F0F0B07, 0x00003F3F, 0x7F1F1B1F, 0x001F7F7F, 0xFF3F3B3F, 0x3F3FFFFF,
+	0x1C1C1800, 0x0000001F, 0x00080000, 0x00000000, 0x00000000, 0x00000000, 0x00020000, 0x00000000,
+	0x07070300, 0x0000001F, 0x0F0F0B07, 0x00000F3F, 0x1F1F1B1F, 0x001F1F7F, 0x3F3F3B3F, 0x3F3F3FFF,
+	0x1C1C1800, 0x0000001C, 0x08080000, 0x00000000, 0x00000000, 0x00000000, 0x02020000, 0x00000000,
+	0x07070300, 0x00000007, 0x0F0F0B07, 0x00000F0F, 0x1F1F1B1F, 0x001F1F1F, 0x3F3F3B3F, 0x3F3F3F3F,
+	0x1C1D1800, 0x0000001C, 0x080A0000, 0x00000008, 0x00040000, 0x00000000, 0x020A0000, 0x00000002,
+	0x07170300, 0x00000007, 0x0F2F0B07, 0x00000F0F, 0x1F5F1B1F, 0x001F1F1F, 0x3FBF3B3F, 0x3F3F3F3F,
+	0x1F1C1800, 0x00001C1C, 0x0E080000, 0x00000808, 0x0E000000, 0x00000000, 0x0E020000, 0x00000202,
+	0x1F070300, 0x00000707, 0x3F0F0B07, 0x00000F0F, 0x7F1F1B1F, 0x001F1F1F, 0xFF3F3B3F, 0x3F3F3F3F,
+	0x1F1F1800, 0x001C1C1F, 0x1F1F0000, 0x0008081F, 0x1F1F0000, 0x0000001F, 0x1F1F0000, 0x0002021F,
+	0x1F1F0300, 0x0007071F, 0x3F3F0B07, 0x000F0F3F, 0x7F7F1B1F, 0x001F1F7F, 0xFFFF3B3F, 0x3F3F3FFF,
+	0x3F3F3B00, 0x1C1C3F3F, 0x3F3F3B00, 0x08083F3F, 0x3F3F3B00, 0x00003F3F, 0x3F3F3B00, 0x02023F3F,
+	0x3F3F3B00, 0x07073F3F, 0x3F3F3B07, 0x0F0F3F3F, 0x7F7F7B1F, 0x1F1F7F7F, 0xFFFFFB3F, 0x3F3FFFFF,
+	0xFFFFF4FC, 0xFFFFFFFF, 0xFFFFF0F8, 0xFFFFFFFF, 0xFFFFF1F1, 0xFFFFFFFF, 0xFFFFE3E3, 0xFFFFFFFF,
+	0xFFFFC7C7, 0xFFFFFFFF, 0xFFFF878F, 0xFFFFFFFF, 0xFFFF171F, 0xFFFFFFFF, 0xFFFF373F, 0xFFFFFFFF,
+	0xFFFCF4FC, 0xFFFFFFFF, 0xFFF8F0F8, 0xFFFFFFFF, 0xFFF1F1F1, 0xFFFFFFFF, 0x00000000, 0x00000000,
+	0xFFC7C7C7, 0xFFFFFFFF, 0xFF8F878F, 0xFFFFFFFF, 0xFF1F171F, 0xFFFFFFFF, 0xFF3F373F, 0xFFFFFFFF,
+	0xFCFCF4FE, 0x00FEFFFF, 0x78787078, 0x00007F7F, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x0F0F070F, 0x00007F7F, 0x1F1F173F, 0x003FFFFF, 0x3F3F377F, 0x7F7FFFFF,
+	0xFCFCF6FE, 0x00FEFEFC, 0x78787478, 0x00007C78, 0x30303000, 0x00000030, 0x00000000, 0x00000000,
+	0x06060600, 0x00000006, 0x0F0F170F, 0x00001F0F, 0x1F1F373F, 0x003F3F1F, 0x3F3F777F, 0x7F7F7F3F,
+	0xFCFEF7FE, 0x00FEFCFC, 0x787D7778, 0x00007878, 0x303A3600, 0x00003030, 0x00141400, 0x00000000,
+	0x062E3600, 0x00000606, 0x0F5F770F, 0x00000F0F, 0x1FBFF73F, 0x003F1F1F, 0x3F7FF77F, 0x7F7F3F3F,
+	0xFFFFF6FE, 0x00FCFCFC, 0x7F7F7478, 0x00787878, 0x3E3E3000, 0x00303030, 0x3E3E0000, 0x00000022,
+	0x3E3E0600, 0x00060606, 0x7F7F170F, 0x000F0F0F, 0xFFFF373F, 0x001F1F1F, 0xFFFF777F, 0x7F3F3F3F,
+	0xFFFFF7FE, 0xFCFCFCFF, 0x7F7F7778, 0x7878787F, 0x7F7F7700, 0x3030717F, 0x7F7F7700, 0x0000637F,
+	0x7F7F7700, 0x0606477F, 0x7F7F770F, 0x0F0F0F7F, 0xFFFFF73F, 0x1F1F1FFF, 0xFFFFF77F, 0x3F3F3FFF,
+	0xFFFFF7FF, 0xFCFCFFFF, 0xFFFFF7FF, 0x78F8FFFF, 0xFFFFF7FF, 0x30F1FFFF, 0xFFFFF7FF, 0x00E3FFFF,
+	0xFFFFF7FF, 0x06C7FFFF, 0xFFFFF7FF, 0x0F8FFFFF, 0xFFFFF7FF, 0x1F1FFFFF, 0xFFFFF7FF, 0x3F3FFFFF,
+	0xFFFFF4FC, 0xFFFFFFFF, 0xFFFFF0F8, 0xFFFFFFFF, 0x001C1010, 0x00000000, 0x001C0000, 0x00000000,
+	0x001C0404, 0x00000000, 0xFFFF878F, 0xFFFFFFFF, 0xFFFF171F, 0xFFFFFFFF, 0xFFFF373F, 0xFFFFFFFF,
+	0x7F7C7478, 0x00007F7F, 0x7F787078, 0x00007F7F, 0x00101000, 0x00000000, 0x00000000, 0x00000000,
+	0x00040400, 0x00000000, 0x7F0F070F, 0x00007F7F, 0x7F1F170F, 0x00007F7F, 0xFF3F373F, 0x003FFFFF,
+	0x7C7C7478, 0x00007C7F, 0x38383000, 0x0000003E, 0x00100000, 0x00000000, 0x00000000, 0x00000000,
+	0x00040000, 0x00000000, 0x0E0E0600, 0x0000003E, 0x1F1F170F, 0x00001F7F, 0x3F3F373F, 0x003F3FFF,
+	0x7C7C7478, 0x00007C7C, 0x38383000, 0x00000038, 0x10100000, 0x00000000, 0x00000000, 0x00000000,
+	0x04040000, 0x00000000, 0x0E0E0600, 0x0000000E, 0x1F1F170F, 0x00001F1F, 0x3F3F373F, 0x003F3F3F,
+	0x7C7D7478, 0x00007C7C, 0x383A3000, 0x00000038, 0x10140000, 0x00000010, 0x00080000, 0x00000000,
+	0x04140000, 0x00000004, 0x0E2E0600, 0x0000000E, 0x1F5F170F, 0x00001F1F, 0x3FBF373F, 0x003F3F3F,
+	0x7F7C7478, 0x00007C7C, 0x3E383000, 0x00003838, 0x1C100000, 0x00001010, 0x1C000000, 0x00000000,
+	0x1C040000, 0x00000404, 0x3E0E0600, 0x00000E0E, 0x7F1F170F, 0x00001F1F, 0xFF3F373F, 0x003F3F3F,
+	0x7F7F7478, 0x007C7C7F, 0x3E3E3000, 0x0038383E, 0x3E3E0000, 0x0010103E, 0x3E3E0000, 0x0000003E,
+	0x3E3E0000, 0x0004043E, 0x3E3E0600, 0x000E0E3E, 0x7F7F170F, 0x001F1F7F, 0xFFFF373F, 0x003F3FFF,
+	0x7F7F7778, 0x7C7C7F7F, 0x7F7F7700, 0x38387F7F, 0x7F7F7700, 0x10107F7F, 0x7F7F7700, 0x00007F7F,
+	0x7F7F7700, 0x04047F7F, 0x7F7F7700, 0x0E0E7F7F, 0x7F7F770F, 0x1F1F7F7F, 0xFFFFF73F, 0x3F3FFFFF
+};
@@ -0,0 +1,165 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+// writes the KPK bitbase as a C header
+//
+// usage: kpkgen [file]     (default kpkdata.h)
+//
+// every position starts out invalid, won (the pawn promotes safely), drawn (stalemate
+// or the pawn falls) or unknown. Unknown positions are then classified from their
+// successors until nothing changes: white wins if any move wins, black draws if any
+// move draws. Whatever is still unknown at the end is a draw.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "kpk.h"
+
+#define WORDS_PER_LINE	8
+
+enum kpkResults{
+	RESULT_INVALID = 0,
+	RESULT_UNKNOWN = 1,
+	RESULT_DRAW = 2,
+	RESULT_WIN = 4
+};
+
+struct KPKPosition{
+	int side;
+	int ksq[2];
+	int psq;
+	int result;
+};
+
+static int distance(int a, int b)
+{
+	int df = abs(fileOf(a) - fileOf(b)), dr = abs(rankOf(a) - rankOf(b));
+	return (df > dr) ? df : dr;
+}
+
+static void initPosition(KPKPosition& p, unsigned int idx)
+{
+	p.ksq[SIDE_WHITE] = idx & 0x3F;
+	p.ksq[SIDE_BLACK] = (idx >> 6) & 0x3F;
+	p.side = (idx >> 12) & 1;
+	p.psq = makeSquare((idx >> 13) & 3, 6 - ((idx >> 15) & 7));
+
+	int wk = p.ksq[SIDE_WHITE], bk = p.ksq[SIDE_BLACK], push = p.psq + 8;
+
+	// overlapping pieces, or a king that could be taken
+	if(distance(wk, bk) <= 1 || wk == p.psq || bk == p.psq
+		|| (p.side == SIDE_WHITE && (g_pawnAttacks[SIDE_WHITE][p.psq] & squareBB(bk))))
+		p.result = RESULT_INVALID;
+
+	// the pawn promotes and the new queen can't be taken
+	else if(p.side == SIDE_WHITE && rankOf(p.psq) == 6 && wk != push
+		&& (distance(bk, push) > 1 || distance(wk, push) == 1))
+		p.result = RESULT_WIN;
+
+	// stalemate, or the black king takes the pawn
+	else if(p.side == SIDE_BLACK
+		&& (!(g_kingAttacks[bk] & ~(g_kingAttacks[wk] | g_pawnAttacks[SIDE_WHITE][p.psq]))
+		|| (g_kingAttacks[bk] & ~g_kingAttacks[wk] & squareBB(p.psq))))
+		p.result = RESULT_DRAW;
+
+	else
+		p.result = RESULT_UNKNOWN;
+}
+
+static int classify(KPKPosition& p, const std::vector<KPKPosition>& db)
+{
+	int good = (p.side == SIDE_WHITE) ? RESULT_WIN : RESULT_DRAW;
+	int bad = (p.side == SIDE_WHITE) ? RESULT_DRAW : RESULT_WIN;
+	int r = RESULT_INVALID;
+
+	for(U64 b = g_kingAttacks[p.ksq[p.side]]; b;){
+		int to = popLsb(b);
+
+		r |= (p.side == SIDE_WHITE) ? db[kpkIndex(SIDE_BLACK, p.ksq[SIDE_BLACK], to, p.psq)].result
+			: db[kpkIndex(SIDE_WHITE, to, p.ksq[SIDE_WHITE], p.psq)].result;
+	}
+
+	if(p.side == SIDE_WHITE){
+		int push = p.psq + 8;
+
+		// a push onto a king lands on an invalid entry, which adds nothing
+		if(rankOf(p.psq) < 6)
+			r |= db[kpkIndex(SIDE_BLACK, p.ksq[SIDE_BLACK], p.ksq[SIDE_WHITE], push)].result;
+
+		if(rankOf(p.psq) == 1 && push != p.ksq[SIDE_WHITE] && push != p.ksq[SIDE_BLACK])
+			r |= db[kpkIndex(SIDE_BLACK, p.ksq[SIDE_BLACK], p.ksq[SIDE_WHITE], push + 8)].result;
+	}
+
+	return p.result = (r & good) ? good : (r & RESULT_UNKNOWN) ? RESULT_UNKNOWN : bad;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* file = (argc > 1) ? argv[1] : "kpkdata.h";
+	std::vector<KPKPosition> db(KPK_SIZE);
+	std::vector<unsigned int> bits(KPK_SIZE / 32, 0);
+	bool changed = true;
+	int wins = 0;
+	FILE* fp;
+
+	initBitboards();
+
+	for(unsigned int idx=0; idx<KPK_SIZE; ++idx)
+		initPosition(db[idx], idx);
+
+	while(changed){
+		changed = false;
+
+		for(unsigned int idx=0; idx<KPK_SIZE; ++idx)
+			if(db[idx].result == RESULT_UNKNOWN && classify(db[idx], db) != RESULT_UNKNOWN)
+				changed = true;
+	}
+
+	for(unsigned int idx=0; idx<KPK_SIZE; ++idx){
+		if(db[idx].result == RESULT_WIN){
+			bits[idx >> 5] |= 1u << (idx & 31);
+			++wins;
+		}
+	}
+
+	fp = fopen(file, "w");
+	if(fp == NULL){
+		printf("Can't write %s\n", file);
+		return 1;
+	}
+
+	fprintf(fp, "// KPK bitbase, generated by kpkgen. Do not edit.\n\n");
+	fprintf(fp, "static const unsigned int s_kpkBitbase[KPK_SIZE / 32] = {\n");
+
+	for(size_t i=0; i<bits.size(); ++i){
+		if(i % WORDS_PER_LINE == 0)
+			fprintf(fp, "\t");
+
+		fprintf(fp, "0x%08X%s", bits[i], (i + 1 == bits.size()) ? "" : ",");
+		fprintf(fp, ((i + 1) % WORDS_PER_LINE == 0 || i + 1 == bits.size()) ? "\n" : " ");
+	}
+
+	fprintf(fp, "};\n");
+	fclose(fp);
+
+	printf("%d of %d positions won, wrote %s\n", wins, KPK_SIZE, file);
+	return 0;
+}
@@ -58,6 +58,10 @@
 #include "arcane_lib.h"
 #include "GL_ARB_multitexture.h"
 #include "resource.h"
+#include "analysis.h"
+#include "mate.h"
+#include "hint.h"
+#include "speculation.h"
 
 //==========================================================================//
 // Constants
@@ -83,6 +87,7 @@ bool			g_hasFocus;
 bool			g_fullscreen;
 bool			g_enterKey;
 bool			g_displayPieceInfo = true;
+bool			g_showHint;
 bool			g_sphereMap;
 float			g_elapsedTimeSec;
 unsigned		g_numBoards = 25;		// for main menu particles
@@ -134,6 +139,7 @@ void RenderPlanet(void);
 void RenderText(GLFont& font, std::ostringstream& o, int x, int y, float color[3]);
 void RenderPieceInfoText(void);
 void RenderText(void);
+void RenderAnalysisText(void);
 void DisplayArbitraryText(const char* str, DWORD time);
 void UpdateFrame(void);
 void UpdateCam(float elapsedTimeSec);
@@ -337,6 +343,9 @@ void RenderFrame(void)
 
 	RenderText();
 
+	if(Analysis::inst().isRunning())
+		RenderAnalysisText();
+
 	if(g_displayPieceInfo){
 		RenderPieceInfoText();
 		g_pieceInfo.render();
@@ -1299,6 +1308,31 @@ void RenderText(void)
 			f = 0.0f;
 	}
 
+	// the mate finder proves forced mates for the side to move in the background
+	if(MateFinder::inst().isRunning()){
+		char move[8];
+		char pos[AI_POS_SIZE];
+		int mateIn, side;
+
+		AI::inst().getPos(pos, sizeof(pos));
+		MateFinder::inst().setPosition(pos);
+		if(MateFinder::inst().getMate(move, mateIn, side))
+			o << std::endl << std::endl << ((side == SIDE_WHITE) ? "White" : "Black") << " mates in " << mateIn << " (" << move << ")";
+	}
+
+	// the hint search follows the game on the player's turn and rests on the opponent's
+	if(Hint::inst().isRunning()){
+		char move[8];
+		int depth;
+		bool playerTurn = (game.getTurn() == game.getPlayerColor());
+		char pos[AI_POS_SIZE];
+
+		AI::inst().getPos(pos, sizeof(pos));
+		Hint::inst().setPosition(playerTurn ? pos : NULL);
+		if(g_showHint && playerTurn && Hint::inst().getHint(move, depth))
+			o << std::endl << std::endl << "Hint: " << move << " (depth " << depth << ")";
+	}
+
 	// draw the font
 	g_font.begin();
 	g_font.setColor(1.0f, 1.0f, 1.0f);
@@ -1306,6 +1340,57 @@ void RenderText(void)
 	g_font.end();
 }
 
+static void FormatScore(int score, char* buf)
+{
+	if(score >= VALUE_MATE_IN_MAX)
+		sprintf(buf, "#%d", (VALUE_MATE - score + 1) / 2);
+	else if(score <= -VALUE_MATE_IN_MAX)
+		sprintf(buf, "#-%d", (VALUE_MATE + score) / 2);
+	else
+		sprintf(buf, "%+.2f", score / 100.0f);
+}
+
+// best lines of the analysis thread below the clocks. They're polled once a
+// frame, and a frame that finds the search publishing keeps the last lines.
+void RenderAnalysisText(void)
+{
+	static AnalysisLine lines[MAX_MULTIPV];
+	static int numLines = 0;
+	static AnalysisLine engineLine;
+	static bool hasEngineLine = false;
+	Analysis& analysis = Analysis::inst();
+	std::ostringstream o;
+	char score[16];
+	char buf[ANALYSIS_TEXT + 32];
+	char pos[AI_POS_SIZE];
+
+	AI::inst().getPos(pos, sizeof(pos));
+	analysis.setPosition(pos);
+	analysis.getLines(lines, numLines);
+
+	if(AI::inst().getEngine() != AI::ENGINE_BUILTIN && analysis.getEngineLine(engineLine))
+		hasEngineLine = true;
+
+	o << "Analysis" << std::endl;
+	for(int i=0; i<numLines; ++i){
+		FormatScore(lines[i].score, score);
+		sprintf(buf, "%d. %s (%d) %s", i + 1, score, lines[i].depth, lines[i].pv);
+		o << buf << std::endl;
+	}
+
+	// what the opponent engine is thinking, from its info lines
+	if(hasEngineLine){
+		FormatScore(engineLine.score, score);
+		sprintf(buf, "Engine: %s (%d) %s", score, engineLine.depth, engineLine.pv);
+		o << std::endl << buf << std::endl;
+	}
+
+	g_font.begin();
+	g_font.setColor(0.8f, 0.9f, 1.0f);
+	g_font.drawText(5, 1 + g_font.getCellHeight() * 7, o.str().c_str());
+	g_font.end();
+}
+
 void UpdateFrame(void)
 {
 	g_elapsedTimeSec = GetElapsedTimeInSeconds();
@@ -1660,6 +1745,21 @@ void ProcessUserInput(void)
 		g_displayPieceInfo = !g_displayPieceInfo;
 	}
 
+	// hint for the player's move, the search is usually well along by now
+	if(keyboard.keyPressed(Keyboard::KEY_H)){
+		g_showHint = !g_showHint;
+		if(g_showHint && !Hint::inst().isRunning())
+			Hint::inst().start();
+	}
+
+	// analysis panel
+	if(keyboard.keyPressed(Keyboard::KEY_N)){
+		if(Analysis::inst().isRunning())
+			Analysis::inst().stop();
+		else
+			Analysis::inst().start();
+	}
+
 	// quick save
 	if(keyboard.keyPressed(Keyboard::KEY_F5)){
 		if(game.quickSave()){
@@ -1764,6 +1864,11 @@ void SwitchFullscreen(void)
 
 void Cleanup(void)
 {
+	Analysis::inst().stop();
+	MateFinder::inst().stop();
+	Hint::inst().stop();
+	Speculation::inst().stop();
+
 	if(g_hDC){
 		if(g_hRC){
 			wglMakeCurrent(g_hDC, 0);
@@ -1939,6 +2044,7 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR lpCmdLine, int nS
 		game.setPlanet(g_config->parseValue("planet"));
 		game.setTextureMode(g_config->parseValue("texture"));
 		game.setTime(g_config->parseValue("time"));
+		game.setIncrement(g_config->parseValue("increment"));
 		graphics.setGeometryQuality(g_config->parseValue("geometry"));
 		
 		if(g_config->parseValue("music"))
@@ -1947,6 +2053,32 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR lpCmdLine, int nS
 		AI::inst().setEngine(g_config->parseValue("ai_engine"));
 		AI::inst().setCustomEngine(g_config->parseValue("ai_custom_engine"));
 		game.setAILevel(g_config->parseValue("ai"));
+		AI::inst().setPonder(g_config->parseValue("ponder", 1) != 0);
+		AI::inst().setRandomize(g_config->parseValue("randomize", 1) != 0);
+
+		// files from before the analysis panel have no line count
+		if(g_config->parseValue("multipv") > 0)
+			Analysis::inst().setNumLines(g_config->parseValue("multipv"));
+		if(g_config->parseValue("analysis"))
+			Analysis::inst().start();
+		if(g_config->parseValue("mate_search") > 0)
+			MateFinder::inst().start(g_config->parseValue("mate_search"));
+		if(g_config->parseValue("hints", 1))
+			Hint::inst().start();
+		if(g_config->parseValue("speculate", 50) > 0)
+			Speculation::inst().start(g_config->parseValue("speculate", 50));
+
+		char* book = g_config->parseStrValue("book");
+		if(book != NULL)
+			AI::inst().setBookPath(book);
+
+		char* tbPath = g_config->parseStrValue("tb_path");
+		if(tbPath != NULL)
+			Syzygy::inst().setPath(tbPath);
+
+		char* statsFile = g_config->parseStrValue("stats_csv");
+		if(statsFile != NULL)
+			AI::inst().setStatsFile(statsFile);
 
 		graphics.setAntialiasing(g_config->parseValue("AA"));
 		graphics.setReflection(g_config->parseValue("reflections"));
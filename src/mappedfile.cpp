@@ -0,0 +1,191 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#if !defined(_WIN32)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_writable = false;
+
+#if defined(_WIN32)
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char* file)
+{
+	close();
+
+#if defined(_WIN32)
+	LARGE_INTEGER size;
+
+	m_hFile = CreateFile(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	if(!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0){
+		close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_hMapping == NULL){
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if(m_data == NULL){
+		close();
+		return false;
+	}
+
+	m_size = (size_t)size.QuadPart;
+#else
+	struct stat st;
+	int fd = ::open(file, O_RDONLY);
+
+	if(fd < 0)
+		return false;
+
+	if(fstat(fd, &st) != 0 || st.st_size == 0){
+		::close(fd);
+		return false;
+	}
+
+	void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if(p == MAP_FAILED)
+		return false;
+
+	m_data = (const unsigned char*)p;
+	m_size = (size_t)st.st_size;
+#endif
+
+	return true;
+}
+
+bool MappedFile::openWritable(const char* file, size_t size)
+{
+	close();
+
+#if defined(_WIN32)
+	LARGE_INTEGER li;
+
+	m_hFile = CreateFile(file, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// the mapping grows the file, a bigger old file is cut down first
+	li.QuadPart = (LONGLONG)size;
+	if(!SetFilePointerEx(m_hFile, li, NULL, FILE_BEGIN) || !SetEndOfFile(m_hFile)){
+		close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+	if(m_hMapping == NULL){
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, 0);
+	if(m_data == NULL){
+		close();
+		return false;
+	}
+#else
+	struct stat st;
+	int fd = ::open(file, O_RDWR | O_CREAT, 0644);
+
+	if(fd < 0)
+		return false;
+
+	if(fstat(fd, &st) != 0 || ((size_t)st.st_size != size && ftruncate(fd, (off_t)size) != 0)){
+		::close(fd);
+		return false;
+	}
+
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if(p == MAP_FAILED)
+		return false;
+
+	m_data = (const unsigned char*)p;
+#endif
+
+	m_size = size;
+	m_writable = true;
+	return true;
+}
+
+void MappedFile::flush(void)
+{
+	if(!m_data || !m_writable)
+		return;
+
+#if defined(_WIN32)
+	FlushViewOfFile(m_data, 0);
+	FlushFileBuffers(m_hFile);
+#else
+	msync((void*)m_data, m_size, MS_SYNC);
+#endif
+}
+
+void MappedFile::close(void)
+{
+	flush();
+
+#if defined(_WIN32)
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_hMapping)
+		CloseHandle(m_hMapping);
+	if(m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if(m_data)
+		munmap((void*)m_data, m_size);
+#endif
+
+	m_data = NULL;
+	m_size = 0;
+	m_writable = false;
+}
@@ -0,0 +1,79 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#endif
+
+#include <cstddef>
+
+// view of a whole file, pages are loaded by the OS on first touch. Writable
+// mappings are written back to the file by flush() and close().
+class MappedFile{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char* file);
+	bool openWritable(const char* file, size_t size);		// created or resized to size
+	void flush(void);
+	void close(void);
+
+	// getter functions
+	bool isOpen(void) const;
+	const unsigned char* getData(void) const;
+	unsigned char* getWritableData(void) const;			// NULL for a read-only mapping
+	size_t getSize(void) const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* m_data;
+	size_t m_size;
+	bool m_writable;
+
+#if defined(_WIN32)
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+};
+
+inline bool MappedFile::isOpen(void) const
+{
+	return m_data != NULL;
+}
+
+inline const unsigned char* MappedFile::getData(void) const
+{
+	return m_data;
+}
+
+inline unsigned char* MappedFile::getWritableData(void) const
+{
+	return m_writable ? (unsigned char*)m_data : NULL;
+}
+
+inline size_t MappedFile::getSize(void) const
+{
+	return m_size;
+}
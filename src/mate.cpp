@@ -0,0 +1,447 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "mate.h"
+
+#define DEPTH_KEY	0x9E3779B97F4A7C15ULL		// spreads the same position at other depths over the table
+#define BUCKET_SIZE	4							// entries sharing a slot
+
+MateSolver::MateSolver()
+{
+	m_table = NULL;
+	m_mask = 0;
+	m_nodes = 0;
+	m_maxNodes = 0;
+	m_stop = false;
+	m_pvLen = 0;
+	m_mated = false;
+
+	resize(MATE_TT_DEFAULT_MB);
+}
+
+MateSolver::~MateSolver()
+{
+	delete[] m_table;
+}
+
+// the number of entries is rounded down to a power of two
+bool MateSolver::resize(unsigned int mb)
+{
+	U64 entries = 1;
+	U64 bytes = (U64)mb * 1024 * 1024;
+
+	while(entries * 2 * sizeof(MateEntry) <= bytes)
+		entries *= 2;
+	if(entries < BUCKET_SIZE)
+		entries = BUCKET_SIZE;
+
+	delete[] m_table;
+	m_table = new(std::nothrow) MateEntry[(size_t)entries];
+	if(m_table == NULL){
+		m_mask = 0;
+		m_table = new MateEntry[BUCKET_SIZE];
+		clear();
+		return false;
+	}
+
+	m_mask = (entries - 1) & ~(U64)(BUCKET_SIZE - 1);
+	clear();
+	return true;
+}
+
+void MateSolver::clear(void)
+{
+	memset(m_table, 0, (size_t)(m_mask + BUCKET_SIZE) * sizeof(MateEntry));
+}
+
+const MateEntry* MateSolver::probe(U64 key, int depth) const
+{
+	const MateEntry* bucket = &m_table[(key ^ (U64)depth * DEPTH_KEY) & m_mask];
+
+	for(int i=0; i<BUCKET_SIZE; ++i){
+		if(bucket[i].key == key && bucket[i].depth == depth)
+			return &bucket[i];
+	}
+
+	return NULL;
+}
+
+// the node's own entry, else a free one, else one picked by the key
+void MateSolver::store(U64 key, int depth, unsigned int phi, unsigned int delta)
+{
+	MateEntry* bucket = &m_table[(key ^ (U64)depth * DEPTH_KEY) & m_mask];
+	MateEntry* e = NULL;
+
+	for(int i=0; i<BUCKET_SIZE && e == NULL; ++i){
+		if(bucket[i].key == key && bucket[i].depth == depth)
+			e = &bucket[i];
+	}
+
+	for(int i=0; i<BUCKET_SIZE && e == NULL; ++i){
+		if(bucket[i].key == 0)
+			e = &bucket[i];
+	}
+
+	if(e == NULL)
+		e = &bucket[key & (BUCKET_SIZE - 1)];
+
+	e->key = key;
+	e->depth = depth;
+	e->phi = phi;
+	e->delta = delta;
+}
+
+int MateSolver::solve(const Position& pos, int mateIn, U64 maxNodes)
+{
+	const MateEntry* e;
+	int depth;
+
+	if(mateIn < 1)
+		mateIn = 1;
+	if(mateIn > MATE_MAX_MOVES)
+		mateIn = MATE_MAX_MOVES;
+
+	m_pos = pos;
+	m_nodes = 0;
+	m_maxNodes = maxNodes;
+	m_stop = false;
+	m_pvLen = 0;
+	m_mated = false;
+
+	// the attacker moves first and last
+	depth = 2 * mateIn - 1;
+	mid(PN_INF, PN_INF, depth, true);
+
+	e = probe(m_pos.getKey(), depth);
+	if(e == NULL)
+		return MATE_UNKNOWN;
+
+	if(e->phi == 0){
+		extractPV(depth);
+		return MATE_PROVEN;
+	}
+
+	return (e->delta == 0) ? MATE_DISPROVEN : MATE_UNKNOWN;
+}
+
+// decided nodes: the side to move is mated, or the attacker ran out of moves or
+// into a draw. A defender still standing after the last attacking move is safe.
+bool MateSolver::terminal(int numMoves, int depth, bool attacker, unsigned int& phi, unsigned int& delta)
+{
+	bool lost;
+
+	if(numMoves == 0 && m_pos.inCheck())
+		lost = true;
+	else if(numMoves == 0 || depth == 0 || m_pos.isDraw())
+		lost = attacker;
+	else
+		return false;
+
+	phi = lost ? PN_INF : 0;
+	delta = lost ? 0 : PN_INF;
+	return true;
+}
+
+// a node's children are looked at once when it's expanded: decided ones are stored
+// right away, and an attacking move is estimated to cost one proof per reply
+void MateSolver::expand(const Move* moves, int n, int depth, bool attacker, U64* keys)
+{
+	Move replies[MAX_MOVES];
+
+	for(int i=0; i<n; ++i){
+		unsigned int phi, delta;
+
+		m_pos.makeMove(moves[i]);
+		keys[i] = m_pos.getKey();
+
+		if(probe(keys[i], depth) == NULL){
+			int numReplies = m_pos.genLegalMoves(replies);
+
+			if(!terminal(numReplies, depth, !attacker, phi, delta)){
+				phi = 1;
+				delta = attacker ? numReplies : 1;
+			}
+
+			store(keys[i], depth, phi, delta);
+		}
+
+		m_pos.unmakeMove(moves[i]);
+	}
+}
+
+// multiple iterative deepening: expands the most proving child until the node's
+// numbers pass its thresholds, so the stack only ever holds the current path
+void MateSolver::mid(unsigned int thphi, unsigned int thdelta, int depth, bool attacker)
+{
+	Move moves[MAX_MOVES];
+	U64 keys[MAX_MOVES];
+	U64 key = m_pos.getKey();
+	unsigned int phi, delta;
+	int n;
+
+	if(++m_nodes >= m_maxNodes && m_maxNodes)
+		m_stop = true;
+
+	n = m_pos.genLegalMoves(moves);
+	if(terminal(n, depth, attacker, phi, delta)){
+		store(key, depth, phi, delta);
+		return;
+	}
+
+	expand(moves, n, depth - 1, attacker, keys);
+
+	for(;;){
+		unsigned int bestDelta = PN_INF, secondDelta = PN_INF, bestPhi = 0, sumPhi = 0;
+		int best = 0;
+
+		// a node is proven by one child whose goal fails, disproven once every child's goal holds
+		for(int i=0; i<n; ++i){
+			const MateEntry* e = probe(keys[i], depth - 1);
+			unsigned int cphi = e ? e->phi : 1;
+			unsigned int cdelta = e ? e->delta : 1;
+
+			sumPhi = (sumPhi + cphi < PN_INF) ? sumPhi + cphi : PN_INF;
+			if(cdelta < bestDelta){
+				secondDelta = bestDelta;
+				bestDelta = cdelta;
+				bestPhi = cphi;
+				best = i;
+			}
+			else if(cdelta < secondDelta){
+				secondDelta = cdelta;
+			}
+		}
+
+		phi = bestDelta;
+		delta = sumPhi;
+
+		if(phi >= thphi || delta >= thdelta || m_stop){
+			store(key, depth, phi, delta);
+			return;
+		}
+
+		// search the best child until it stops being the best or the node's thresholds are met
+		m_pos.makeMove(moves[best]);
+		mid(thdelta - delta + bestPhi, (thphi < secondDelta + 1) ? thphi : secondDelta + 1, depth - 1, !attacker);
+		m_pos.unmakeMove(moves[best]);
+	}
+}
+
+// follows proven children from the root: a refuting attacker move, then any defence
+void MateSolver::extractPV(int depth)
+{
+	Move moves[MAX_MOVES];
+	bool attacker = true;
+
+	for(; m_pvLen < depth; attacker = !attacker){
+		int n = m_pos.genLegalMoves(moves);
+		Move next = MOVE_NONE;
+
+		for(int i=0; i<n && next==MOVE_NONE; ++i){
+			const MateEntry* e;
+
+			m_pos.makeMove(moves[i]);
+			e = probe(m_pos.getKey(), depth - m_pvLen - 1);
+			m_pos.unmakeMove(moves[i]);
+
+			if(e && (attacker ? e->delta == 0 : e->phi == 0))
+				next = moves[i];
+		}
+
+		if(next == MOVE_NONE)
+			break;
+
+		m_pos.makeMove(next);
+		m_pv[m_pvLen++] = next;
+	}
+
+	m_mated = (m_pos.genLegalMoves(moves) == 0 && m_pos.inCheck());
+
+	for(int i=m_pvLen-1; i>=0; --i)
+		m_pos.unmakeMove(m_pv[i]);
+}
+
+int MateSolver::getPV(Move* pv) const
+{
+	for(int i=0; i<m_pvLen; ++i)
+		pv[i] = m_pv[i];
+
+	return m_pvLen;
+}
+
+MateFinder::MateFinder()
+{
+	m_solver = NULL;
+	m_pos[0] = 0;
+	m_generation = 0;
+	m_solveGeneration = 0;
+	m_mateBound = 0;
+	m_found = false;
+	m_move[0] = 0;
+	m_mateIn = 0;
+	m_side = SIDE_WHITE;
+	m_running = false;
+	m_finished = true;
+}
+
+MateFinder::~MateFinder()
+{
+	stop();
+}
+
+MateFinder& MateFinder::inst(void)
+{
+	static MateFinder finder;
+	return finder;
+}
+
+bool MateFinder::start(int mateIn)
+{
+	m_mateBound = (mateIn < MATE_MAX_MOVES) ? mateIn : MATE_MAX_MOVES;
+
+	if(m_running)
+		return true;
+
+	m_solver = new MateSolver();
+
+	m_lock.lock();
+	m_pos[0] = 0;
+	m_found = false;
+	++m_generation;
+	m_lock.unlock();
+
+	m_running = true;
+	m_finished = false;
+
+	if(!m_thread.start(&worker, this)){
+		printf("Failed to start the mate finder thread\n");
+		m_running = false;
+		m_finished = true;
+		delete m_solver;
+		m_solver = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void MateFinder::stop(void)
+{
+	if(!m_solver)
+		return;
+
+	// a stop can land just before the worker starts the next proof, so repeat it
+	m_running = false;
+	while(!m_finished){
+		m_solver->stop();
+		sleepMs(10);
+	}
+
+	m_thread.join();
+
+	delete m_solver;
+	m_solver = NULL;
+}
+
+// called every frame, like Analysis::setPosition()
+void MateFinder::setPosition(const char* pos)
+{
+	if(!m_running)
+		return;
+
+	m_lock.lock();
+
+	if(strcmp(pos, m_pos) != 0){
+		strncpy(m_pos, pos, sizeof(m_pos) - 1);
+		m_pos[sizeof(m_pos) - 1] = 0;
+		m_found = false;
+		++m_generation;
+	}
+
+	if(m_solveGeneration != m_generation)
+		m_solver->stop();
+
+	m_lock.unlock();
+}
+
+// the lock is only ever held to copy a few bytes, never while solving
+bool MateFinder::getMate(char* move, int& mateIn, int& side)
+{
+	bool found;
+
+	m_lock.lock();
+
+	found = m_found;
+	if(found){
+		strcpy(move, m_move);
+		mateIn = m_mateIn;
+		side = m_side;
+	}
+
+	m_lock.unlock();
+	return found;
+}
+
+void MateFinder::worker(void* arg)
+{
+	((MateFinder*)arg)->run();
+}
+
+void MateFinder::run(void)
+{
+	char pos[sizeof(m_pos)];
+	unsigned int generation = m_generation - 1;
+	Position board;
+
+	while(m_running){
+		m_lock.lock();
+		bool changed = (generation != m_generation);
+		if(changed){
+			generation = m_generation;
+			strcpy(pos, m_pos);
+		}
+		m_solveGeneration = generation;
+		m_lock.unlock();
+
+		if(!changed || !board.setPosition(pos)){
+			sleepMs(20);
+			continue;
+		}
+
+		if(m_solver->solve(board, m_mateBound, MATE_DEFAULT_NODES) != MATE_PROVEN)
+			continue;
+
+		m_lock.lock();
+		if(generation == m_generation){
+			Position::moveToStr(m_solver->getBestMove(), m_move);
+
+			// a proof line cut short by the table still proves the bound
+			m_mateIn = m_solver->getMateIn() ? m_solver->getMateIn() : m_mateBound;
+			m_side = board.getSide();
+			m_found = true;
+		}
+		m_lock.unlock();
+	}
+
+	m_finished = true;
+}
@@ -0,0 +1,163 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+#pragma once
+
+#include "position.h"
+#include "thread.h"
+
+#define MATE_TT_DEFAULT_MB	16
+#define MATE_MAX_MOVES		30				// longest mate-in bound, 2n - 1 plies must fit in the proof line
+#define MATE_DEFAULT_NODES	2000000			// background finder's budget per position
+#define PN_INF				100000000
+
+enum mateResults{
+	MATE_UNKNOWN = 0,						// stopped or out of nodes
+	MATE_PROVEN,
+	MATE_DISPROVEN
+};
+
+// proof and disproof numbers of one node for one remaining depth, from the point of
+// view of the side to move: phi is the cost of proving its goal, delta of disproving it
+struct MateEntry{
+	U64 key;
+	unsigned int phi;
+	unsigned int delta;
+	int depth;
+	int pad;							// 24 bytes on every compiler
+};
+
+// depth-first proof-number search (df-pn) for a forced mate by the side to move
+// within a number of moves. The attacker needs one working move and the defender
+// every reply refuted, which proof numbers capture far better than alpha-beta.
+//
+// draws by repetition are stored like any other result, so a path dependent draw
+// can hide a mate but never produce a false one
+class MateSolver{
+public:
+	MateSolver();
+	~MateSolver();
+
+	bool resize(unsigned int mb);
+	void clear(void);
+
+	int solve(const Position& pos, int mateIn, U64 maxNodes);	// maxNodes 0 for no limit
+	void stop(void);
+
+	// getter functions
+	Move getBestMove(void) const;
+	int getPV(Move* pv) const;								// proof line, the defender's replies are any refutation
+	int getMateIn(void) const;								// moves of the proof line when it ends in mate
+	U64 getNodes(void) const;
+
+private:
+	MateSolver(const MateSolver&);
+	MateSolver& operator=(const MateSolver&);
+
+	void mid(unsigned int thphi, unsigned int thdelta, int depth, bool attacker);
+	bool terminal(int numMoves, int depth, bool attacker, unsigned int& phi, unsigned int& delta);
+	void expand(const Move* moves, int n, int depth, bool attacker, U64* keys);
+	const MateEntry* probe(U64 key, int depth) const;
+	void store(U64 key, int depth, unsigned int phi, unsigned int delta);
+	void extractPV(int depth);
+
+	MateEntry* m_table;
+	U64 m_mask;
+
+	Position m_pos;
+	U64 m_nodes;
+	U64 m_maxNodes;
+	volatile bool m_stop;
+
+	Move m_pv[2 * MATE_MAX_MOVES];
+	int m_pvLen;
+	bool m_mated;											// the proof line ends in checkmate
+};
+
+// runs the solver on the game position in the background, for the mate indicator
+class MateFinder{
+public:
+	static MateFinder& inst(void);
+
+	bool start(int mateIn);
+	void stop(void);
+
+	void setPosition(const char* pos);						// UCI position command, restarts the solver when it changed
+
+	// getter functions
+	bool getMate(char* move, int& mateIn, int& side);		// false until a mate is proven in the current position
+	bool isRunning(void) const;
+	int getMateBound(void) const;
+
+private:
+	MateFinder();
+	~MateFinder();
+	MateFinder(const MateFinder&);
+	MateFinder& operator=(const MateFinder&);
+
+	static void worker(void* arg);
+	void run(void);
+
+	MateSolver* m_solver;
+	Thread m_thread;
+
+	Mutex m_lock;											// guards the position and the result
+	char m_pos[4096];
+	unsigned int m_generation;
+	volatile unsigned int m_solveGeneration;
+	int m_mateBound;
+
+	bool m_found;
+	char m_move[8];
+	int m_mateIn;
+	int m_side;
+
+	volatile bool m_running;
+	volatile bool m_finished;
+};
+
+inline void MateSolver::stop(void)
+{
+	m_stop = true;
+}
+
+inline Move MateSolver::getBestMove(void) const
+{
+	return (m_pvLen > 0) ? m_pv[0] : MOVE_NONE;
+}
+
+inline int MateSolver::getMateIn(void) const
+{
+	return m_mated ? (m_pvLen + 1) / 2 : 0;
+}
+
+inline U64 MateSolver::getNodes(void) const
+{
+	return m_nodes;
+}
+
+inline bool MateFinder::isRunning(void) const
+{
+	return m_running;
+}
+
+inline int MateFinder::getMateBound(void) const
+{
+	return m_mateBound;
+}
@@ -0,0 +1,463 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "nnue.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define NNUE_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define TARGET_SSE41
+		#define TARGET_AVX2
+		#if _MSC_VER >= 1700
+			#define NNUE_AVX2					// AVX2 intrinsics arrived with Visual Studio 2012
+		#endif
+	#else
+		#define NNUE_AVX2
+		#define TARGET_SSE41 __attribute__((target("sse4.1")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+#define HEADER_SIZE		16
+#define MAX_UPDATES		32				// walk back at most this many moves before refreshing
+#define MAX_EVAL		20000			// keep network scores clear of the mate range
+
+// dst = src + sum(add) - sum(sub), one pass over the hidden layer
+typedef void (*UpdateFunc)(short* dst, const short* src, const short* const* add, int numAdd, const short* const* sub, int numSub);
+
+// clipped relu of both perspectives dotted with the output weights
+typedef int (*OutputFunc)(const short* us, const short* them, const short* weights);
+
+// the same for up to NNUE_BATCH positions, each weight vector is loaded once for all of them
+typedef void (*OutputBatchFunc)(const short* const* us, const short* const* them, const short* weights, int n, int* out);
+
+static void updateScalar(short* dst, const short* src, const short* const* add, int numAdd, const short* const* sub, int numSub)
+{
+	for(int i=0; i<NNUE_HIDDEN; ++i){
+		int v = src[i];
+
+		for(int j=0; j<numAdd; ++j)
+			v += add[j][i];
+		for(int j=0; j<numSub; ++j)
+			v -= sub[j][i];
+
+		dst[i] = (short)v;
+	}
+}
+
+static inline int clip(int v)
+{
+	return (v < 0) ? 0 : (v > NNUE_QA) ? NNUE_QA : v;
+}
+
+static int outputScalar(const short* us, const short* them, const short* weights)
+{
+	int sum = 0;
+
+	for(int i=0; i<NNUE_HIDDEN; ++i){
+		sum += clip(us[i]) * weights[i];
+		sum += clip(them[i]) * weights[NNUE_HIDDEN + i];
+	}
+
+	return sum;
+}
+
+static void outputBatchScalar(const short* const* us, const short* const* them, const short* weights, int n, int* out)
+{
+	for(int b=0; b<n; ++b)
+		out[b] = 0;
+
+	for(int i=0; i<NNUE_HIDDEN; ++i){
+		int w0 = weights[i], w1 = weights[NNUE_HIDDEN + i];
+
+		for(int b=0; b<n; ++b)
+			out[b] += clip(us[b][i]) * w0 + clip(them[b][i]) * w1;
+	}
+}
+
+#if defined(NNUE_X86)
+TARGET_SSE41 static void updateSSE41(short* dst, const short* src, const short* const* add, int numAdd, const short* const* sub, int numSub)
+{
+	for(int i=0; i<NNUE_HIDDEN; i+=8){
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+
+		for(int j=0; j<numAdd; ++j)
+			v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(add[j] + i)));
+		for(int j=0; j<numSub; ++j)
+			v = _mm_sub_epi16(v, _mm_loadu_si128((const __m128i*)(sub[j] + i)));
+
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+	}
+}
+
+TARGET_SSE41 static int outputSSE41(const short* us, const short* them, const short* weights)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i qa = _mm_set1_epi16(NNUE_QA);
+	__m128i sum = zero;
+
+	for(int i=0; i<NNUE_HIDDEN; i+=8){
+		__m128i a = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(us + i)), zero), qa);
+		__m128i b = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(them + i)), zero), qa);
+
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(a, _mm_loadu_si128((const __m128i*)(weights + i))));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(b, _mm_loadu_si128((const __m128i*)(weights + NNUE_HIDDEN + i))));
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+}
+
+TARGET_SSE41 static void outputBatchSSE41(const short* const* us, const short* const* them, const short* weights, int n, int* out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i qa = _mm_set1_epi16(NNUE_QA);
+	__m128i sum[NNUE_BATCH];
+
+	for(int b=0; b<n; ++b)
+		sum[b] = zero;
+
+	for(int i=0; i<NNUE_HIDDEN; i+=8){
+		__m128i w0 = _mm_loadu_si128((const __m128i*)(weights + i));
+		__m128i w1 = _mm_loadu_si128((const __m128i*)(weights + NNUE_HIDDEN + i));
+
+		for(int b=0; b<n; ++b){
+			__m128i a = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(us[b] + i)), zero), qa);
+			__m128i c = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(them[b] + i)), zero), qa);
+
+			sum[b] = _mm_add_epi32(sum[b], _mm_add_epi32(_mm_madd_epi16(a, w0), _mm_madd_epi16(c, w1)));
+		}
+	}
+
+	for(int b=0; b<n; ++b){
+		__m128i s = _mm_add_epi32(sum[b], _mm_shuffle_epi32(sum[b], 0x4E));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+		out[b] = _mm_cvtsi128_si32(s);
+	}
+}
+
+#if defined(NNUE_AVX2)
+TARGET_AVX2 static void updateAVX2(short* dst, const short* src, const short* const* add, int numAdd, const short* const* sub, int numSub)
+{
+	for(int i=0; i<NNUE_HIDDEN; i+=16){
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+
+		for(int j=0; j<numAdd; ++j)
+			v = _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i*)(add[j] + i)));
+		for(int j=0; j<numSub; ++j)
+			v = _mm256_sub_epi16(v, _mm256_loadu_si256((const __m256i*)(sub[j] + i)));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), v);
+	}
+}
+
+TARGET_AVX2 static int outputAVX2(const short* us, const short* them, const short* weights)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+	__m256i sum = zero;
+	__m128i sum128;
+
+	for(int i=0; i<NNUE_HIDDEN; i+=16){
+		__m256i a = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(us + i)), zero), qa);
+		__m256i b = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(them + i)), zero), qa);
+
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, _mm256_loadu_si256((const __m256i*)(weights + i))));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(b, _mm256_loadu_si256((const __m256i*)(weights + NNUE_HIDDEN + i))));
+	}
+
+	sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+	return _mm_cvtsi128_si32(sum128);
+}
+
+TARGET_AVX2 static void outputBatchAVX2(const short* const* us, const short* const* them, const short* weights, int n, int* out)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+	__m256i sum[NNUE_BATCH];
+
+	for(int b=0; b<n; ++b)
+		sum[b] = zero;
+
+	for(int i=0; i<NNUE_HIDDEN; i+=16){
+		__m256i w0 = _mm256_loadu_si256((const __m256i*)(weights + i));
+		__m256i w1 = _mm256_loadu_si256((const __m256i*)(weights + NNUE_HIDDEN + i));
+
+		for(int b=0; b<n; ++b){
+			__m256i a = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(us[b] + i)), zero), qa);
+			__m256i c = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(them[b] + i)), zero), qa);
+
+			sum[b] = _mm256_add_epi32(sum[b], _mm256_add_epi32(_mm256_madd_epi16(a, w0), _mm256_madd_epi16(c, w1)));
+		}
+	}
+
+	for(int b=0; b<n; ++b){
+		__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum[b]), _mm256_extracti128_si256(sum[b], 1));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+		out[b] = _mm_cvtsi128_si32(s);
+	}
+}
+#endif
+#endif
+
+static UpdateFunc s_update = updateScalar;
+static OutputFunc s_output = outputScalar;
+static OutputBatchFunc s_outputBatch = outputBatchScalar;
+static const char* s_kernelName = "scalar";
+
+// picks the widest kernels the CPU (and OS, for AVX state) supports
+static void selectKernels(void)
+{
+#if defined(NNUE_X86)
+	bool sse41 = false, avx2 = false;
+
+	#if defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	sse41 = (info[2] & (1 << 19)) != 0;
+
+	// AVX registers are only usable if the OS saves them
+	if(maxLeaf >= 7 && (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6){
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	#else
+	__builtin_cpu_init();
+	sse41 = __builtin_cpu_supports("sse4.1") != 0;
+	avx2 = __builtin_cpu_supports("avx2") != 0;
+	#endif
+
+	#if defined(NNUE_AVX2)
+	if(avx2){
+		s_update = updateAVX2;
+		s_output = outputAVX2;
+		s_outputBatch = outputBatchAVX2;
+		s_kernelName = "avx2";
+		return;
+	}
+	#endif
+
+	if(sse41){
+		s_update = updateSSE41;
+		s_output = outputSSE41;
+		s_outputBatch = outputBatchSSE41;
+		s_kernelName = "sse4.1";
+	}
+#endif
+}
+
+// kings are not inputs, the other pieces are seen from each side with the board flipped for black
+static inline int featureIndex(int perspective, int kingSq, int piece, int sq)
+{
+	int flip = (perspective == SIDE_WHITE) ? 0 : 56;
+	int type = pieceType(piece) * 2 + (pieceSide(piece) != perspective);
+
+	return (((kingSq ^ flip) * 10 + type) * SQUARE_NB + (sq ^ flip)) * NNUE_HIDDEN;
+}
+
+Network::Network()
+{
+	m_bias = NULL;
+	m_weights = NULL;
+	m_output = NULL;
+	m_outputBias = 0;
+	m_hash = 0;
+	m_loaded = false;
+
+	selectKernels();
+}
+
+Network& Network::inst(void)
+{
+	static Network network;
+	return network;
+}
+
+bool Network::load(const char* file)
+{
+	int header[4];
+	size_t expected = HEADER_SIZE + (NNUE_HIDDEN + (size_t)NNUE_INPUTS * NNUE_HIDDEN + 2 * NNUE_HIDDEN) * sizeof(short) + sizeof(int);
+
+	unload();
+
+	if(!m_file.open(file))
+		return false;
+
+	if(m_file.getSize() == expected)
+		memcpy(header, m_file.getData(), sizeof(header));
+
+	if(m_file.getSize() != expected || header[0] != NNUE_MAGIC || header[1] != NNUE_VERSION ||
+	   header[2] != NNUE_INPUTS || header[3] != NNUE_HIDDEN){
+		printf("%s is not a compatible network\n", file);
+		m_file.close();
+		return false;
+	}
+
+	// the weights are used straight out of the mapping, so only touched pages get read
+	m_bias = (const short*)(m_file.getData() + HEADER_SIZE);
+	m_weights = m_bias + NNUE_HIDDEN;
+	m_output = m_weights + (size_t)NNUE_INPUTS * NNUE_HIDDEN;
+	memcpy(&m_outputBias, m_output + 2 * NNUE_HIDDEN, sizeof(int));
+
+	// FNV-1a over the biases and the output layer. Any retraining changes them,
+	// and unlike the input weights they're only a few pages.
+	m_hash = 0xCBF29CE484222325ULL;
+	for(int i=0; i<NNUE_HIDDEN; ++i)
+		m_hash = (m_hash ^ (unsigned short)m_bias[i]) * 0x100000001B3ULL;
+	for(int i=0; i<2 * NNUE_HIDDEN; ++i)
+		m_hash = (m_hash ^ (unsigned short)m_output[i]) * 0x100000001B3ULL;
+	m_hash = (m_hash ^ (unsigned int)m_outputBias) * 0x100000001B3ULL;
+
+	m_loaded = true;
+	return true;
+}
+
+void Network::unload(void)
+{
+	m_loaded = false;
+	m_hash = 0;
+	m_bias = m_weights = m_output = NULL;
+	m_file.close();
+}
+
+int Network::evaluate(const Position& pos, Accumulator* stack) const
+{
+	int us = pos.getSide();
+	int score;
+
+	update(pos, stack, SIDE_WHITE);
+	update(pos, stack, SIDE_BLACK);
+
+	const Accumulator& acc = stack[pos.getStateIndex()];
+	score = s_output(acc.values[us], acc.values[us ^ 1], m_output);
+
+	return scaleOutput(score);
+}
+
+void Network::evaluateBatch(const Position* const* pos, int n, int* out) const
+{
+	Accumulator acc[NNUE_BATCH];
+	const short* us[NNUE_BATCH];
+	const short* them[NNUE_BATCH];
+
+	for(int base=0; base<n; base+=NNUE_BATCH){
+		int count = (n - base < NNUE_BATCH) ? n - base : NNUE_BATCH;
+
+		for(int b=0; b<count; ++b){
+			const Position& p = *pos[base + b];
+
+			refresh(p, acc[b], SIDE_WHITE);
+			refresh(p, acc[b], SIDE_BLACK);
+			us[b] = acc[b].values[p.getSide()];
+			them[b] = acc[b].values[p.getSide() ^ 1];
+		}
+
+		s_outputBatch(us, them, m_output, count, out + base);
+
+		for(int b=0; b<count; ++b)
+			out[base + b] = scaleOutput(out[base + b]);
+	}
+}
+
+int Network::scaleOutput(int sum) const
+{
+	int score = (sum + m_outputBias) / NNUE_QA * NNUE_SCALE / NNUE_QB;
+
+	return (score > MAX_EVAL) ? MAX_EVAL : (score < -MAX_EVAL) ? -MAX_EVAL : score;
+}
+
+// brings one perspective up to date from the nearest computed ancestor, applying
+// only the pieces each move changed; a move of this side's own king needs a refresh
+void Network::update(const Position& pos, Accumulator* stack, int perspective) const
+{
+	int idx = pos.getStateIndex(), i = idx;
+	int kingSq = pos.getKingSquare(perspective);
+	int ownKing = makePiece(perspective, P_KING);
+
+	while(stack[i].key[perspective] != pos.getStateKey(i)){
+		const DirtyPiece& dp = pos.getDirtyPiece(i);
+		bool kingMoved = false;
+
+		for(int j=0; j<dp.count; ++j)
+			kingMoved |= (dp.piece[j] == ownKing);
+
+		if(i == 0 || idx - i >= MAX_UPDATES || kingMoved){
+			refresh(pos, stack[idx], perspective);
+			return;
+		}
+
+		--i;
+	}
+
+	for(++i; i<=idx; ++i){
+		const DirtyPiece& dp = pos.getDirtyPiece(i);
+		const short* add[3];
+		const short* sub[3];
+		int numAdd = 0, numSub = 0;
+
+		for(int j=0; j<dp.count; ++j){
+			if(pieceType(dp.piece[j]) == P_KING)
+				continue;
+
+			if(dp.from[j] != SQ_NONE)
+				sub[numSub++] = m_weights + featureIndex(perspective, kingSq, dp.piece[j], dp.from[j]);
+			if(dp.to[j] != SQ_NONE)
+				add[numAdd++] = m_weights + featureIndex(perspective, kingSq, dp.piece[j], dp.to[j]);
+		}
+
+		s_update(stack[i].values[perspective], stack[i - 1].values[perspective], add, numAdd, sub, numSub);
+		stack[i].key[perspective] = pos.getStateKey(i);
+	}
+}
+
+void Network::refresh(const Position& pos, Accumulator& acc, int perspective) const
+{
+	const short* add[SQUARE_NB];
+	int n = 0;
+	int kingSq = pos.getKingSquare(perspective);
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		for(int type=P_PAWN; type<P_KING; ++type){
+			for(U64 b = pos.getPieces(side, type); b;)
+				add[n++] = m_weights + featureIndex(perspective, kingSq, makePiece(side, type), popLsb(b));
+		}
+	}
+
+	s_update(acc.values[perspective], m_bias, add, n, NULL, 0);
+	acc.key[perspective] = pos.getKey();
+}
+
+const char* Network::getKernelName(void) const
+{
+	return s_kernelName;
+}
@@ -0,0 +1,95 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+#include "mappedfile.h"
+
+#define NNUE_FILE		"Data/Network/ethereal.nnue"
+#define NNUE_MAGIC		0x4E4E4345		// "ECNN"
+#define NNUE_VERSION	1
+
+// HalfKP: own king square x non-king piece (5 types, 2 colours) x square
+#define NNUE_INPUTS		(SQUARE_NB * 10 * SQUARE_NB)
+#define NNUE_HIDDEN		256
+
+// quantisation of the weights file
+#define NNUE_QA			255				// hidden layer activation clip
+#define NNUE_QB			64				// output weight scale
+#define NNUE_SCALE		400				// network output to centipawns
+
+#define NNUE_BATCH		8				// positions evaluateBatch runs through the output layer together
+
+// first layer output for both perspectives, one per position in the move history
+struct Accumulator{
+	short values[2][NNUE_HIDDEN];
+	U64 key[2];							// position the perspective was computed for, 0 when stale
+};
+
+// efficiently updatable network, shared read-only by every evaluator
+//
+// file layout (little endian): int magic, int version, int inputs, int hidden,
+// short bias[hidden], short weights[inputs][hidden], short output[2 * hidden], int outputBias
+class Network{
+public:
+	static Network& inst(void);
+
+	bool load(const char* file);
+	void unload(void);
+
+	int evaluate(const Position& pos, Accumulator* stack) const;	// side to move's point of view
+
+	// unrelated positions, each from its side to move. The accumulators are built
+	// from scratch and every block of positions shares one pass over the output weights.
+	void evaluateBatch(const Position* const* pos, int n, int* out) const;
+
+	// getter functions
+	bool isLoaded(void) const;
+	const char* getKernelName(void) const;							// SIMD path picked for this CPU
+	U64 getHash(void) const;										// identifies the weights, 0 when not loaded
+
+private:
+	Network();
+	Network(const Network&);
+	Network& operator=(const Network&);
+
+	void update(const Position& pos, Accumulator* stack, int perspective) const;
+	void refresh(const Position& pos, Accumulator& acc, int perspective) const;
+	int scaleOutput(int sum) const;					// output layer sum to clamped centipawns
+
+	MappedFile m_file;
+	const short* m_bias;
+	const short* m_weights;
+	const short* m_output;
+	int m_outputBias;
+	U64 m_hash;
+	bool m_loaded;
+};
+
+inline bool Network::isLoaded(void) const
+{
+	return m_loaded;
+}
+
+inline U64 Network::getHash(void) const
+{
+	return m_hash;
+}
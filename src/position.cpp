@@ -0,0 +1,794 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#include "position.h"
+
+static U64 s_zobPiece[12][SQUARE_NB];
+static U64 s_zobCastle[16];
+static U64 s_zobEp[8];
+static U64 s_zobSide;
+
+// castle rights that survive a move touching each square
+static int s_castleMask[SQUARE_NB];
+
+static const char PIECE_CHARS[] = "PpNnBbRrQqKk";
+
+// fixed seed so keys (and therefore searches) are reproducible between runs
+static U64 randKey(void)
+{
+	static U64 s = 1070372ULL;
+
+	s ^= s >> 12;
+	s ^= s << 25;
+	s ^= s >> 27;
+	return s * 2685821657736338717ULL;
+}
+
+static void initZobrist(void)
+{
+	static bool initialized = false;
+
+	if(initialized)
+		return;
+
+	for(int p=0; p<12; ++p)
+		for(int sq=0; sq<SQUARE_NB; ++sq)
+			s_zobPiece[p][sq] = randKey();
+
+	for(int i=0; i<16; ++i)
+		s_zobCastle[i] = (i == 0) ? 0 : randKey();
+
+	for(int i=0; i<8; ++i)
+		s_zobEp[i] = randKey();
+
+	s_zobSide = randKey();
+
+	for(int sq=0; sq<SQUARE_NB; ++sq)
+		s_castleMask[sq] = CASTLE_WK | CASTLE_WQ | CASTLE_BK | CASTLE_BQ;
+
+	s_castleMask[SQ_A1] &= ~CASTLE_WQ;
+	s_castleMask[SQ_E1] &= ~(CASTLE_WK | CASTLE_WQ);
+	s_castleMask[SQ_H1] &= ~CASTLE_WK;
+	s_castleMask[SQ_A8] &= ~CASTLE_BQ;
+	s_castleMask[SQ_E8] &= ~(CASTLE_BK | CASTLE_BQ);
+	s_castleMask[SQ_H8] &= ~CASTLE_BK;
+
+	initialized = true;
+}
+
+// the keys are made while the program loads, like the attack tables, so threads
+// never race on the shared generator or see half the table
+static struct ZobristInit{
+	ZobristInit() { initZobrist(); }
+} s_zobristInit;
+
+Position::Position()
+{
+	initBitboards();
+	initZobrist();
+
+	setFEN(START_FEN);
+}
+
+void Position::clear(void)
+{
+	memset(m_pieces, 0, sizeof(m_pieces));
+	memset(m_sidePieces, 0, sizeof(m_sidePieces));
+
+	for(int sq=0; sq<SQUARE_NB; ++sq)
+		m_board[sq] = NO_PIECE;
+
+	m_side = SIDE_WHITE;
+	m_fullmove = 1;
+	m_stateIdx = 0;
+
+	m_states[0].key = 0;
+	m_states[0].pawnKey = 0;
+	m_states[0].castle = 0;
+	m_states[0].ep = SQ_NONE;
+	m_states[0].halfmove = 0;
+	m_states[0].captured = NO_PIECE;
+	m_states[0].dirty.count = 0;
+}
+
+void Position::putPiece(int piece, int sq)
+{
+	U64 b = squareBB(sq);
+
+	m_pieces[pieceSide(piece)][pieceType(piece)] |= b;
+	m_sidePieces[pieceSide(piece)] |= b;
+	m_board[sq] = piece;
+	m_states[m_stateIdx].key ^= s_zobPiece[piece][sq];
+	if(pieceType(piece) == P_PAWN)
+		m_states[m_stateIdx].pawnKey ^= s_zobPiece[piece][sq];
+}
+
+void Position::removePiece(int sq)
+{
+	int piece = m_board[sq];
+	U64 b = squareBB(sq);
+
+	m_pieces[pieceSide(piece)][pieceType(piece)] ^= b;
+	m_sidePieces[pieceSide(piece)] ^= b;
+	m_board[sq] = NO_PIECE;
+	m_states[m_stateIdx].key ^= s_zobPiece[piece][sq];
+	if(pieceType(piece) == P_PAWN)
+		m_states[m_stateIdx].pawnKey ^= s_zobPiece[piece][sq];
+}
+
+void Position::movePiece(int from, int to)
+{
+	int piece = m_board[from];
+	U64 b = squareBB(from) | squareBB(to);
+
+	m_pieces[pieceSide(piece)][pieceType(piece)] ^= b;
+	m_sidePieces[pieceSide(piece)] ^= b;
+	m_board[from] = NO_PIECE;
+	m_board[to] = piece;
+	m_states[m_stateIdx].key ^= s_zobPiece[piece][from] ^ s_zobPiece[piece][to];
+	if(pieceType(piece) == P_PAWN)
+		m_states[m_stateIdx].pawnKey ^= s_zobPiece[piece][from] ^ s_zobPiece[piece][to];
+}
+
+void Position::addDirty(int piece, int from, int to)
+{
+	DirtyPiece& dp = m_states[m_stateIdx].dirty;
+
+	dp.piece[dp.count] = piece;
+	dp.from[dp.count] = from;
+	dp.to[dp.count] = to;
+	++dp.count;
+}
+
+// only record the en passant square when a capture is actually possible,
+// so transpositions hash the same (this matches the Polyglot convention)
+void Position::setEnPassant(int sq)
+{
+	// called before the side to move changes, so m_side made the double push
+	if(g_pawnAttacks[m_side][sq] & m_pieces[m_side ^ 1][P_PAWN]){
+		m_states[m_stateIdx].ep = sq;
+		m_states[m_stateIdx].key ^= s_zobEp[fileOf(sq)];
+	}
+}
+
+bool Position::setFEN(const char* fen)
+{
+	const char* p = fen;
+	int file = 0, rank = 7;
+
+	clear();
+
+	// piece placement
+	for(; *p && *p != ' '; ++p){
+		if(*p == '/'){
+			file = 0;
+			--rank;
+		}
+		else if(isdigit(*p)){
+			file += *p - '0';
+		}
+		else{
+			const char* c = strchr(PIECE_CHARS, *p);
+
+			if(c == NULL || file > 7 || rank < 0)
+				return false;
+
+			int idx = c - PIECE_CHARS;
+			putPiece(makePiece(idx & 1, idx >> 1), makeSquare(file, rank));
+			++file;
+		}
+	}
+
+	if(popCount(m_pieces[SIDE_WHITE][P_KING]) != 1 || popCount(m_pieces[SIDE_BLACK][P_KING]) != 1)
+		return false;
+
+	// side to move
+	for(; *p == ' '; ++p);
+	m_side = (*p == 'b') ? SIDE_BLACK : SIDE_WHITE;
+	if(m_side == SIDE_BLACK)
+		m_states[0].key ^= s_zobSide;
+	if(*p)
+		++p;
+
+	// castling rights
+	for(; *p == ' '; ++p);
+	for(; *p && *p != ' '; ++p){
+		switch(*p){
+			case 'K': m_states[0].castle |= CASTLE_WK; break;
+			case 'Q': m_states[0].castle |= CASTLE_WQ; break;
+			case 'k': m_states[0].castle |= CASTLE_BK; break;
+			case 'q': m_states[0].castle |= CASTLE_BQ; break;
+			default: break;
+		}
+	}
+	m_states[0].key ^= s_zobCastle[m_states[0].castle];
+
+	// en passant square, stored relative to the side that just moved
+	for(; *p == ' '; ++p);
+	if(*p >= 'a' && *p <= 'h' && (p[1] == '3' || p[1] == '6')){
+		m_side ^= 1;
+		setEnPassant(makeSquare(p[0] - 'a', p[1] - '1'));
+		m_side ^= 1;
+		p += 2;
+	}
+	for(; *p && *p != ' '; ++p);
+
+	// move counters
+	if(*p){
+		int halfmove = 0, fullmove = 1;
+
+		if(sscanf(p, "%d %d", &halfmove, &fullmove) >= 1){
+			m_states[0].halfmove = halfmove;
+			m_fullmove = (fullmove > 0) ? fullmove : 1;
+		}
+	}
+
+	return true;
+}
+
+void Position::setPieces(const int* pieces, const int* squares, int n, int side)
+{
+	clear();
+
+	for(int i=0; i<n; ++i)
+		putPiece(pieces[i], squares[i]);
+
+	m_side = side;
+	if(m_side == SIDE_BLACK)
+		m_states[0].key ^= s_zobSide;
+}
+
+void Position::getFEN(char* fen) const
+{
+	char* p = fen;
+
+	for(int rank=7; rank>=0; --rank){
+		int empty = 0;
+
+		for(int file=0; file<8; ++file){
+			int piece = m_board[makeSquare(file, rank)];
+
+			if(piece == NO_PIECE){
+				++empty;
+				continue;
+			}
+
+			if(empty){
+				*p++ = (char)('0' + empty);
+				empty = 0;
+			}
+			*p++ = PIECE_CHARS[(pieceType(piece) << 1) | pieceSide(piece)];
+		}
+
+		if(empty)
+			*p++ = (char)('0' + empty);
+		if(rank > 0)
+			*p++ = '/';
+	}
+
+	*p++ = ' ';
+	*p++ = (m_side == SIDE_WHITE) ? 'w' : 'b';
+	*p++ = ' ';
+
+	if(getCastle() == 0)
+		*p++ = '-';
+	if(getCastle() & CASTLE_WK) *p++ = 'K';
+	if(getCastle() & CASTLE_WQ) *p++ = 'Q';
+	if(getCastle() & CASTLE_BK) *p++ = 'k';
+	if(getCastle() & CASTLE_BQ) *p++ = 'q';
+
+	*p++ = ' ';
+	if(getEnPassant() != SQ_NONE){
+		*p++ = (char)('a' + fileOf(getEnPassant()));
+		*p++ = (char)('1' + rankOf(getEnPassant()));
+	}
+	else{
+		*p++ = '-';
+	}
+
+	sprintf(p, " %d %d", getHalfmove(), m_fullmove);
+}
+
+bool Position::setPosition(const char* str)
+{
+	const char* p = strstr(str, "moves");
+	char buf[8];
+
+	if(strstr(str, "fen ")){
+		if(!setFEN(strstr(str, "fen ") + 4))
+			return false;
+	}
+	else{
+		setFEN(START_FEN);
+	}
+
+	if(p == NULL)
+		return true;
+
+	for(p += 5; *p;){
+		int n = 0;
+
+		for(; *p == ' '; ++p);
+		for(; *p && *p != ' ' && n < 7; ++p)
+			buf[n++] = *p;
+		buf[n] = 0;
+
+		if(n == 0)
+			break;
+
+		Move m = parseMove(buf);
+		if(m == MOVE_NONE || !makeMove(m))
+			return false;
+	}
+
+	return true;
+}
+
+bool Position::isAttacked(int sq, int bySide) const
+{
+	const U64* them = m_pieces[bySide];
+	U64 occupied = getOccupied();
+
+	if(g_pawnAttacks[bySide ^ 1][sq] & them[P_PAWN])
+		return true;
+	if(g_knightAttacks[sq] & them[P_KNIGHT])
+		return true;
+	if(g_kingAttacks[sq] & them[P_KING])
+		return true;
+	if(bishopAttacks(sq, occupied) & (them[P_BISHOP] | them[P_QUEEN]))
+		return true;
+	if(rookAttacks(sq, occupied) & (them[P_ROOK] | them[P_QUEEN]))
+		return true;
+
+	return false;
+}
+
+int Position::getNonPawnMaterial(int side) const
+{
+	return 3 * popCount(m_pieces[side][P_KNIGHT] | m_pieces[side][P_BISHOP])
+		 + 5 * popCount(m_pieces[side][P_ROOK])
+		 + 9 * popCount(m_pieces[side][P_QUEEN]);
+}
+
+bool Position::makeMove(Move m)
+{
+	int from = moveFrom(m), to = moveTo(m), flags = moveFlags(m);
+	int us = m_side;
+	int piece = m_board[from];
+	StateInfo& prev = m_states[m_stateIdx];
+	StateInfo& st = m_states[++m_stateIdx];
+
+	st.key = prev.key ^ s_zobSide;
+	st.pawnKey = prev.pawnKey;
+	st.castle = prev.castle;
+	st.ep = SQ_NONE;
+	st.halfmove = prev.halfmove + 1;
+	st.captured = NO_PIECE;
+	st.dirty.count = 0;
+
+	if(prev.ep != SQ_NONE)
+		st.key ^= s_zobEp[fileOf(prev.ep)];
+
+	if(flags == MF_CASTLE){
+		bool kingSide = to > from;
+		int rookFrom = kingSide ? to + 1 : to - 2, rookTo = kingSide ? to - 1 : to + 1;
+
+		addDirty(piece, from, to);
+		addDirty(m_board[rookFrom], rookFrom, rookTo);
+		movePiece(from, to);
+		movePiece(rookFrom, rookTo);
+	}
+	else{
+		if(flags == MF_ENPASSANT){
+			st.captured = m_board[to ^ 8];
+			addDirty(st.captured, to ^ 8, SQ_NONE);
+			removePiece(to ^ 8);
+		}
+		else if(m_board[to] != NO_PIECE){
+			st.captured = m_board[to];
+			addDirty(st.captured, to, SQ_NONE);
+			removePiece(to);
+		}
+
+		movePiece(from, to);
+
+		if(pieceType(piece) == P_PAWN){
+			st.halfmove = 0;
+
+			if((from ^ to) == 16)
+				setEnPassant((from + to) >> 1);
+			else if(flags == MF_PROMOTION){
+				removePiece(to);
+				putPiece(makePiece(us, movePromo(m)), to);
+			}
+		}
+
+		if(flags == MF_PROMOTION){
+			addDirty(piece, from, SQ_NONE);
+			addDirty(makePiece(us, movePromo(m)), SQ_NONE, to);
+		}
+		else
+			addDirty(piece, from, to);
+
+		if(st.captured != NO_PIECE)
+			st.halfmove = 0;
+	}
+
+	st.castle &= s_castleMask[from] & s_castleMask[to];
+	st.key ^= s_zobCastle[prev.castle] ^ s_zobCastle[st.castle];
+
+	m_side ^= 1;
+	if(m_side == SIDE_WHITE)
+		++m_fullmove;
+
+	// take the move back if it left our king attacked
+	if(isAttacked(getKingSquare(us), m_side)){
+		unmakeMove(m);
+		return false;
+	}
+
+	return true;
+}
+
+void Position::unmakeMove(Move m)
+{
+	int from = moveFrom(m), to = moveTo(m), flags = moveFlags(m);
+	int captured = m_states[m_stateIdx].captured;
+
+	if(m_side == SIDE_WHITE)
+		--m_fullmove;
+	m_side ^= 1;
+
+	// board updates touch the key of the state being discarded
+	if(flags == MF_CASTLE){
+		bool kingSide = to > from;
+
+		movePiece(to, from);
+		movePiece(kingSide ? to - 1 : to + 1, kingSide ? to + 1 : to - 2);
+	}
+	else{
+		if(flags == MF_PROMOTION){
+			removePiece(to);
+			putPiece(makePiece(m_side, P_PAWN), to);
+		}
+
+		movePiece(to, from);
+
+		if(captured != NO_PIECE)
+			putPiece(captured, (flags == MF_ENPASSANT) ? to ^ 8 : to);
+	}
+
+	--m_stateIdx;
+}
+
+void Position::makeNullMove(void)
+{
+	StateInfo& prev = m_states[m_stateIdx];
+	StateInfo& st = m_states[++m_stateIdx];
+
+	st.key = prev.key ^ s_zobSide;
+	st.pawnKey = prev.pawnKey;
+	st.castle = prev.castle;
+	st.ep = SQ_NONE;
+	st.halfmove = prev.halfmove + 1;
+	st.captured = NO_PIECE;
+	st.dirty.count = 0;
+
+	if(prev.ep != SQ_NONE)
+		st.key ^= s_zobEp[fileOf(prev.ep)];
+
+	m_side ^= 1;
+}
+
+void Position::unmakeNullMove(void)
+{
+	m_side ^= 1;
+	--m_stateIdx;
+}
+
+// adds every promotion (or only the queen) for a pawn move
+static Move* addPromotions(Move* list, int from, int to, bool underPromotions)
+{
+	*list++ = encodeMove(from, to, MF_PROMOTION, P_QUEEN);
+
+	if(underPromotions){
+		*list++ = encodeMove(from, to, MF_PROMOTION, P_ROOK);
+		*list++ = encodeMove(from, to, MF_PROMOTION, P_BISHOP);
+		*list++ = encodeMove(from, to, MF_PROMOTION, P_KNIGHT);
+	}
+
+	return list;
+}
+
+int Position::generate(Move* list, bool quiets) const
+{
+	Move* start = list;
+	int us = m_side, them = m_side ^ 1;
+	U64 occupied = getOccupied();
+	U64 enemies = m_sidePieces[them];
+	U64 empty = ~occupied;
+	U64 targets = quiets ? ~m_sidePieces[us] : enemies;
+	U64 promoRank = (us == SIDE_WHITE) ? RANK_8_BB : RANK_1_BB;
+	int up = (us == SIDE_WHITE) ? 8 : -8;
+	U64 b;
+
+	// pawns
+	for(b = m_pieces[us][P_PAWN]; b;){
+		int from = popLsb(b);
+		int to = from + up;
+		U64 caps = g_pawnAttacks[us][from] & enemies;
+
+		if(squareBB(to) & empty){
+			if(squareBB(to) & promoRank){
+				list = addPromotions(list, from, to, quiets);
+			}
+			else if(quiets){
+				*list++ = encodeMove(from, to);
+
+				if(relativeRank(us, from) == 1 && (squareBB(to + up) & empty))
+					*list++ = encodeMove(from, to + up);
+			}
+		}
+
+		for(; caps;){
+			int cap = popLsb(caps);
+
+			if(squareBB(cap) & promoRank)
+				list = addPromotions(list, from, cap, quiets);
+			else
+				*list++ = encodeMove(from, cap);
+		}
+
+		if(getEnPassant() != SQ_NONE && (g_pawnAttacks[us][from] & squareBB(getEnPassant())))
+			*list++ = encodeMove(from, getEnPassant(), MF_ENPASSANT);
+	}
+
+	// pieces
+	for(int type=P_KNIGHT; type<=P_KING; ++type){
+		for(b = m_pieces[us][type]; b;){
+			int from = popLsb(b);
+			U64 attacks;
+
+			switch(type){
+				case P_KNIGHT:	attacks = g_knightAttacks[from]; break;
+				case P_BISHOP:	attacks = bishopAttacks(from, occupied); break;
+				case P_ROOK:	attacks = rookAttacks(from, occupied); break;
+				case P_QUEEN:	attacks = queenAttacks(from, occupied); break;
+				default:		attacks = g_kingAttacks[from]; break;
+			}
+
+			for(attacks &= targets; attacks;)
+				*list++ = encodeMove(from, popLsb(attacks));
+		}
+	}
+
+	// castling (the destination square is checked when the move is made)
+	if(quiets && getCastle()){
+		int castleK = (us == SIDE_WHITE) ? CASTLE_WK : CASTLE_BK;
+		int castleQ = (us == SIDE_WHITE) ? CASTLE_WQ : CASTLE_BQ;
+		int king = (us == SIDE_WHITE) ? SQ_E1 : SQ_E8;
+
+		if((getCastle() & castleK) && !(occupied & (squareBB(king + 1) | squareBB(king + 2)))
+			&& !isAttacked(king, them) && !isAttacked(king + 1, them)){
+			*list++ = encodeMove(king, king + 2, MF_CASTLE);
+		}
+
+		if((getCastle() & castleQ) && !(occupied & (squareBB(king - 1) | squareBB(king - 2) | squareBB(king - 3)))
+			&& !isAttacked(king, them) && !isAttacked(king - 1, them)){
+			*list++ = encodeMove(king, king - 2, MF_CASTLE);
+		}
+	}
+
+	return (int)(list - start);
+}
+
+int Position::genMoves(Move* list) const
+{
+	return generate(list, true);
+}
+
+int Position::genCaptures(Move* list) const
+{
+	return generate(list, false);
+}
+
+int Position::genLegalMoves(Move* list)
+{
+	Move moves[MAX_MOVES];
+	int n = genMoves(moves);
+	int count = 0;
+
+	for(int i=0; i<n; ++i){
+		if(makeMove(moves[i])){
+			unmakeMove(moves[i]);
+			list[count++] = moves[i];
+		}
+	}
+
+	return count;
+}
+
+// a move from the GUI without a promotion letter is taken as a queen promotion
+Move Position::parseMove(const char* str)
+{
+	Move moves[MAX_MOVES];
+	int n, from, to;
+
+	if(strlen(str) < 4)
+		return MOVE_NONE;
+
+	from = makeSquare(str[0] - 'a', str[1] - '1');
+	to = makeSquare(str[2] - 'a', str[3] - '1');
+	n = genLegalMoves(moves);
+
+	for(int i=0; i<n; ++i){
+		if(moveFrom(moves[i]) != from || moveTo(moves[i]) != to)
+			continue;
+
+		if(moveFlags(moves[i]) == MF_PROMOTION){
+			int promo = movePromo(moves[i]);
+			char c = (char)tolower(str[4]);
+
+			if(!((c == 'n' && promo == P_KNIGHT) || (c == 'b' && promo == P_BISHOP) ||
+				 (c == 'r' && promo == P_ROOK) || ((c == 'q' || isspace(c) || c == 0) && promo == P_QUEEN)))
+				continue;
+		}
+
+		return moves[i];
+	}
+
+	return MOVE_NONE;
+}
+
+// standard algebraic notation as found in PGN files ("Nbd7", "exd8=Q+", "O-O")
+Move Position::parseSAN(const char* san)
+{
+	static const char PIECES[] = "PNBRQK";
+	Move moves[MAX_MOVES];
+	char buf[16];
+	int len = 0, n, type = P_PAWN, promo = P_NONE;
+	int fromFile = -1, fromRank = -1, to;
+	const char* p;
+
+	// drop capture marks, check marks and annotations
+	for(p = san; *p && !isspace(*p) && len < (int)sizeof(buf) - 1; ++p){
+		if(*p != 'x' && *p != '+' && *p != '#' && *p != '!' && *p != '?')
+			buf[len++] = *p;
+	}
+	buf[len] = 0;
+
+	n = genLegalMoves(moves);
+
+	if(strcmp(buf, "O-O") == 0 || strcmp(buf, "0-0") == 0 || strcmp(buf, "O-O-O") == 0 || strcmp(buf, "0-0-0") == 0){
+		bool kingSide = (len == 3);
+
+		for(int i=0; i<n; ++i){
+			if(moveFlags(moves[i]) == MF_CASTLE && (moveTo(moves[i]) > moveFrom(moves[i])) == kingSide)
+				return moves[i];
+		}
+
+		return MOVE_NONE;
+	}
+
+	// promotion piece, with or without the '='
+	if(len >= 2 && strchr("NBRQnbrq", buf[len - 1]) && (buf[len - 2] == '=' || isdigit(buf[len - 2]))){
+		promo = (int)(strchr(PIECES, toupper(buf[len - 1])) - PIECES);
+		len -= (buf[len - 2] == '=') ? 2 : 1;
+		buf[len] = 0;
+	}
+
+	if(len < 2)
+		return MOVE_NONE;
+
+	p = buf;
+	if(*p && strchr("NBRQK", *p)){
+		type = (int)(strchr(PIECES, *p) - PIECES);
+		++p;
+	}
+
+	// whatever sits between the piece and the destination disambiguates
+	for(; p < buf + len - 2; ++p){
+		if(*p >= 'a' && *p <= 'h')
+			fromFile = *p - 'a';
+		else if(*p >= '1' && *p <= '8')
+			fromRank = *p - '1';
+	}
+
+	if(buf[len - 2] < 'a' || buf[len - 2] > 'h' || buf[len - 1] < '1' || buf[len - 1] > '8')
+		return MOVE_NONE;
+	to = makeSquare(buf[len - 2] - 'a', buf[len - 1] - '1');
+
+	for(int i=0; i<n; ++i){
+		Move m = moves[i];
+
+		if(moveTo(m) != to || moveFlags(m) == MF_CASTLE || pieceType(m_board[moveFrom(m)]) != type)
+			continue;
+		if(fromFile >= 0 && fileOf(moveFrom(m)) != fromFile)
+			continue;
+		if(fromRank >= 0 && rankOf(moveFrom(m)) != fromRank)
+			continue;
+		if((moveFlags(m) == MF_PROMOTION) != (promo != P_NONE))
+			continue;
+		if(promo != P_NONE && movePromo(m) != promo)
+			continue;
+
+		return m;
+	}
+
+	return MOVE_NONE;
+}
+
+void Position::moveToStr(Move m, char* str)
+{
+	str[0] = (char)('a' + fileOf(moveFrom(m)));
+	str[1] = (char)('1' + rankOf(moveFrom(m)));
+	str[2] = (char)('a' + fileOf(moveTo(m)));
+	str[3] = (char)('1' + rankOf(moveTo(m)));
+	str[4] = 0;
+
+	if(moveFlags(m) == MF_PROMOTION){
+		str[4] = "nbrq"[movePromo(m) - P_KNIGHT];
+		str[5] = 0;
+	}
+}
+
+bool Position::isDraw(void) const
+{
+	const StateInfo& st = m_states[m_stateIdx];
+
+	if(st.halfmove >= 100)
+		return true;
+
+	// a single repetition is enough to score the line as a draw
+	for(int i=m_stateIdx - 2; i >= 0 && i >= m_stateIdx - st.halfmove; i -= 2){
+		if(m_states[i].key == st.key)
+			return true;
+	}
+
+	// insufficient material: bare kings or a single minor piece
+	if(!(m_pieces[SIDE_WHITE][P_PAWN] | m_pieces[SIDE_BLACK][P_PAWN] |
+		 m_pieces[SIDE_WHITE][P_ROOK] | m_pieces[SIDE_BLACK][P_ROOK] |
+		 m_pieces[SIDE_WHITE][P_QUEEN] | m_pieces[SIDE_BLACK][P_QUEEN])){
+		if(popCount(getOccupied()) <= 3)
+			return true;
+	}
+
+	return false;
+}
+
+void Position::print(void) const
+{
+	char fen[128];
+
+	for(int rank=7; rank>=0; --rank){
+		for(int file=0; file<8; ++file){
+			int piece = m_board[makeSquare(file, rank)];
+			printf("%c ", (piece == NO_PIECE) ? '.' : PIECE_CHARS[(pieceType(piece) << 1) | pieceSide(piece)]);
+		}
+		printf("\n");
+	}
+
+	getFEN(fen);
+	printf("%s\nkey: %016llx\n", fen, getKey());
+}
@@ -0,0 +1,227 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include "bitboard.h"
+
+#define MAX_MOVES	256
+#define MAX_HISTORY	2048		// game moves plus search plies
+
+#define START_FEN	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// move layout: from (6 bits), to (6 bits), promotion piece (2 bits), flags (2 bits)
+typedef unsigned int Move;
+
+#define MOVE_NONE	0
+#define MOVE_NULL	65
+
+enum moveFlags{
+	MF_NORMAL = 0,
+	MF_PROMOTION,
+	MF_ENPASSANT,
+	MF_CASTLE
+};
+
+enum castleRights{
+	CASTLE_WK = 1,
+	CASTLE_WQ = 2,
+	CASTLE_BK = 4,
+	CASTLE_BQ = 8
+};
+
+inline Move encodeMove(int from, int to, int flags = MF_NORMAL, int promo = P_KNIGHT)
+{
+	return from | (to << 6) | ((promo - P_KNIGHT) << 12) | (flags << 14);
+}
+
+inline int moveFrom(Move m)		{ return m & 63; }
+inline int moveTo(Move m)		{ return (m >> 6) & 63; }
+inline int movePromo(Move m)	{ return ((m >> 12) & 3) + P_KNIGHT; }
+inline int moveFlags(Move m)	{ return (m >> 14) & 3; }
+
+// pieces changed by the last move, from or to is SQ_NONE when a piece appears or disappears
+struct DirtyPiece{
+	int count;
+	int piece[3];
+	int from[3];
+	int to[3];
+};
+
+// rules core used by the built-in engine
+class Position{
+public:
+	Position();
+
+	// setup functions
+	bool setFEN(const char* fen);
+	void getFEN(char* fen) const;
+	bool setPosition(const char* str);					// "position startpos moves e2e4 ..."
+	void setPieces(const int* pieces, const int* squares, int n, int side);	// no castling or en passant
+
+	// move functions
+	bool makeMove(Move m);								// returns false (and takes back) if illegal
+	void unmakeMove(Move m);
+	void makeNullMove(void);
+	void unmakeNullMove(void);
+	int genMoves(Move* list) const;						// all pseudo-legal moves
+	int genCaptures(Move* list) const;					// captures and queen promotions
+	int genLegalMoves(Move* list);
+	Move parseMove(const char* str);
+	Move parseSAN(const char* san);
+	static void moveToStr(Move m, char* str);
+
+	// getter functions
+	int getSide(void) const;
+	int getPieceAt(int sq) const;
+	int getCastle(void) const;
+	int getEnPassant(void) const;
+	int getHalfmove(void) const;
+	int getKingSquare(int side) const;
+	U64 getPieces(int side, int type) const;
+	U64 getPieces(int side) const;
+	U64 getOccupied(void) const;
+	U64 getKey(void) const;
+	U64 getPawnKey(void) const;							// pawns only, for the pawn structure hash
+	int getNonPawnMaterial(int side) const;
+
+	// move history, used to update evaluation caches incrementally
+	int getStateIndex(void) const;
+	U64 getStateKey(int idx) const;
+	const DirtyPiece& getDirtyPiece(int idx) const;
+
+	bool isAttacked(int sq, int bySide) const;
+	bool inCheck(void) const;
+	bool isCapture(Move m) const;
+	bool isDraw(void) const;
+
+	// debugging
+	void print(void) const;
+
+private:
+	struct StateInfo{
+		U64 key;
+		U64 pawnKey;
+		int castle;
+		int ep;
+		int halfmove;
+		int captured;
+		DirtyPiece dirty;
+	};
+
+	void clear(void);
+	void putPiece(int piece, int sq);
+	void removePiece(int sq);
+	void movePiece(int from, int to);
+	void setEnPassant(int sq);
+	void addDirty(int piece, int from, int to);
+	int generate(Move* list, bool quiets) const;
+
+	U64 m_pieces[2][6];
+	U64 m_sidePieces[2];
+	int m_board[SQUARE_NB];
+	int m_side;
+	int m_fullmove;
+
+	StateInfo m_states[MAX_HISTORY];
+	int m_stateIdx;										// index of the current state (kept as an index so copies stay valid)
+};
+
+inline int Position::getSide(void) const
+{
+	return m_side;
+}
+
+inline int Position::getPieceAt(int sq) const
+{
+	return m_board[sq];
+}
+
+inline int Position::getCastle(void) const
+{
+	return m_states[m_stateIdx].castle;
+}
+
+inline int Position::getEnPassant(void) const
+{
+	return m_states[m_stateIdx].ep;
+}
+
+inline int Position::getHalfmove(void) const
+{
+	return m_states[m_stateIdx].halfmove;
+}
+
+inline int Position::getKingSquare(int side) const
+{
+	return lsb(m_pieces[side][P_KING]);
+}
+
+inline U64 Position::getPieces(int side, int type) const
+{
+	return m_pieces[side][type];
+}
+
+inline U64 Position::getPieces(int side) const
+{
+	return m_sidePieces[side];
+}
+
+inline U64 Position::getOccupied(void) const
+{
+	return m_sidePieces[SIDE_WHITE] | m_sidePieces[SIDE_BLACK];
+}
+
+inline U64 Position::getKey(void) const
+{
+	return m_states[m_stateIdx].key;
+}
+
+inline U64 Position::getPawnKey(void) const
+{
+	return m_states[m_stateIdx].pawnKey;
+}
+
+inline int Position::getStateIndex(void) const
+{
+	return m_stateIdx;
+}
+
+inline U64 Position::getStateKey(int idx) const
+{
+	return m_states[idx].key;
+}
+
+inline const DirtyPiece& Position::getDirtyPiece(int idx) const
+{
+	return m_states[idx].dirty;
+}
+
+inline bool Position::inCheck(void) const
+{
+	return isAttacked(getKingSquare(m_side), m_side ^ 1);
+}
+
+inline bool Position::isCapture(Move m) const
+{
+	return m_board[moveTo(m)] != NO_PIECE || moveFlags(m) == MF_ENPASSANT;
+}
@@ -0,0 +1,981 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#else
+	#include <sys/time.h>
+#endif
+
+#include "search.h"
+#include "tablebase.h"
+#include "syzygy.h"
+
+// default selectivity, {name, value, min, max}
+static const SearchParam DEFAULT_PARAMS[NUM_SEARCH_PARAMS] = {
+	{ "NullMove",				1,		0,		1 },
+	{ "NullMinDepth",			3,		1,		8 },
+	{ "NullReduction",			3,		1,		6 },
+	{ "NullDepthDivisor",		4,		1,		12 },
+	{ "NullEvalDivisor",		200,	50,		800 },
+	{ "LMR",					1,		0,		1 },
+	{ "LMRMinDepth",			3,		1,		8 },
+	{ "LMRMinMoves",			3,		1,		12 },
+	{ "LMRBase",				75,		0,		200 },
+	{ "LMRDivisor",				225,	100,	500 },
+	{ "ReverseFutility",		1,		0,		1 },
+	{ "RFPMaxDepth",			8,		1,		12 },
+	{ "RFPMargin",				80,		20,		250 },
+	{ "Futility",				1,		0,		1 },
+	{ "FutilityMaxDepth",		6,		1,		10 },
+	{ "FutilityBase",			80,		0,		300 },
+	{ "FutilityMargin",			90,		20,		300 },
+	{ "LateMovePruning",		1,		0,		1 },
+	{ "LMPMaxDepth",			8,		1,		12 },
+	{ "LMPBase",				3,		0,		12 }
+};
+
+// ln(n) * 1024 rounded, so the reductions and with them the bench signature
+// don't depend on the compiler's libm
+static const int LOG_1024[64] = {
+	0, 0, 710, 1125, 1420, 1648, 1835, 1993,
+	2129, 2250, 2358, 2455, 2545, 2627, 2702, 2773,
+	2839, 2901, 2960, 3015, 3068, 3118, 3165, 3211,
+	3254, 3296, 3336, 3375, 3412, 3448, 3483, 3516,
+	3549, 3580, 3611, 3641, 3670, 3698, 3725, 3751,
+	3777, 3803, 3827, 3851, 3875, 3898, 3921, 3943,
+	3964, 3985, 4006, 4026, 4046, 4066, 4085, 4104,
+	4122, 4140, 4158, 4175, 4193, 4210, 4226, 4243
+};
+
+// on/off switches touched by setSelectivity()
+static const int SELECTIVITY_SWITCHES[] = { SP_NULL_MOVE, SP_LMR, SP_RFP, SP_FUTILITY, SP_LMP };
+
+// move ordering buckets
+static const int ORDER_TT		= 1 << 30;
+static const int ORDER_CAPTURE	= 1 << 28;
+static const int ORDER_KILLER1	= 1 << 27;
+static const int ORDER_KILLER2	= (1 << 27) - 1;
+
+static const int HISTORY_MAX	= 16384;
+
+unsigned int getTimeMs(void)
+{
+#if defined(_WIN32)
+	return GetTickCount();
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned int)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
+}
+
+Search::Search(TransTable& tt) : m_tt(tt)
+{
+	memcpy(m_params, DEFAULT_PARAMS, sizeof(m_params));
+
+	m_bestMove = MOVE_NONE;
+	m_score = 0;
+	m_depth = 0;
+	m_nodes = 0;
+	m_tbHits = 0;
+	m_startTime = 0;
+	m_ponderMove = MOVE_NONE;
+	m_stop = false;
+	m_pondering = false;
+	m_stopOnPonderhit = false;
+	m_ponderHit = false;
+	m_stopRequested = false;
+	m_searching = false;
+	m_output = false;
+	m_numLines = 0;
+	m_multiPV = 1;
+	m_pvIdx = 0;
+	m_statsFile = NULL;
+	m_statsPath[0] = 0;
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	clearHistory();
+	initReductions();
+}
+
+Search::~Search()
+{
+	setStatsFile(NULL);
+}
+
+bool Search::setStatsFile(const char* file)
+{
+	if(m_statsFile)
+		fclose(m_statsFile);
+
+	m_statsFile = NULL;
+	m_statsPath[0] = 0;
+
+	if(file == NULL || file[0] == 0)
+		return true;
+
+	m_statsFile = fopen(file, "a");
+	if(m_statsFile == NULL){
+		printf("Can't open the search statistics file %s\n", file);
+		return false;
+	}
+
+	strncpy(m_statsPath, file, sizeof(m_statsPath) - 1);
+	m_statsPath[sizeof(m_statsPath) - 1] = 0;
+
+	// a new file gets the column names
+	fseek(m_statsFile, 0, SEEK_END);
+	if(ftell(m_statsFile) == 0)
+		fprintf(m_statsFile, "depth,seldepth,nodes,qnodes,nps,tt_hit_pct,ebf,first_move_cutoff_pct,iteration_ms,total_ms\n");
+
+	return true;
+}
+
+double Search::getTTHitRate(void) const
+{
+	return m_stats.ttProbes ? 100.0 * m_stats.ttHits / m_stats.ttProbes : 0.0;
+}
+
+double Search::getFirstMoveCutoffRate(void) const
+{
+	return m_stats.cutoffs ? 100.0 * m_stats.firstMoveCutoffs / m_stats.cutoffs : 0.0;
+}
+
+double Search::getBranchingFactor(void) const
+{
+	return m_stats.prevIterationNodes ? (double)m_stats.iterationNodes / m_stats.prevIterationNodes : 0.0;
+}
+
+void Search::printStats(void) const
+{
+	unsigned int elapsed = getTimeMs() - m_startTime;
+
+	printf("info string stats depth %d seldepth %d nodes %llu qnodes %llu nps %llu tthit %.1f%% ebf %.2f firstcut %.1f%% time %u/%u ms\n",
+		m_depth, m_stats.selDepth, m_nodes, m_stats.qnodes, (elapsed > 0) ? m_nodes * 1000 / elapsed : m_nodes,
+		getTTHitRate(), getBranchingFactor(), getFirstMoveCutoffRate(), m_stats.iterationTime, elapsed);
+	fflush(stdout);
+}
+
+void Search::writeStats(void)
+{
+	unsigned int elapsed = getTimeMs() - m_startTime;
+
+	fprintf(m_statsFile, "%d,%d,%llu,%llu,%llu,%.2f,%.3f,%.2f,%u,%u\n",
+		m_depth, m_stats.selDepth, m_nodes, m_stats.qnodes, (elapsed > 0) ? m_nodes * 1000 / elapsed : m_nodes,
+		getTTHitRate(), getBranchingFactor(), getFirstMoveCutoffRate(), m_stats.iterationTime, elapsed);
+	fflush(m_statsFile);
+}
+
+void Search::clearHistory(void)
+{
+	memset(m_killers, 0, sizeof(m_killers));
+	memset(m_history, 0, sizeof(m_history));
+}
+
+// logarithmic late move reductions indexed by [depth][move number]:
+// base / 100 + ln(d) * ln(m) / (divisor / 100), worked out in integers
+void Search::initReductions(void)
+{
+	long long base = getParam(SP_LMR_BASE);
+	long long divisor = getParam(SP_LMR_DIVISOR);
+
+	for(int d=0; d<64; ++d){
+		for(int m=0; m<64; ++m){
+			long long scaled = base * divisor * 1024 * 1024 + 10000LL * LOG_1024[d] * LOG_1024[m];
+
+			m_reductions[d][m] = (d == 0 || m == 0) ? 0 : (int)(scaled / (100 * divisor * 1024 * 1024));
+		}
+	}
+}
+
+bool Search::setParam(const char* name, int value)
+{
+	for(int i=0; i<NUM_SEARCH_PARAMS; ++i){
+		if(strcmp(m_params[i].name, name) == 0){
+			setParam(i, value);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Search::setParam(int param, int value)
+{
+	if(value < m_params[param].min)
+		value = m_params[param].min;
+	if(value > m_params[param].max)
+		value = m_params[param].max;
+
+	m_params[param].value = value;
+
+	if(param == SP_LMR_BASE || param == SP_LMR_DIVISOR)
+		initReductions();
+}
+
+U64 Search::getSignature(void) const
+{
+	U64 hash = 0xCBF29CE484222325ULL;
+
+	hash = (hash ^ EVAL_VERSION) * 0x100000001B3ULL;
+	hash = (hash ^ Evaluator::getParamsId()) * 0x100000001B3ULL;
+	hash = (hash ^ Network::inst().getHash()) * 0x100000001B3ULL;
+
+	for(int i=0; i<NUM_SEARCH_PARAMS; ++i)
+		hash = (hash ^ (unsigned int)m_params[i].value) * 0x100000001B3ULL;
+
+	return hash;
+}
+
+void Search::setSelectivity(bool enable)
+{
+	for(unsigned int i=0; i<sizeof(SELECTIVITY_SWITCHES) / sizeof(SELECTIVITY_SWITCHES[0]); ++i)
+		setParam(SELECTIVITY_SWITCHES[i], enable ? 1 : 0);
+}
+
+int Search::scoreToTT(int score, int ply)
+{
+	if(score >= VALUE_MATE_IN_MAX)
+		return score + ply;
+	if(score <= -VALUE_MATE_IN_MAX)
+		return score - ply;
+
+	return score;
+}
+
+int Search::scoreFromTT(int score, int ply)
+{
+	if(score >= VALUE_MATE_IN_MAX)
+		return score - ply;
+	if(score <= -VALUE_MATE_IN_MAX)
+		return score + ply;
+
+	return score;
+}
+
+void Search::checkLimits(void)
+{
+	if(m_pondering)
+		return;
+
+	if(m_limits.movetime && getTimeMs() - m_startTime >= m_limits.movetime)
+		m_stop = true;
+
+	if(m_limits.time && getTimeMs() - m_startTime >= m_timeMan.getMaximum())
+		m_stop = true;
+
+	if(m_limits.nodes && m_nodes >= m_limits.nodes)
+		m_stop = true;
+}
+
+// the predicted move was played: the time spent pondering counts, so a search
+// that already used its budget stops right away. The hit stays latched, so a
+// ponder search whose thread hasn't reached think() yet starts out as a normal one.
+void Search::ponderhit(void)
+{
+	m_ponderLock.lock();
+	m_ponderHit = true;
+	m_pondering = false;
+
+	if(m_stopOnPonderhit)
+		m_stop = true;
+	m_ponderLock.unlock();
+}
+
+void Search::clearPonderhit(void)
+{
+	m_ponderLock.lock();
+	m_ponderHit = false;
+	m_ponderLock.unlock();
+}
+
+// a ponder search has no limits, so a stop that lands before think() clears
+// m_stop would leave it running forever. The request stays latched until
+// clearStop(); searches with limits ignore it.
+void Search::requestStop(void)
+{
+	m_ponderLock.lock();
+	m_stopRequested = true;
+	m_stop = true;
+	m_ponderLock.unlock();
+}
+
+void Search::clearStop(void)
+{
+	m_ponderLock.lock();
+	m_stopRequested = false;
+	m_ponderLock.unlock();
+}
+
+void Search::clearLines(void)
+{
+	m_lineLock.lock();
+	m_numLines = 0;
+	m_lineLock.unlock();
+}
+
+bool Search::getLines(SearchLine* lines, int& num)
+{
+	if(!m_lineLock.tryLock())
+		return false;
+
+	num = m_numLines;
+	for(int i=0; i<num; ++i){
+		lines[i].depth = m_lines[i].depth;
+		lines[i].score = m_lines[i].score;
+		lines[i].length = m_lines[i].length;
+		memcpy(lines[i].moves, m_lines[i].moves, m_lines[i].length * sizeof(Move));
+	}
+
+	m_lineLock.unlock();
+	return true;
+}
+
+// the iteration's lines become visible to getLines() all at once
+void Search::publishLines(int num)
+{
+	m_lineLock.lock();
+	memcpy(m_lines, m_rootLines, num * sizeof(SearchLine));
+	m_numLines = num;
+	m_lineLock.unlock();
+
+	if(m_output){
+		for(int i=0; i<num; ++i)
+			printInfo(m_lines[i], i);
+	}
+}
+
+bool Search::isExcluded(Move m) const
+{
+	for(int i=0; i<m_pvIdx; ++i){
+		if(m_rootLines[i].moves[0] == m)
+			return true;
+	}
+
+	if(m_limits.numSearchMoves == 0)
+		return false;
+
+	for(int i=0; i<m_limits.numSearchMoves; ++i){
+		if(m_limits.searchMoves[i] == m)
+			return false;
+	}
+
+	return true;
+}
+
+void Search::printInfo(const SearchLine& line, int pvIdx)
+{
+	char buf[8];
+	unsigned int elapsed = getTimeMs() - m_startTime;
+
+	printf("info depth %d", line.depth);
+
+	if(m_multiPV > 1)
+		printf(" multipv %d", pvIdx + 1);
+
+	if(line.score >= VALUE_MATE_IN_MAX)
+		printf(" score mate %d", (VALUE_MATE - line.score + 1) / 2);
+	else if(line.score <= -VALUE_MATE_IN_MAX)
+		printf(" score mate -%d", (VALUE_MATE + line.score) / 2);
+	else
+		printf(" score cp %d", line.score);
+
+	printf(" nodes %llu time %u nps %llu", m_nodes, elapsed,
+		(elapsed > 0) ? m_nodes * 1000 / elapsed : m_nodes);
+
+	if(m_tbHits)
+		printf(" tbhits %llu", m_tbHits);
+
+	printf(" pv");
+
+	for(int i=0; i<line.length; ++i){
+		Position::moveToStr(line.moves[i], buf);
+		printf(" %s", buf);
+	}
+
+	printf("\n");
+	fflush(stdout);
+}
+
+Move Search::think(const Position& pos, const SearchLimits& limits)
+{
+	Move moves[MAX_MOVES];
+	int numLegal;
+
+	m_pos = pos;
+	m_limits = limits;
+	m_startTime = getTimeMs();
+	m_nodes = 0;
+	m_tbHits = 0;
+	m_searching = true;
+	m_depth = 0;
+	m_score = 0;
+	m_bestMove = MOVE_NONE;
+	m_ponderMove = MOVE_NONE;
+	m_pvIdx = 0;
+
+	m_ponderLock.lock();
+	m_stop = limits.ponder && m_stopRequested;
+	m_pondering = limits.ponder && !m_ponderHit;
+	m_ponderHit = false;
+	m_stopOnPonderhit = false;
+	m_ponderLock.unlock();
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	memset(m_killers, 0, sizeof(m_killers));
+	clearLines();
+	m_tt.newSearch();
+
+	if(limits.time)
+		m_timeMan.init(limits.time, limits.inc, limits.movestogo);
+
+	// always have something to play, even if the first iteration is cut short.
+	// A move list with nothing legal in it is ignored.
+	numLegal = m_pos.genLegalMoves(moves);
+	if(m_limits.numSearchMoves > 0){
+		int allowed = 0;
+
+		for(int i=0; i<numLegal; ++i)
+			if(!isExcluded(moves[i]))
+				moves[allowed++] = moves[i];
+
+		if(allowed > 0)
+			numLegal = allowed;
+		else
+			m_limits.numSearchMoves = 0;
+	}
+	if(numLegal > 0)
+		m_bestMove = moves[0];
+
+	m_multiPV = (limits.multipv < MAX_MULTIPV) ? limits.multipv : MAX_MULTIPV;
+	if(m_multiPV > numLegal)
+		m_multiPV = numLegal;
+	if(m_multiPV < 1)
+		m_multiPV = 1;
+
+	m_eval.setUseBitbase(limits.tablebases);
+
+	// endgame tables know the exact result, so there is nothing to search
+	if(limits.tablebases && m_limits.numSearchMoves == 0 && probeTablebases())
+		return m_bestMove;
+
+	for(int depth=1; depth<=limits.depth && depth<MAX_PLY; ++depth){
+		unsigned int iterationStart = getTimeMs();
+		U64 iterationStartNodes = m_nodes;
+
+		// each further line searches the root without the moves of the lines before it
+		for(m_pvIdx=0; m_pvIdx<m_multiPV; ++m_pvIdx){
+			SearchLine& line = m_rootLines[m_pvIdx];
+			int alpha = -VALUE_INF, beta = VALUE_INF;
+			int delta = 25;
+			int score;
+
+			// aspiration window around the line's previous score
+			if(depth >= 5){
+				alpha = (line.score - delta > -VALUE_INF) ? line.score - delta : -VALUE_INF;
+				beta = (line.score + delta < VALUE_INF) ? line.score + delta : VALUE_INF;
+			}
+
+			for(;;){
+				score = search(alpha, beta, depth, 0, false);
+
+				if(m_stop)
+					break;
+
+				delta += delta;
+				if(score <= alpha){
+					alpha = (score - delta > -VALUE_INF) ? score - delta : -VALUE_INF;
+					if(m_pvIdx == 0)
+						m_timeMan.failLow();
+				}
+				else if(score >= beta){
+					beta = (score + delta < VALUE_INF) ? score + delta : VALUE_INF;
+				}
+				else{
+					break;
+				}
+			}
+
+			if(m_stop)
+				break;
+
+			line.depth = depth;
+			line.score = score;
+			line.length = m_pvLen[0];
+			memcpy(line.moves, m_pv[0], m_pvLen[0] * sizeof(Move));
+		}
+
+		if(m_stop)
+			break;
+
+		// a later line can come out ahead when the search is unstable
+		for(int i=1; i<m_multiPV; ++i){
+			for(int j=i; j>0 && m_rootLines[j].score > m_rootLines[j - 1].score; --j){
+				SearchLine tmp = m_rootLines[j];
+
+				m_rootLines[j] = m_rootLines[j - 1];
+				m_rootLines[j - 1] = tmp;
+			}
+		}
+
+		if(m_rootLines[0].length > 0)
+			m_bestMove = m_rootLines[0].moves[0];
+		m_ponderMove = (m_rootLines[0].length > 1) ? m_rootLines[0].moves[1] : MOVE_NONE;
+		m_score = m_rootLines[0].score;
+		m_depth = depth;
+
+		m_stats.prevIterationNodes = m_stats.iterationNodes;
+		m_stats.iterationNodes = m_nodes - iterationStartNodes;
+		m_stats.iterationTime = getTimeMs() - iterationStart;
+
+		publishLines(m_multiPV);
+
+		if(m_output)
+			printStats();
+		if(m_statsFile)
+			writeStats();
+
+		if(m_limits.time)
+			m_timeMan.update(m_bestMove, m_score);
+
+		// the next iteration would not finish in the remaining time. While
+		// pondering the clock isn't running yet, so only remember to stop at the hit.
+		if((m_limits.movetime && getTimeMs() - m_startTime > m_limits.movetime / 2)
+			|| (m_limits.time && m_timeMan.stopIteration(getTimeMs() - m_startTime))){
+			bool hit;
+
+			m_ponderLock.lock();
+			hit = !m_pondering;
+			if(!hit)
+				m_stopOnPonderhit = true;
+			m_ponderLock.unlock();
+
+			if(hit)
+				break;
+		}
+	}
+
+	m_searching = false;
+	return m_bestMove;
+}
+
+bool Search::probeTablebases(void)
+{
+	int value;
+	Move move = Tablebases::inst().probeRoot(m_pos, value);
+
+	if(move != MOVE_NONE){
+		// mate in n moves is 2n - 1 plies away
+		if(tbIsWin(value))
+			m_score = VALUE_MATE - (2 * value - 1);
+		else if(tbIsLoss(value))
+			m_score = -VALUE_MATE + 2 * (value - TB_LOSS);
+		else
+			m_score = 0;
+	}
+	else{
+		// Syzygy only knows the result and the distance to the next capture or
+		// pawn move, so a win scores just below the mate range
+		move = Syzygy::inst().probeRoot(m_pos, value);
+		if(move == MOVE_NONE)
+			return false;
+
+		if(value == WDL_WIN)
+			m_score = VALUE_MATE_IN_MAX - 1;
+		else if(value == WDL_LOSS)
+			m_score = -VALUE_MATE_IN_MAX + 1;
+		else
+			m_score = 0;
+
+		++m_tbHits;
+	}
+
+	m_bestMove = move;
+	m_rootLines[0].depth = 1;
+	m_rootLines[0].score = m_score;
+	m_rootLines[0].length = 1;
+	m_rootLines[0].moves[0] = move;
+	m_multiPV = 1;
+	m_depth = 1;
+	m_searching = false;
+
+	publishLines(1);
+
+	return true;
+}
+
+void Search::scoreMoves(const Move* list, int* scores, int n, Move ttMove, int ply)
+{
+	for(int i=0; i<n; ++i){
+		Move m = list[i];
+
+		if(m == ttMove){
+			scores[i] = ORDER_TT;
+		}
+		else if(m_pos.isCapture(m) || moveFlags(m) == MF_PROMOTION){
+			// most valuable victim, least valuable attacker
+			int victim = (moveFlags(m) == MF_ENPASSANT || m_pos.getPieceAt(moveTo(m)) == NO_PIECE)
+				? P_PAWN : pieceType(m_pos.getPieceAt(moveTo(m)));
+			int attacker = pieceType(m_pos.getPieceAt(moveFrom(m)));
+
+			scores[i] = ORDER_CAPTURE + Evaluator::pieceValue(victim) * 16 - attacker;
+			if(moveFlags(m) == MF_PROMOTION)
+				scores[i] += Evaluator::pieceValue(movePromo(m));
+		}
+		else if(m == m_killers[ply][0]){
+			scores[i] = ORDER_KILLER1;
+		}
+		else if(m == m_killers[ply][1]){
+			scores[i] = ORDER_KILLER2;
+		}
+		else{
+			scores[i] = m_history[m_pos.getSide()][moveFrom(m)][moveTo(m)];
+		}
+	}
+}
+
+// selection sort step, moves the best remaining move to index i
+Move Search::pickMove(Move* list, int* scores, int n, int i)
+{
+	int best = i;
+
+	for(int j=i+1; j<n; ++j){
+		if(scores[j] > scores[best])
+			best = j;
+	}
+
+	if(best != i){
+		Move m = list[i];
+		int s = scores[i];
+
+		list[i] = list[best];
+		scores[i] = scores[best];
+		list[best] = m;
+		scores[best] = s;
+	}
+
+	return list[i];
+}
+
+void Search::updateQuietStats(Move best, const Move* quiets, int numQuiets, int depth, int ply)
+{
+	int side = m_pos.getSide();
+	int bonus = (depth > 13) ? 32 * 13 * 13 : 32 * depth * depth;
+
+	if(m_killers[ply][0] != best){
+		m_killers[ply][1] = m_killers[ply][0];
+		m_killers[ply][0] = best;
+	}
+
+	// history gravity keeps the values within +/- HISTORY_MAX
+	for(int i=0; i<numQuiets; ++i){
+		int* h = &m_history[side][moveFrom(quiets[i])][moveTo(quiets[i])];
+		int b = (quiets[i] == best) ? bonus : -bonus;
+
+		*h += b - *h * abs(b) / HISTORY_MAX;
+	}
+}
+
+int Search::search(int alpha, int beta, int depth, int ply, bool nullOk)
+{
+	Move moves[MAX_MOVES], quiets[MAX_MOVES];
+	int scores[MAX_MOVES];
+	bool pvNode = (beta - alpha) > 1;
+	bool inCheck, improving;
+	int staticEval, bestScore = -VALUE_INF, origAlpha = alpha;
+	int n, legal = 0, numQuiets = 0;
+	Move ttMove = MOVE_NONE, bestMove = MOVE_NONE;
+	TTEntry tte;
+	bool ttHit;
+
+	m_pvLen[ply] = 0;
+
+	inCheck = m_pos.inCheck();
+	if(inCheck)
+		++depth;
+
+	if(depth <= 0)
+		return quiesce(alpha, beta, ply);
+
+	if((++m_nodes & 1023) == 0)
+		checkLimits();
+	if(m_stop)
+		return 0;
+
+	if(ply > m_stats.selDepth)
+		m_stats.selDepth = ply;
+
+	if(ply > 0){
+		if(m_pos.isDraw())
+			return 0;
+
+		if(ply >= MAX_PLY - 1)
+			return inCheck ? 0 : m_eval.evaluate(m_pos);
+
+		// mate distance pruning
+		if(alpha < -VALUE_MATE + ply)
+			alpha = -VALUE_MATE + ply;
+		if(beta > VALUE_MATE - ply - 1)
+			beta = VALUE_MATE - ply - 1;
+		if(alpha >= beta)
+			return alpha;
+	}
+
+	ttHit = m_tt.probe(m_pos.getKey(), tte);
+	++m_stats.ttProbes;
+	if(ttHit){
+		int ttScore = scoreFromTT(tte.score, ply);
+
+		++m_stats.ttHits;
+		ttMove = tte.move;
+
+		if(!pvNode && tte.depth >= depth){
+			if(tte.getBound() == BOUND_EXACT ||
+			  (tte.getBound() == BOUND_LOWER && ttScore >= beta) ||
+			  (tte.getBound() == BOUND_UPPER && ttScore <= alpha)){
+				return ttScore;
+			}
+		}
+	}
+
+	// right after a capture or pawn move the win/draw/loss tables are exact
+	if(ply > 0 && m_limits.tablebases && m_pos.getHalfmove() == 0 && !m_pos.getCastle()
+		&& popCount(m_pos.getOccupied()) <= Syzygy::inst().getMaxPieces()){
+		int wdl;
+
+		if(Syzygy::inst().probeWDL(m_pos, wdl)){
+			int score = (wdl == WDL_WIN) ? VALUE_MATE_IN_MAX - ply - 1
+				: (wdl == WDL_LOSS) ? -VALUE_MATE_IN_MAX + ply + 1 : 0;
+
+			++m_tbHits;
+			m_tt.store(m_pos.getKey(), MOVE_NONE, scoreToTT(score, ply), score, MAX_PLY - 1, BOUND_EXACT);
+			return score;
+		}
+	}
+
+	if(inCheck)
+		staticEval = -VALUE_INF;
+	else
+		staticEval = ttHit ? tte.eval : m_eval.evaluate(m_pos);
+
+	m_evalStack[ply] = staticEval;
+	improving = !inCheck && ply >= 2 && staticEval > m_evalStack[ply - 2];
+
+	if(!pvNode && !inCheck){
+		// reverse futility pruning: far enough above beta that a quiet move won't drop below it
+		if(getParam(SP_RFP) && depth <= getParam(SP_RFP_MAX_DEPTH)
+			&& staticEval - getParam(SP_RFP_MARGIN) * (depth - (improving ? 1 : 0)) >= beta
+			&& abs(beta) < VALUE_MATE_IN_MAX){
+			return staticEval;
+		}
+
+		// adaptive null move pruning, skipped with only pawns left to avoid zugzwang
+		if(getParam(SP_NULL_MOVE) && nullOk && depth >= getParam(SP_NULL_MIN_DEPTH)
+			&& staticEval >= beta && m_pos.getNonPawnMaterial(m_pos.getSide()) > 0){
+			int evalReduction = (staticEval - beta) / getParam(SP_NULL_EVAL_DIVISOR);
+			int R = getParam(SP_NULL_REDUCTION) + depth / getParam(SP_NULL_DEPTH_DIVISOR)
+				+ ((evalReduction < 3) ? evalReduction : 3);
+			int score;
+
+			m_pos.makeNullMove();
+			score = -search(-beta, -beta + 1, depth - 1 - R, ply + 1, false);
+			m_pos.unmakeNullMove();
+
+			if(m_stop)
+				return 0;
+
+			if(score >= beta)
+				return (score >= VALUE_MATE_IN_MAX) ? beta : score;
+		}
+	}
+
+	n = m_pos.genMoves(moves);
+	scoreMoves(moves, scores, n, ttMove, ply);
+
+	for(int i=0; i<n; ++i){
+		Move m = pickMove(moves, scores, n, i);
+
+		if(ply == 0 && isExcluded(m))
+			continue;
+
+		bool quiet = !m_pos.isCapture(m) && moveFlags(m) != MF_PROMOTION;
+		int newDepth = depth - 1;
+		int score;
+
+		// shallow depth pruning of quiet moves once a real score is known
+		if(ply > 0 && quiet && !inCheck && bestScore > -VALUE_MATE_IN_MAX){
+			if(getParam(SP_LMP) && depth <= getParam(SP_LMP_MAX_DEPTH)
+				&& numQuiets >= (getParam(SP_LMP_BASE) + depth * depth) / (improving ? 1 : 2)){
+				continue;
+			}
+
+			if(getParam(SP_FUTILITY) && depth <= getParam(SP_FUTILITY_MAX_DEPTH)
+				&& staticEval + getParam(SP_FUTILITY_BASE) + getParam(SP_FUTILITY_MARGIN) * depth <= alpha){
+				continue;
+			}
+		}
+
+		if(!m_pos.makeMove(m))
+			continue;
+
+		++legal;
+		if(quiet)
+			quiets[numQuiets++] = m;
+
+		if(legal == 1){
+			score = -search(-beta, -alpha, newDepth, ply + 1, true);
+		}
+		else{
+			int R = 0;
+
+			// late move reductions for quiet moves that don't give check
+			if(getParam(SP_LMR) && quiet && depth >= getParam(SP_LMR_MIN_DEPTH)
+				&& legal > getParam(SP_LMR_MIN_MOVES) && !inCheck && !m_pos.inCheck()){
+				R = m_reductions[(depth < 63) ? depth : 63][(legal < 63) ? legal : 63];
+
+				if(pvNode)
+					--R;
+				if(!improving)
+					++R;
+				if(m == m_killers[ply][0] || m == m_killers[ply][1])
+					--R;
+
+				if(R > newDepth - 1)
+					R = newDepth - 1;
+				if(R < 0)
+					R = 0;
+			}
+
+			score = -search(-alpha - 1, -alpha, newDepth - R, ply + 1, true);
+
+			if(score > alpha && R > 0)
+				score = -search(-alpha - 1, -alpha, newDepth, ply + 1, true);
+
+			if(score > alpha && score < beta)
+				score = -search(-beta, -alpha, newDepth, ply + 1, true);
+		}
+
+		m_pos.unmakeMove(m);
+
+		if(m_stop)
+			return 0;
+
+		if(score > bestScore){
+			bestScore = score;
+
+			if(score > alpha){
+				alpha = score;
+				bestMove = m;
+
+				// update the principal variation
+				m_pv[ply][0] = m;
+				for(int j=0; j<m_pvLen[ply + 1]; ++j)
+					m_pv[ply][j + 1] = m_pv[ply + 1][j];
+				m_pvLen[ply] = m_pvLen[ply + 1] + 1;
+
+				if(alpha >= beta){
+					++m_stats.cutoffs;
+					if(legal == 1)
+						++m_stats.firstMoveCutoffs;
+
+					if(quiet)
+						updateQuietStats(m, quiets, numQuiets, depth, ply);
+					break;
+				}
+			}
+		}
+	}
+
+	if(legal == 0)
+		return inCheck ? -VALUE_MATE + ply : 0;
+
+	// a root with excluded moves doesn't have its real score
+	if(ply > 0 || (m_pvIdx == 0 && m_limits.numSearchMoves == 0)){
+		m_tt.store(m_pos.getKey(), bestMove, scoreToTT(bestScore, ply), staticEval, depth,
+			(bestScore >= beta) ? BOUND_LOWER : (bestScore > origAlpha) ? BOUND_EXACT : BOUND_UPPER);
+	}
+
+	return bestScore;
+}
+
+int Search::quiesce(int alpha, int beta, int ply)
+{
+	Move moves[MAX_MOVES];
+	int scores[MAX_MOVES];
+	int standPat, bestScore, n;
+
+	m_pvLen[ply] = 0;
+
+	++m_stats.qnodes;
+	if((++m_nodes & 1023) == 0)
+		checkLimits();
+	if(m_stop)
+		return 0;
+
+	if(ply > m_stats.selDepth)
+		m_stats.selDepth = ply;
+
+	if(m_pos.isDraw())
+		return 0;
+
+	standPat = m_eval.evaluate(m_pos);
+	if(ply >= MAX_PLY - 1 || standPat >= beta)
+		return standPat;
+
+	if(standPat > alpha)
+		alpha = standPat;
+	bestScore = standPat;
+
+	n = m_pos.genCaptures(moves);
+	scoreMoves(moves, scores, n, MOVE_NONE, ply);
+
+	for(int i=0; i<n; ++i){
+		Move m = pickMove(moves, scores, n, i);
+		int score;
+
+		if(!m_pos.makeMove(m))
+			continue;
+
+		score = -quiesce(-beta, -alpha, ply + 1);
+		m_pos.unmakeMove(m);
+
+		if(m_stop)
+			return 0;
+
+		if(score > bestScore){
+			bestScore = score;
+
+			if(score > alpha){
+				alpha = score;
+
+				if(alpha >= beta)
+					break;
+			}
+		}
+	}
+
+	return bestScore;
+}
@@ -0,0 +1,280 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include <cstdio>
+
+#include "position.h"
+#include "eval.h"
+#include "tt.h"
+#include "timeman.h"
+#include "thread.h"
+
+#define MAX_PLY				128
+#define MAX_MULTIPV			8
+#define VALUE_INF			32000
+#define VALUE_MATE			31000
+#define VALUE_MATE_IN_MAX	(VALUE_MATE - MAX_PLY)
+
+// tunable selectivity settings, indices into the parameter table
+enum searchParams{
+	SP_NULL_MOVE = 0,
+	SP_NULL_MIN_DEPTH,
+	SP_NULL_REDUCTION,
+	SP_NULL_DEPTH_DIVISOR,
+	SP_NULL_EVAL_DIVISOR,
+	SP_LMR,
+	SP_LMR_MIN_DEPTH,
+	SP_LMR_MIN_MOVES,
+	SP_LMR_BASE,						// hundredths
+	SP_LMR_DIVISOR,						// hundredths
+	SP_RFP,
+	SP_RFP_MAX_DEPTH,
+	SP_RFP_MARGIN,
+	SP_FUTILITY,
+	SP_FUTILITY_MAX_DEPTH,
+	SP_FUTILITY_BASE,
+	SP_FUTILITY_MARGIN,
+	SP_LMP,
+	SP_LMP_MAX_DEPTH,
+	SP_LMP_BASE,
+	NUM_SEARCH_PARAMS
+};
+
+struct SearchParam{
+	const char* name;
+	int value;
+	int min;
+	int max;
+};
+
+struct SearchLimits{
+	int depth;
+	unsigned int movetime;				// milliseconds, 0 for no limit
+	U64 nodes;							// 0 for no limit
+	unsigned int time;					// clock of the side to move in milliseconds, 0 for none
+	unsigned int inc;					// increment per move
+	int movestogo;						// moves to the next time control, 0 for the rest of the game
+	bool ponder;						// no time limits until ponderhit()
+	int multipv;						// number of best lines to search, up to MAX_MULTIPV
+	bool tablebases;					// probe the endgame tables and the KPK bitbase
+	int numSearchMoves;					// root moves to choose from, 0 for all of them
+	Move searchMoves[MAX_MOVES];
+
+	SearchLimits() : depth(MAX_PLY - 1), movetime(0), nodes(0), time(0), inc(0), movestogo(0), ponder(false), multipv(1), tablebases(true), numSearchMoves(0) {}
+};
+
+// counters of one search. Each search thread owns its Search and bumps plain
+// counters, the rates are only worked out when they're read.
+struct SearchStats{
+	U64 qnodes;							// of getNodes(), the quiescence ones
+	U64 ttProbes;
+	U64 ttHits;
+	U64 cutoffs;						// beta cutoffs in the main search
+	U64 firstMoveCutoffs;				// of those, by the first move searched
+	U64 iterationNodes;					// nodes of the last completed iteration
+	U64 prevIterationNodes;				// and of the one before it
+	unsigned int iterationTime;			// milliseconds of the last completed iteration
+	int selDepth;						// deepest ply reached
+};
+
+// one root move's line from a completed iteration
+struct SearchLine{
+	int depth;
+	int score;							// side to move's point of view
+	int length;
+	Move moves[MAX_PLY];
+};
+
+unsigned int getTimeMs(void);
+
+// alpha-beta search for the built-in engine
+class Search{
+public:
+	Search(TransTable& tt);
+	~Search();
+
+	Move think(const Position& pos, const SearchLimits& limits);
+	void stop(void);
+	void requestStop(void);								// also ends a ponder search that hasn't started yet
+	void clearStop(void);								// forgets an earlier request, call before starting a ponder search
+	void ponderhit(void);								// also counts when it comes before the ponder search starts
+	void clearPonderhit(void);							// forgets a late hit for an earlier search, call before starting a ponder search
+	void clearHistory(void);
+	void clearLines(void);
+
+	// best lines of the last completed iteration, sorted by score. Safe to call
+	// from another thread while searching, returns false rather than waiting.
+	bool getLines(SearchLine* lines, int& num);
+
+	// parameter table
+	bool setParam(const char* name, int value);
+	void setParam(int param, int value);
+	int getParam(int param) const;
+	const SearchParam* getParams(void) const;
+	void setSelectivity(bool enable);					// toggles every pruning/reduction switch
+	U64 getSignature(void) const;						// evaluation and parameters, scores are only comparable when it matches
+
+	// statistics, printed with the info lines and optionally logged per iteration
+	bool setStatsFile(const char* file);				// CSV, appended to. NULL or empty to stop logging
+	void printStats(void) const;
+
+	// getter functions
+	int getScore(void) const;
+	Move getPonderMove(void) const;						// expected reply from the last completed iteration
+	int getDepth(void) const;
+	U64 getNodes(void) const;
+	U64 getTbHits(void) const;
+	const SearchStats& getStats(void) const;
+	double getTTHitRate(void) const;					// percent
+	double getFirstMoveCutoffRate(void) const;			// percent
+	double getBranchingFactor(void) const;				// effective, from the last two iterations
+	const char* getStatsFile(void) const;
+	bool isSearching(void) const;
+	Evaluator& getEvaluator(void);
+
+	// setter functions
+	void setOutput(bool output);						// print UCI style info lines
+
+private:
+	int search(int alpha, int beta, int depth, int ply, bool nullOk);
+	int quiesce(int alpha, int beta, int ply);
+	void scoreMoves(const Move* list, int* scores, int n, Move ttMove, int ply);
+	Move pickMove(Move* list, int* scores, int n, int i);
+	void updateQuietStats(Move best, const Move* quiets, int numQuiets, int depth, int ply);
+	void initReductions(void);
+	void checkLimits(void);
+	bool probeTablebases(void);
+	bool isExcluded(Move m) const;
+	void publishLines(int num);
+	void printInfo(const SearchLine& line, int pvIdx);
+	void writeStats(void);
+
+	static int scoreToTT(int score, int ply);
+	static int scoreFromTT(int score, int ply);
+
+	Position m_pos;
+	Evaluator m_eval;
+	TransTable& m_tt;
+	SearchLimits m_limits;
+	TimeManager m_timeMan;
+	SearchParam m_params[NUM_SEARCH_PARAMS];
+
+	Move m_pv[MAX_PLY][MAX_PLY];
+	int m_pvLen[MAX_PLY];
+	Move m_killers[MAX_PLY][2];
+	int m_history[2][SQUARE_NB][SQUARE_NB];
+	int m_evalStack[MAX_PLY];
+	int m_reductions[64][64];
+
+	// multi-PV: lines found so far this iteration, and the last completed ones
+	SearchLine m_rootLines[MAX_MULTIPV];
+	SearchLine m_lines[MAX_MULTIPV];
+	int m_numLines;
+	int m_multiPV;
+	int m_pvIdx;						// root moves of the lines before it are skipped
+	Mutex m_lineLock;
+
+	SearchStats m_stats;
+	FILE* m_statsFile;
+	char m_statsPath[260];
+
+	Move m_bestMove;
+	Move m_ponderMove;
+	int m_score;
+	int m_depth;
+	U64 m_nodes;
+	U64 m_tbHits;
+	unsigned int m_startTime;
+	volatile bool m_stop;
+	volatile bool m_searching;
+	volatile bool m_pondering;
+	volatile bool m_stopOnPonderhit;
+	bool m_ponderHit;					// latched by ponderhit(), taken by the next think()
+	bool m_stopRequested;				// latched by requestStop(), ponder searches start out stopped
+	Mutex m_ponderLock;					// orders ponderhit() and requestStop() against think() and the iteration end
+	bool m_output;
+};
+
+inline void Search::stop(void)
+{
+	m_stop = true;
+}
+
+inline int Search::getParam(int param) const
+{
+	return m_params[param].value;
+}
+
+inline const SearchParam* Search::getParams(void) const
+{
+	return m_params;
+}
+
+inline int Search::getScore(void) const
+{
+	return m_score;
+}
+
+inline Move Search::getPonderMove(void) const
+{
+	return m_ponderMove;
+}
+
+inline int Search::getDepth(void) const
+{
+	return m_depth;
+}
+
+inline U64 Search::getNodes(void) const
+{
+	return m_nodes;
+}
+
+inline U64 Search::getTbHits(void) const
+{
+	return m_tbHits;
+}
+
+inline const SearchStats& Search::getStats(void) const
+{
+	return m_stats;
+}
+
+inline const char* Search::getStatsFile(void) const
+{
+	return m_statsPath;
+}
+
+inline bool Search::isSearching(void) const
+{
+	return m_searching;
+}
+
+inline Evaluator& Search::getEvaluator(void)
+{
+	return m_eval;
+}
+
+inline void Search::setOutput(bool output)
+{
+	m_output = output;
+}
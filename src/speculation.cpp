@@ -0,0 +1,300 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "speculation.h"
+
+Speculation::Speculation()
+{
+	m_numWorkers = 0;
+	m_cpuPercent = 0;
+	m_pos[0] = 0;
+	m_generation = 1;
+	m_planned = true;
+	m_numJobs = 0;
+	m_nextJob = 0;
+	m_running = false;
+	m_active = 0;
+
+	for(int i=0; i<SPEC_MAX_WORKERS; ++i){
+		m_workers[i].tt = NULL;
+		m_workers[i].search = NULL;
+		m_workers[i].generation = 0;
+	}
+
+	memset(m_cache, 0, sizeof(m_cache));
+}
+
+Speculation::~Speculation()
+{
+	stop();
+}
+
+Speculation& Speculation::inst(void)
+{
+	static Speculation speculation;
+	return speculation;
+}
+
+// a share of the cores, at least one worker and never more than replies to search
+bool Speculation::start(int cpuPercent)
+{
+	if(m_running)
+		return true;
+
+	m_cpuPercent = (cpuPercent > 100) ? 100 : cpuPercent;
+	m_numWorkers = getNumCpus() * m_cpuPercent / 100;
+
+	if(m_numWorkers < 1)
+		m_numWorkers = 1;
+	if(m_numWorkers > SPEC_MAX_WORKERS)
+		m_numWorkers = SPEC_MAX_WORKERS;
+
+	m_lock.lock();
+	m_pos[0] = 0;
+	m_planned = true;
+	m_numJobs = m_nextJob = 0;
+	++m_generation;
+	m_lock.unlock();
+
+	m_running = true;
+
+	for(int i=0; i<m_numWorkers; ++i){
+		Worker& w = m_workers[i];
+
+		w.tt = new TransTable();
+		w.tt->resize(SPEC_TT_MB);
+		w.search = new Search(*w.tt);
+		w.generation = 0;
+
+		atomicAdd(&m_active, 1);
+		if(!w.thread.start(&worker, &w)){
+			printf("Failed to start speculative worker %d\n", i);
+			atomicAdd(&m_active, -1);
+			delete w.search;
+			delete w.tt;
+			w.search = NULL;
+			w.tt = NULL;
+			m_numWorkers = i;
+			break;
+		}
+	}
+
+	if(m_numWorkers == 0){
+		m_running = false;
+		return false;
+	}
+
+	return true;
+}
+
+void Speculation::stop(void)
+{
+	if(!m_running)
+		return;
+
+	// a stop can land just before a worker starts its next search, so repeat it
+	m_running = false;
+	while(m_active > 0){
+		for(int i=0; i<m_numWorkers; ++i)
+			m_workers[i].search->stop();
+		sleepMs(10);
+	}
+
+	for(int i=0; i<m_numWorkers; ++i){
+		m_workers[i].thread.join();
+		delete m_workers[i].search;
+		delete m_workers[i].tt;
+		m_workers[i].search = NULL;
+		m_workers[i].tt = NULL;
+	}
+
+	m_numWorkers = 0;
+}
+
+// waits until no worker is on an older position. Called once per change, so
+// unlike the per-frame callers it has to close the start of search race itself.
+void Speculation::stopStale(void)
+{
+	for(;;){
+		bool stale = false;
+
+		for(int i=0; i<m_numWorkers; ++i){
+			Worker& w = m_workers[i];
+
+			if(w.generation != 0 && w.generation != m_generation){
+				w.search->stop();
+				stale = true;
+			}
+		}
+
+		if(!stale)
+			return;
+
+		sleepMs(1);
+	}
+}
+
+void Speculation::setPosition(const char* pos, const SearchLimits& limits)
+{
+	if(!m_running)
+		return;
+
+	if(pos == NULL)
+		pos = "";
+
+	m_lock.lock();
+
+	if(strcmp(pos, m_pos) == 0 && limits.nodes == m_limits.nodes && limits.multipv == m_limits.multipv){
+		m_lock.unlock();
+		return;
+	}
+
+	strncpy(m_pos, pos, sizeof(m_pos) - 1);
+	m_pos[sizeof(m_pos) - 1] = 0;
+	m_limits = limits;
+	m_planned = (m_pos[0] == 0);
+	m_numJobs = m_nextJob = 0;
+	++m_generation;
+
+	m_lock.unlock();
+
+	stopStale();
+}
+
+bool Speculation::probe(U64 key, const SearchLimits& limits, SearchLine* lines, int& num)
+{
+	bool found = false;
+
+	if(!m_running)
+		return false;
+
+	m_lock.lock();
+
+	const SpecEntry& entry = m_cache[key & (SPEC_CACHE_SIZE - 1)];
+	if(entry.key == key && entry.nodes == limits.nodes && entry.multipv == limits.multipv && entry.numLines > 0){
+		num = entry.numLines;
+		memcpy(lines, entry.lines, num * sizeof(SearchLine));
+		found = true;
+	}
+
+	m_lock.unlock();
+	return found;
+}
+
+void Speculation::worker(void* arg)
+{
+	Speculation::inst().run(*(Worker*)arg);
+}
+
+// the first worker to see a new position ranks the replies, then every worker
+// takes the next reply until they run out
+void Speculation::run(Worker& w)
+{
+	char pos[sizeof(m_pos)];
+	Position board;
+	SearchLimits limits;
+	SearchLine lines[MAX_MULTIPV];
+	int num;
+
+	lowerThreadPriority();
+
+	while(m_running){
+		unsigned int generation;
+		Move reply = MOVE_NONE;
+		bool planning = false;
+
+		m_lock.lock();
+		generation = m_generation;
+		if(!m_planned){
+			m_planned = planning = true;
+			strcpy(pos, m_pos);
+		}
+		else if(m_nextJob < m_numJobs){
+			reply = m_jobs[m_nextJob++];
+			strcpy(pos, m_pos);
+			limits = m_limits;
+		}
+		w.generation = (planning || reply != MOVE_NONE) ? generation : 0;
+		m_lock.unlock();
+
+		if(planning){
+			plan(w, pos, generation);
+		}
+		else if(reply != MOVE_NONE && board.setPosition(pos) && board.makeMove(reply)){
+			// the clock isn't running for a position that may never happen
+			limits.time = 0;
+			limits.ponder = false;
+			w.search->clearLines();
+			w.search->think(board, limits);
+
+			// a search cut short by a new position is dropped
+			m_lock.lock();
+			if(generation == m_generation && w.search->getLines(lines, num) && num > 0){
+				SpecEntry& entry = m_cache[board.getKey() & (SPEC_CACHE_SIZE - 1)];
+
+				entry.key = board.getKey();
+				entry.nodes = limits.nodes;
+				entry.multipv = limits.multipv;
+				entry.numLines = num;
+				memcpy(entry.lines, lines, num * sizeof(SearchLine));
+			}
+			m_lock.unlock();
+		}
+		else{
+			sleepMs(20);
+		}
+
+		w.generation = 0;
+	}
+
+	atomicAdd(&m_active, -1);
+}
+
+// the likeliest replies are the ones a shallow multi-PV search rates best
+void Speculation::plan(Worker& w, const char* pos, unsigned int generation)
+{
+	Position board;
+	SearchLimits limits;
+	SearchLine lines[MAX_MULTIPV];
+	int num = 0;
+
+	if(!board.setPosition(pos))
+		return;
+
+	limits.depth = SPEC_RANK_DEPTH;
+	limits.multipv = SPEC_MAX_REPLIES;
+	w.search->clearLines();
+	w.search->think(board, limits);
+
+	if(!w.search->getLines(lines, num))
+		num = 0;
+
+	m_lock.lock();
+	if(generation == m_generation){
+		m_numJobs = m_nextJob = 0;
+		for(int i=0; i<num; ++i)
+			if(lines[i].length > 0)
+				m_jobs[m_numJobs++] = lines[i].moves[0];
+	}
+	m_lock.unlock();
+}
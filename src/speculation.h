@@ -0,0 +1,111 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "search.h"
+
+#define SPEC_MAX_WORKERS	8
+#define SPEC_RANK_DEPTH		6				// shallow search that orders the player's replies
+#define SPEC_MAX_REPLIES	MAX_MULTIPV		// replies searched ahead
+#define SPEC_CACHE_SIZE		64				// positions remembered, power of two
+#define SPEC_TT_MB			16				// per worker
+
+// a finished search of a position the player might move into
+struct SpecEntry{
+	U64 key;
+	U64 nodes;								// limits it was searched with, a hit must match them
+	int multipv;
+	int numLines;
+	SearchLine lines[MAX_MULTIPV];
+};
+
+// while the player thinks, ranks their replies with a shallow search and has
+// background workers search the best few positions with the engine's own
+// limits. When the player moves into one of them the engine answers from the
+// cache instead of searching. The workers run at low priority and their
+// number is a share of the cores, so rendering keeps its CPU.
+class Speculation{
+public:
+	static Speculation& inst(void);
+
+	bool start(int cpuPercent);
+	void stop(void);
+
+	// position with the player to move and the limits the engine will reply
+	// with. NULL stops the workers once the player has moved.
+	void setPosition(const char* pos, const SearchLimits& limits);
+	bool probe(U64 key, const SearchLimits& limits, SearchLine* lines, int& num);
+
+	// getter functions
+	bool isRunning(void) const;
+	int getCpuPercent(void) const;
+	int getNumWorkers(void) const;
+
+private:
+	struct Worker{
+		Thread thread;
+		TransTable* tt;
+		Search* search;
+		volatile unsigned int generation;	// of the job being searched, 0 when idle
+	};
+
+	Speculation();
+	~Speculation();
+	Speculation(const Speculation&);
+	Speculation& operator=(const Speculation&);
+
+	static void worker(void* arg);
+	void run(Worker& w);
+	void plan(Worker& w, const char* pos, unsigned int generation);
+	void stopStale(void);
+
+	Worker m_workers[SPEC_MAX_WORKERS];
+	int m_numWorkers;
+	int m_cpuPercent;
+
+	Mutex m_lock;							// guards everything below
+	char m_pos[4096];
+	SearchLimits m_limits;
+	unsigned int m_generation;				// bumped for every new position, never 0
+	bool m_planned;							// a worker has taken the ranking search
+	Move m_jobs[SPEC_MAX_REPLIES];
+	int m_numJobs;
+	int m_nextJob;
+	SpecEntry m_cache[SPEC_CACHE_SIZE];
+
+	volatile bool m_running;
+	volatile long m_active;					// workers still in their loop
+};
+
+inline bool Speculation::isRunning(void) const
+{
+	return m_running;
+}
+
+inline int Speculation::getCpuPercent(void) const
+{
+	return m_cpuPercent;
+}
+
+inline int Speculation::getNumWorkers(void) const
+{
+	return m_numWorkers;
+}
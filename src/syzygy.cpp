@@ -0,0 +1,1071 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "syzygy.h"
+#include "tablebase.h"
+
+#define WDL_MAGIC		0x5D23E871		// first four bytes, little endian
+#define DTZ_MAGIC		0xA50C66D7
+
+#define MAX_RANK		(1 << 18)		// root rank of a certain win, above any distance
+
+// per table flags
+#define FLAG_STM			1
+#define FLAG_MAPPED			2
+#define FLAG_WIN_PLIES		4
+#define FLAG_LOSS_PLIES		8
+#define FLAG_WIDE			16
+#define FLAG_SINGLE_VALUE	128
+
+enum probeStates{
+	PROBE_FAIL = 0,
+	PROBE_OK,
+	PROBE_CHANGE_STM,				// the DTZ table only holds the other side to move
+	PROBE_ZEROING					// the best move is a capture or pawn move
+};
+
+// decoding data of one sub-table, a file has one per side to move and leading pawn file
+struct PairsData{
+	int flags;
+	int maxSymLen;
+	int minSymLen;
+	U64 numBlocks;
+	U64 sizeofBlock;
+	U64 span;								// a sparse index entry for every span values
+	const unsigned char* lowestSym;			// lowest symbol of each length, 16 bit
+	const unsigned char* btree;				// 3 bytes per symbol, left and right 12 bit children
+	const unsigned char* blockLength;		// values in each block minus one, 16 bit
+	U64 blockLengthSize;
+	const unsigned char* sparseIndex;		// 6 bytes, 32 bit block and 16 bit offset
+	U64 sparseIndexSize;
+	const unsigned char* data;
+	std::vector<U64> base64;				// lowest symbol of each length, left aligned
+	std::vector<unsigned char> symlen;		// values a symbol expands to, minus one
+	int pieces[SYZYGY_MAX_PIECES];
+	U64 groupIdx[SYZYGY_MAX_PIECES + 1];
+	int groupLen[SYZYGY_MAX_PIECES + 1];
+	int mapIdx[4];							// DTZ value maps for win, loss, cursed win, blessed loss
+};
+
+struct SyzygyTable{
+	MappedFile file;
+	PairsData items[2][4];					// [side to move][leading pawn file]
+	const unsigned char* map;
+	volatile long ready;					// mapping has been tried, set last with atomicStore
+	bool loaded;
+};
+
+struct SyzygyEntry{
+	std::string name;						// path without the extension
+	unsigned int key;						// material with the first side of the name white
+	unsigned int key2;						// and with it black
+	int pieceCount;
+	int pawnCount[2];						// leading colour first
+	bool hasPawns;
+	bool hasUniquePieces;
+	bool hasDTZ;
+	SyzygyTable wdl;
+	SyzygyTable dtz;
+};
+
+static int s_mapPawns[SQUARE_NB];
+static int s_mapB1H1H7[SQUARE_NB];
+static int s_mapA1D1D4[SQUARE_NB];
+static int s_mapKK[10][SQUARE_NB];
+static U64 s_binomial[6][SQUARE_NB];
+static U64 s_leadPawnIdx[6][SQUARE_NB];
+static U64 s_leadPawnsSize[6][4];
+
+static unsigned int readLE16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static unsigned int readLE32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+static unsigned int readBE32(const unsigned char* p) { return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static U64 readBE64(const unsigned char* p) { return ((U64)readBE32(p) << 32) | readBE32(p + 4); }
+
+static int leftSym(const unsigned char* btree, int sym)
+{
+	const unsigned char* p = btree + sym * 3;
+	return ((p[1] & 0xF) << 8) | p[0];
+}
+
+static int rightSym(const unsigned char* btree, int sym)
+{
+	const unsigned char* p = btree + sym * 3;
+	return (p[2] << 4) | (p[1] >> 4);
+}
+
+static int offA1H8(int sq)
+{
+	return rankOf(sq) - fileOf(sq);
+}
+
+static bool pawnsBefore(int a, int b)
+{
+	return s_mapPawns[a] < s_mapPawns[b];
+}
+
+// the engine numbers pieces type * 2 + side, the files type + 1 plus 8 for black
+static int filePiece(int piece)
+{
+	return (pieceType(piece) + 1) | (pieceSide(piece) << 3);
+}
+
+static unsigned int materialKey(const int counts[2][6])
+{
+	unsigned int key = 0;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side)
+		for(int type=P_PAWN; type<P_KING; ++type)
+			key |= counts[side][type] << (3 * (side * 5 + type));
+
+	return key;
+}
+
+static int signOf(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+// distance to zeroing of a move that is itself a capture or pawn move
+static int dtzBeforeZeroing(int wdl)
+{
+	switch(wdl){
+		case WDL_WIN:			return 1;
+		case WDL_CURSED_WIN:	return 101;
+		case WDL_BLESSED_LOSS:	return -101;
+		case WDL_LOSS:			return -1;
+		default:				return 0;
+	}
+}
+
+// encoding tables, these reproduce the generator's layout
+static void initEncoding(void)
+{
+	static bool done = false;
+	std::vector<int> diagonal;
+	std::vector<std::pair<int, int> > bothOnDiagonal;
+	int code, available = 47;
+
+	if(done)
+		return;
+
+	// squares below the a1-h8 diagonal to 0..27
+	code = 0;
+	for(int sq=0; sq<SQUARE_NB; ++sq)
+		if(offA1H8(sq) < 0)
+			s_mapB1H1H7[sq] = code++;
+
+	// the a1-d1-d4 triangle to 0..9, diagonal squares last
+	code = 0;
+	for(int sq=SQ_A1; sq<=makeSquare(3, 3); ++sq){
+		if(offA1H8(sq) < 0 && fileOf(sq) <= 3)
+			s_mapA1D1D4[sq] = code++;
+		else if(offA1H8(sq) == 0 && fileOf(sq) <= 3)
+			diagonal.push_back(sq);
+	}
+	for(size_t i=0; i<diagonal.size(); ++i)
+		s_mapA1D1D4[diagonal[i]] = code++;
+
+	// the 462 placements of two kings with the first in the triangle, and the
+	// second not above the diagonal when the first is on it
+	code = 0;
+	for(int idx=0; idx<10; ++idx){
+		for(int s1=SQ_A1; s1<=makeSquare(3, 3); ++s1){
+			if(s_mapA1D1D4[s1] != idx || (idx == 0 && s1 != SQ_B1))
+				continue;
+
+			for(int s2=0; s2<SQUARE_NB; ++s2){
+				if(abs(fileOf(s1) - fileOf(s2)) <= 1 && abs(rankOf(s1) - rankOf(s2)) <= 1)
+					continue;
+				else if(offA1H8(s1) == 0 && offA1H8(s2) > 0)
+					continue;
+				else if(offA1H8(s1) == 0 && offA1H8(s2) == 0)
+					bothOnDiagonal.push_back(std::make_pair(idx, s2));
+				else
+					s_mapKK[idx][s2] = code++;
+			}
+		}
+	}
+	for(size_t i=0; i<bothOnDiagonal.size(); ++i)
+		s_mapKK[bothOnDiagonal[i].first][bothOnDiagonal[i].second] = code++;
+
+	s_binomial[0][0] = 1;
+	for(int n=1; n<SQUARE_NB; ++n)
+		for(int k=0; k<6 && k<=n; ++k)
+			s_binomial[k][n] = (k > 0 ? s_binomial[k - 1][n - 1] : 0) + (k < n ? s_binomial[k][n - 1] : 0);
+
+	// pawn squares a2-h7 to 47..0, nearest the edge and lowest rank highest. The
+	// pawn with the largest value leads and picks one of four sub-tables by file.
+	for(int lead=1; lead<=5; ++lead){
+		for(int file=0; file<4; ++file){
+			U64 idx = 0;
+
+			for(int rank=1; rank<=6; ++rank){
+				int sq = makeSquare(file, rank);
+
+				if(lead == 1){
+					s_mapPawns[sq] = available--;
+					s_mapPawns[sq ^ 7] = available--;
+				}
+
+				s_leadPawnIdx[lead][sq] = idx;
+				idx += s_binomial[lead - 1][s_mapPawns[sq]];
+			}
+
+			s_leadPawnsSize[lead][file] = idx;
+		}
+	}
+
+	done = true;
+}
+
+static void setGroups(const SyzygyEntry& e, PairsData* d, const int* order, int file)
+{
+	int n = 0, firstLen = e.hasPawns ? 0 : e.hasUniquePieces ? 3 : 2;
+	bool pp = e.hasPawns && e.pawnCount[1];
+	int next = pp ? 2 : 1;
+	int freeSquares;
+	U64 idx = 1;
+
+	// the leading group holds the first two or three pieces, or the leading
+	// pawns, after that each run of identical pieces is a group
+	d->groupLen[n] = 1;
+	for(int i=1; i<e.pieceCount; ++i){
+		if(--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+			d->groupLen[n]++;
+		else
+			d->groupLen[++n] = 1;
+	}
+	d->groupLen[++n] = 0;
+
+	// the groups are combined in the order the file gives
+	freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+
+	for(int k=0; next<n || k==order[0] || k==order[1]; ++k){
+		if(k == order[0]){
+			d->groupIdx[0] = idx;
+			idx *= e.hasPawns ? s_leadPawnsSize[d->groupLen[0]][file] : e.hasUniquePieces ? 31332 : 462;
+		}
+		else if(k == order[1]){
+			d->groupIdx[1] = idx;
+			idx *= s_binomial[d->groupLen[1]][48 - d->groupLen[0]];
+		}
+		else{
+			d->groupIdx[next] = idx;
+			idx *= s_binomial[d->groupLen[next]][freeSquares];
+			freeSquares -= d->groupLen[next++];
+		}
+	}
+
+	d->groupIdx[n] = idx;
+}
+
+// recursive pairing: a symbol stands for its left and right children in turn
+static int setSymlen(PairsData* d, int sym, std::vector<bool>& visited)
+{
+	int left, right;
+
+	visited[sym] = true;
+
+	right = rightSym(d->btree, sym);
+	if(right == 0xFFF)
+		return 0;
+
+	left = leftSym(d->btree, sym);
+	if(!visited[left])
+		d->symlen[left] = (unsigned char)setSymlen(d, left, visited);
+	if(!visited[right])
+		d->symlen[right] = (unsigned char)setSymlen(d, right, visited);
+
+	return d->symlen[left] + d->symlen[right] + 1;
+}
+
+static const unsigned char* setSizes(PairsData* d, const unsigned char* data)
+{
+	U64 tbSize;
+	int padding, num;
+
+	d->flags = *data++;
+
+	if(d->flags & FLAG_SINGLE_VALUE){
+		d->numBlocks = d->span = d->blockLengthSize = d->sparseIndexSize = 0;
+		d->minSymLen = *data++;							// the value itself
+		return data;
+	}
+
+	tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + SYZYGY_MAX_PIECES, 0) - d->groupLen];
+
+	d->sizeofBlock = 1ULL << *data++;
+	d->span = 1ULL << *data++;
+	d->sparseIndexSize = (tbSize + d->span - 1) / d->span;
+	padding = *data++;
+	d->numBlocks = readLE32(data);
+	data += 4;
+	d->blockLengthSize = d->numBlocks + padding;		// so the sparse index can't point past the end
+	d->maxSymLen = *data++;
+	d->minSymLen = *data++;
+	d->lowestSym = data;
+	d->base64.assign(d->maxSymLen - d->minSymLen + 1, 0);
+
+	// canonical Huffman code: longer symbols have lower values, so every length
+	// gets a left aligned lower bound and a code's length is found by comparison
+	for(int i=(int)d->base64.size()-2; i>=0; --i)
+		d->base64[i] = (d->base64[i + 1] + readLE16(d->lowestSym + i * 2) - readLE16(d->lowestSym + (i + 1) * 2)) / 2;
+
+	for(size_t i=0; i<d->base64.size(); ++i)
+		d->base64[i] <<= 64 - i - d->minSymLen;
+
+	data += d->base64.size() * 2;
+	num = readLE16(data);
+	data += 2;
+	d->symlen.assign(num, 0);
+	d->btree = data;
+
+	std::vector<bool> visited(num, false);
+	for(int sym=0; sym<num; ++sym)
+		if(!visited[sym])
+			d->symlen[sym] = (unsigned char)setSymlen(d, sym, visited);
+
+	return data + num * 3 + (num & 1);
+}
+
+static int decompressPairs(const PairsData* d, U64 idx)
+{
+	unsigned int k, block;
+	int offset, bufSize = 64, sym;
+	const unsigned char* p;
+	U64 buf;
+
+	if(d->flags & FLAG_SINGLE_VALUE)
+		return d->minSymLen;
+
+	// the sparse index gives the block and offset of value k * span + span / 2,
+	// from there walk to the block holding idx
+	k = (unsigned int)(idx / d->span);
+	block = readLE32(d->sparseIndex + k * 6);
+	offset = (int)readLE16(d->sparseIndex + k * 6 + 4);
+	offset += (int)(idx % d->span) - (int)(d->span / 2);
+
+	while(offset < 0)
+		offset += readLE16(d->blockLength + --block * 2) + 1;
+
+	while(offset > (int)readLE16(d->blockLength + block * 2))
+		offset -= readLE16(d->blockLength + block++ * 2) + 1;
+
+	p = d->data + block * d->sizeofBlock;
+	buf = readBE64(p);
+	p += 8;
+
+	// skip whole symbols until the one covering offset
+	for(;;){
+		int len = 0;
+
+		while(buf < d->base64[len])
+			++len;
+
+		sym = (int)((buf - d->base64[len]) >> (64 - len - d->minSymLen));
+		sym += readLE16(d->lowestSym + len * 2);
+
+		if(offset < d->symlen[sym] + 1)
+			break;
+
+		offset -= d->symlen[sym] + 1;
+		len += d->minSymLen;
+		buf <<= len;
+		bufSize -= len;
+
+		if(bufSize <= 32){
+			bufSize += 32;
+			buf |= (U64)readBE32(p) << (64 - bufSize);
+			p += 4;
+		}
+	}
+
+	// then descend the pairs to the single value at offset
+	while(d->symlen[sym]){
+		int left = leftSym(d->btree, sym);
+
+		if(offset < d->symlen[left] + 1){
+			sym = left;
+		}
+		else{
+			offset -= d->symlen[left] + 1;
+			sym = rightSym(d->btree, sym);
+		}
+	}
+
+	return leftSym(d->btree, sym);
+}
+
+static const unsigned char* setDtzMap(SyzygyTable& t, const unsigned char* data, const unsigned char* base, int maxFile)
+{
+	t.map = data;
+
+	for(int f=0; f<=maxFile; ++f){
+		PairsData* d = &t.items[0][f];
+
+		if(!(d->flags & FLAG_MAPPED))
+			continue;
+
+		if(d->flags & FLAG_WIDE){
+			data += (data - base) & 1;
+			for(int i=0; i<4; ++i){
+				d->mapIdx[i] = (int)((data - t.map) / 2 + 1);
+				data += 2 * readLE16(data) + 2;
+			}
+		}
+		else{
+			for(int i=0; i<4; ++i){
+				d->mapIdx[i] = (int)(data - t.map + 1);
+				data += *data + 1;
+			}
+		}
+	}
+
+	return data + ((data - base) & 1);
+}
+
+// reads the piece order, group layout and block tables of every sub-table
+static bool initTable(const SyzygyEntry& e, SyzygyTable& t, bool dtz)
+{
+	const unsigned char* base = t.file.getData();
+	const unsigned char* data = base + 4;
+	int sides = (!dtz && e.key != e.key2) ? 2 : 1;
+	int maxFile = e.hasPawns ? 3 : 0;
+	bool pp = e.hasPawns && e.pawnCount[1];
+
+	if(((*data & 2) != 0) != e.hasPawns)
+		return false;
+	++data;
+
+	for(int f=0; f<=maxFile; ++f){
+		int order[2][2] = {
+			{ data[0] & 0xF, pp ? data[1] & 0xF : 0xF },
+			{ data[0] >> 4, pp ? data[1] >> 4 : 0xF }
+		};
+
+		data += 1 + pp;
+
+		for(int k=0; k<e.pieceCount; ++k, ++data)
+			for(int i=0; i<sides; ++i)
+				t.items[i][f].pieces[k] = i ? *data >> 4 : *data & 0xF;
+
+		for(int i=0; i<sides; ++i)
+			setGroups(e, &t.items[i][f], order[i], f);
+	}
+
+	data += (data - base) & 1;
+
+	for(int f=0; f<=maxFile; ++f)
+		for(int i=0; i<sides; ++i)
+			data = setSizes(&t.items[i][f], data);
+
+	if(dtz)
+		data = setDtzMap(t, data, base, maxFile);
+
+	for(int f=0; f<=maxFile; ++f){
+		for(int i=0; i<sides; ++i){
+			t.items[i][f].sparseIndex = data;
+			data += t.items[i][f].sparseIndexSize * 6;
+		}
+	}
+
+	for(int f=0; f<=maxFile; ++f){
+		for(int i=0; i<sides; ++i){
+			t.items[i][f].blockLength = data;
+			data += t.items[i][f].blockLengthSize * 2;
+		}
+	}
+
+	for(int f=0; f<=maxFile; ++f){
+		for(int i=0; i<sides; ++i){
+			data += (64 - ((data - base) & 63)) & 63;
+			t.items[i][f].data = data;
+			data += t.items[i][f].numBlocks * t.items[i][f].sizeofBlock;
+		}
+	}
+
+	return data <= base + t.file.getSize();
+}
+
+Syzygy::Syzygy()
+{
+	m_path = SYZYGY_PATH;
+	m_maxPieces = 0;
+	m_initialized = false;
+}
+
+Syzygy::~Syzygy()
+{
+	close();
+}
+
+Syzygy& Syzygy::inst(void)
+{
+	static Syzygy syzygy;
+	return syzygy;
+}
+
+void Syzygy::setPath(const char* path)
+{
+	close();
+	m_path = path;
+}
+
+void Syzygy::close(void)
+{
+	for(size_t i=0; i<m_list.size(); ++i)
+		delete m_list[i];
+
+	m_list.clear();
+	m_entries.clear();
+	m_maxPieces = 0;
+	m_initialized = false;
+}
+
+void Syzygy::addEntry(const int counts[2][6])
+{
+	std::string path = m_path + ";";
+	char name[TB_NAME_SIZE];
+	int mirrored[2][6];
+	SyzygyEntry* e = NULL;
+
+	tbMaterialName(counts, name);
+
+	// a table may be in any of the directories
+	for(size_t start=0, end; start<path.size() && e == NULL; start=end+1){
+		std::string dir;
+		FILE* fp;
+
+		end = path.find(';', start);
+		dir = path.substr(start, end - start);
+		if(dir.empty())
+			continue;
+
+		fp = fopen((dir + "/" + name + ".rtbw").c_str(), "rb");
+		if(fp == NULL)
+			continue;
+		fclose(fp);
+
+		e = new SyzygyEntry;
+		e->name = dir + "/" + name;
+
+		fp = fopen((e->name + ".rtbz").c_str(), "rb");
+		e->hasDTZ = (fp != NULL);
+		if(fp)
+			fclose(fp);
+	}
+
+	if(e == NULL)
+		return;
+
+	for(int type=P_PAWN; type<=P_KING; ++type){
+		mirrored[SIDE_WHITE][type] = counts[SIDE_BLACK][type];
+		mirrored[SIDE_BLACK][type] = counts[SIDE_WHITE][type];
+	}
+
+	e->key = materialKey(counts);
+	e->key2 = materialKey(mirrored);
+	e->pieceCount = 2;
+	e->hasUniquePieces = false;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		for(int type=P_PAWN; type<P_KING; ++type){
+			e->pieceCount += counts[side][type];
+			if(counts[side][type] == 1)
+				e->hasUniquePieces = true;
+		}
+	}
+
+	// the side with fewer pawns leads, it compresses better
+	int wp = counts[SIDE_WHITE][P_PAWN], bp = counts[SIDE_BLACK][P_PAWN];
+	bool whiteLeads = (bp == 0) || (wp && bp >= wp);
+
+	e->hasPawns = (wp + bp) > 0;
+	e->pawnCount[0] = whiteLeads ? wp : bp;
+	e->pawnCount[1] = whiteLeads ? bp : wp;
+	e->wdl.ready = e->dtz.ready = 0;
+	e->wdl.loaded = e->dtz.loaded = false;
+	e->wdl.map = e->dtz.map = NULL;
+
+	m_list.push_back(e);
+	m_entries[e->key] = e;
+	m_entries[e->key2] = e;
+
+	if(e->pieceCount > m_maxPieces)
+		m_maxPieces = e->pieceCount;
+}
+
+// every material combination under its file name, stronger side first
+static void listMaterials(int counts[2][6], int type, int side, int pieces, std::vector<std::vector<int> >& lists)
+{
+	char name[TB_NAME_SIZE];
+
+	if(type < P_PAWN){
+		if(side == SIDE_WHITE)
+			listMaterials(counts, P_QUEEN, SIDE_BLACK, pieces, lists);
+		else if(pieces > 2 && !tbMaterialName(counts, name))
+			lists.push_back(std::vector<int>(&counts[0][0], &counts[0][0] + 12));
+		return;
+	}
+
+	for(int n=0; pieces+n<=SYZYGY_MAX_PIECES; ++n){
+		counts[side][type] = n;
+		listMaterials(counts, type - 1, side, pieces + n, lists);
+	}
+	counts[side][type] = 0;
+}
+
+int Syzygy::init(void)
+{
+	std::vector<std::vector<int> > lists;
+	int counts[2][6] = {{0}};
+
+	close();
+	initEncoding();
+
+	if(m_path.empty())
+		return 0;
+
+	counts[SIDE_WHITE][P_KING] = counts[SIDE_BLACK][P_KING] = 1;
+	listMaterials(counts, P_QUEEN, SIDE_WHITE, 2, lists);
+
+	for(size_t i=0; i<lists.size(); ++i){
+		memcpy(counts, &lists[i][0], sizeof(counts));
+		addEntry(counts);
+	}
+
+	m_initialized = true;
+	return (int)m_list.size();
+}
+
+// maps a file the first time it's needed, other threads wait for the first one
+bool Syzygy::mapTable(SyzygyEntry& e, bool dtz)
+{
+	SyzygyTable& t = dtz ? e.dtz : e.wdl;
+	std::string file = e.name + (dtz ? ".rtbz" : ".rtbw");
+
+	// the acquire pairs with the release below, so loaded and the table data are complete
+	if(atomicLoad(&t.ready))
+		return t.loaded;
+
+	m_mapLock.lock();
+
+	if(!t.ready){
+		t.loaded = false;
+
+		if(t.file.open(file.c_str())){
+			if(t.file.getSize() % 64 == 16 && readLE32(t.file.getData()) == (dtz ? DTZ_MAGIC : WDL_MAGIC) && initTable(e, t, dtz))
+				t.loaded = true;
+			else
+				printf("%s is not a Syzygy table\n", file.c_str());
+		}
+
+		if(!t.loaded)
+			t.file.close();
+		atomicStore(&t.ready, 1);
+	}
+
+	m_mapLock.unlock();
+	return t.loaded;
+}
+
+// value stored for the position: WDL + 2 for .rtbw, plies or moves to zeroing for .rtbz
+int Syzygy::probeTable(const Position& pos, bool dtz, int wdl, int& state)
+{
+	std::map<unsigned int, SyzygyEntry*>::iterator it;
+	int squares[SYZYGY_MAX_PIECES], pieces[SYZYGY_MAX_PIECES];
+	int counts[2][6], size = 0, leadPawnsCnt = 0, tbFile = 0, next = 0;
+	U64 b, leadPawns = 0, idx;
+	const PairsData* d;
+	SyzygyEntry* e;
+
+	if(popCount(pos.getOccupied()) == 2)
+		return WDL_DRAW;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side)
+		for(int type=P_PAWN; type<=P_KING; ++type)
+			counts[side][type] = popCount(pos.getPieces(side, type));
+
+	it = m_entries.find(materialKey(counts));
+	if(it == m_entries.end() || (dtz && !it->second->hasDTZ) || !mapTable(*it->second, dtz)){
+		state = PROBE_FAIL;
+		return 0;
+	}
+
+	e = it->second;
+	SyzygyTable& t = dtz ? e->dtz : e->wdl;
+
+	// the files are built with the first side of the name white, and symmetric
+	// material only with white to move: otherwise swap the colours
+	bool flip = (e->key == e->key2) ? pos.getSide() == SIDE_BLACK : materialKey(counts) != e->key;
+	int flipColor = flip ? 8 : 0, flipSquares = flip ? 56 : 0;
+	int stm = (flip ? 1 : 0) ^ pos.getSide();
+
+	// pawn tables are split by the file of the leading pawn
+	if(e->hasPawns){
+		int pc = t.items[0][0].pieces[0] ^ flipColor;
+
+		leadPawns = b = pos.getPieces(pc >> 3, P_PAWN);
+		while(b)
+			squares[size++] = popLsb(b) ^ flipSquares;
+
+		leadPawnsCnt = size;
+		std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawnsBefore));
+
+		tbFile = fileOf(squares[0]);
+		if(tbFile > 3)
+			tbFile = fileOf(squares[0] ^ 7);
+	}
+
+	// DTZ files are one sided
+	if(dtz){
+		int flags = t.items[0][tbFile].flags;
+
+		if((flags & FLAG_STM) != stm && !(e->key == e->key2 && !e->hasPawns)){
+			state = PROBE_CHANGE_STM;
+			return 0;
+		}
+	}
+
+	b = pos.getOccupied() ^ leadPawns;
+	while(b){
+		int sq = popLsb(b);
+
+		squares[size] = sq ^ flipSquares;
+		pieces[size++] = filePiece(pos.getPieceAt(sq)) ^ flipColor;
+	}
+
+	d = &t.items[dtz ? 0 : stm][e->hasPawns ? tbFile : 0];
+
+	// put the pieces in the order the file lists them
+	for(int i=leadPawnsCnt; i<size-1; ++i){
+		for(int j=i+1; j<size; ++j){
+			if(d->pieces[i] == pieces[j]){
+				std::swap(pieces[i], pieces[j]);
+				std::swap(squares[i], squares[j]);
+				break;
+			}
+		}
+	}
+
+	if(fileOf(squares[0]) > 3)
+		for(int i=0; i<size; ++i)
+			squares[i] ^= 7;
+
+	if(e->hasPawns){
+		idx = s_leadPawnIdx[leadPawnsCnt][squares[0]];
+
+		std::stable_sort(squares + 1, squares + leadPawnsCnt, pawnsBefore);
+		for(int i=1; i<leadPawnsCnt; ++i)
+			idx += s_binomial[i][s_mapPawns[squares[i]]];
+	}
+	else{
+		if(rankOf(squares[0]) > 3)
+			for(int i=0; i<size; ++i)
+				squares[i] ^= 56;
+
+		// the first leading piece off the diagonal goes below it
+		for(int i=0; i<d->groupLen[0]; ++i){
+			if(!offA1H8(squares[i]))
+				continue;
+
+			if(offA1H8(squares[i]) > 0)
+				for(int j=i; j<size; ++j)
+					squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+			break;
+		}
+
+		// the leading group: three unique pieces together, otherwise the two kings
+		if(e->hasUniquePieces){
+			int adjust1 = squares[1] > squares[0];
+			int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+			if(offA1H8(squares[0]))
+				idx = ((U64)s_mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+			else if(offA1H8(squares[1]))
+				idx = ((U64)6 * 63 + rankOf(squares[0]) * 28 + s_mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+			else if(offA1H8(squares[2]))
+				idx = 6 * 63 * 62 + 4 * 28 * 62 + rankOf(squares[0]) * 7 * 28
+					+ (rankOf(squares[1]) - adjust1) * 28 + s_mapB1H1H7[squares[2]];
+			else
+				idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rankOf(squares[0]) * 7 * 6
+					+ (rankOf(squares[1]) - adjust1) * 6 + (rankOf(squares[2]) - adjust2);
+		}
+		else{
+			idx = s_mapKK[s_mapA1D1D4[squares[0]]][squares[1]];
+		}
+	}
+
+	// the remaining groups, each as a combination of the squares left over
+	idx *= d->groupIdx[0];
+	int* groupSq = squares + d->groupLen[0];
+	bool remainingPawns = e->hasPawns && e->pawnCount[1];
+
+	while(d->groupLen[++next]){
+		U64 n = 0;
+
+		std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+
+		for(int i=0; i<d->groupLen[next]; ++i){
+			int adjust = 0;
+
+			for(int* s=squares; s<groupSq; ++s)
+				adjust += groupSq[i] > *s;
+
+			n += s_binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+		}
+
+		remainingPawns = false;
+		idx += n * d->groupIdx[next];
+		groupSq += d->groupLen[next];
+	}
+
+	int value = decompressPairs(d, idx);
+
+	if(!dtz)
+		return value - 2;
+
+	// DTZ values go through a per file map, and some are stored in moves
+	static const int wdlMap[] = { 1, 3, 0, 2, 0 };
+	int flags = t.items[0][tbFile].flags;
+
+	if(flags & FLAG_MAPPED){
+		const int* mapIdx = t.items[0][tbFile].mapIdx;
+
+		if(flags & FLAG_WIDE)
+			value = readLE16(t.map + 2 * (mapIdx[wdlMap[wdl + 2]] + value));
+		else
+			value = t.map[mapIdx[wdlMap[wdl + 2]] + value];
+	}
+
+	if((wdl == WDL_WIN && !(flags & FLAG_WIN_PLIES)) || (wdl == WDL_LOSS && !(flags & FLAG_LOSS_PLIES))
+		|| wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS)
+		value *= 2;
+
+	return value + 1;
+}
+
+// the tables know nothing of en passant, so captures are tried first. With
+// zeroing set pawn moves are tried too, DTZ values are unreliable when one is best.
+int Syzygy::search(Position& pos, int& state, bool zeroing)
+{
+	Move moves[MAX_MOVES];
+	int n = pos.genLegalMoves(moves);
+	int count = 0, value, best = WDL_LOSS;
+	bool noMoreMoves;
+
+	for(int i=0; i<n; ++i){
+		Move m = moves[i];
+
+		if(!pos.isCapture(m) && (!zeroing || pieceType(pos.getPieceAt(moveFrom(m))) != P_PAWN))
+			continue;
+
+		++count;
+
+		pos.makeMove(m);
+		value = -search(pos, state, false);
+		pos.unmakeMove(m);
+
+		if(state == PROBE_FAIL)
+			return WDL_DRAW;
+
+		if(value > best){
+			best = value;
+
+			if(value >= WDL_WIN){
+				state = PROBE_ZEROING;
+				return value;
+			}
+		}
+	}
+
+	noMoreMoves = count > 0 && count == n;
+
+	if(noMoreMoves){
+		value = best;
+	}
+	else{
+		value = probeTable(pos, false, WDL_DRAW, state);
+		if(state == PROBE_FAIL)
+			return WDL_DRAW;
+	}
+
+	if(best >= value){
+		state = (best > WDL_DRAW || noMoreMoves) ? PROBE_ZEROING : PROBE_OK;
+		return best;
+	}
+
+	state = PROBE_OK;
+	return value;
+}
+
+bool Syzygy::probeWDL(Position& pos, int& wdl)
+{
+	int state = PROBE_OK;
+
+	if(!m_initialized || pos.getCastle() || popCount(pos.getOccupied()) > m_maxPieces)
+		return false;
+
+	wdl = search(pos, state, false);
+	return state != PROBE_FAIL;
+}
+
+bool Syzygy::probeDTZ(Position& pos, int& dtz)
+{
+	Move moves[MAX_MOVES];
+	int state = PROBE_OK, wdl, n, minDTZ = 0xFFFF;
+
+	if(!m_initialized || pos.getCastle() || popCount(pos.getOccupied()) > m_maxPieces)
+		return false;
+
+	wdl = search(pos, state, true);
+	if(state == PROBE_FAIL)
+		return false;
+
+	// draws aren't stored
+	if(wdl == WDL_DRAW){
+		dtz = 0;
+		return true;
+	}
+
+	if(state == PROBE_ZEROING){
+		dtz = dtzBeforeZeroing(wdl);
+		return true;
+	}
+
+	dtz = probeTable(pos, true, wdl, state);
+	if(state == PROBE_FAIL)
+		return false;
+
+	if(state != PROBE_CHANGE_STM){
+		dtz = (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * signOf(wdl);
+		return true;
+	}
+
+	// stored for the other side to move: look one move ahead
+	n = pos.genLegalMoves(moves);
+	for(int i=0; i<n; ++i){
+		bool zeroingMove = pos.isCapture(moves[i]) || pieceType(pos.getPieceAt(moveFrom(moves[i]))) == P_PAWN;
+		int value, childWdl;
+		bool ok;
+
+		pos.makeMove(moves[i]);
+
+		// after a zeroing move only the result matters, its distance restarts
+		if(zeroingMove){
+			ok = probeWDL(pos, childWdl);
+			value = -dtzBeforeZeroing(childWdl);
+		}
+		else{
+			ok = probeDTZ(pos, value);
+			value = -value;
+		}
+
+		if(ok && value == 1 && pos.inCheck()){
+			Move replies[MAX_MOVES];
+
+			if(pos.genLegalMoves(replies) == 0)
+				minDTZ = 1;
+		}
+
+		pos.unmakeMove(moves[i]);
+
+		if(!ok)
+			return false;
+
+		if(!zeroingMove)
+			value += signOf(value);
+
+		if(value < minDTZ && signOf(value) == signOf(wdl))
+			minDTZ = value;
+	}
+
+	// no moves means mate
+	dtz = (minDTZ == 0xFFFF) ? -1 : minDTZ;
+	return true;
+}
+
+// ranks every move by DTZ from the root, keeping to the fifty move rule
+Move Syzygy::probeRoot(Position& pos, int& wdl)
+{
+	Move moves[MAX_MOVES], best = MOVE_NONE;
+	int n, halfmove = pos.getHalfmove();
+	int bestRank = 0, bestDTZ = 0;
+
+	if(!m_initialized || pos.getCastle() || popCount(pos.getOccupied()) > m_maxPieces)
+		return MOVE_NONE;
+
+	n = pos.genLegalMoves(moves);
+
+	for(int i=0; i<n; ++i){
+		int dtz, rank;
+		bool ok;
+
+		pos.makeMove(moves[i]);
+
+		if(pos.getHalfmove() == 0){
+			int childWdl;
+
+			ok = probeWDL(pos, childWdl);
+			dtz = dtzBeforeZeroing(-childWdl);
+		}
+		else{
+			ok = probeDTZ(pos, dtz);
+			dtz = -dtz;
+			dtz = (dtz > 0) ? dtz + 1 : (dtz < 0) ? dtz - 1 : 0;
+		}
+
+		// a mating move counts as one ply
+		if(ok && dtz == 2 && pos.inCheck()){
+			Move replies[MAX_MOVES];
+
+			if(pos.genLegalMoves(replies) == 0)
+				dtz = 1;
+		}
+
+		pos.unmakeMove(moves[i]);
+
+		if(!ok)
+			return MOVE_NONE;
+
+		// wins inside the fifty move rule are equal, then the fewest plies to
+		// the next zeroing move decide so the win keeps making progress
+		if(dtz > 0)
+			rank = (dtz + halfmove <= 99) ? MAX_RANK : MAX_RANK - (dtz + halfmove);
+		else if(dtz < 0)
+			rank = (-dtz * 2 + halfmove < 100) ? -MAX_RANK : -MAX_RANK + (-dtz + halfmove);
+		else
+			rank = 0;
+
+		if(best == MOVE_NONE || rank > bestRank || (rank == bestRank && dtz < bestDTZ)){
+			best = moves[i];
+			bestRank = rank;
+			bestDTZ = dtz;
+		}
+	}
+
+	wdl = (bestRank >= MAX_RANK) ? WDL_WIN : (bestRank > 0) ? WDL_CURSED_WIN : (bestRank == 0) ? WDL_DRAW
+		: (bestRank > -MAX_RANK) ? WDL_BLESSED_LOSS : WDL_LOSS;
+	return best;
+}
@@ -0,0 +1,101 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "mappedfile.h"
+#include "thread.h"
+
+#define SYZYGY_PATH			"Data/Syzygy"
+#define SYZYGY_MAX_PIECES	7
+
+struct SyzygyEntry;
+
+// results from the side to move's point of view. Cursed wins and blessed losses
+// are drawn by the fifty move rule.
+enum wdlScores{
+	WDL_LOSS = -2,
+	WDL_BLESSED_LOSS,
+	WDL_DRAW,
+	WDL_CURSED_WIN,
+	WDL_WIN
+};
+
+// Syzygy tablebases: .rtbw files hold win/draw/loss, .rtbz files the distance to
+// the next capture or pawn move. init() looks for the files, each one is
+// memory-mapped the first time a position needs it. Probes may come from several
+// threads at once.
+class Syzygy{
+public:
+	static Syzygy& inst(void);
+
+	int init(void);												// returns the number of tables found
+	void close(void);
+
+	bool probeWDL(Position& pos, int& wdl);
+	bool probeDTZ(Position& pos, int& dtz);						// plies, positive when winning
+	Move probeRoot(Position& pos, int& wdl);					// quickest safe win or slowest loss
+
+	// getter functions
+	const char* getPath(void) const;
+	int getMaxPieces(void) const;
+	bool isInitialized(void) const;
+
+	// setter functions
+	void setPath(const char* path);								// directories separated by ';'
+
+private:
+	Syzygy();
+	~Syzygy();
+	Syzygy(const Syzygy&);
+	Syzygy& operator=(const Syzygy&);
+
+	void addEntry(const int counts[2][6]);
+	bool mapTable(SyzygyEntry& e, bool dtz);
+	int probeTable(const Position& pos, bool dtz, int wdl, int& state);
+	int search(Position& pos, int& state, bool zeroing);
+
+	std::map<unsigned int, SyzygyEntry*> m_entries;			// both colourings of each table
+	std::vector<SyzygyEntry*> m_list;
+	std::string m_path;
+	Mutex m_mapLock;
+	int m_maxPieces;
+	bool m_initialized;
+};
+
+inline const char* Syzygy::getPath(void) const
+{
+	return m_path.c_str();
+}
+
+inline int Syzygy::getMaxPieces(void) const
+{
+	return m_maxPieces;
+}
+
+inline bool Syzygy::isInitialized(void) const
+{
+	return m_initialized;
+}
@@ -0,0 +1,599 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "tablebase.h"
+
+#define TB_HEADER_SIZE	40				// magic, version, block size, blocks, entries, name
+
+static const char TYPE_CHARS[] = "PNBRQK";
+
+// the white king is folded into a1-d1-d4 without pawns, onto files a-d with them
+static const int s_triangle[10] = {
+	SQ_A1, SQ_B1, SQ_C1, SQ_D1, 9, 10, 11, 18, 19, 27
+};
+
+static int s_triangleIdx[SQUARE_NB];
+
+static void initTriangle(void)
+{
+	static bool done = false;
+
+	if(done)
+		return;
+
+	for(int sq=0; sq<SQUARE_NB; ++sq)
+		s_triangleIdx[sq] = -1;
+	for(int i=0; i<10; ++i)
+		s_triangleIdx[s_triangle[i]] = i;
+
+	done = true;
+}
+
+static bool hasPawns(const TBPosition& tp)
+{
+	for(int i=2; i<tp.count; ++i)
+		if(pieceType(tp.piece[i]) == P_PAWN)
+			return true;
+
+	return false;
+}
+
+static unsigned int readU32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void writeU32(FILE* fp, unsigned int v)
+{
+	unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+	fwrite(b, 1, 4, fp);
+}
+
+// runs of (length, value) pairs
+static int decodeEntry(const unsigned char* p, const unsigned char* end, unsigned int pos)
+{
+	for(; p + 1 < end; p += 2){
+		if(pos < p[0])
+			return p[1];
+		pos -= p[0];
+	}
+
+	return TB_ILLEGAL;
+}
+
+bool tbSetMaterial(const char* name, TBPosition& tp)
+{
+	int side = SIDE_WHITE;
+
+	if(name[0] != 'K')
+		return false;
+
+	tp.count = 2;
+	tp.side = SIDE_WHITE;
+	tp.piece[0] = makePiece(SIDE_WHITE, P_KING);
+	tp.piece[1] = makePiece(SIDE_BLACK, P_KING);
+
+	for(const char* p=name+1; *p; ++p){
+		if(*p == 'v' && side == SIDE_WHITE && p[1] == 'K'){
+			side = SIDE_BLACK;
+			++p;
+			continue;
+		}
+
+		const char* c = strchr(TYPE_CHARS, *p);
+		if(c == NULL || *c == 'K' || tp.count == TB_MAX_PIECES)
+			return false;
+
+		tp.piece[tp.count] = makePiece(side, (int)(c - TYPE_CHARS));
+		tp.square[tp.count++] = SQ_NONE;
+	}
+
+	return side == SIDE_BLACK;
+}
+
+bool tbMaterialName(const int counts[2][6], char* name)
+{
+	int num[2] = {0, 0};
+	bool swap = false;
+
+	for(int type=P_PAWN; type<P_KING; ++type){
+		num[SIDE_WHITE] += counts[SIDE_WHITE][type];
+		num[SIDE_BLACK] += counts[SIDE_BLACK][type];
+	}
+
+	// more pieces first, then the stronger pieces
+	if(num[SIDE_WHITE] != num[SIDE_BLACK]){
+		swap = num[SIDE_BLACK] > num[SIDE_WHITE];
+	}
+	else{
+		for(int type=P_QUEEN; type>=P_PAWN; --type){
+			if(counts[SIDE_WHITE][type] != counts[SIDE_BLACK][type]){
+				swap = counts[SIDE_BLACK][type] > counts[SIDE_WHITE][type];
+				break;
+			}
+		}
+	}
+
+	for(int i=0; i<2; ++i){
+		int side = swap ? i ^ 1 : i;
+
+		if(i == 1)
+			*name++ = 'v';
+		*name++ = 'K';
+
+		for(int type=P_QUEEN; type>=P_PAWN; --type)
+			for(int n=0; n<counts[side][type]; ++n)
+				*name++ = TYPE_CHARS[type];
+	}
+
+	*name = '\0';
+	return swap;
+}
+
+bool tbFromPosition(const Position& pos, TBPosition& tp, char* name)
+{
+	int counts[2][6];
+	bool swap;
+
+	if(popCount(pos.getOccupied()) > TB_MAX_PIECES)
+		return false;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side)
+		for(int type=P_PAWN; type<=P_KING; ++type)
+			counts[side][type] = popCount(pos.getPieces(side, type));
+
+	swap = tbMaterialName(counts, name);
+
+	// a swapped position is mirrored vertically so pawns keep their direction
+	tp.count = 0;
+	tp.side = swap ? pos.getSide() ^ 1 : pos.getSide();
+
+	for(int i=0; i<2; ++i){
+		int side = swap ? i ^ 1 : i;
+
+		tp.piece[tp.count] = makePiece(i, P_KING);
+		tp.square[tp.count++] = swap ? pos.getKingSquare(side) ^ 56 : pos.getKingSquare(side);
+	}
+
+	for(int i=0; i<2; ++i){
+		int side = swap ? i ^ 1 : i;
+
+		for(int type=P_QUEEN; type>=P_PAWN; --type){
+			for(U64 b = pos.getPieces(side, type); b;){
+				int sq = popLsb(b);
+
+				tp.piece[tp.count] = makePiece(i, type);
+				tp.square[tp.count++] = swap ? sq ^ 56 : sq;
+			}
+		}
+	}
+
+	return true;
+}
+
+U64 tbSize(const TBPosition& tp)
+{
+	U64 size = (hasPawns(tp) ? 32 : 10) * SQUARE_NB;
+
+	for(int i=2; i<tp.count; ++i)
+		size *= (pieceType(tp.piece[i]) == P_PAWN) ? 48 : SQUARE_NB;
+
+	return size;
+}
+
+// index of squares already folded by the symmetries
+static U64 encode(const TBPosition& tp, int* sq, bool pawns)
+{
+	U64 idx;
+
+	// identical pieces are stored in square order
+	for(int i=3; i<tp.count; ++i){
+		for(int j=i; j>2 && tp.piece[j] == tp.piece[j - 1] && sq[j] < sq[j - 1]; --j){
+			int t = sq[j];
+			sq[j] = sq[j - 1];
+			sq[j - 1] = t;
+		}
+	}
+
+	idx = pawns ? rankOf(sq[0]) * 4 + fileOf(sq[0]) : s_triangleIdx[sq[0]];
+	idx = idx * SQUARE_NB + sq[1];
+
+	for(int i=2; i<tp.count; ++i){
+		if(pieceType(tp.piece[i]) == P_PAWN)
+			idx = idx * 48 + (sq[i] - 8);
+		else
+			idx = idx * SQUARE_NB + sq[i];
+	}
+
+	return idx;
+}
+
+U64 tbIndex(const TBPosition& tp)
+{
+	int sq[TB_MAX_PIECES];
+	bool pawns = hasPawns(tp);
+
+	initTriangle();
+	memcpy(sq, tp.square, sizeof(sq));
+
+	// mirror the white king onto files a-d, and without pawns below the a1-h8 diagonal
+	if(fileOf(sq[0]) > 3)
+		for(int i=0; i<tp.count; ++i)
+			sq[i] ^= 7;
+
+	if(!pawns){
+		if(rankOf(sq[0]) > 3)
+			for(int i=0; i<tp.count; ++i)
+				sq[i] ^= 56;
+
+		if(rankOf(sq[0]) > fileOf(sq[0])){
+			for(int i=0; i<tp.count; ++i)
+				sq[i] = (fileOf(sq[i]) << 3) | rankOf(sq[i]);
+		}
+		else if(rankOf(sq[0]) == fileOf(sq[0])){
+			// a king on the diagonal leaves two mirror images, keep the smaller index
+			int flipped[TB_MAX_PIECES];
+			U64 a, b;
+
+			for(int i=0; i<tp.count; ++i)
+				flipped[i] = (fileOf(sq[i]) << 3) | rankOf(sq[i]);
+
+			a = encode(tp, sq, pawns);
+			b = encode(tp, flipped, pawns);
+			return (a < b) ? a : b;
+		}
+	}
+
+	return encode(tp, sq, pawns);
+}
+
+bool tbDecode(U64 idx, TBPosition& tp)
+{
+	U64 occupied = 0, rest = idx;
+
+	for(int i=tp.count-1; i>=2; --i){
+		if(pieceType(tp.piece[i]) == P_PAWN){
+			tp.square[i] = (int)(rest % 48) + 8;
+			rest /= 48;
+		}
+		else{
+			tp.square[i] = (int)(rest % SQUARE_NB);
+			rest /= SQUARE_NB;
+		}
+	}
+
+	tp.square[1] = (int)(rest % SQUARE_NB);
+	rest /= SQUARE_NB;
+	tp.square[0] = hasPawns(tp) ? makeSquare((int)rest % 4, (int)rest / 4) : s_triangle[rest];
+
+	for(int i=0; i<tp.count; ++i){
+		if(occupied & squareBB(tp.square[i]))
+			return false;
+		occupied |= squareBB(tp.square[i]);
+	}
+
+	// other orders of identical pieces and mirror images are stored once
+	return tbIndex(tp) == idx;
+}
+
+bool tbSave(const char* file, const char* name, unsigned char* const values[2], U64 entries)
+{
+	unsigned int numBlocks = (unsigned int)((entries + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE);
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned char> data;
+	char header[TB_NAME_SIZE] = {0};
+	FILE* fp;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		for(unsigned int b=0; b<numBlocks; ++b){
+			U64 end = ((U64)b + 1) * TB_BLOCK_SIZE;
+
+			if(end > entries)
+				end = entries;
+
+			offsets.push_back((unsigned int)data.size());
+			for(U64 i=(U64)b*TB_BLOCK_SIZE; i<end;){
+				unsigned char v = values[side][i];
+				int run = 0;
+
+				// illegal positions are never probed, so they join whatever run they're in
+				for(; i<end && run < 255; ++i, ++run){
+					unsigned char next = values[side][i];
+
+					if(next == TB_ILLEGAL)
+						continue;
+					if(v == TB_ILLEGAL)
+						v = next;
+					if(next != v)
+						break;
+				}
+
+				data.push_back((unsigned char)run);
+				data.push_back(v);
+			}
+		}
+	}
+	offsets.push_back((unsigned int)data.size());
+
+	fp = fopen(file, "wb");
+	if(fp == NULL){
+		printf("Can't write %s\n", file);
+		return false;
+	}
+
+	strncpy(header, name, TB_NAME_SIZE - 1);
+
+	writeU32(fp, TB_MAGIC);
+	writeU32(fp, TB_VERSION);
+	writeU32(fp, TB_BLOCK_SIZE);
+	writeU32(fp, numBlocks);
+	writeU32(fp, (unsigned int)entries);
+	writeU32(fp, (unsigned int)(entries >> 32));
+	fwrite(header, 1, TB_NAME_SIZE, fp);
+
+	for(size_t i=0; i<offsets.size(); ++i)
+		writeU32(fp, offsets[i]);
+	fwrite(&data[0], 1, data.size(), fp);
+
+	if(ferror(fp)){
+		printf("Error writing %s\n", file);
+		fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// checks the header and returns the block count, 0 if the file doesn't hold this table
+static unsigned int checkHeader(const MappedFile& file, const char* name, U64 entries)
+{
+	const unsigned char* p = file.getData();
+	unsigned int numBlocks;
+	size_t dataStart;
+
+	if(file.getSize() < TB_HEADER_SIZE)
+		return 0;
+
+	numBlocks = readU32(p + 12);
+	dataStart = TB_HEADER_SIZE + ((size_t)numBlocks * 2 + 1) * 4;
+
+	if(readU32(p) != TB_MAGIC || readU32(p + 4) != TB_VERSION || readU32(p + 8) != TB_BLOCK_SIZE)
+		return 0;
+
+	if((readU32(p + 16) | ((U64)readU32(p + 20) << 32)) != entries || strncmp((const char*)p + 24, name, TB_NAME_SIZE) != 0)
+		return 0;
+
+	if(numBlocks != (entries + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE || file.getSize() < dataStart)
+		return 0;
+
+	if(file.getSize() < dataStart + readU32(p + TB_HEADER_SIZE + (size_t)numBlocks * 8))
+		return 0;
+
+	return numBlocks;
+}
+
+bool tbLoad(const char* file, const char* name, unsigned char* values[2], U64 entries)
+{
+	MappedFile mapped;
+	unsigned int numBlocks;
+
+	if(!mapped.open(file))
+		return false;
+
+	numBlocks = checkHeader(mapped, name, entries);
+	if(numBlocks == 0){
+		printf("%s is not a %s table\n", file, name);
+		return false;
+	}
+
+	const unsigned char* offsets = mapped.getData() + TB_HEADER_SIZE;
+	const unsigned char* data = offsets + ((size_t)numBlocks * 2 + 1) * 4;
+
+	for(int side=SIDE_WHITE; side<=SIDE_BLACK; ++side){
+		U64 i = 0;
+
+		for(unsigned int b=0; b<numBlocks; ++b){
+			unsigned int block = side * numBlocks + b;
+			const unsigned char* p = data + readU32(offsets + block * 4);
+			const unsigned char* end = data + readU32(offsets + (block + 1) * 4);
+
+			for(; p + 1 < end && i < entries; p += 2)
+				for(int n=0; n<p[0] && i<entries; ++n)
+					values[side][i++] = p[1];
+		}
+
+		if(i != entries){
+			printf("%s is damaged\n", file);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Tablebases::Tablebases()
+{
+	m_path = TB_DIR;
+}
+
+Tablebases::~Tablebases()
+{
+	close();
+}
+
+Tablebases& Tablebases::inst(void)
+{
+	static Tablebases tablebases;
+	return tablebases;
+}
+
+void Tablebases::setPath(const char* path)
+{
+	m_lock.lock();
+	freeTables();
+	m_path = path;
+	m_lock.unlock();
+}
+
+void Tablebases::close(void)
+{
+	m_lock.lock();
+	freeTables();
+	m_lock.unlock();
+}
+
+void Tablebases::freeTables(void)
+{
+	for(std::map<std::string, Table*>::iterator it = m_tables.begin(); it != m_tables.end(); ++it)
+		delete it->second;
+
+	m_tables.clear();
+}
+
+// missing tables are remembered too, so each file is only tried once
+Tablebases::Table* Tablebases::getTable(const char* name)
+{
+	std::map<std::string, Table*>::iterator it;
+	Table* table;
+
+	m_lock.lock();
+
+	it = m_tables.find(name);
+	if(it != m_tables.end()){
+		table = it->second;
+	}
+	else{
+		table = loadTable(name);
+		m_tables[name] = table;
+	}
+
+	m_lock.unlock();
+	return table;
+}
+
+Tablebases::Table* Tablebases::loadTable(const char* name)
+{
+	std::string file = m_path + "/" + name + TB_EXT;
+	TBPosition tp;
+	Table* table = new Table;
+
+	if(!tbSetMaterial(name, tp) || !table->file.open(file.c_str())){
+		delete table;
+		return NULL;
+	}
+
+	table->entries = tbSize(tp);
+	table->numBlocks = checkHeader(table->file, name, table->entries);
+	if(table->numBlocks == 0){
+		printf("%s is not a %s table\n", file.c_str(), name);
+		delete table;
+		return NULL;
+	}
+
+	table->offsets = table->file.getData() + TB_HEADER_SIZE;
+	table->data = table->offsets + ((size_t)table->numBlocks * 2 + 1) * 4;
+
+	return table;
+}
+
+int Tablebases::probe(const Position& pos)
+{
+	char name[TB_NAME_SIZE];
+	TBPosition tp;
+	Table* table;
+	U64 idx;
+
+	if(pos.getCastle() || !tbFromPosition(pos, tp, name))
+		return TB_UNKNOWN;
+
+	if(tp.count == 2)
+		return TB_DRAW;
+
+	// the tables have no en passant rights, so look one move ahead instead
+	if(pos.getEnPassant() != SQ_NONE){
+		Position copy = pos;
+		int value;
+
+		return probeRoot(copy, value) != MOVE_NONE ? value : TB_UNKNOWN;
+	}
+
+	table = getTable(name);
+	if(table == NULL)
+		return TB_UNKNOWN;
+
+	idx = tbIndex(tp);
+
+	unsigned int block = tp.side * table->numBlocks + (unsigned int)(idx / TB_BLOCK_SIZE);
+	const unsigned char* p = table->data + readU32(table->offsets + block * 4);
+	const unsigned char* end = table->data + readU32(table->offsets + (block + 1) * 4);
+	int value = decodeEntry(p, end, (unsigned int)(idx % TB_BLOCK_SIZE));
+
+	return (value == TB_ILLEGAL) ? TB_UNKNOWN : value;
+}
+
+Move Tablebases::probeRoot(Position& pos, int& value)
+{
+	Move moves[MAX_MOVES], best = MOVE_NONE;
+	int n, bestRank = -1000;
+
+	if(pos.getCastle() || popCount(pos.getOccupied()) > TB_MAX_PIECES)
+		return MOVE_NONE;
+
+	n = pos.genLegalMoves(moves);
+	if(n == 0)
+		return MOVE_NONE;
+
+	for(int i=0; i<n; ++i){
+		int child, ours, rank;
+
+		pos.makeMove(moves[i]);
+		child = probe(pos);
+		pos.unmakeMove(moves[i]);
+
+		if(child == TB_UNKNOWN)
+			return MOVE_NONE;
+
+		// shortest win, then a draw, then the longest loss
+		if(tbIsLoss(child)){
+			ours = child - TB_LOSS + 1;
+			rank = 1000 - ours;
+		}
+		else if(tbIsWin(child)){
+			ours = TB_LOSS + child;
+			rank = -1000 + child;
+		}
+		else{
+			ours = TB_DRAW;
+			rank = 0;
+		}
+
+		if(rank > bestRank){
+			bestRank = rank;
+			best = moves[i];
+			value = ours;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "position.h"
+#include "mappedfile.h"
+#include "thread.h"
+
+#define TB_DIR			"Data/Tablebases"
+#define TB_EXT			".ectb"
+#define TB_MAGIC		0x42544345		// "ECTB"
+#define TB_VERSION		1
+#define TB_MAX_PIECES	5
+#define TB_NAME_SIZE	16
+#define TB_BLOCK_SIZE	4096			// entries per separately compressed block
+
+// one byte per position from the side to move's point of view:
+// 1..127 mate in n moves, TB_LOSS + n mated in n moves
+#define TB_DRAW			0
+#define TB_LOSS			128
+#define TB_ILLEGAL		255
+#define TB_UNKNOWN		-1				// no table for the position
+
+inline bool tbIsWin(int v)		{ return v > TB_DRAW && v < TB_LOSS; }
+inline bool tbIsLoss(int v)		{ return v >= TB_LOSS && v < TB_ILLEGAL; }
+
+// the pieces of a material combination in index order: white king, black king, then
+// white and black pieces strongest first. Colours are swapped so white is the stronger side.
+struct TBPosition{
+	int piece[TB_MAX_PIECES];
+	int square[TB_MAX_PIECES];
+	int count;
+	int side;
+};
+
+// material names ("KRPvKR") and position indexing, shared by ectbgen and the prober
+bool tbSetMaterial(const char* name, TBPosition& tp);
+bool tbMaterialName(const int counts[2][6], char* name);			// true when the colours must be swapped
+bool tbFromPosition(const Position& pos, TBPosition& tp, char* name);
+U64 tbSize(const TBPosition& tp);
+U64 tbIndex(const TBPosition& tp);									// folds the board symmetries
+bool tbDecode(U64 idx, TBPosition& tp);								// false unless idx is the canonical index of a placement
+
+// compressed files: header, block offsets for both sides to move, run length coded blocks.
+// Illegal positions are stored as whatever value makes the runs longest.
+bool tbSave(const char* file, const char* name, unsigned char* const values[2], U64 entries);
+bool tbLoad(const char* file, const char* name, unsigned char* values[2], U64 entries);
+
+// tables generated by ectbgen, memory-mapped on first use
+class Tablebases{
+public:
+	static Tablebases& inst(void);
+
+	void close(void);
+
+	int probe(const Position& pos);								// TB value or TB_UNKNOWN
+	Move probeRoot(Position& pos, int& value);					// shortest win, or longest loss
+
+	// getter functions
+	const char* getPath(void) const;
+
+	// setter functions
+	void setPath(const char* path);
+
+private:
+	struct Table{
+		MappedFile file;
+		U64 entries;
+		unsigned int numBlocks;
+		const unsigned char* offsets;
+		const unsigned char* data;
+	};
+
+	Tablebases();
+	~Tablebases();
+	Tablebases(const Tablebases&);
+	Tablebases& operator=(const Tablebases&);
+
+	Table* getTable(const char* name);
+	Table* loadTable(const char* name);
+	void freeTables(void);
+
+	// every search thread probes, so the cache and path are only touched under the lock.
+	// A table, once loaded, stays mapped until close() or setPath().
+	Mutex m_lock;
+	std::map<std::string, Table*> m_tables;					// NULL when the file is missing
+	std::string m_path;
+};
+
+inline const char* Tablebases::getPath(void) const
+{
+	return m_path.c_str();
+}
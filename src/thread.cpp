@@ -0,0 +1,277 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#if !defined(_WIN32)
+	#include <sys/time.h>
+	#include <unistd.h>
+#endif
+#if defined(__linux__)
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+#endif
+
+#include "thread.h"
+
+Thread::Thread()
+{
+#if defined(_WIN32)
+	m_handle = NULL;
+#endif
+	m_func = NULL;
+	m_arg = NULL;
+	m_running = false;
+}
+
+Thread::~Thread()
+{
+	join();
+}
+
+bool Thread::start(ThreadFunc func, void* arg)
+{
+	if(m_running)
+		return false;
+
+	m_func = func;
+	m_arg = arg;
+
+#if defined(_WIN32)
+	m_handle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)&entry, this, 0, 0);
+	m_running = (m_handle != NULL);
+#else
+	m_running = (pthread_create(&m_thread, NULL, &entry, this) == 0);
+#endif
+
+	return m_running;
+}
+
+void Thread::join(void)
+{
+	if(!m_running)
+		return;
+
+#if defined(_WIN32)
+	WaitForSingleObject(m_handle, INFINITE);
+	CloseHandle(m_handle);
+	m_handle = NULL;
+#else
+	pthread_join(m_thread, NULL);
+#endif
+
+	m_running = false;
+}
+
+#if defined(_WIN32)
+unsigned long WINAPI Thread::entry(void* lpThread)
+{
+	Thread* t = (Thread*)lpThread;
+
+	t->m_func(t->m_arg);
+	return 0;
+}
+#else
+void* Thread::entry(void* lpThread)
+{
+	Thread* t = (Thread*)lpThread;
+
+	t->m_func(t->m_arg);
+	return NULL;
+}
+#endif
+
+Mutex::Mutex()
+{
+#if defined(_WIN32)
+	InitializeCriticalSection(&m_cs);
+#else
+	pthread_mutex_init(&m_mutex, NULL);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#if defined(_WIN32)
+	DeleteCriticalSection(&m_cs);
+#else
+	pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void Mutex::lock(void)
+{
+#if defined(_WIN32)
+	EnterCriticalSection(&m_cs);
+#else
+	pthread_mutex_lock(&m_mutex);
+#endif
+}
+
+bool Mutex::tryLock(void)
+{
+#if defined(_WIN32)
+	return TryEnterCriticalSection(&m_cs) != 0;
+#else
+	return pthread_mutex_trylock(&m_mutex) == 0;
+#endif
+}
+
+void Mutex::unlock(void)
+{
+#if defined(_WIN32)
+	LeaveCriticalSection(&m_cs);
+#else
+	pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+Event::Event()
+{
+#if defined(_WIN32)
+	m_handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_cond, NULL);
+	m_set = false;
+#endif
+}
+
+Event::~Event()
+{
+#if defined(_WIN32)
+	CloseHandle(m_handle);
+#else
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void Event::set(void)
+{
+#if defined(_WIN32)
+	SetEvent(m_handle);
+#else
+	pthread_mutex_lock(&m_mutex);
+	m_set = true;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+bool Event::wait(unsigned int ms)
+{
+#if defined(_WIN32)
+	return WaitForSingleObject(m_handle, ms) == WAIT_OBJECT_0;
+#else
+	struct timeval now;
+	struct timespec until;
+	bool set;
+
+	gettimeofday(&now, NULL);
+	until.tv_sec = now.tv_sec + ms / 1000;
+	until.tv_nsec = (now.tv_usec + (long)(ms % 1000) * 1000) * 1000;
+	if(until.tv_nsec >= 1000000000){
+		until.tv_sec += 1;
+		until.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	while(!m_set && pthread_cond_timedwait(&m_cond, &m_mutex, &until) == 0)
+		;
+	set = m_set;
+	m_set = false;
+	pthread_mutex_unlock(&m_mutex);
+
+	return set;
+#endif
+}
+
+int getNumCpus(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (int)n : 1;
+#endif
+}
+
+void sleepMs(unsigned int ms)
+{
+#if defined(_WIN32)
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+// Linux keeps a nice value per thread, elsewhere on POSIX the thread keeps its priority
+void lowerThreadPriority(void)
+{
+#if defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+}
+
+long atomicAdd(volatile long* value, long add)
+{
+#if defined(_WIN32)
+	return InterlockedExchangeAdd(value, add);
+#else
+	return __sync_fetch_and_add(value, add);
+#endif
+}
+
+unsigned long long atomicOr(volatile unsigned long long* value, unsigned long long bits)
+{
+#if defined(_WIN32)
+	LONGLONG old;
+
+	do{
+		old = *(volatile LONGLONG*)value;
+	}while(InterlockedCompareExchange64((volatile LONGLONG*)value, old | bits, old) != old);
+
+	return (unsigned long long)old;
+#else
+	return __sync_fetch_and_or(value, bits);
+#endif
+}
+
+long atomicLoad(volatile long* value)
+{
+#if defined(_WIN32)
+	return InterlockedCompareExchange(value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void atomicStore(volatile long* value, long v)
+{
+#if defined(_WIN32)
+	InterlockedExchange(value, v);
+#else
+	__atomic_store_n(value, v, __ATOMIC_RELEASE);
+#endif
+}
@@ -0,0 +1,119 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+typedef void (*ThreadFunc)(void* arg);
+
+// minimal portable threads for the engine and the headless tools
+class Thread{
+public:
+	Thread();
+	~Thread();
+
+	bool start(ThreadFunc func, void* arg);
+	void join(void);
+
+	// getter functions
+	bool isRunning(void) const;
+
+private:
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+
+#if defined(_WIN32)
+	static unsigned long WINAPI entry(void* lpThread);
+
+	HANDLE m_handle;
+#else
+	static void* entry(void* lpThread);
+
+	pthread_t m_thread;
+#endif
+
+	ThreadFunc m_func;
+	void* m_arg;
+	bool m_running;
+};
+
+class Mutex{
+public:
+	Mutex();
+	~Mutex();
+
+	void lock(void);
+	bool tryLock(void);							// false instead of waiting when it's held
+	void unlock(void);
+
+private:
+	Mutex(const Mutex&);
+	Mutex& operator=(const Mutex&);
+
+#if defined(_WIN32)
+	CRITICAL_SECTION m_cs;
+#else
+	pthread_mutex_t m_mutex;
+#endif
+};
+
+// auto-reset signal: set() wakes one wait(), or the next one if nobody waits yet
+class Event{
+public:
+	Event();
+	~Event();
+
+	void set(void);
+	bool wait(unsigned int ms);					// false when it timed out
+
+private:
+	Event(const Event&);
+	Event& operator=(const Event&);
+
+#if defined(_WIN32)
+	HANDLE m_handle;
+#else
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+	bool m_set;
+#endif
+};
+
+int getNumCpus(void);
+void sleepMs(unsigned int ms);
+void lowerThreadPriority(void);					// calling thread, for background work that must not slow the game
+
+// atomic read-modify-write, both return the previous value
+long atomicAdd(volatile long* value, long add);
+unsigned long long atomicOr(volatile unsigned long long* value, unsigned long long bits);
+
+// publishing a flag: writes before the store are visible to a thread whose load sees it
+long atomicLoad(volatile long* value);
+void atomicStore(volatile long* value, long v);
+
+inline bool Thread::isRunning(void) const
+{
+	return m_running;
+}
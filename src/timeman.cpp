@@ -0,0 +1,99 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include "timeman.h"
+
+// percent of the optimum time by how many iterations in a row agreed on the move
+static const int STABILITY_SCALE[5] = { 130, 110, 95, 80, 65 };
+
+#define SCORE_DROP			30			// centipawns lost since the last iteration that count as trouble
+#define FAIL_LOW_SCALE		150			// percent, on top of the stability scale
+
+TimeManager::TimeManager()
+{
+	m_optimum = m_maximum = 0;
+	m_lastBest = MOVE_NONE;
+	m_lastScore = 0;
+	m_stability = 0;
+	m_failLow = m_extend = false;
+}
+
+void TimeManager::init(unsigned int time, unsigned int inc, int movesToGo)
+{
+	unsigned int avail = (time > TM_OVERHEAD) ? time - TM_OVERHEAD : 1;
+
+	if(movesToGo <= 0)
+		movesToGo = TM_MOVES_TO_GO;
+
+	// an even share of the clock plus most of the increment, never more than
+	// a fixed share of what is left so a long think can't lose on time
+	m_maximum = avail * TM_MAX_SHARE / 100 + inc / 2;
+	if(m_maximum > avail)
+		m_maximum = avail;
+
+	m_optimum = avail / movesToGo + inc * 3 / 4;
+	if(m_optimum > m_maximum)
+		m_optimum = m_maximum;
+
+	if(m_maximum > m_optimum * 5)
+		m_maximum = m_optimum * 5;
+
+	m_lastBest = MOVE_NONE;
+	m_lastScore = 0;
+	m_stability = 0;
+	m_failLow = m_extend = false;
+}
+
+void TimeManager::update(Move best, int score)
+{
+	if(best == m_lastBest){
+		if(m_stability < 4)
+			++m_stability;
+	}
+	else{
+		m_stability = 0;
+	}
+
+	// a fail low in this iteration or a falling score buys the next one more time
+	m_extend = m_failLow || (m_lastBest != MOVE_NONE && score < m_lastScore - SCORE_DROP);
+	m_failLow = false;
+	m_lastBest = best;
+	m_lastScore = score;
+}
+
+void TimeManager::failLow(void)
+{
+	m_failLow = true;
+}
+
+unsigned int TimeManager::getSoftLimit(void) const
+{
+	unsigned int soft = m_optimum * STABILITY_SCALE[m_stability] / 100;
+
+	if(m_extend)
+		soft = soft * FAIL_LOW_SCALE / 100;
+
+	return (soft < m_maximum) ? soft : m_maximum;
+}
+
+bool TimeManager::stopIteration(unsigned int elapsed) const
+{
+	return m_optimum > 0 && elapsed >= getSoftLimit();
+}
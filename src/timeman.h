@@ -0,0 +1,66 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+
+#define TM_MOVES_TO_GO		30			// moves assumed left when the clock has no move count
+#define TM_OVERHEAD			50			// milliseconds kept back for the GUI and the pipes
+#define TM_MAX_SHARE		30			// percent of the remaining clock one move may use
+
+// splits the clock into a soft limit, checked between iterations, and a hard
+// limit the search is stopped at. The soft limit shrinks while the best move
+// stays the same and grows after the root score drops.
+class TimeManager{
+public:
+	TimeManager();
+
+	void init(unsigned int time, unsigned int inc, int movesToGo);
+	void update(Move best, int score);				// after every completed iteration
+	void failLow(void);								// the root fell below the aspiration window
+
+	bool stopIteration(unsigned int elapsed) const;	// not worth starting another iteration
+
+	// getter functions
+	unsigned int getOptimum(void) const;
+	unsigned int getMaximum(void) const;
+	unsigned int getSoftLimit(void) const;
+
+private:
+	unsigned int m_optimum;
+	unsigned int m_maximum;
+
+	Move m_lastBest;
+	int m_lastScore;
+	int m_stability;							// iterations the best move has survived
+	bool m_failLow;
+	bool m_extend;								// the last iteration failed low or lost score
+};
+
+inline unsigned int TimeManager::getOptimum(void) const
+{
+	return m_optimum;
+}
+
+inline unsigned int TimeManager::getMaximum(void) const
+{
+	return m_maximum;
+}
@@ -0,0 +1,204 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "tt.h"
+
+TransTable::TransTable()
+{
+	m_table = NULL;
+	m_mask = 0;
+	m_generation = 0;
+
+	resize(TT_DEFAULT_MB);
+}
+
+TransTable::~TransTable()
+{
+	if(isMapped())
+		save();
+	else
+		delete[] m_table;
+}
+
+// the number of clusters is rounded down to a power of two
+U64 TransTable::numClusters(unsigned int mb)
+{
+	U64 clusters = 1;
+	U64 bytes = (U64)mb * 1024 * 1024;
+
+	while(clusters * 2 * sizeof(Cluster) <= bytes)
+		clusters *= 2;
+
+	return clusters;
+}
+
+bool TransTable::resize(unsigned int mb)
+{
+	U64 clusters = numClusters(mb);
+
+	if(isMapped()){
+		save();
+		m_file.close();
+	}
+	else{
+		delete[] m_table;
+	}
+
+	m_table = new(std::nothrow) Cluster[(size_t)clusters];
+	if(m_table == NULL){
+		m_mask = 0;
+		m_table = new Cluster[1];
+		clear();
+		return false;
+	}
+
+	m_mask = clusters - 1;
+	clear();
+	return true;
+}
+
+bool TransTable::mapFile(const char* file, unsigned int mb, U64 signature)
+{
+	U64 clusters = numClusters(mb);
+	TTFileHeader* header;
+
+	if(isMapped()){
+		save();
+		m_file.close();
+	}
+	else{
+		delete[] m_table;
+	}
+
+	if(!m_file.openWritable(file, sizeof(TTFileHeader) + (size_t)(clusters * sizeof(Cluster)))){
+		printf("Can't map the table file %s, using memory\n", file);
+		m_table = NULL;
+		resize(mb);
+		return false;
+	}
+
+	header = (TTFileHeader*)m_file.getWritableData();
+	m_table = (Cluster*)(m_file.getWritableData() + sizeof(TTFileHeader));
+	m_mask = clusters - 1;
+
+	// pages are only read in as entries are probed, so a matching file costs nothing up front
+	if(header->magic == TT_FILE_MAGIC && header->version == TT_FILE_VERSION
+		&& header->signature == signature && header->clusters == clusters){
+		m_generation = (unsigned char)header->generation;
+		return true;
+	}
+
+	if(header->magic != 0)
+		printf("%s was saved by another engine version, starting over\n", file);
+
+	memset(header, 0, sizeof(TTFileHeader));
+	header->magic = TT_FILE_MAGIC;
+	header->version = TT_FILE_VERSION;
+	header->signature = signature;
+	header->clusters = clusters;
+	clear();
+	return true;
+}
+
+// the mapping is written back as it is, only the generation lives outside it
+void TransTable::save(void)
+{
+	if(!isMapped())
+		return;
+
+	((TTFileHeader*)m_file.getWritableData())->generation = m_generation;
+	m_file.flush();
+}
+
+void TransTable::clear(void)
+{
+	memset(m_table, 0, (size_t)(m_mask + 1) * sizeof(Cluster));
+	m_generation = 0;
+}
+
+void TransTable::newSearch(void)
+{
+	m_generation += 4;
+}
+
+bool TransTable::probe(U64 key, TTEntry& entry) const
+{
+	Cluster* c = getCluster(key);
+
+	for(int i=0; i<TT_CLUSTER_SIZE; ++i){
+		if(c->entries[i].key == key && c->entries[i].getBound() != BOUND_NONE){
+			entry = c->entries[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TransTable::store(U64 key, Move move, int score, int eval, int depth, int bound)
+{
+	Cluster* c = getCluster(key);
+	TTEntry* replace = &c->entries[0];
+
+	for(int i=0; i<TT_CLUSTER_SIZE; ++i){
+		TTEntry* e = &c->entries[i];
+
+		if(e->key == key || e->getBound() == BOUND_NONE){
+			replace = e;
+			break;
+		}
+
+		// prefer replacing shallow entries from older searches
+		int age = (unsigned char)(m_generation - (e->genBound & 0xFC)) >> 2;
+		int replaceAge = (unsigned char)(m_generation - (replace->genBound & 0xFC)) >> 2;
+		if(e->depth - 8 * age < replace->depth - 8 * replaceAge)
+			replace = e;
+	}
+
+	// keep the old move when this search didn't find one
+	if(move != MOVE_NONE || replace->key != key)
+		replace->move = (unsigned short)move;
+
+	replace->key = key;
+	replace->score = (short)score;
+	replace->eval = (short)eval;
+	replace->depth = (unsigned char)((depth < 0) ? 0 : depth);
+	replace->genBound = (unsigned char)(m_generation | bound);
+}
+
+int TransTable::hashfull(void) const
+{
+	int used = 0;
+	int samples = (m_mask + 1 < 1000) ? (int)(m_mask + 1) : 1000;
+
+	for(int i=0; i<samples; ++i){
+		for(int j=0; j<TT_CLUSTER_SIZE; ++j){
+			const TTEntry& e = m_table[i].entries[j];
+			if(e.getBound() != BOUND_NONE && (e.genBound & 0xFC) == m_generation)
+				++used;
+		}
+	}
+
+	return used * 1000 / (samples * TT_CLUSTER_SIZE);
+}
@@ -0,0 +1,103 @@
+/*
+ *  Ethereal Chess - OpenGL 3D Chess - <http://etherealchess.sourceforge.net/>
+ *  Copyright (C) 2012 Jordan Sparks - unixunited@live.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Special thanks to http://www.dhpoware.com/ for providing some OpenGL code.
+ */
+
+#pragma once
+
+#include "position.h"
+#include "mappedfile.h"
+
+#define TT_CLUSTER_SIZE	4
+#define TT_DEFAULT_MB	64
+#define TT_FILE_MAGIC	0x54544345		// "ECTT"
+#define TT_FILE_VERSION	1
+
+enum bounds{
+	BOUND_NONE = 0,
+	BOUND_UPPER,
+	BOUND_LOWER,
+	BOUND_EXACT
+};
+
+// 16 bytes, four of them share a 64 byte cache line
+struct TTEntry{
+	U64 key;
+	unsigned short move;
+	short score;
+	short eval;
+	unsigned char depth;
+	unsigned char genBound;		// generation in the upper six bits, bound in the lower two
+
+	int getBound(void) const { return genBound & 3; }
+};
+
+// 64 bytes at the start of a saved table, the clusters follow it
+struct TTFileHeader{
+	unsigned int magic;
+	unsigned int version;
+	U64 signature;				// Search::getSignature() of the engine that filled it
+	U64 clusters;
+	unsigned int generation;
+	unsigned char pad[36];
+};
+
+// transposition table shared by the built-in search
+class TransTable{
+public:
+	TransTable();
+	~TransTable();
+
+	bool resize(unsigned int mb);
+	void clear(void);
+	void newSearch(void);
+
+	// persistent table in a memory-mapped file. A file from another engine or
+	// evaluation is started over, otherwise its entries are used as they are.
+	bool mapFile(const char* file, unsigned int mb, U64 signature);
+	void save(void);
+	bool isMapped(void) const;
+
+	bool probe(U64 key, TTEntry& entry) const;
+	void store(U64 key, Move move, int score, int eval, int depth, int bound);
+	int hashfull(void) const;							// permille of entries used by this search
+
+private:
+	struct Cluster{
+		TTEntry entries[TT_CLUSTER_SIZE];
+	};
+
+	Cluster* getCluster(U64 key) const;
+
+	static U64 numClusters(unsigned int mb);
+
+	Cluster* m_table;
+	U64 m_mask;
+	unsigned char m_generation;
+	MappedFile m_file;
+};
+
+inline bool TransTable::isMapped(void) const
+{
+	return m_file.isOpen();
+}
+
+inline TransTable::Cluster* TransTable::getCluster(U64 key) const
+{
+	return &m_table[key & m_mask];
+}